@@ -13,3 +13,7 @@ CFLAGS += -Wno-address
 # Include common header file
 #
 CFLAGS += -include compiler.h
+
+# Enable GNU extensions (e.g. fopencookie())
+#
+CFLAGS += -D_GNU_SOURCE
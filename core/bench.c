@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Benchmarks
+ *
+ * Each benchmark is a linker table entry, allowing the same
+ * measurements to be made both on the target and on a host build.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <uniport/bench.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/string.h>
+#include <uniport/timer.h>
+
+/**
+ * Report benchmark measurement
+ *
+ * @v name		Benchmark name
+ * @v variant		Variant measured
+ * @v ticks		Elapsed time (in ticks)
+ * @v ops		Number of operations performed
+ */
+void bench_report ( const char *name, const char *variant,
+		    unsigned long ticks, unsigned long long ops ) {
+	unsigned long long ns;
+
+	ns = ( ( ( unsigned long long ) ticks ) *
+	       ( 1000000000ULL / TICKS_PER_SEC ) );
+	cprintf ( "%s: %-18s %9llu ops %6lu.%03lums %8llu.%01llu ns/op\n",
+		  name, variant, ops, ( ticks / TICKS_PER_MS ),
+		  ( ticks % TICKS_PER_MS ), ( ops ? ( ns / ops ) : 0 ),
+		  ( ops ? ( ( ( ns * 10 ) / ops ) % 10 ) : 0 ) );
+}
+
+/** "bench" options */
+struct bench_options {
+	/** Number of iterations */
+	unsigned int count;
+};
+
+/** "bench" option list */
+static struct option_descriptor bench_opts[] = {
+	OPTION_DESC ( "count", 'n', required_argument,
+		      struct bench_options, count, parse_integer ),
+};
+
+/** "bench" command descriptor */
+static struct command_descriptor bench_cmd =
+	COMMAND_DESC ( struct bench_options, bench_opts, 0, MAX_ARGUMENTS,
+		       "[<name-pattern>...]" );
+
+/**
+ * Check if benchmark was selected
+ *
+ * @v bench		Benchmark
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret selected	Benchmark was selected
+ */
+static int bench_selected ( struct benchmark *bench, int argc, char **argv ) {
+	int i;
+
+	/* Run all benchmarks if none are named */
+	if ( optind >= argc )
+		return 1;
+
+	/* Otherwise, run only the matching benchmarks */
+	for ( i = optind ; i < argc ; i++ ) {
+		if ( glob_match ( argv[i], bench->name ) )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * "bench" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int bench_exec ( int argc, char **argv ) {
+	struct bench_options opts;
+	struct benchmark *bench;
+	unsigned int found = 0;
+	int rc;
+
+	/* Parse options, with defaults */
+	memset ( &opts, 0, sizeof ( opts ) );
+	opts.count = BENCH_DEFAULT_COUNT;
+	if ( ( rc = reparse_options ( argc, argv, &bench_cmd, &opts ) ) != 0 )
+		return rc;
+	if ( ! opts.count ) {
+		cprintf ( "%s: count must be non-zero\n", argv[0] );
+		return -EINVAL;
+	}
+
+	/* Run selected benchmarks */
+	for_each_table_entry ( bench, BENCHMARKS ) {
+		if ( ! bench_selected ( bench, argc, argv ) )
+			continue;
+		found++;
+		if ( ( rc = bench->run ( opts.count ) ) != 0 ) {
+			cprintf ( "%s: %s failed: %s\n",
+				  argv[0], bench->name, strerror ( rc ) );
+			return rc;
+		}
+	}
+	if ( ! found ) {
+		cprintf ( "%s: no such benchmark\n", argv[0] );
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+/** "bench" command */
+struct command bench_command __command = {
+	.name = "bench",
+	.exec = bench_exec,
+};
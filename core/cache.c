@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Resource retrieval cache
+ *
+ * Resources backed by slow hardware (e.g. sensors on an I2C bus) may
+ * specify a cache lifetime in their descriptor.  The state returned
+ * by retrieve() will then be reused until the lifetime expires, and
+ * a retrieval requested while another is already in progress will
+ * wait for and share the in-progress result.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <uniport/cache.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/timer.h>
+
+/** Cache lock */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Cache retrieval completion */
+static pthread_cond_t cache_done = PTHREAD_COND_INITIALIZER;
+
+/**
+ * Reserve retrieval cache
+ *
+ * @v res		Resource
+ * @ret rc		Return status code
+ */
+int cache_reserve ( struct resource *res ) {
+
+	/* Allocate and initialise cache */
+	res->cache = calloc ( 1, sizeof ( *res->cache ) );
+	if ( ! res->cache )
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * Release retrieval cache
+ *
+ * @v res		Resource
+ */
+void cache_release ( struct resource *res ) {
+
+	/* Free cache */
+	free ( res->cache );
+	res->cache = NULL;
+}
+
+/**
+ * Retrieve resource state via cache
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+const void * cache_retrieve ( struct resource *res ) {
+	struct resource_cache *cache = res->cache;
+	const void *state;
+	unsigned long now;
+	unsigned int generation;
+	int waited = 0;
+
+	pthread_mutex_lock ( &cache_lock );
+
+	/* Wait for any in-progress retrieval to complete */
+	while ( 1 ) {
+
+		/* Use cached state if still valid */
+		now = currticks();
+		if ( cache->state &&
+		     ( ( now - cache->fetched ) < res->desc->ttl ) ) {
+			if ( waited ) {
+				cache->coalesced++;
+			} else {
+				cache->hits++;
+			}
+			state = cache->state;
+			goto out;
+		}
+
+		/* Retrieve state unless a retrieval is in progress */
+		if ( ! cache->busy )
+			break;
+		pthread_cond_wait ( &cache_done, &cache_lock );
+		waited = 1;
+	}
+
+	/* Retrieve state, without holding the lock */
+	cache->busy = 1;
+	cache->misses++;
+	generation = cache->generation;
+	pthread_mutex_unlock ( &cache_lock );
+	state = res->desc->retrieve ( res );
+	pthread_mutex_lock ( &cache_lock );
+
+	/* Store retrieved state unless the cache was invalidated
+	 * while the retrieval was in progress, since the retrieved
+	 * state may predate the change that caused the invalidation.
+	 */
+	if ( cache->generation == generation ) {
+		cache->state = state;
+		cache->fetched = now;
+	}
+	cache->busy = 0;
+	pthread_cond_broadcast ( &cache_done );
+
+ out:
+	pthread_mutex_unlock ( &cache_lock );
+	return state;
+}
+
+/**
+ * Invalidate cached resource state
+ *
+ * @v res		Resource
+ */
+void cache_invalidate ( struct resource *res ) {
+	struct resource_cache *cache = res->cache;
+
+	pthread_mutex_lock ( &cache_lock );
+	cache->state = NULL;
+	cache->generation++;
+	pthread_mutex_unlock ( &cache_lock );
+}
+
+/** "cache" options */
+struct cache_options {};
+
+/** "cache" option list */
+static struct option_descriptor cache_opts[] = {};
+
+/** "cache" command descriptor */
+static struct command_descriptor cache_cmd =
+	COMMAND_DESC ( struct cache_options, cache_opts, 0, 1,
+		       "[<uri-pattern>]" );
+
+/**
+ * "cache" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int cache_exec ( int argc, char **argv ) {
+	struct cache_options opts;
+	struct resource_cache *cache;
+	struct resource *res;
+	const char *pattern;
+	unsigned int i;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &cache_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Parse URI pattern, if present */
+	pattern = ( ( optind < argc ) ? argv[optind] : "*" );
+
+	/* Print cache statistics */
+	for ( i = 0 ; i < resource_index_count ; i++ ) {
+		res = resource_index[i];
+		cache = res->cache;
+		if ( ! cache )
+			continue;
+		if ( ! resource_uri_match ( res, pattern ) )
+			continue;
+		cprintf ( "%s%s: hits=%lu misses=%lu coalesced=%lu\n",
+			  res->ns->uri, res->uri, cache->hits, cache->misses,
+			  cache->coalesced );
+	}
+
+	return 0;
+}
+
+/** "cache" command */
+struct command cache_command __command = {
+	.name = "cache",
+	.exec = cache_exec,
+};
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Batched stream channels
+ *
+ * A channel owns a connected stream socket and a thread that writes
+ * out queued data in batches.  Data is constructed directly within a
+ * fixed-size outbound buffer by whichever thread produces it, without
+ * any system calls.  The channel thread swaps this buffer with a
+ * second buffer and writes out everything accumulated so far in a
+ * single write(), so that many messages share each system call.
+ *
+ * The owning protocol supplies the handling of received data and of
+ * any periodic work (such as retransmissions or checkpoints) via the
+ * channel operations.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <uniport/channel.h>
+#include <uniport/timer.h>
+
+/**
+ * Reserve space within outbound buffer
+ *
+ * @v chan		Channel
+ * @v len		Length of data
+ * @ret data		Data pointer, or NULL if there is insufficient space
+ *
+ * Must be called with the channel lock held.  One additional byte
+ * beyond the end of the data is guaranteed to be writable, to allow
+ * for the NUL written when formatting property values.
+ */
+uint8_t * channel_reserve ( struct channel *chan, size_t len ) {
+	uint8_t *data;
+	uint8_t wake = 0;
+
+	/* Check for space */
+	if ( ( chan->tx_len + len + 1 /* NUL */ ) > chan->size )
+		return NULL;
+
+	/* Wake channel thread when the buffer first becomes non-empty */
+	if ( ! chan->tx_len ) {
+		if ( write ( chan->wake[1], &wake, sizeof ( wake ) ) < 0 ) {
+			/* Channel thread will notice within CHANNEL_IDLE_MS */
+		}
+	}
+
+	data = &chan->tx[chan->tx_len];
+	chan->tx_len += len;
+	return data;
+}
+
+/**
+ * Read received data
+ *
+ * @v chan		Channel
+ * @v buf		Data buffer
+ * @v len		Length of data buffer
+ * @ret len		Length of data read, or negative error
+ *
+ * A closed connection is reported as an error, and the absence of
+ * any data is reported as a zero length.
+ */
+ssize_t channel_read ( struct channel *chan, void *buf, size_t len ) {
+	ssize_t rc;
+
+	rc = read ( chan->fd, buf, len );
+	if ( rc < 0 )
+		return ( ( errno == EAGAIN ) ? 0 : -errno );
+	if ( ( rc == 0 ) && len )
+		return -ECONNRESET;
+	return rc;
+}
+
+/**
+ * Transmit data
+ *
+ * @v chan		Channel
+ * @ret rc		Return status code
+ */
+static int channel_transmit ( struct channel *chan ) {
+	uint8_t *tmp;
+	ssize_t len;
+
+	/* Swap buffers, if the outbound buffer has been written out */
+	pthread_mutex_lock ( &chan->lock );
+	if ( ( ! chan->out_len ) && chan->tx_len ) {
+		tmp = chan->out;
+		chan->out = chan->tx;
+		chan->out_len = chan->tx_len;
+		chan->out_offset = 0;
+		chan->tx = tmp;
+		chan->tx_len = 0;
+	}
+	pthread_mutex_unlock ( &chan->lock );
+
+	/* Write out as much as possible */
+	if ( ! chan->out_len )
+		return 0;
+	len = write ( chan->fd, ( chan->out + chan->out_offset ),
+		      chan->out_len );
+	if ( len < 0 )
+		return ( ( errno == EAGAIN ) ? 0 : -errno );
+	chan->out_offset += len;
+	chan->out_len -= len;
+	chan->active = currticks();
+	chan->stats.writes++;
+	chan->stats.bytes += len;
+
+	return 0;
+}
+
+/**
+ * Run channel thread
+ *
+ * @v arg		Channel
+ * @ret arg		Unused
+ */
+static void * channel_thread ( void *arg ) {
+	struct channel *chan = arg;
+	struct channel_operations *op = chan->op;
+	struct pollfd pfd[2];
+	uint8_t discard[16];
+	int timeout;
+	int rc = 0;
+
+	while ( chan->running ) {
+
+		/* Wait for data, space, or wakeup */
+		pfd[0].fd = chan->fd;
+		pfd[0].events = ( POLLIN | ( chan->out_len ? POLLOUT : 0 ) );
+		pfd[1].fd = chan->wake[0];
+		pfd[1].events = POLLIN;
+		timeout = ( ( ( chan->tx_len && ! chan->out_len ) ||
+			      ( op->busy && op->busy ( chan ) ) ) ?
+			    0 : CHANNEL_IDLE_MS );
+		if ( poll ( pfd, 2, timeout ) < 0 )
+			continue;
+		if ( pfd[1].revents & POLLIN ) {
+			if ( read ( chan->wake[0], discard,
+				    sizeof ( discard ) ) < 0 ) {
+				/* Nothing to do */
+			}
+		}
+
+		/* Receive data */
+		if ( pfd[0].revents & ( POLLIN | POLLHUP | POLLERR ) ) {
+			if ( ( rc = op->receive ( chan ) ) != 0 )
+				break;
+		}
+
+		/* Perform periodic work */
+		if ( op->step )
+			op->step ( chan, currticks() );
+
+		/* Transmit data and refill outbound buffer */
+		if ( ( rc = channel_transmit ( chan ) ) != 0 )
+			break;
+		if ( op->refill )
+			op->refill ( chan );
+	}
+
+	if ( rc != 0 ) {
+		printf ( "%s: connection lost: %s\n",
+			 chan->name, strerror ( rc ) );
+	}
+	chan->running = 0;
+	return NULL;
+}
+
+/**
+ * Open channel on a connected socket
+ *
+ * @v chan		Channel
+ * @v fd		Connected stream socket (will be owned by the channel)
+ * @ret rc		Return status code
+ *
+ * The channel must already have been initialised via channel_init().
+ * The socket is closed if the channel cannot be opened.
+ */
+int channel_open ( struct channel *chan, int fd ) {
+	int rc;
+
+	/* Initialise channel */
+	chan->fd = fd;
+	chan->tx = chan->buf;
+	chan->tx_len = 0;
+	chan->out = ( chan->buf + chan->size );
+	chan->out_len = 0;
+	chan->out_offset = 0;
+	chan->active = currticks();
+	memset ( &chan->stats, 0, sizeof ( chan->stats ) );
+	pthread_mutex_init ( &chan->lock, NULL );
+	if ( fcntl ( fd, F_SETFL,
+		     ( fcntl ( fd, F_GETFL ) | O_NONBLOCK ) ) < 0 ) {
+		rc = -errno;
+		goto err_nonblock;
+	}
+
+	/* Create wakeup pipe */
+	if ( pipe ( chan->wake ) != 0 ) {
+		rc = -errno;
+		goto err_pipe;
+	}
+	fcntl ( chan->wake[0], F_SETFL, O_NONBLOCK );
+	fcntl ( chan->wake[1], F_SETFL, O_NONBLOCK );
+
+	/* Start channel thread */
+	chan->running = 1;
+	if ( ( rc = pthread_create ( &chan->thread, NULL, channel_thread,
+				     chan ) ) != 0 ) {
+		rc = -rc;
+		goto err_thread;
+	}
+
+	return 0;
+
+ err_thread:
+	chan->running = 0;
+	close ( chan->wake[0] );
+	close ( chan->wake[1] );
+ err_pipe:
+ err_nonblock:
+	pthread_mutex_destroy ( &chan->lock );
+	close ( fd );
+	chan->fd = -1;
+	return rc;
+}
+
+/**
+ * Close channel
+ *
+ * @v chan		Channel
+ *
+ * A single attempt is made to write out any queued data, without
+ * waiting for space within the socket.  Any data that cannot be
+ * written out immediately is discarded.
+ */
+void channel_close ( struct channel *chan ) {
+
+	/* Stop channel thread */
+	chan->running = 0;
+	pthread_join ( chan->thread, NULL );
+
+	/* Write out any queued data, if possible */
+	if ( channel_transmit ( chan ) == 0 )
+		channel_transmit ( chan );
+
+	/* Close socket and wakeup pipe */
+	close ( chan->fd );
+	close ( chan->wake[0] );
+	close ( chan->wake[1] );
+	pthread_mutex_destroy ( &chan->lock );
+	chan->fd = -1;
+}
@@ -18,12 +18,16 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 #include <uniport/resource.h>
 #include <uniport/command.h>
 #include <uniport/parseopt.h>
 #include <uniport/interface.h>
+#include <uniport/string.h>
+#include <uniport/cli.h>
 
 /** @file
  *
@@ -37,28 +41,98 @@ struct cli_observer {
 	struct list_head list;
 	/** Observer */
 	struct observer obs;
+	/** Output stream (the command output of the requesting session) */
+	FILE *out;
 };
 
 /** List of command-line observers */
 static struct list_head cli_observers = LIST_HEAD_INIT ( cli_observers );
 
+/** Command-line observer lock
+ *
+ * This protects the list of command-line observers.  It is not held
+ * while delivering a notification: removing an observer waits for
+ * any notification in progress (see resource_unobserve()), and so an
+ * output stream cannot be closed while a notification is being
+ * written to it.
+ */
+static pthread_mutex_t cli_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * Find command-line observer
  *
  * @v res		Resource
+ * @v out		Output stream
  * @ret obs		Command-line observer, or NULL if not found
  */
-static struct cli_observer * cli_observer ( struct resource *res ) {
+static struct cli_observer * cli_observer ( struct resource *res,
+					    FILE *out ) {
 	struct cli_observer *obs;
 
 	list_for_each_entry ( obs, &cli_observers, list ) {
-		if ( obs->obs.res == res )
+		if ( ( obs->obs.res == res ) && ( obs->out == out ) )
 			return obs;
 	}
 
 	return NULL;
 }
 
+/**
+ * Remove command-line observer
+ *
+ * @v obs		Command-line observer
+ */
+static void cli_unobserve ( struct cli_observer *obs ) {
+
+	resource_unobserve ( &obs->obs );
+	list_del ( &obs->list );
+	free ( obs );
+}
+
+/**
+ * Remove all command-line observers using an output stream
+ *
+ * @v out		Output stream
+ *
+ * This waits for any notification being written to the output
+ * stream.  No further notifications will be written to the output
+ * stream once this function returns, and so the stream may then be
+ * closed.
+ */
+void cli_close ( FILE *out ) {
+	struct cli_observer *obs;
+	struct cli_observer *tmp;
+
+	pthread_mutex_lock ( &cli_lock );
+	list_for_each_entry_safe ( obs, tmp, &cli_observers, list ) {
+		if ( obs->out == out )
+			cli_unobserve ( obs );
+	}
+	pthread_mutex_unlock ( &cli_lock );
+}
+
+/**
+ * Remove all command-line observers of resources within a namespace
+ *
+ * @v ns		Resource namespace
+ */
+static void cli_forget ( struct namespace *ns ) {
+	struct cli_observer *obs;
+	struct cli_observer *tmp;
+
+	pthread_mutex_lock ( &cli_lock );
+	list_for_each_entry_safe ( obs, tmp, &cli_observers, list ) {
+		if ( obs->obs.res->ns == ns )
+			cli_unobserve ( obs );
+	}
+	pthread_mutex_unlock ( &cli_lock );
+}
+
+/** Command line interface namespace removal hook */
+struct namespace_hook cli_namespace_hook __namespace_hook = {
+	.forget = cli_forget,
+};
+
 /**
  * Notify of change in resource state
  *
@@ -66,20 +140,126 @@ static struct cli_observer * cli_observer ( struct resource *res ) {
  * @v state		Resource state
  */
 static void cli_notify ( struct observer *obs, const void *state ) {
+	struct cli_observer *cliobs =
+		container_of ( obs, struct cli_observer, obs );
+
+	/* Print resource state to the requesting session, without
+	 * interleaving with notifications from other resources.
+	 */
+	flockfile ( cliobs->out );
+	resource_fprint ( cliobs->out, obs->res, obs->intf, state );
+	fflush ( cliobs->out );
+	funlockfile ( cliobs->out );
+}
 
-	/* Print resource state */
-	resource_print ( obs->res, obs->intf, state );
+/** "ls" output buffer */
+struct ls_buffer {
+	/** Length of buffered output */
+	size_t len;
+	/** Buffered output */
+	char data[256];
+};
+
+/**
+ * Flush "ls" output buffer
+ *
+ * @v buf		Output buffer
+ */
+static void ls_flush ( struct ls_buffer *buf ) {
+
+	fwrite ( buf->data, 1, buf->len, command_output() );
+	buf->len = 0;
+}
+
+/**
+ * Append resource URI to "ls" output buffer
+ *
+ * @v buf		Output buffer
+ * @v res		Resource
+ */
+static void ls_append ( struct ls_buffer *buf, struct resource *res ) {
+	size_t len = resource_uri ( res, NULL, 0 );
+
+	/* Flush buffer if URI will not fit */
+	if ( ( buf->len + len + 1 /* "\n" */ ) > sizeof ( buf->data ) )
+		ls_flush ( buf );
+
+	/* Print directly if URI can never fit */
+	if ( ( len + 1 /* "\n" */ ) > sizeof ( buf->data ) ) {
+		cprintf ( "%s%s\n", res->ns->uri, res->uri );
+		return;
+	}
+
+	/* Append URI to buffer */
+	resource_uri ( res, &buf->data[buf->len], ( len + 1 /* NUL */ ) );
+	buf->len += len;
+	buf->data[buf->len++] = '\n';
 }
 
 /** "ls" options */
-struct ls_options {};
+struct ls_options {
+	/** Interface filter */
+	struct interface *intf;
+	/** Property type filter */
+	const struct property_type *type;
+	/** Resource type filter */
+	char *rt;
+	/** Number of matching resources to skip */
+	unsigned int skip;
+	/** Maximum number of matching resources to list */
+	unsigned int limit;
+};
 
 /** "ls" option list */
-static struct option_descriptor ls_opts[] = {};
+static struct option_descriptor ls_opts[] = {
+	OPTION_DESC ( "interface", 'i', required_argument,
+		      struct ls_options, intf, parse_interface ),
+	OPTION_DESC ( "type", 't', required_argument,
+		      struct ls_options, type, parse_property_type ),
+	OPTION_DESC ( "rt", 'r', required_argument,
+		      struct ls_options, rt, parse_string ),
+	OPTION_DESC ( "skip", 's', required_argument,
+		      struct ls_options, skip, parse_integer ),
+	OPTION_DESC ( "limit", 'n', required_argument,
+		      struct ls_options, limit, parse_integer ),
+};
 
 /** "ls" command descriptor */
 static struct command_descriptor ls_cmd =
-	COMMAND_DESC ( struct ls_options, ls_opts, 0, 0, NULL );
+	COMMAND_DESC ( struct ls_options, ls_opts, 0, 1, "[<uri-pattern>]" );
+
+/**
+ * Check if resource matches "ls" property filters
+ *
+ * @v res		Resource
+ * @v opts		"ls" options
+ * @ret match		Resource matches filters
+ *
+ * A resource matches if any single property satisfies all of the
+ * property filters.
+ */
+static int ls_match ( struct resource *res, struct ls_options *opts ) {
+	struct property *prop;
+	unsigned int i;
+
+	/* Match all resources if no property filters are specified */
+	if ( ! ( opts->intf || opts->type ) )
+		return 1;
+
+	/* Check each property */
+	for ( i = 0 ; i < res->desc->count ; i++ ) {
+		prop = &res->desc->props[i];
+		if ( opts->intf &&
+		     ( ! interface_mask_test ( opts->intf, res->desc,
+					       INTERFACE_VISIBLE, i ) ) )
+			continue;
+		if ( opts->type && ( prop->type != opts->type ) )
+			continue;
+		return 1;
+	}
+
+	return 0;
+}
 
 /**
  * "ls" command
@@ -90,20 +270,70 @@ static struct command_descriptor ls_cmd =
  */
 static int ls_exec ( int argc, char **argv ) {
 	struct ls_options opts;
-	struct namespace *ns;
-	struct resource **res;
+	struct ls_buffer buf;
+	struct resource **candidates;
+	struct resource *res;
+	const char *pattern;
+	size_t prefix_len;
+	unsigned int num_candidates;
+	unsigned int skipped = 0;
+	unsigned int count = 0;
+	unsigned int i;
+	int diff;
 	int rc;
 
 	/* Parse options */
 	if ( ( rc = parse_options ( argc, argv, &ls_cmd, &opts ) ) != 0 )
 		return rc;
 
-	/* List all resource URIs */
-	list_for_each_entry ( ns, &namespaces, list ) {
-		for ( res = ns->resources ; *res ; res++ ) {
-			printf ( "%s%s\n", ns->uri, (*res)->uri );
+	/* Parse URI pattern, if present */
+	pattern = ( ( optind < argc ) ? argv[optind] : "*" );
+
+	/* Scan only the resources of the requested type, if any, or
+	 * otherwise only the range of the resource index that matches
+	 * the literal prefix of the URI pattern.  Both are sorted by
+	 * URI.
+	 */
+	buf.len = 0;
+	prefix_len = glob_prefix_len ( pattern );
+	if ( opts.rt ) {
+		candidates = resource_find_type ( opts.rt, &num_candidates );
+	} else {
+		i = resource_index_lower ( pattern, prefix_len );
+		candidates = &resource_index[i];
+		num_candidates = ( resource_index_count - i );
+	}
+	for ( i = 0 ; i < num_candidates ; i++ ) {
+
+		/* Stop at end of matching prefix range */
+		res = candidates[i];
+		diff = resource_uri_ncmp ( res, pattern, prefix_len );
+		if ( diff < 0 )
+			continue;
+		if ( diff > 0 )
+			break;
+
+		/* Check full URI pattern */
+		if ( ! resource_uri_match ( res, pattern ) )
+			continue;
+
+		/* Check property filters */
+		if ( ! ls_match ( res, &opts ) )
+			continue;
+
+		/* Apply paging */
+		if ( skipped < opts.skip ) {
+			skipped++;
+			continue;
 		}
+		if ( opts.limit && ( count >= opts.limit ) )
+			break;
+		count++;
+
+		/* List resource URI */
+		ls_append ( &buf, res );
 	}
+	ls_flush ( &buf );
 
 	return 0;
 }
@@ -205,6 +435,7 @@ static int set_exec ( int argc, char **argv ) {
 	char *name;
 	char *sep;
 	char *value;
+	unsigned int index;
 	int rc;
 
 	/* Parse options */
@@ -247,37 +478,40 @@ static int set_exec ( int argc, char **argv ) {
 		/* Find property */
 		prop = resource_property ( res, name );
 		if ( ! prop ) {
-			printf ( "\"%s\": no such property\n", name );
+			cprintf ( "\"%s\": no such property\n", name );
 			rc = -ENOENT;
 			goto err_property;
 		}
 
 		/* Check if interface has property */
-		if ( ! interface_has_property ( opts.intf, prop ) ) {
-			printf ( "\"%s\": not accessible via \"%s\"\n",
-				 name, opts.intf->name );
+		index = ( prop - res->desc->props );
+		if ( ! interface_mask_test ( opts.intf, res->desc,
+					     INTERFACE_VISIBLE, index ) ) {
+			cprintf ( "\"%s\": not accessible via \"%s\"\n",
+				  name, opts.intf->name );
 			rc = -ENOTTY;
 			goto err_interface;
 		}
 
 		/* Check if property is writable */
-		if ( ! ( prop->flags & PROP_RW ) ) {
-			printf ( "\"%s\": property is read-only\n", name );
+		if ( ! interface_mask_test ( opts.intf, res->desc,
+					     INTERFACE_WRITABLE, index ) ) {
+			cprintf ( "\"%s\": property is read-only\n", name );
 			rc = -EROFS;
 			goto err_read_only;
 		}
 
 		/* Parse property */
 		if ( ( rc = property_parse ( prop, value, state ) ) != 0 ) {
-			printf ( "\"%s\": %s\n", name, strerror ( rc ) );
+			cprintf ( "\"%s\": %s\n", name, strerror ( rc ) );
 			goto err_parse;
 		}
 	}
 
 	/* Update resource state */
 	if ( ( rc = resource_update ( res, state ) ) != 0 ) {
-		printf ( "Could not update resource state: %s\n",
-			 strerror ( rc ) );
+		cprintf ( "Could not update resource state: %s\n",
+			  strerror ( rc ) );
 		goto err_update;
 	}
 
@@ -287,6 +521,7 @@ static int set_exec ( int argc, char **argv ) {
  err_interface:
  err_property:
  err_sep:
+	resource_discard ( res, state );
 	free ( state );
  err_alloc:
  err_parse_resource:
@@ -331,6 +566,7 @@ static int observe_exec ( int argc, char **argv ) {
 	struct observe_options opts;
 	struct resource *res;
 	struct cli_observer *obs;
+	FILE *out = command_output();
 	char *uri;
 	int rc;
 
@@ -347,28 +583,32 @@ static int observe_exec ( int argc, char **argv ) {
 	if ( ! opts.intf )
 		opts.intf = &oic_if_baseline;
 
-	/* Find existing observer, if any */
-	obs = cli_observer ( res );
+	/* Find existing observer for this session, if any */
+	pthread_mutex_lock ( &cli_lock );
+	obs = cli_observer ( res, out );
 
 	/* Create, delete, or modify observer as applicable */
 	if ( ( ! obs ) && ( ! opts.delete ) ) {
 		obs = malloc ( sizeof ( *obs ) );
-		if ( ! obs )
-			return -ENOMEM;
+		if ( ! obs ) {
+			rc = -ENOMEM;
+			goto out;
+		}
 		observer_init ( &obs->obs, res, opts.intf, cli_notify );
+		obs->out = out;
 		list_add_tail ( &obs->list, &cli_observers );
 		resource_observe ( &obs->obs );
 	} else if ( obs && opts.delete ) {
-		resource_unobserve ( &obs->obs );
-		list_del ( &obs->list );
-		free ( obs );
+		cli_unobserve ( obs );
 	} else if ( obs ) {
 		resource_unobserve ( &obs->obs );
 		obs->obs.intf = opts.intf;
 		resource_observe ( &obs->obs );
 	}
 
-	return 0;
+ out:
+	pthread_mutex_unlock ( &cli_lock );
+	return rc;
 }
 
 /** "observe" command */
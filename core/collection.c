@@ -0,0 +1,819 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Resource collections
+ *
+ * A collection groups arbitrary resources from other namespaces
+ * (e.g. "all lights on floor 2") behind a single collection resource
+ * listing links to its members.  Retrieving or updating the members
+ * of a collection fans out to every member.
+ *
+ * Member retrieve() and update() methods may be slow (e.g. when
+ * backed by GPIO or I2C hardware), and so the fan-out is shared
+ * between the calling thread and a small pool of worker threads.
+ * Each member records its own result, allowing partial failures to
+ * be reported.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <uniport/collection.h>
+#include <uniport/discovery.h>
+#include <uniport/interface.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/string.h>
+#include <uniport/timer.h>
+
+/** A fan-out of an operation to all members of a collection */
+struct collection_batch {
+	/** List of batches awaiting a worker */
+	struct list_head list;
+	/** Collection */
+	struct collection *coll;
+	/**
+	 * Apply operation to a member
+	 *
+	 * @v batch		Batch
+	 * @v member		Collection member
+	 * @ret rc		Return status code
+	 */
+	int ( * op ) ( struct collection_batch *batch,
+		       struct collection_member *member );
+	/** Interface in use */
+	struct interface *intf;
+	/** Property assignments (each split into name and value) */
+	char **assignments;
+	/** Number of property assignments */
+	unsigned int count;
+	/** Index of next unclaimed member */
+	unsigned int next;
+	/** Number of members not yet completed */
+	unsigned int remaining;
+};
+
+/** List of collections */
+static LIST_HEAD ( collections );
+
+/** Worker pool lock */
+static pthread_mutex_t collection_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Work available for worker pool */
+static pthread_cond_t collection_work = PTHREAD_COND_INITIALIZER;
+
+/** Batch completion */
+static pthread_cond_t collection_done = PTHREAD_COND_INITIALIZER;
+
+/** Batches with unclaimed members */
+static LIST_HEAD ( collection_batches );
+
+/** Number of worker threads started */
+static unsigned int collection_workers;
+
+/** Worker pool could not be started */
+static int collection_no_workers;
+
+/**
+ * Claim next member from a batch
+ *
+ * @v batch		Batch (must have an unclaimed member)
+ * @ret member		Collection member
+ *
+ * Must be called with the worker pool lock held.
+ */
+static struct collection_member *
+collection_claim ( struct collection_batch *batch ) {
+	struct collection *coll = batch->coll;
+	struct collection_member *member;
+
+	member = &coll->members[ batch->next++ ];
+	if ( batch->next == coll->count )
+		list_del ( &batch->list );
+	return member;
+}
+
+/**
+ * Complete member of a batch
+ *
+ * @v batch		Batch
+ * @v member		Collection member
+ * @v rc		Return status code
+ *
+ * Must be called with the worker pool lock held.
+ */
+static void collection_complete ( struct collection_batch *batch,
+				  struct collection_member *member,
+				  int rc ) {
+
+	member->rc = rc;
+	if ( --batch->remaining == 0 )
+		pthread_cond_broadcast ( &collection_done );
+}
+
+/**
+ * Run worker thread
+ *
+ * @v arg		Unused
+ * @ret arg		Unused
+ */
+static void * collection_worker ( void *arg __unused ) {
+	struct collection_batch *batch;
+	struct collection_member *member;
+	int rc;
+
+	pthread_mutex_lock ( &collection_lock );
+	while ( 1 ) {
+
+		/* Wait for work */
+		if ( list_empty ( &collection_batches ) ) {
+			pthread_cond_wait ( &collection_work,
+					    &collection_lock );
+			continue;
+		}
+
+		/* Apply operation to next member, without holding the
+		 * lock.  The batch remains valid until its last member
+		 * has completed.
+		 */
+		batch = list_first_entry ( &collection_batches,
+					   struct collection_batch, list );
+		member = collection_claim ( batch );
+		pthread_mutex_unlock ( &collection_lock );
+		rc = batch->op ( batch, member );
+		pthread_mutex_lock ( &collection_lock );
+		collection_complete ( batch, member, rc );
+	}
+
+	return NULL;
+}
+
+/**
+ * Start worker pool, if not already started
+ *
+ * Must be called with the worker pool lock held.  If no worker
+ * threads can be started, all operations will be applied by the
+ * calling thread.
+ */
+static void collection_start_workers ( void ) {
+	pthread_attr_t attr;
+	pthread_t thread;
+
+	/* Do nothing if already started (or failed to start) */
+	if ( collection_workers || collection_no_workers )
+		return;
+
+	/* Start detached worker threads */
+	pthread_attr_init ( &attr );
+	pthread_attr_setdetachstate ( &attr, PTHREAD_CREATE_DETACHED );
+	while ( collection_workers < COLLECTION_WORKERS ) {
+		if ( pthread_create ( &thread, &attr, collection_worker,
+				      NULL ) != 0 )
+			break;
+		collection_workers++;
+	}
+	pthread_attr_destroy ( &attr );
+	if ( ! collection_workers )
+		collection_no_workers = 1;
+}
+
+/**
+ * Apply operation to all members of a collection
+ *
+ * @v batch		Batch
+ * @ret failed		Number of members for which the operation failed
+ *
+ * The calling thread applies the operation alongside the worker
+ * pool, and returns once the operation has completed for all
+ * members.
+ */
+static unsigned int collection_fan_out ( struct collection_batch *batch ) {
+	struct collection *coll = batch->coll;
+	struct collection_member *member;
+	unsigned int failed = 0;
+	unsigned int i;
+	int rc;
+
+	/* Do nothing if there are no members */
+	if ( ! coll->count )
+		return 0;
+
+	/* Hand out members to worker pool */
+	batch->next = 0;
+	batch->remaining = coll->count;
+	pthread_mutex_lock ( &collection_lock );
+	collection_start_workers();
+	list_add_tail ( &batch->list, &collection_batches );
+	pthread_cond_broadcast ( &collection_work );
+
+	/* Apply operation to any members not yet claimed */
+	while ( batch->next < coll->count ) {
+		member = collection_claim ( batch );
+		pthread_mutex_unlock ( &collection_lock );
+		rc = batch->op ( batch, member );
+		pthread_mutex_lock ( &collection_lock );
+		collection_complete ( batch, member, rc );
+	}
+
+	/* Wait for claimed members to complete */
+	while ( batch->remaining )
+		pthread_cond_wait ( &collection_done, &collection_lock );
+	pthread_mutex_unlock ( &collection_lock );
+
+	/* Count failures */
+	for ( i = 0 ; i < coll->count ; i++ ) {
+		if ( coll->members[i].rc != 0 )
+			failed++;
+	}
+	return failed;
+}
+
+/**
+ * Retrieve member state
+ *
+ * @v batch		Batch
+ * @v member		Collection member
+ * @ret rc		Return status code
+ */
+static int collection_get ( struct collection_batch *batch __unused,
+			    struct collection_member *member ) {
+
+	member->state = resource_retrieve ( member->res );
+	return 0;
+}
+
+/**
+ * Update member state
+ *
+ * @v batch		Batch
+ * @v member		Collection member
+ * @ret rc		Return status code
+ *
+ * Members having none of the assigned properties are left untouched.
+ */
+static int collection_set ( struct collection_batch *batch,
+			    struct collection_member *member ) {
+	struct resource *res = member->res;
+	struct property *prop;
+	void *state = NULL;
+	const char *name;
+	const char *value;
+	unsigned int index;
+	unsigned int i;
+	int rc = 0;
+
+	/* Construct updated state */
+	for ( i = 0 ; i < batch->count ; i++ ) {
+
+		/* Skip properties not present in this member */
+		name = batch->assignments[i];
+		value = ( name + strlen ( name ) + 1 /* NUL */ );
+		prop = resource_property ( res, name );
+		if ( ! prop )
+			continue;
+
+		/* Check property is accessible and writable */
+		index = ( prop - res->desc->props );
+		if ( ! interface_mask_test ( batch->intf, res->desc,
+					     INTERFACE_VISIBLE, index ) ) {
+			rc = -ENOTTY;
+			goto err_access;
+		}
+		if ( ! interface_mask_test ( batch->intf, res->desc,
+					     INTERFACE_WRITABLE, index ) ) {
+			rc = -EROFS;
+			goto err_access;
+		}
+
+		/* Retrieve and copy current state, if not yet done */
+		if ( ! state ) {
+			state = malloc ( res->desc->len );
+			if ( ! state ) {
+				rc = -ENOMEM;
+				goto err_alloc;
+			}
+			memcpy ( state, resource_retrieve ( res ),
+				 res->desc->len );
+		}
+
+		/* Parse property */
+		if ( ( rc = property_parse ( prop, value, state ) ) != 0 )
+			goto err_parse;
+	}
+
+	/* Update resource state, if applicable */
+	if ( state )
+		rc = resource_update ( res, state );
+
+ err_parse:
+ err_alloc:
+ err_access:
+	if ( state )
+		resource_discard ( res, state );
+	free ( state );
+	return rc;
+}
+
+/**
+ * Retrieve state of all members of a collection
+ *
+ * @v coll		Collection
+ * @ret rc		Return status code
+ *
+ * The state of each member is recorded within the member.
+ */
+int collection_retrieve ( struct collection *coll ) {
+	struct collection_batch batch;
+
+	/* Retrieve all members */
+	memset ( &batch, 0, sizeof ( batch ) );
+	batch.coll = coll;
+	batch.op = collection_get;
+	collection_fan_out ( &batch );
+
+	return 0;
+}
+
+/**
+ * Update state of all members of a collection
+ *
+ * @v coll		Collection
+ * @v intf		Interface in use
+ * @v assignments	Property assignments ("<name>=<value>"; will be split)
+ * @v count		Number of property assignments
+ * @ret rc		Return status code
+ *
+ * The assignments are checked before any member is updated.  Each
+ * member is then updated independently, and records its own result.
+ * If any member fails to update, the error from the first failed
+ * member is returned.
+ */
+int collection_update ( struct collection *coll, struct interface *intf,
+			char **assignments, unsigned int count ) {
+	struct collection_batch batch;
+	struct collection_member *member;
+	char *sep;
+	unsigned int i;
+	unsigned int j;
+
+	/* Split assignments into names and values */
+	for ( i = 0 ; i < count ; i++ ) {
+		sep = strchr ( assignments[i], '=' );
+		if ( ! sep )
+			return -EINVAL;
+		*sep = '\0';
+	}
+
+	/* Check that each property is present in at least one member */
+	for ( i = 0 ; i < count ; i++ ) {
+		for ( j = 0 ; j < coll->count ; j++ ) {
+			if ( resource_property ( coll->members[j].res,
+						 assignments[i] ) )
+				break;
+		}
+		if ( j == coll->count )
+			return -ENOENT;
+	}
+
+	/* Update all members */
+	memset ( &batch, 0, sizeof ( batch ) );
+	batch.coll = coll;
+	batch.op = collection_set;
+	batch.intf = intf;
+	batch.assignments = assignments;
+	batch.count = count;
+	coll->state.failed = collection_fan_out ( &batch );
+	resource_notify ( &coll->res );
+
+	/* Report first failure, if any */
+	for ( i = 0 ; i < coll->count ; i++ ) {
+		member = &coll->members[i];
+		if ( member->rc != 0 )
+			return member->rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Format member links
+ *
+ * @v coll		Collection
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @ret len		Length of links
+ */
+static size_t collection_format ( struct collection *coll, char *buf,
+				  size_t len ) {
+	size_t offset;
+	size_t used = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < coll->count ; i++ ) {
+		if ( i ) {
+			if ( used < len )
+				buf[used] = ',';
+			used++;
+		}
+		offset = ( ( used < len ) ? used : len );
+		used += discovery_link ( coll->members[i].res, ( buf + offset ),
+					 ( len - offset ) );
+	}
+	if ( len )
+		buf[ ( used < len ) ? used : ( len - 1 ) ] = '\0';
+
+	return used;
+}
+
+/**
+ * Retrieve collection resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ *
+ * Member links are reconstructed only if members have been removed
+ * since the links were last constructed.  The previous links are
+ * retained if they cannot be reconstructed.
+ */
+static const struct collection_state *
+collection_retrieve_state ( struct resource *res ) {
+	struct collection *coll = container_of ( res, struct collection, res );
+	size_t len;
+	char *links;
+
+	/* Reconstruct member links, if necessary */
+	if ( coll->stale ) {
+		len = collection_format ( coll, NULL, 0 );
+		links = malloc ( len + 1 /* NUL */ );
+		if ( links ) {
+			collection_format ( coll, links,
+					    ( len + 1 /* NUL */ ) );
+			free ( coll->links );
+			coll->links = links;
+			coll->stale = 0;
+		}
+	}
+	coll->state.links = ( coll->links ? coll->links : "" );
+	coll->state.count = coll->count;
+
+	return &coll->state;
+}
+
+/** Collection resource properties */
+static struct property collection_props[] = {
+	PROPERTY_STRING ( "links", struct collection_state, links, 0 ),
+	PROPERTY_INTEGER ( "count", struct collection_state, count, 0 ),
+	PROPERTY_INTEGER ( "failed", struct collection_state, failed, 0 ),
+};
+
+/** Collection resource descriptor */
+static const struct resource_descriptor collection_desc =
+	RESOURCE_DESC ( struct collection_state, collection_props,
+			collection_retrieve_state, NULL, NULL,
+			.rt = "oic.wk.col" );
+
+/**
+ * Find collection
+ *
+ * @v res		Collection resource
+ * @ret coll		Collection, or NULL if not a collection
+ */
+static struct collection * collection_find ( struct resource *res ) {
+
+	if ( res->desc != &collection_desc )
+		return NULL;
+	return container_of ( res, struct collection, res );
+}
+
+/**
+ * Add members matching a URI pattern
+ *
+ * @v coll		Collection
+ * @v pattern		URI pattern
+ * @ret rc		Return status code
+ */
+static int collection_add ( struct collection *coll, const char *pattern ) {
+	struct collection_member *members;
+	struct resource *res;
+	size_t prefix_len = glob_prefix_len ( pattern );
+	unsigned int i;
+	unsigned int j;
+
+	/* Scan matching prefix range of resource index */
+	for ( i = resource_index_lower ( pattern, prefix_len ) ;
+	      i < resource_index_count ; i++ ) {
+
+		/* Stop at end of matching prefix range */
+		res = resource_index[i];
+		if ( resource_uri_ncmp ( res, pattern, prefix_len ) != 0 )
+			break;
+
+		/* Check full URI pattern */
+		if ( ! resource_uri_match ( res, pattern ) )
+			continue;
+
+		/* Skip existing members */
+		for ( j = 0 ; j < coll->count ; j++ ) {
+			if ( coll->members[j].res == res )
+				break;
+		}
+		if ( j < coll->count )
+			continue;
+
+		/* Add member */
+		members = realloc ( coll->members, ( ( coll->count + 1 ) *
+						     sizeof ( members[0] ) ) );
+		if ( ! members )
+			return -ENOMEM;
+		coll->members = members;
+		memset ( &members[coll->count], 0, sizeof ( members[0] ) );
+		members[coll->count++].res = res;
+	}
+
+	return 0;
+}
+
+/**
+ * Free collection
+ *
+ * @v coll		Collection
+ */
+static void collection_free ( struct collection *coll ) {
+
+	free ( coll->links );
+	free ( coll->members );
+	free ( coll );
+}
+
+/**
+ * Create collection
+ *
+ * @v uri		Collection resource URI
+ * @v patterns		Member URI patterns
+ * @v count		Number of member URI patterns
+ * @ret rc		Return status code
+ *
+ * The collection resource is registered within a new namespace
+ * formed from all but the final component of its URI.
+ */
+static int collection_create ( const char *uri, char **patterns,
+			       unsigned int count ) {
+	struct collection *coll;
+	const char *suffix;
+	size_t prefix_len;
+	char *ns_uri;
+	char *res_uri;
+	unsigned int i;
+	int rc;
+
+	/* Split URI into namespace prefix and resource suffix */
+	suffix = strrchr ( uri, '/' );
+	if ( ( uri[0] != '/' ) || ( ! suffix[1] ) ) {
+		rc = -EINVAL;
+		goto err_uri;
+	}
+	suffix++;
+	prefix_len = ( suffix - uri );
+
+	/* Allocate and initialise collection */
+	coll = calloc ( 1, ( sizeof ( *coll ) + strlen ( uri ) +
+			     2 /* NULs */ ) );
+	if ( ! coll ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ns_uri = ( ( void * ) ( coll + 1 ) );
+	memcpy ( ns_uri, uri, prefix_len );
+	res_uri = ( ns_uri + prefix_len + 1 /* NUL */ );
+	strcpy ( res_uri, suffix );
+	coll->ns.uri = ns_uri;
+	coll->ns.resources = coll->resources;
+	coll->resources[0] = &coll->res;
+	coll->res.uri = res_uri;
+	coll->res.desc = &collection_desc;
+	INIT_LIST_HEAD ( &coll->res.observers );
+	coll->stale = 1;
+
+	/* Add members */
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( ( rc = collection_add ( coll, patterns[i] ) ) != 0 )
+			goto err_add;
+	}
+	if ( ! coll->count ) {
+		cprintf ( "No matching resources\n" );
+		rc = -ENOENT;
+		goto err_empty;
+	}
+
+	/* Register collection resource */
+	if ( ( rc = resource_register ( &coll->ns ) ) != 0 )
+		goto err_register;
+
+	/* Add to list of collections */
+	list_add_tail ( &coll->list, &collections );
+
+	return 0;
+
+ err_register:
+ err_empty:
+ err_add:
+	collection_free ( coll );
+ err_alloc:
+ err_uri:
+	return rc;
+}
+
+/**
+ * Destroy collection
+ *
+ * @v coll		Collection
+ */
+static void collection_destroy ( struct collection *coll ) {
+
+	/* Remove from list of collections */
+	list_del ( &coll->list );
+
+	/* Unregister collection resource */
+	resource_unregister ( &coll->ns );
+
+	/* Free collection */
+	collection_free ( coll );
+}
+
+/**
+ * Remove members within an unregistered namespace
+ *
+ * @v ns		Resource namespace
+ */
+static void collection_forget ( struct namespace *ns ) {
+	struct collection *coll;
+	unsigned int i;
+	unsigned int j;
+
+	list_for_each_entry ( coll, &collections, list ) {
+
+		/* Compact members, preserving order */
+		for ( i = 0, j = 0 ; i < coll->count ; i++ ) {
+			if ( coll->members[i].res->ns != ns )
+				coll->members[j++] = coll->members[i];
+		}
+
+		/* Mark member links as out of date, if applicable */
+		if ( j != coll->count ) {
+			coll->count = j;
+			coll->stale = 1;
+		}
+	}
+}
+
+/** Resource collection namespace removal hook */
+struct namespace_hook collection_namespace_hook __namespace_hook = {
+	.forget = collection_forget,
+};
+
+/** "collection" options */
+struct collection_options {
+	/** Create collection */
+	int create;
+	/** Delete collection */
+	int delete;
+	/** Update members */
+	int update;
+	/** Interface in use */
+	struct interface *intf;
+};
+
+/** "collection" option list */
+static struct option_descriptor collection_opts[] = {
+	OPTION_DESC ( "create", 'c', no_argument,
+		      struct collection_options, create, parse_flag ),
+	OPTION_DESC ( "delete", 'd', no_argument,
+		      struct collection_options, delete, parse_flag ),
+	OPTION_DESC ( "update", 'u', no_argument,
+		      struct collection_options, update, parse_flag ),
+	OPTION_DESC ( "interface", 'i', required_argument,
+		      struct collection_options, intf, parse_interface ),
+};
+
+/** "collection" command descriptor */
+static struct command_descriptor collection_cmd =
+	COMMAND_DESC ( struct collection_options, collection_opts,
+		       1, MAX_ARGUMENTS,
+		       "<uri> [<uri-pattern>...|<prop>=<value>...]" );
+
+/**
+ * "collection" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int collection_exec ( int argc, char **argv ) {
+	struct collection_options opts;
+	struct collection_member *member;
+	struct collection *coll;
+	struct resource *res;
+	unsigned long start;
+	unsigned long elapsed;
+	unsigned int i;
+	char *uri;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &collection_cmd,
+				    &opts ) ) != 0 )
+		return rc;
+	uri = argv[optind++];
+
+	/* Create collection, if applicable */
+	if ( opts.create )
+		return collection_create ( uri, &argv[optind],
+					   ( argc - optind ) );
+
+	/* Find collection */
+	if ( ( rc = parse_resource ( uri, &res ) ) != 0 )
+		return rc;
+	coll = collection_find ( res );
+	if ( ! coll ) {
+		cprintf ( "\"%s\": not a collection\n", uri );
+		return -ENOTTY;
+	}
+
+	/* Delete collection, if applicable */
+	if ( opts.delete ) {
+		collection_destroy ( coll );
+		return 0;
+	}
+
+	/* Default to baseline interface where not specified */
+	if ( ! opts.intf )
+		opts.intf = &oic_if_baseline;
+
+	/* Update members, if applicable */
+	if ( opts.update ) {
+		start = currticks();
+		rc = collection_update ( coll, opts.intf, &argv[optind],
+					 ( argc - optind ) );
+		elapsed = ( ( currticks() - start ) /
+			    ( TICKS_PER_SEC / 1000000 ) );
+		if ( rc == -ENOENT ) {
+			cprintf ( "No member has the assigned properties\n" );
+			return rc;
+		}
+		if ( rc == -EINVAL ) {
+			print_usage ( &collection_cmd, argv );
+			return rc;
+		}
+		for ( i = 0 ; i < coll->count ; i++ ) {
+			member = &coll->members[i];
+			if ( member->rc == 0 )
+				continue;
+			cprintf ( "%s%s: %s\n", member->res->ns->uri,
+				  member->res->uri, strerror ( member->rc ) );
+		}
+		cprintf ( "%u members, %d failed, %luus\n", coll->count,
+			  coll->state.failed, elapsed );
+		return rc;
+	}
+
+	/* Otherwise, retrieve and print member states */
+	start = currticks();
+	if ( ( rc = collection_retrieve ( coll ) ) != 0 )
+		return rc;
+	elapsed = ( ( currticks() - start ) / ( TICKS_PER_SEC / 1000000 ) );
+	for ( i = 0 ; i < coll->count ; i++ ) {
+		member = &coll->members[i];
+		resource_print ( member->res, opts.intf, member->state );
+	}
+	cprintf ( "%u members, %luus\n", coll->count, elapsed );
+
+	return 0;
+}
+
+/** "collection" command */
+struct command collection_command __command = {
+	.name = "collection",
+	.exec = collection_exec,
+};
@@ -0,0 +1,731 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Closed-loop control
+ *
+ * A control loop periodically measures a process value from a plant,
+ * calculates an output using a control algorithm, and applies the
+ * output to the plant.  Each loop runs in its own thread, with
+ * deadlines calculated from a fixed period so that timing errors do
+ * not accumulate.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+#include <uniport/string.h>
+#include <uniport/control.h>
+#include <uniport/bench.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/timer.h>
+
+/** List of running control loops */
+static LIST_HEAD ( control_loops );
+
+/** Control loop list lock */
+static pthread_mutex_t control_loops_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*****************************************************************************
+ *
+ * Control algorithms
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Limit controller output to valid range
+ *
+ * @v output		Unlimited output
+ * @ret output		Limited output
+ */
+static inline unsigned int control_limit ( int64_t output ) {
+
+	if ( output < 0 )
+		return 0;
+	if ( output > CONTROL_OUTPUT_MAX )
+		return CONTROL_OUTPUT_MAX;
+	return output;
+}
+
+/**
+ * Calculate PID controller output
+ *
+ * @v loop		Control loop
+ * @v measured		Measured process value
+ * @v dt		Time since previous step (in ticks)
+ * @ret output		Controller output
+ *
+ * The derivative term is calculated from the measured value rather
+ * than the error, to avoid a spike in output when the setpoint
+ * changes.  The integral is not accumulated while doing so would
+ * drive the output further into saturation.
+ */
+static unsigned int pid_step ( struct control_loop *loop, int measured,
+			       unsigned long dt ) {
+	int error = ( loop->setpoint - measured );
+	int64_t integral;
+	int64_t output;
+	int64_t trial;
+
+	/* Calculate proportional and derivative terms */
+	output = ( ( ( int64_t ) loop->kp ) * error );
+	if ( dt ) {
+		output -= ( ( ( ( int64_t ) loop->kd ) *
+			      ( measured - loop->previous ) *
+			      ( ( int64_t ) TICKS_PER_SEC ) )
+			    / ( ( int64_t ) dt ) );
+	}
+
+	/* Accumulate integral, unless saturated */
+	integral = ( loop->integral + ( ( ( int64_t ) error ) * dt ) );
+	trial = ( output + ( ( ( ( int64_t ) loop->ki ) * integral ) /
+			     ( ( int64_t ) TICKS_PER_SEC ) ) );
+	if ( ( ( trial <= CONTROL_OUTPUT_MAX ) || ( error < 0 ) ) &&
+	     ( ( trial >= 0 ) || ( error > 0 ) ) ) {
+		loop->integral = integral;
+	}
+
+	/* Add integral term */
+	output += ( ( ( ( int64_t ) loop->ki ) * loop->integral ) /
+		    ( ( int64_t ) TICKS_PER_SEC ) );
+
+	return control_limit ( output );
+}
+
+/** PID controller */
+struct controller pid_controller = {
+	.name = "pid",
+	.step = pid_step,
+};
+
+/**
+ * Calculate on/off controller output
+ *
+ * @v loop		Control loop
+ * @v measured		Measured process value
+ * @v dt		Time since previous step (in ticks)
+ * @ret output		Controller output
+ */
+static unsigned int onoff_step ( struct control_loop *loop, int measured,
+				 unsigned long dt __unused ) {
+	int hysteresis = loop->hysteresis;
+
+	/* Switch on below, or off above, the hysteresis band */
+	if ( measured < ( loop->setpoint - hysteresis ) )
+		return CONTROL_OUTPUT_MAX;
+	if ( measured > ( loop->setpoint + hysteresis ) )
+		return 0;
+
+	/* Leave output unchanged within the hysteresis band */
+	return loop->output;
+}
+
+/** On/off controller */
+struct controller onoff_controller = {
+	.name = "onoff",
+	.step = onoff_step,
+};
+
+/** Control algorithms */
+static struct controller *controllers[] = {
+	&pid_controller,
+	&onoff_controller,
+};
+
+/*****************************************************************************
+ *
+ * Control loops
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Run control loop
+ *
+ * @v arg		Control loop
+ * @ret result		Result (unused)
+ */
+static void * control_thread ( void *arg ) {
+	struct control_loop *loop = arg;
+	struct control_stats *stats = &loop->stats;
+	unsigned long deadline = currticks();
+	unsigned long previous = deadline;
+	unsigned long now;
+	unsigned long done;
+	unsigned long jitter;
+	unsigned long busy;
+	unsigned int output;
+	int measured;
+
+	while ( loop->running ) {
+
+		/* Wait for next deadline */
+		now = currticks();
+		if ( ( ( long ) ( deadline - now ) ) > 0 ) {
+			usleep ( ( deadline - now ) /
+				 ( TICKS_PER_SEC / 1000000 ) );
+			now = currticks();
+		}
+		jitter = ( ( ( ( long ) ( now - deadline ) ) > 0 ) ?
+			   ( now - deadline ) : 0 );
+
+		/* Measure, calculate, and actuate.  The plant is called
+		 * without holding the lock, since it may notify
+		 * observers that in turn change the setpoint.
+		 */
+		measured = loop->plant->measure ( loop, now );
+		pthread_mutex_lock ( &loop->lock );
+		output = loop->ctrl->step ( loop, measured,
+					    ( now - previous ) );
+		loop->output = output;
+		loop->previous = measured;
+		pthread_mutex_unlock ( &loop->lock );
+		loop->plant->actuate ( loop, output );
+		previous = now;
+
+		/* Update statistics */
+		done = currticks();
+		busy = ( done - now );
+		pthread_mutex_lock ( &loop->lock );
+		stats->iterations++;
+		stats->jitter += jitter;
+		if ( jitter > stats->jitter_max )
+			stats->jitter_max = jitter;
+		stats->busy += busy;
+		if ( busy > stats->busy_max )
+			stats->busy_max = busy;
+
+		/* Schedule next iteration, skipping any missed periods */
+		deadline += loop->period;
+		while ( ( ( long ) ( done - deadline ) ) >= 0 ) {
+			deadline += loop->period;
+			stats->overruns++;
+		}
+		pthread_mutex_unlock ( &loop->lock );
+	}
+
+	return NULL;
+}
+
+/**
+ * Start control loop
+ *
+ * @v loop		Control loop
+ * @ret rc		Return status code
+ */
+int control_start ( struct control_loop *loop ) {
+	int rc;
+
+	/* Initialise controller state */
+	loop->integral = 0;
+	loop->output = 0;
+	loop->previous = loop->plant->measure ( loop, currticks() );
+	memset ( &loop->stats, 0, sizeof ( loop->stats ) );
+
+	/* Start control thread */
+	loop->running = 1;
+	if ( ( rc = pthread_create ( &loop->thread, NULL, control_thread,
+				     loop ) ) != 0 ) {
+		loop->running = 0;
+		return -rc;
+	}
+
+	/* Add to list of control loops */
+	pthread_mutex_lock ( &control_loops_lock );
+	list_add_tail ( &loop->list, &control_loops );
+	pthread_mutex_unlock ( &control_loops_lock );
+
+	return 0;
+}
+
+/**
+ * Stop control loop
+ *
+ * @v loop		Control loop
+ */
+void control_stop ( struct control_loop *loop ) {
+
+	/* Stop control thread */
+	loop->running = 0;
+	pthread_join ( loop->thread, NULL );
+
+	/* Remove from list of control loops */
+	pthread_mutex_lock ( &control_loops_lock );
+	list_del ( &loop->list );
+	pthread_mutex_unlock ( &control_loops_lock );
+}
+
+/**
+ * Change control loop setpoint
+ *
+ * @v loop		Control loop
+ * @v setpoint		New setpoint
+ */
+void control_setpoint ( struct control_loop *loop, int setpoint ) {
+
+	pthread_mutex_lock ( &loop->lock );
+	loop->setpoint = setpoint;
+	pthread_mutex_unlock ( &loop->lock );
+}
+
+/*****************************************************************************
+ *
+ * Simulated thermal mass
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Advance thermal model
+ *
+ * @v model		Thermal model
+ * @v heating		Heater is switched on
+ * @v now		Current time
+ */
+void thermal_model_step ( struct thermal_model *model, int heating,
+			  unsigned long now ) {
+	int64_t dt;
+	int64_t power;
+
+	/* Calculate elapsed time, in microseconds */
+	dt = ( ( ( ( int64_t ) ( now - model->updated ) ) * 1000000 ) /
+	       ( ( int64_t ) TICKS_PER_SEC ) );
+	model->updated = now;
+
+	/* Calculate net heat flow, in milliwatts */
+	power = ( heating ? ( ( int64_t ) model->power ) : 0 );
+	power -= ( ( ( ( int64_t ) model->loss ) *
+		     ( model->temperature -
+		       ( ( ( int64_t ) model->ambient ) * 1000000 ) ) ) /
+		   1000000 );
+
+	/* One milliwatt for one microsecond raises the temperature of
+	 * one millijoule-per-degree by one micro-degree.
+	 */
+	model->temperature += ( ( power * dt ) /
+				( ( int64_t ) model->capacity ) );
+}
+
+/**
+ * Get thermal model temperature
+ *
+ * @v model		Thermal model
+ * @v scale		Number of decimal places
+ * @ret temperature	Temperature (in units of ( 10 ^ -scale ) degrees)
+ */
+int thermal_model_temperature ( struct thermal_model *model,
+				unsigned int scale ) {
+	int64_t temperature = model->temperature;
+	int64_t divisor;
+
+	assert ( scale <= 6 );
+	divisor = ( 1000000 / powers_of_ten[scale] );
+	return ( ( temperature + ( ( temperature < 0 ) ? -( divisor / 2 ) :
+				   ( divisor / 2 ) ) ) / divisor );
+}
+
+/*****************************************************************************
+ *
+ * Benchmarks
+ *
+ *****************************************************************************
+ */
+
+/** A benchmark control loop */
+struct control_bench {
+	/** Control loop */
+	struct control_loop loop;
+	/** Simulated thermal mass */
+	struct thermal_model model;
+	/** Heater is switched on */
+	int heating;
+};
+
+/** Benchmark control periods (in microseconds) */
+static const unsigned int control_bench_periods[] = { 1000, 250, 100 };
+
+/** Number of iterations for each benchmark control period */
+#define CONTROL_BENCH_ITERATIONS 2000
+
+/**
+ * Measure benchmark plant temperature
+ *
+ * @v loop		Control loop
+ * @v now		Current time
+ * @ret temperature	Current temperature (in tenths of a degree)
+ */
+static int control_bench_measure ( struct control_loop *loop,
+				   unsigned long now ) {
+	struct control_bench *bench =
+		container_of ( loop, struct control_bench, loop );
+
+	thermal_model_step ( &bench->model, bench->heating, now );
+	return thermal_model_temperature ( &bench->model, 1 );
+}
+
+/**
+ * Apply benchmark plant heater output
+ *
+ * @v loop		Control loop
+ * @v output		Controller output
+ */
+static void control_bench_actuate ( struct control_loop *loop,
+				    unsigned int output ) {
+	struct control_bench *bench =
+		container_of ( loop, struct control_bench, loop );
+
+	bench->heating = ( output >= ( CONTROL_OUTPUT_MAX / 2 ) );
+}
+
+/** Benchmark plant */
+static struct control_plant control_bench_plant = {
+	.measure = control_bench_measure,
+	.actuate = control_bench_actuate,
+};
+
+/**
+ * Initialise benchmark control loop
+ *
+ * @v bench		Benchmark control loop
+ * @v ctrl		Control algorithm
+ * @v period		Control period (in ticks)
+ */
+static void control_bench_init ( struct control_bench *bench,
+				 struct controller *ctrl,
+				 unsigned long period ) {
+
+	memset ( bench, 0, sizeof ( *bench ) );
+	bench->loop.name = "bench";
+	bench->loop.plant = &control_bench_plant;
+	bench->loop.ctrl = ctrl;
+	bench->loop.period = period;
+	bench->loop.setpoint = 1800;
+	bench->loop.kp = 5;
+	bench->loop.ki = 1;
+	bench->loop.kd = 20;
+	bench->loop.hysteresis = 20;
+	bench->model.temperature = ( 20 * 1000000LL );
+	bench->model.ambient = 20;
+	bench->model.power = 2000000;
+	bench->model.loss = 10000;
+	bench->model.capacity = 5000000;
+	pthread_mutex_init ( &bench->loop.lock, NULL );
+}
+
+/**
+ * Benchmark control loops
+ *
+ * @v count		Number of iterations
+ * @ret rc		Return status code
+ *
+ * The cost of each iteration is measured by stepping each control
+ * algorithm directly against a simulated plant.  The wakeup jitter
+ * is then measured by running a real control loop at a range of
+ * high control rates.
+ */
+static int control_bench_run ( unsigned int count ) {
+	struct control_bench bench;
+	struct control_loop *loop = &bench.loop;
+	struct control_stats stats;
+	unsigned long period;
+	unsigned long start;
+	unsigned long now;
+	unsigned int iterations;
+	unsigned int i;
+	unsigned int j;
+	int measured;
+	int rc;
+
+	/* Measure cost of each iteration, using simulated time */
+	for ( i = 0 ; i < ( sizeof ( controllers ) /
+			    sizeof ( controllers[0] ) ) ; i++ ) {
+		period = ( 100 * ( TICKS_PER_SEC / 1000000 ) );
+		control_bench_init ( &bench, controllers[i], period );
+		now = 0;
+		loop->previous = control_bench_measure ( loop, now );
+		start = currticks();
+		for ( j = 0 ; j < count ; j++ ) {
+			now += period;
+			measured = control_bench_measure ( loop, now );
+			loop->output = loop->ctrl->step ( loop, measured,
+							  period );
+			control_bench_actuate ( loop, loop->output );
+			loop->previous = measured;
+		}
+		bench_report ( "control", controllers[i]->name,
+			       ( currticks() - start ), count );
+		pthread_mutex_destroy ( &loop->lock );
+	}
+
+	/* Measure wakeup jitter at each control period */
+	for ( i = 0 ; i < ( sizeof ( control_bench_periods ) /
+			    sizeof ( control_bench_periods[0] ) ) ; i++ ) {
+		period = ( control_bench_periods[i] *
+			   ( TICKS_PER_SEC / 1000000 ) );
+		control_bench_init ( &bench, &pid_controller, period );
+		bench.model.updated = currticks();
+		if ( ( rc = control_start ( loop ) ) != 0 ) {
+			pthread_mutex_destroy ( &loop->lock );
+			return rc;
+		}
+		do {
+			usleep ( 10000 );
+			pthread_mutex_lock ( &loop->lock );
+			iterations = loop->stats.iterations;
+			pthread_mutex_unlock ( &loop->lock );
+		} while ( iterations < CONTROL_BENCH_ITERATIONS );
+		control_stop ( loop );
+		memcpy ( &stats, &loop->stats, sizeof ( stats ) );
+		pthread_mutex_destroy ( &loop->lock );
+		cprintf ( "control: period=%uus iterations=%lu overruns=%lu "
+			  "jitter=%lu/%luus busy=%lu/%luus\n",
+			  control_bench_periods[i], stats.iterations,
+			  stats.overruns,
+			  ( ( unsigned long ) ( stats.jitter /
+					        stats.iterations ) /
+			    ( TICKS_PER_SEC / 1000000 ) ),
+			  ( stats.jitter_max / ( TICKS_PER_SEC / 1000000 ) ),
+			  ( ( unsigned long ) ( stats.busy /
+					        stats.iterations ) /
+			    ( TICKS_PER_SEC / 1000000 ) ),
+			  ( stats.busy_max / ( TICKS_PER_SEC / 1000000 ) ) );
+	}
+
+	return 0;
+}
+
+/** Control loop benchmark */
+struct benchmark control_benchmark __benchmark = {
+	.name = "control",
+	.run = control_bench_run,
+};
+
+/*****************************************************************************
+ *
+ * Command line interface
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Parse control algorithm name
+ *
+ * @v text		Text
+ * @ret ctrl		Control algorithm
+ * @ret rc		Return status code
+ */
+static int parse_controller ( char *text, struct controller **ctrl ) {
+	unsigned int i;
+
+	/* Find control algorithm */
+	for ( i = 0 ; i < ( sizeof ( controllers ) /
+			    sizeof ( controllers[0] ) ) ; i++ ) {
+		if ( strcmp ( text, controllers[i]->name ) == 0 ) {
+			*ctrl = controllers[i];
+			return 0;
+		}
+	}
+
+	cprintf ( "\"%s\": no such control algorithm\n", text );
+	return -ENOENT;
+}
+
+/**
+ * Print control loop status
+ *
+ * @v loop		Control loop
+ */
+static void control_print ( struct control_loop *loop ) {
+	struct control_stats stats;
+	struct controller *ctrl;
+	unsigned long iterations;
+	unsigned long period;
+	unsigned int output;
+	unsigned int kp;
+	unsigned int ki;
+	unsigned int kd;
+	unsigned int hysteresis;
+	int setpoint;
+	int measured;
+
+	/* Take a consistent copy of the parameters and statistics */
+	pthread_mutex_lock ( &loop->lock );
+	ctrl = loop->ctrl;
+	period = loop->period;
+	setpoint = loop->setpoint;
+	measured = loop->previous;
+	output = loop->output;
+	kp = loop->kp;
+	ki = loop->ki;
+	kd = loop->kd;
+	hysteresis = loop->hysteresis;
+	memcpy ( &stats, &loop->stats, sizeof ( stats ) );
+	pthread_mutex_unlock ( &loop->lock );
+	iterations = ( stats.iterations ? stats.iterations : 1 );
+
+	cprintf ( "%s: %s period=%luus setpoint=%d measured=%d output=%u "
+		  "kp=%u ki=%u kd=%u hysteresis=%u\n", loop->name,
+		  ctrl->name, ( period / ( TICKS_PER_SEC / 1000000 ) ),
+		  setpoint, measured, output, kp, ki, kd, hysteresis );
+	cprintf ( "  iterations=%lu overruns=%lu jitter=%lu/%luus "
+		  "busy=%lu/%luus\n", stats.iterations, stats.overruns,
+		  ( ( unsigned long ) ( stats.jitter / iterations ) /
+		    ( TICKS_PER_SEC / 1000000 ) ),
+		  ( stats.jitter_max / ( TICKS_PER_SEC / 1000000 ) ),
+		  ( ( unsigned long ) ( stats.busy / iterations ) /
+		    ( TICKS_PER_SEC / 1000000 ) ),
+		  ( stats.busy_max / ( TICKS_PER_SEC / 1000000 ) ) );
+}
+
+/** "control" options */
+struct control_options {
+	/** Control algorithm */
+	struct controller *ctrl;
+	/** Control period (in microseconds) */
+	unsigned int period;
+	/** Proportional gain */
+	unsigned int kp;
+	/** Integral gain */
+	unsigned int ki;
+	/** Derivative gain */
+	unsigned int kd;
+	/** Hysteresis */
+	unsigned int hysteresis;
+	/** Reset statistics */
+	int reset;
+};
+
+/** "control" option list */
+static struct option_descriptor control_opts[] = {
+	OPTION_DESC ( "algorithm", 'a', required_argument,
+		      struct control_options, ctrl, parse_controller ),
+	OPTION_DESC ( "period", 'p', required_argument,
+		      struct control_options, period, parse_integer ),
+	OPTION_DESC ( "kp", 'P', required_argument,
+		      struct control_options, kp, parse_integer ),
+	OPTION_DESC ( "ki", 'I', required_argument,
+		      struct control_options, ki, parse_integer ),
+	OPTION_DESC ( "kd", 'D', required_argument,
+		      struct control_options, kd, parse_integer ),
+	OPTION_DESC ( "hysteresis", 'H', required_argument,
+		      struct control_options, hysteresis, parse_integer ),
+	OPTION_DESC ( "reset", 'z', no_argument,
+		      struct control_options, reset, parse_flag ),
+};
+
+/** "control" command descriptor */
+static struct command_descriptor control_cmd =
+	COMMAND_DESC ( struct control_options, control_opts, 0, 1,
+		       "[<name>]" );
+
+/**
+ * "control" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int control_exec ( int argc, char **argv ) {
+	struct control_options opts;
+	struct control_loop *loop;
+	const char *name;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &control_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* List all control loops if no name is specified.  The list
+	 * lock is held throughout, so that no loop can be stopped
+	 * while being printed or modified.
+	 */
+	pthread_mutex_lock ( &control_loops_lock );
+	if ( optind == argc ) {
+		list_for_each_entry ( loop, &control_loops, list )
+			control_print ( loop );
+		rc = 0;
+		goto out;
+	}
+
+	/* Find control loop */
+	name = argv[optind];
+	list_for_each_entry ( loop, &control_loops, list ) {
+		if ( strcmp ( loop->name, name ) == 0 )
+			break;
+	}
+	if ( &loop->list == &control_loops ) {
+		cprintf ( "\"%s\": no such control loop\n", name );
+		rc = -ENOENT;
+		goto out;
+	}
+
+	/* Reparse options using current values as defaults */
+	pthread_mutex_lock ( &loop->lock );
+	opts.ctrl = loop->ctrl;
+	opts.period = ( loop->period / ( TICKS_PER_SEC / 1000000 ) );
+	opts.kp = loop->kp;
+	opts.ki = loop->ki;
+	opts.kd = loop->kd;
+	opts.hysteresis = loop->hysteresis;
+	pthread_mutex_unlock ( &loop->lock );
+	opts.reset = 0;
+	optind = 0;
+	if ( ( rc = reparse_options ( argc, argv, &control_cmd,
+				      &opts ) ) != 0 )
+		goto out;
+	if ( ! opts.period ) {
+		print_usage ( &control_cmd, argv );
+		rc = -EINVAL;
+		goto out;
+	}
+
+	/* Apply new parameters */
+	pthread_mutex_lock ( &loop->lock );
+	if ( opts.ctrl != loop->ctrl )
+		loop->integral = 0;
+	loop->ctrl = opts.ctrl;
+	loop->period = ( opts.period * ( TICKS_PER_SEC / 1000000 ) );
+	loop->kp = opts.kp;
+	loop->ki = opts.ki;
+	loop->kd = opts.kd;
+	loop->hysteresis = opts.hysteresis;
+	if ( opts.reset )
+		memset ( &loop->stats, 0, sizeof ( loop->stats ) );
+	pthread_mutex_unlock ( &loop->lock );
+
+	control_print ( loop );
+	rc = 0;
+
+ out:
+	pthread_mutex_unlock ( &control_loops_lock );
+	return rc;
+}
+
+/** "control" command */
+struct command control_command __command = {
+	.name = "control",
+	.exec = control_exec,
+};
@@ -0,0 +1,757 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Input debouncing
+ *
+ * A debounced input is sampled only while it is settling.  Each raw
+ * edge (typically reported by an interrupt handler) triggers
+ * sampling, and sampling stops once the debounced value is stable.
+ * All inputs are sampled by a single shared thread, which sleeps
+ * indefinitely while every input is stable.
+ *
+ * Changes and settling are collected while sampling, and reported
+ * to each input's methods only after the debounce lock has been
+ * dropped, so that those methods may notify observers or report
+ * further edges.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <uniport/debounce.h>
+#include <uniport/string.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+
+/** Debounce lock */
+static pthread_mutex_t debounce_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Debounce thread wakeup */
+static pthread_cond_t debounce_wake = PTHREAD_COND_INITIALIZER;
+
+/** List of debounced inputs */
+static LIST_HEAD ( debounce_inputs );
+
+/** List of inputs being sampled */
+static LIST_HEAD ( debounce_active );
+
+/** List of inputs with events awaiting report */
+static LIST_HEAD ( debounce_pending );
+
+/** Input whose events are currently being reported */
+static struct debounce *debounce_reporting;
+
+/** Debounce event report completion */
+static pthread_cond_t debounce_reported = PTHREAD_COND_INITIALIZER;
+
+/** Debounce thread has been started */
+static int debounce_running;
+
+/** Debounced value has changed */
+#define DEBOUNCE_CHANGED 0x0001
+
+/** Input has settled */
+#define DEBOUNCE_SETTLED 0x0002
+
+/*****************************************************************************
+ *
+ * Filters
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Reset debounce filter
+ *
+ * @v deb		Debounced input
+ * @v raw		Raw input value
+ * @v now		Current time
+ */
+void debounce_reset ( struct debounce *deb, int raw, unsigned long now ) {
+
+	deb->value = ( !! raw );
+	deb->raw = deb->value;
+	deb->count = ( deb->value ? deb->threshold : 0 );
+	deb->since = now;
+	deb->sampling = 0;
+	memset ( &deb->stats, 0, sizeof ( deb->stats ) );
+}
+
+/**
+ * Apply sample to debounce filter
+ *
+ * @v deb		Debounced input
+ * @v raw		Raw input value
+ * @v now		Current time
+ * @ret changed		Debounced value has changed
+ */
+int debounce_step ( struct debounce *deb, int raw, unsigned long now ) {
+	int value = deb->value;
+
+	/* Record raw value */
+	raw = ( !! raw );
+	if ( raw != deb->raw ) {
+		deb->raw = raw;
+		deb->since = now;
+	}
+	deb->stats.samples++;
+
+	/* Apply filter */
+	switch ( deb->mode ) {
+	case DEBOUNCE_INTEGRATOR:
+		if ( raw ) {
+			if ( deb->count < deb->threshold )
+				deb->count++;
+		} else {
+			if ( deb->count )
+				deb->count--;
+		}
+		if ( deb->count == 0 ) {
+			value = 0;
+		} else if ( deb->count >= deb->threshold ) {
+			value = 1;
+		}
+		break;
+	case DEBOUNCE_WINDOW:
+		if ( ( now - deb->since ) >= deb->window )
+			value = raw;
+		break;
+	}
+
+	/* Record any change */
+	if ( value == deb->value )
+		return 0;
+	deb->value = value;
+	deb->stats.changes++;
+	return 1;
+}
+
+/**
+ * Check if debounced input has settled
+ *
+ * @v deb		Debounced input
+ * @v now		Current time
+ * @ret settled		Debounced value matches a stable raw value
+ */
+int debounce_is_settled ( struct debounce *deb, unsigned long now ) {
+
+	if ( deb->raw != deb->value )
+		return 0;
+	switch ( deb->mode ) {
+	case DEBOUNCE_INTEGRATOR:
+		return ( deb->count == ( deb->value ? deb->threshold : 0 ) );
+	case DEBOUNCE_WINDOW:
+		return ( ( now - deb->since ) >= deb->window );
+	default:
+		return 1;
+	}
+}
+
+/*****************************************************************************
+ *
+ * Debounce thread
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Start sampling input
+ *
+ * @v deb		Debounced input
+ *
+ * Must be called with the debounce lock held.
+ */
+static void debounce_start ( struct debounce *deb ) {
+
+	if ( deb->sampling )
+		return;
+	deb->sampling = 1;
+	list_add_tail ( &deb->active, &debounce_active );
+	pthread_cond_signal ( &debounce_wake );
+}
+
+/**
+ * Record event for later report
+ *
+ * @v deb		Debounced input
+ * @v event		Event
+ *
+ * Must be called with the debounce lock held.
+ */
+static void debounce_defer ( struct debounce *deb, unsigned int event ) {
+
+	if ( ! deb->events )
+		list_add_tail ( &deb->pending, &debounce_pending );
+	deb->events |= event;
+}
+
+/**
+ * Sample input
+ *
+ * @v deb		Debounced input
+ * @v now		Current time
+ *
+ * Must be called with the debounce lock held.
+ */
+static void debounce_sample ( struct debounce *deb, unsigned long now ) {
+
+	/* Apply sample to filter */
+	if ( debounce_step ( deb, deb->sample ( deb ), now ) )
+		debounce_defer ( deb, DEBOUNCE_CHANGED );
+
+	/* Stop sampling once settled */
+	if ( ! debounce_is_settled ( deb, now ) )
+		return;
+	list_del ( &deb->active );
+	deb->sampling = 0;
+	if ( deb->settled )
+		debounce_defer ( deb, DEBOUNCE_SETTLED );
+}
+
+/**
+ * Report events for input
+ *
+ * @v deb		Debounced input
+ *
+ * Must be called with the debounce lock held.  The lock is dropped
+ * while the input's methods are called, and debounce_unregister()
+ * waits for the report to complete.
+ */
+static void debounce_report ( struct debounce *deb ) {
+	unsigned int events = deb->events;
+
+	/* Claim events */
+	list_del ( &deb->pending );
+	deb->events = 0;
+	debounce_reporting = deb;
+
+	/* Call methods without the debounce lock held */
+	pthread_mutex_unlock ( &debounce_lock );
+	if ( events & DEBOUNCE_CHANGED )
+		deb->changed ( deb );
+	if ( events & DEBOUNCE_SETTLED )
+		deb->settled ( deb );
+	pthread_mutex_lock ( &debounce_lock );
+
+	/* Resume sampling if the input changed before the edge
+	 * interrupt was re-enabled.
+	 */
+	if ( ( events & DEBOUNCE_SETTLED ) &&
+	     ( ( !! deb->sample ( deb ) ) != deb->value ) )
+		debounce_start ( deb );
+
+	/* Allow input to be unregistered */
+	debounce_reporting = NULL;
+	pthread_cond_broadcast ( &debounce_reported );
+}
+
+/**
+ * Run debounce thread
+ *
+ * @v arg		Argument (ignored)
+ * @ret result		Result (unused)
+ */
+static void * debounce_thread ( void *arg __unused ) {
+	struct debounce *deb;
+	struct debounce *tmp;
+	unsigned long now;
+
+	pthread_mutex_lock ( &debounce_lock );
+	while ( 1 ) {
+
+		/* Sleep until an input is triggered */
+		while ( list_empty ( &debounce_active ) )
+			pthread_cond_wait ( &debounce_wake, &debounce_lock );
+
+		/* Wait for next sampling period */
+		pthread_mutex_unlock ( &debounce_lock );
+		usleep ( DEBOUNCE_PERIOD / ( TICKS_PER_SEC / 1000000 ) );
+		pthread_mutex_lock ( &debounce_lock );
+
+		/* Sample each active input */
+		now = currticks();
+		list_for_each_entry_safe ( deb, tmp, &debounce_active, active )
+			debounce_sample ( deb, now );
+
+		/* Report any resulting events */
+		while ( ( deb = list_first_entry ( &debounce_pending,
+						   struct debounce,
+						   pending ) ) != NULL ) {
+			debounce_report ( deb );
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Register debounced input
+ *
+ * @v deb		Debounced input
+ * @ret rc		Return status code
+ *
+ * The debounced value is initialised from the current raw value.
+ */
+int debounce_register ( struct debounce *deb ) {
+	pthread_t thread;
+	int rc;
+
+	pthread_mutex_lock ( &debounce_lock );
+
+	/* Start shared thread, if not already running */
+	if ( ! debounce_running ) {
+		if ( ( rc = pthread_create ( &thread, NULL, debounce_thread,
+					     NULL ) ) != 0 ) {
+			rc = -rc;
+			goto err_create;
+		}
+		pthread_detach ( thread );
+		debounce_running = 1;
+	}
+
+	/* Initialise filter and add to list of inputs */
+	debounce_reset ( deb, deb->sample ( deb ), currticks() );
+	list_add_tail ( &deb->list, &debounce_inputs );
+	rc = 0;
+
+ err_create:
+	pthread_mutex_unlock ( &debounce_lock );
+	return rc;
+}
+
+/**
+ * Unregister debounced input
+ *
+ * @v deb		Debounced input
+ *
+ * This waits for any in-progress report of the input's events to
+ * complete, and discards any events not yet reported.
+ */
+void debounce_unregister ( struct debounce *deb ) {
+
+	pthread_mutex_lock ( &debounce_lock );
+	while ( debounce_reporting == deb )
+		pthread_cond_wait ( &debounce_reported, &debounce_lock );
+	if ( deb->sampling ) {
+		list_del ( &deb->active );
+		deb->sampling = 0;
+	}
+	if ( deb->events ) {
+		list_del ( &deb->pending );
+		deb->events = 0;
+	}
+	list_del ( &deb->list );
+	pthread_mutex_unlock ( &debounce_lock );
+}
+
+/**
+ * Report raw edge on debounced input
+ *
+ * @v deb		Debounced input
+ *
+ * This starts sampling the input, if it is not already being
+ * sampled.  This must not be called from interrupt context.
+ */
+void debounce_trigger ( struct debounce *deb ) {
+
+	pthread_mutex_lock ( &debounce_lock );
+	deb->stats.triggers++;
+	debounce_start ( deb );
+	pthread_mutex_unlock ( &debounce_lock );
+}
+
+/*****************************************************************************
+ *
+ * Bounce trace replay
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Append edge to bounce trace
+ *
+ * @v trace		Bounce trace
+ * @v time		Time (in ticks)
+ * @v raw		Raw value following the edge
+ * @ret rc		Return status code
+ */
+static int debounce_trace_add ( struct debounce_trace *trace,
+				unsigned long time, int raw ) {
+	struct debounce_edge *edges;
+	unsigned int max;
+
+	/* Extend edge list, if necessary */
+	if ( trace->count == trace->max ) {
+		max = ( trace->max ? ( trace->max * 2 ) : 256 );
+		edges = realloc ( trace->edges, ( max * sizeof ( *edges ) ) );
+		if ( ! edges )
+			return -ENOMEM;
+		trace->edges = edges;
+		trace->max = max;
+	}
+
+	/* Record edge */
+	trace->edges[trace->count].time = time;
+	trace->edges[trace->count].raw = raw;
+	trace->count++;
+	return 0;
+}
+
+/**
+ * Load bounce trace
+ *
+ * @v trace		Bounce trace
+ * @v filename		File name
+ * @ret rc		Return status code
+ *
+ * Each line of the file holds a time in microseconds and the raw
+ * value (0 or 1) following the edge at that time.  Times must not
+ * decrease, and the raw value is initially 0.  Blank lines and lines
+ * starting with '#' are ignored.
+ */
+int debounce_trace_load ( struct debounce_trace *trace,
+			  const char *filename ) {
+	char line[80];
+	const char *end;
+	char *tmp;
+	unsigned long time;
+	unsigned long previous = 0;
+	FILE *file;
+	int raw;
+	int rc;
+
+	/* Open file */
+	file = fopen ( filename, "r" );
+	if ( ! file ) {
+		rc = -errno;
+		goto err_open;
+	}
+
+	/* Parse each line */
+	while ( fgets ( line, sizeof ( line ), file ) ) {
+		tmp = ( line + strspn ( line, " \t" ) );
+		if ( ( ! *tmp ) || ( *tmp == '\n' ) || ( *tmp == '#' ) )
+			continue;
+		errno = 0;
+		time = strtoul ( tmp, &tmp, 10 );
+		if ( errno || ( *tmp != ' ' ) || ( time < previous ) ) {
+			rc = -EINVAL;
+			goto err_parse;
+		}
+		tmp += strspn ( tmp, " " );
+		if ( ( ( rc = parse_int ( tmp, &end, &raw ) ) != 0 ) ||
+		     ( raw < 0 ) || ( raw > 1 ) ||
+		     ( ( *end != '\n' ) && ( *end != '\0' ) ) ) {
+			rc = -EINVAL;
+			goto err_parse;
+		}
+		if ( ( rc = debounce_trace_add ( trace,
+						 ( time * ( TICKS_PER_SEC /
+							    1000000 ) ),
+						 raw ) ) != 0 )
+			goto err_add;
+		previous = time;
+	}
+
+	rc = 0;
+ err_add:
+ err_parse:
+	fclose ( file );
+ err_open:
+	return rc;
+}
+
+/**
+ * Append simulated bounce burst to bounce trace
+ *
+ * @v trace		Bounce trace
+ * @v time		Time of first edge (updated to follow the burst)
+ * @v raw		Final raw value
+ * @v seed		Random seed
+ * @ret rc		Return status code
+ */
+static int debounce_trace_burst ( struct debounce_trace *trace,
+				  unsigned long *time, int raw,
+				  unsigned int *seed ) {
+	unsigned int edges = ( ( 2 * ( rand_r ( seed ) % 32 ) ) + 1 );
+	unsigned int i;
+	int rc;
+
+	/* Generate an odd number of edges, each 5-300us apart */
+	for ( i = edges ; i ; i-- ) {
+		if ( ( rc = debounce_trace_add ( trace, *time,
+						 ( ( i & 1 ) ? raw :
+						   ( ! raw ) ) ) ) != 0 )
+			return rc;
+		*time += ( ( 5 + ( rand_r ( seed ) % 295 ) ) *
+			   ( TICKS_PER_SEC / 1000000 ) );
+	}
+	return 0;
+}
+
+/**
+ * Generate simulated bounce trace
+ *
+ * @v trace		Bounce trace
+ * @v presses		Number of button presses
+ * @v seed		Random seed
+ * @ret rc		Return status code
+ */
+static int debounce_trace_generate ( struct debounce_trace *trace,
+				     unsigned int presses,
+				     unsigned int seed ) {
+	unsigned long time = 0;
+	unsigned int i;
+	int rc;
+
+	/* Generate presses separated by 100-500ms, each held for
+	 * 50-300ms, with a bounce burst on both press and release.
+	 */
+	for ( i = 0 ; i < presses ; i++ ) {
+		time += ( ( 100 + ( rand_r ( &seed ) % 400 ) ) * TICKS_PER_MS );
+		if ( ( rc = debounce_trace_burst ( trace, &time, 1,
+						   &seed ) ) != 0 )
+			return rc;
+		time += ( ( 50 + ( rand_r ( &seed ) % 250 ) ) * TICKS_PER_MS );
+		if ( ( rc = debounce_trace_burst ( trace, &time, 0,
+						   &seed ) ) != 0 )
+			return rc;
+	}
+	trace->expected = ( 2 * presses );
+	return 0;
+}
+
+/**
+ * Replay bounce trace without debouncing
+ *
+ * @v trace		Bounce trace
+ * @v replay		Replay results to fill in
+ *
+ * Every edge wakes the handler, which notifies whenever the raw value
+ * differs from the previously notified value.
+ */
+void debounce_replay_raw ( struct debounce_trace *trace,
+			   struct debounce_replay *replay ) {
+	int value = 0;
+	unsigned int i;
+
+	memset ( replay, 0, sizeof ( *replay ) );
+	for ( i = 0 ; i < trace->count ; i++ ) {
+		replay->wakeups++;
+		if ( trace->edges[i].raw != value ) {
+			value = trace->edges[i].raw;
+			replay->notifications++;
+		}
+	}
+}
+
+/**
+ * Replay bounce trace through debounce filter
+ *
+ * @v trace		Bounce trace
+ * @v deb		Debounced input (with filter parameters set)
+ * @v replay		Replay results to fill in
+ *
+ * This models the debounce thread: the first edge wakes the thread,
+ * which then samples every DEBOUNCE_PERIOD until the input settles.
+ * Edges seen while sampling are masked.
+ */
+void debounce_replay_filter ( struct debounce_trace *trace,
+			      struct debounce *deb,
+			      struct debounce_replay *replay ) {
+	struct debounce_edge *edge = trace->edges;
+	struct debounce_edge *end = ( trace->edges + trace->count );
+	unsigned long next = 0;
+	int raw = 0;
+
+	memset ( replay, 0, sizeof ( *replay ) );
+	debounce_reset ( deb, raw, ( trace->count ? edge->time : 0 ) );
+	while ( ( edge < end ) || deb->sampling ) {
+
+		/* Take any sample due before the next edge */
+		if ( deb->sampling &&
+		     ( ( edge == end ) ||
+		       ( ( ( long ) ( edge->time - next ) ) > 0 ) ) ) {
+			replay->wakeups++;
+			if ( debounce_step ( deb, raw, next ) )
+				replay->notifications++;
+			if ( debounce_is_settled ( deb, next ) )
+				deb->sampling = 0;
+			next += DEBOUNCE_PERIOD;
+			continue;
+		}
+
+		/* Apply edge, starting sampling if not already active */
+		raw = edge->raw;
+		if ( ! deb->sampling ) {
+			deb->stats.triggers++;
+			deb->sampling = 1;
+			replay->wakeups++;
+			next = ( edge->time + DEBOUNCE_PERIOD );
+		}
+		edge++;
+	}
+	replay->samples = deb->stats.samples;
+}
+
+/** "debounce" options */
+struct debounce_options {
+	/** Integrator threshold (in samples) */
+	unsigned int threshold;
+	/** Stable time window (in milliseconds) */
+	unsigned int window;
+	/** Number of simulated presses */
+	unsigned int presses;
+	/** Random seed */
+	unsigned int seed;
+};
+
+/** "debounce" option list */
+static struct option_descriptor debounce_opts[] = {
+	OPTION_DESC ( "threshold", 't', required_argument,
+		      struct debounce_options, threshold, parse_integer ),
+	OPTION_DESC ( "window", 'w', required_argument,
+		      struct debounce_options, window, parse_integer ),
+	OPTION_DESC ( "presses", 'n', required_argument,
+		      struct debounce_options, presses, parse_integer ),
+	OPTION_DESC ( "seed", 's', required_argument,
+		      struct debounce_options, seed, parse_integer ),
+};
+
+/** "debounce" command descriptor */
+static struct command_descriptor debounce_cmd =
+	COMMAND_DESC ( struct debounce_options, debounce_opts, 0, 1,
+		       "[<trace>]" );
+
+/**
+ * Print bounce trace replay results
+ *
+ * @v name		Filter name
+ * @v replay		Replay results
+ * @v raw		Unfiltered replay results
+ */
+static void debounce_replay_print ( const char *name,
+				    struct debounce_replay *replay,
+				    struct debounce_replay *raw ) {
+
+	cprintf ( "%-10s %8lu notifications %8lu wakeups %8lu samples",
+		  name, replay->notifications, replay->wakeups,
+		  replay->samples );
+	if ( replay != raw ) {
+		cprintf ( " (%ld notifications and %ld wakeups saved)",
+			  ( ( long ) ( raw->notifications -
+				       replay->notifications ) ),
+			  ( ( long ) ( raw->wakeups - replay->wakeups ) ) );
+	}
+	cprintf ( "\n" );
+}
+
+/**
+ * "debounce" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ *
+ * Show the statistics for each debounced input, then replay a bounce
+ * trace (either recorded or simulated) without debouncing and through
+ * each debounce filter, and report the notifications and wakeups
+ * resulting from each.
+ */
+static int debounce_exec ( int argc, char **argv ) {
+	struct debounce_options opts;
+	struct debounce_trace trace;
+	struct debounce_replay raw;
+	struct debounce_replay integrator;
+	struct debounce_replay window;
+	struct debounce deb;
+	struct debounce *input;
+	int rc;
+
+	/* Parse options, with defaults */
+	memset ( &opts, 0, sizeof ( opts ) );
+	opts.threshold = 5;
+	opts.window = 5;
+	opts.presses = 100;
+	if ( ( rc = reparse_options ( argc, argv, &debounce_cmd,
+				      &opts ) ) != 0 )
+		goto err_parse;
+	if ( ! opts.threshold ) {
+		cprintf ( "Threshold must be non-zero\n" );
+		rc = -EINVAL;
+		goto err_parse;
+	}
+
+	/* Show debounced inputs */
+	pthread_mutex_lock ( &debounce_lock );
+	list_for_each_entry ( input, &debounce_inputs, list ) {
+		cprintf ( "%s: value=%d %lu triggers %lu samples %lu changes\n",
+			  input->name, input->value, input->stats.triggers,
+			  input->stats.samples, input->stats.changes );
+	}
+	pthread_mutex_unlock ( &debounce_lock );
+
+	/* Load or generate bounce trace */
+	memset ( &trace, 0, sizeof ( trace ) );
+	if ( optind < argc ) {
+		rc = debounce_trace_load ( &trace, argv[optind] );
+	} else {
+		rc = debounce_trace_generate ( &trace, opts.presses,
+					       opts.seed );
+	}
+	if ( rc != 0 )
+		goto err_trace;
+
+	/* Replay trace */
+	memset ( &deb, 0, sizeof ( deb ) );
+	debounce_replay_raw ( &trace, &raw );
+	deb.mode = DEBOUNCE_INTEGRATOR;
+	deb.threshold = opts.threshold;
+	debounce_replay_filter ( &trace, &deb, &integrator );
+	deb.mode = DEBOUNCE_WINDOW;
+	deb.window = ( opts.window * TICKS_PER_MS );
+	debounce_replay_filter ( &trace, &deb, &window );
+
+	/* Report results */
+	cprintf ( "%u edges", trace.count );
+	if ( trace.expected )
+		cprintf ( ", %u expected changes", trace.expected );
+	cprintf ( "\n" );
+	debounce_replay_print ( "raw", &raw, &raw );
+	debounce_replay_print ( "integrator", &integrator, &raw );
+	debounce_replay_print ( "window", &window, &raw );
+
+ err_trace:
+	free ( trace.edges );
+ err_parse:
+	return rc;
+}
+
+/** "debounce" command */
+struct command debounce_command __command = {
+	.name = "debounce",
+	.exec = debounce_exec,
+};
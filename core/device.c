@@ -24,7 +24,9 @@
  *
  */
 
+#include <stdio.h>
 #include <uniport/device.h>
+#include <uniport/interface.h>
 #include <uniport/init.h>
 
 /**
@@ -33,12 +35,20 @@
  */
 static void devices_init ( void ) {
 	struct device *dev;
+	struct resource **res;
 	int rc;
 
 	/* Register all device namespaces */
 	for_each_table_entry ( dev, DEVICES ) {
 		rc = resource_register ( &dev->ns );
 		assert ( rc == 0 );
+
+		/* Print initial resource state for diagnostics */
+		printf ( "Namespace %s...\n", dev->ns.uri );
+		for ( res = dev->ns.resources ; *res ; res++ ) {
+			resource_print ( *res, &oic_if_baseline,
+					 resource_retrieve ( *res ) );
+		}
 	}
 }
 
@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Resource discovery
+ *
+ * The discovery resource "/oic/res" lists a link for every registered
+ * resource, using the CoRE link format (RFC 6690).  Links are
+ * serialised once per namespace when the namespace is registered.
+ * The complete list is never assembled: it is formatted directly
+ * from the per-namespace links, under a lock, into the caller's
+ * buffer.  Readers therefore never hold a pointer into storage that
+ * may be freed by a concurrent registration or unregistration.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <uniport/discovery.h>
+#include <uniport/interface.h>
+#include <uniport/device.h>
+#include <uniport/string.h>
+
+/** Serialised discovery links for a namespace */
+struct discovery_links {
+	/** List of serialised discovery links */
+	struct list_head list;
+	/** Length of links */
+	size_t len;
+	/** Links */
+	char text[0];
+};
+
+/** List of serialised discovery links */
+static LIST_HEAD ( discovery_list );
+
+/** Discovery links lock */
+static pthread_mutex_t discovery_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Discovery links generation */
+static unsigned int discovery_generation;
+
+/**
+ * Append text to a link
+ *
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v used		Length used so far
+ * @v text		Text
+ * @v text_len		Length of text
+ * @ret used		Updated length used
+ */
+static size_t discovery_append ( char *buf, size_t len, size_t used,
+				 const char *text, size_t text_len ) {
+	size_t offset = ( ( used < len ) ? used : len );
+
+	return ( used + format_string ( ( buf + offset ), ( len - offset ),
+					text, text_len ) );
+}
+
+/**
+ * Check if resource is accessible via an interface
+ *
+ * @v res		Resource
+ * @v intf		Interface
+ * @ret accessible	Resource has at least one property in the interface
+ */
+bool discovery_has_interface ( struct resource *res,
+			       struct interface *intf ) {
+	const struct resource_descriptor *desc = res->desc;
+
+	return ( interface_mask_next ( intf, desc, INTERFACE_VISIBLE, 0 ) <
+		 desc->count );
+}
+
+/**
+ * Format discovery link for a resource
+ *
+ * @v res		Resource
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @ret len		Length of link
+ */
+size_t discovery_link ( struct resource *res, char *buf, size_t len ) {
+	struct interface *intf;
+	size_t offset;
+	size_t used = 0;
+	bool first = true;
+
+	/* Construct "<uri>" */
+	used = discovery_append ( buf, len, used, "<", 1 );
+	offset = ( ( used < len ) ? used : len );
+	used += resource_uri ( res, ( buf + offset ), ( len - offset ) );
+	used = discovery_append ( buf, len, used, ">", 1 );
+
+	/* Construct ";rt=\"...\"", if applicable */
+	if ( res->desc->rt ) {
+		used = discovery_append ( buf, len, used, ";rt=\"", 5 );
+		used = discovery_append ( buf, len, used, res->desc->rt,
+					  strlen ( res->desc->rt ) );
+		used = discovery_append ( buf, len, used, "\"", 1 );
+	}
+
+	/* Construct ";if=\"...\"" */
+	used = discovery_append ( buf, len, used, ";if=\"", 5 );
+	for_each_table_entry ( intf, INTERFACES ) {
+		if ( ! discovery_has_interface ( res, intf ) )
+			continue;
+		if ( ! first )
+			used = discovery_append ( buf, len, used, " ", 1 );
+		used = discovery_append ( buf, len, used, intf->name,
+					  strlen ( intf->name ) );
+		first = false;
+	}
+	used = discovery_append ( buf, len, used, "\"", 1 );
+
+	return used;
+}
+
+/**
+ * Format discovery links for a namespace
+ *
+ * @v ns		Resource namespace
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @ret len		Length of links
+ */
+static size_t discovery_format ( struct namespace *ns, char *buf,
+				 size_t len ) {
+	struct resource **res;
+	size_t offset;
+	size_t used = 0;
+
+	for ( res = ns->resources ; *res ; res++ ) {
+		if ( res != ns->resources )
+			used = discovery_append ( buf, len, used, ",", 1 );
+		offset = ( ( used < len ) ? used : len );
+		used += discovery_link ( *res, ( buf + offset ),
+					 ( len - offset ) );
+	}
+
+	return used;
+}
+
+/**
+ * Add discovery links for a namespace
+ *
+ * @v ns		Resource namespace
+ * @ret rc		Return status code
+ */
+int discovery_add ( struct namespace *ns ) {
+	struct discovery_links *links;
+	size_t len;
+	size_t check;
+
+	/* Serialise links for this namespace */
+	len = discovery_format ( ns, NULL, 0 );
+	links = malloc ( sizeof ( *links ) + len + 1 /* NUL */ );
+	if ( ! links )
+		return -ENOMEM;
+	check = discovery_format ( ns, links->text, ( len + 1 /* NUL */ ) );
+	assert ( check == len );
+	links->len = len;
+	ns->links = links;
+
+	/* Add to list of links */
+	pthread_mutex_lock ( &discovery_lock );
+	list_add_tail ( &links->list, &discovery_list );
+	discovery_generation++;
+	pthread_mutex_unlock ( &discovery_lock );
+
+	return 0;
+}
+
+/**
+ * Remove discovery links for a namespace
+ *
+ * @v ns		Resource namespace
+ */
+void discovery_del ( struct namespace *ns ) {
+	struct discovery_links *links = ns->links;
+
+	/* Do nothing unless links were added */
+	if ( ! links )
+		return;
+
+	/* Remove from list of links */
+	pthread_mutex_lock ( &discovery_lock );
+	list_del ( &links->list );
+	discovery_generation++;
+	pthread_mutex_unlock ( &discovery_lock );
+
+	/* Free links for this namespace */
+	free ( links );
+	ns->links = NULL;
+}
+
+/**
+ * Copy part of discovery links for all namespaces
+ *
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v offset		Starting offset within links
+ * @ret len		Length of remainder of links
+ *
+ * The links are copied in the same way as snprintf(), and so will be
+ * truncated and NUL-terminated if they do not fit within the buffer.
+ */
+size_t discovery_links ( char *buf, size_t len, size_t offset ) {
+	struct discovery_links *links;
+	size_t position = 0;
+	size_t used = 0;
+	size_t piece_len;
+	size_t skip;
+	size_t copy;
+	const char *piece;
+	unsigned int i;
+
+	pthread_mutex_lock ( &discovery_lock );
+
+	/* Copy each separator and per-namespace list of links */
+	list_for_each_entry ( links, &discovery_list, list ) {
+		if ( ! links->len )
+			continue;
+		for ( i = ( position ? 0 : 1 ) ; i < 2 ; i++ ) {
+			piece = ( i ? links->text : "," );
+			piece_len = ( i ? links->len : 1 );
+			if ( ( position + piece_len ) > offset ) {
+				skip = ( ( offset > position ) ?
+					 ( offset - position ) : 0 );
+				if ( ( used + 1 /* NUL */ ) < len ) {
+					copy = ( piece_len - skip );
+					if ( copy > ( len - used - 1 ) )
+						copy = ( len - used - 1 );
+					memcpy ( ( buf + used ),
+						 ( piece + skip ), copy );
+				}
+				used += ( piece_len - skip );
+			}
+			position += piece_len;
+		}
+	}
+
+	pthread_mutex_unlock ( &discovery_lock );
+
+	/* Terminate string */
+	if ( len )
+		buf[ ( used < len ) ? used : ( len - 1 ) ] = '\0';
+
+	return used;
+}
+
+/**
+ * Format part of property as string
+ *
+ * @v prop		Property
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		State variable
+ * @v offset		Starting offset within formatted string
+ * @v hint		Position hint (unused)
+ * @ret len		Length of remainder of string
+ */
+static size_t
+discovery_links_format_part ( struct property *prop __unused, char *buf,
+			      size_t len, const unsigned int *value __unused,
+			      size_t offset,
+			      struct property_hint *hint __unused ) {
+
+	return discovery_links ( buf, len, offset );
+}
+
+/**
+ * Format property as string
+ *
+ * @v prop		Property
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		State variable
+ * @ret len		Length of string
+ */
+static size_t discovery_links_format ( struct property *prop __unused,
+				       char *buf, size_t len,
+				       const unsigned int *value __unused ) {
+
+	return discovery_links ( buf, len, 0 );
+}
+
+/**
+ * Parse property from a string
+ *
+ * @v prop		Property
+ * @v string		String
+ * @v value		State variable
+ * @ret rc		Return status code
+ */
+static int discovery_links_parse ( struct property *prop __unused,
+				   const char *string __unused,
+				   unsigned int *value __unused ) {
+
+	return -ENOTSUP;
+}
+
+/** Discovery links property type
+ *
+ * The state variable holds only the discovery links generation.  The
+ * links themselves are formatted directly from the per-namespace
+ * links at the time of formatting.
+ */
+static const struct property_type discovery_links_property __property_type =
+	PROPERTY_TYPE ( "links", unsigned int, discovery_links_format,
+			discovery_links_parse,
+			.format_part = PROPERTY_FORMAT_PART (
+				unsigned int, discovery_links_format_part ) );
+
+/** Discovery resource state */
+struct discovery_state {
+	/** Links generation */
+	unsigned int generation;
+};
+
+/** Discovery resource properties */
+static struct property discovery_props[] = {
+	PROPERTY ( "links", struct discovery_state, generation, unsigned int,
+		   &discovery_links_property, 0 ),
+};
+
+/** Discovery resource state */
+static struct discovery_state discovery_state;
+
+/**
+ * Retrieve discovery resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct discovery_state *
+discovery_retrieve ( struct resource *res __unused ) {
+
+	pthread_mutex_lock ( &discovery_lock );
+	discovery_state.generation = discovery_generation;
+	pthread_mutex_unlock ( &discovery_lock );
+
+	return &discovery_state;
+}
+
+/** Discovery resource descriptor */
+static const struct resource_descriptor discovery_desc =
+	RESOURCE_DESC ( struct discovery_state, discovery_props,
+			discovery_retrieve, NULL, NULL,
+			.rt = "oic.wk.res" );
+
+/** Discovery resource */
+static struct resource discovery_res = {
+	.uri = "res",
+	.desc = &discovery_desc,
+	.observers = OBSERVERS_INIT ( discovery_res ),
+};
+
+/** Core resources */
+static struct resource *oic_res[] = {
+	&discovery_res,
+	NULL
+};
+
+/** Core device */
+struct device oic_dev __device = {
+	.name = "oic",
+	.ns = {
+		.uri = "/oic/",
+		.resources = oic_res,
+	},
+};
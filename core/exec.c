@@ -35,8 +35,28 @@
  *
  * Derived from the implementation in iPXE.
  *
+ * Each command writes its output to the output stream passed to
+ * fsystem(), which is recorded per thread so that commands executing
+ * concurrently (e.g. on the console and within a network shell
+ * session) do not interfere with each other.  Commands executed via
+ * system() write to the calling thread's current output stream,
+ * which defaults to stdout.
+ *
  */
 
+/** Output stream for commands executing on this thread, if not stdout */
+static __thread FILE *command_out;
+
+/**
+ * Get command output stream
+ *
+ * @ret out		Output stream
+ */
+FILE * command_output ( void ) {
+
+	return ( command_out ? command_out : stdout );
+}
+
 /**
  * Execute command
  *
@@ -73,7 +93,7 @@ int execv ( const char *command, char * const argv[] ) {
 		}
 	}
 
-	printf ( "%s: command not found\n", command );
+	cprintf ( "%s: command not found\n", command );
 	return -ENOEXEC;
 }
 
@@ -88,13 +108,13 @@ int execv ( const char *command, char * const argv[] ) {
  * tokens is non-NULL, any whitespace in the command line will be
  * replaced with NULs.
  */
-static int split_command ( char *command, char **tokens ) {
+int split_command ( char *command, char **tokens ) {
 	int count = 0;
 	int c;
 
 	while ( 1 ) {
 		/* Skip over any whitespace / convert to NUL */
-		while ( isspace ( ( c = *command ) ) ) {
+		while ( isspace ( ( c = *( ( unsigned char * ) command ) ) ) ) {
 			if ( tokens )
 				*command = '\0';
 			command++;
@@ -107,7 +127,8 @@ static int split_command ( char *command, char **tokens ) {
 			tokens[count] = command;
 		count++;
 		/* Skip to start of next whitespace, if any */
-		while ( ( c = *command ) && ! isspace ( c ) ) {
+		while ( ( c = *( ( unsigned char * ) command ) ) &&
+			! isspace ( c ) ) {
 			command++;
 		}
 	}
@@ -146,6 +167,50 @@ int system ( const char *command ) {
 	return rc;
 }
 
+/**
+ * Execute command line with output directed to a stream
+ *
+ * @v out		Output stream
+ * @v command		Command line
+ * @ret rc		Return status code
+ *
+ * The output stream is flushed once the command completes.
+ */
+int fsystem ( FILE *out, const char *command ) {
+	FILE *saved = command_out;
+	int rc;
+
+	command_out = out;
+	rc = system ( command );
+	fflush ( out );
+	command_out = saved;
+
+	return rc;
+}
+
+/**
+ * Execute command with output directed to a stream
+ *
+ * @v out		Output stream
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ *
+ * The arguments are passed to the command exactly as given, without
+ * being joined and resplit at whitespace.  The output stream is
+ * flushed once the command completes.
+ */
+int fexecv ( FILE *out, char * const argv[] ) {
+	FILE *saved = command_out;
+	int rc;
+
+	command_out = out;
+	rc = execv ( argv[0], argv );
+	fflush ( out );
+	command_out = saved;
+
+	return rc;
+}
+
 /**
  * "help" command
  *
@@ -157,20 +222,20 @@ static int help_exec ( int argc __unused, char **argv __unused ) {
 	struct command *command;
 	unsigned int hpos = 0;
 
-	printf ( "\nAvailable commands:\n\n" );
+	cprintf ( "\nAvailable commands:\n\n" );
 	for_each_table_entry ( command, COMMANDS ) {
-		hpos += printf ( "  %s", command->name );
+		hpos += cprintf ( "  %s", command->name );
 		if ( hpos > ( 16 * 4 ) ) {
-			printf ( "\n" );
+			cprintf ( "\n" );
 			hpos = 0;
 		} else {
 			while ( hpos % 16 ) {
-				printf ( " " );
+				cprintf ( " " );
 				hpos++;
 			}
 		}
 	}
-	printf ( "\n\nType \"<command> --help\" for further information\n\n" );
+	cprintf ( "\n\nType \"<command> --help\" for further information\n\n" );
 	return 0;
 }
 
@@ -0,0 +1,509 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Shared-memory state export
+ *
+ * The state of every registered resource may be mirrored into a
+ * single shared-memory segment, allowing co-located processes to
+ * read live resource state without any system calls.
+ *
+ * The segment starts with a header describing the layout of each
+ * resource descriptor (as published via include/uniport/export.h),
+ * followed by one record per resource.  Each record holds a copy of
+ * the resource state in exactly the layout used by the resource
+ * descriptor, guarded by a sequence lock.  The copy is updated each
+ * time that observers are notified via resource_notify().
+ *
+ * Readers never block the exporting process: a reader that observes
+ * a change in the sequence counter during its copy simply retries.
+ * Writers are counted while they hold a record pointer, so that the
+ * segment is not unmapped while a copy is still in progress.
+ *
+ * The set of exported resources is fixed when the segment is
+ * created.  Resources registered subsequently are not exported until
+ * the segment is recreated.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <uniport/export.h>
+#include <uniport/resource.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/** The exported segment, if any */
+static struct export_header *export_hdr;
+
+/** Name of the exported segment */
+static char *export_name;
+
+/** Number of writers that may be using a record within the segment */
+static unsigned int export_writers;
+
+/**
+ * Round up to exported state alignment
+ *
+ * @v len		Length
+ * @ret len		Aligned length
+ */
+static inline size_t export_align ( size_t len ) {
+
+	return ( ( len + EXPORT_ALIGN - 1 ) & ~( EXPORT_ALIGN - 1 ) );
+}
+
+/**
+ * Acquire write side of sequence lock
+ *
+ * @v rec		Exported resource
+ * @ret seq		Sequence counter (before acquisition)
+ *
+ * Concurrent writers to the same record are serialised by spinning,
+ * which is expected to be rare since each resource is normally
+ * notified from a single thread.
+ */
+static uint32_t export_lock ( struct export_resource *rec ) {
+	uint32_t seq;
+
+	do {
+		seq = ( __atomic_load_n ( &rec->seq, __ATOMIC_RELAXED ) & ~1 );
+	} while ( ! __atomic_compare_exchange_n ( &rec->seq, &seq, ( seq + 1 ),
+						  0, __ATOMIC_ACQUIRE,
+						  __ATOMIC_RELAXED ) );
+
+	/* Ensure that the odd counter is visible before any data */
+	__atomic_thread_fence ( __ATOMIC_RELEASE );
+
+	return seq;
+}
+
+/**
+ * Release write side of sequence lock
+ *
+ * @v rec		Exported resource
+ * @v seq		Sequence counter (before acquisition)
+ */
+static void export_unlock ( struct export_resource *rec, uint32_t seq ) {
+
+	__atomic_store_n ( &rec->seq, ( seq + 2 ), __ATOMIC_RELEASE );
+}
+
+/**
+ * Record resource state
+ *
+ * @v res		Resource
+ * @v state		Resource state
+ *
+ * The caller should check that the resource is exported, to avoid
+ * touching the shared writer count when no segment exists.
+ */
+void export_record ( struct resource *res, const void *state ) {
+	struct export_resource *rec;
+	uint32_t seq;
+
+	rec = resource_attachment_get ( &export_writers, &res->export );
+	if ( rec ) {
+		seq = export_lock ( rec );
+		memcpy ( export_ptr ( export_hdr, rec->state ), state,
+			 res->desc->len );
+		export_unlock ( rec, seq );
+	}
+	resource_attachment_put ( &export_writers );
+}
+
+/**
+ * Remove namespace from export
+ *
+ * @v ns		Resource namespace
+ */
+static void export_forget ( struct namespace *ns ) {
+	struct export_resource *rec;
+	struct resource **res;
+	uint32_t seq;
+
+	/* Mark each exported resource as removed */
+	for ( res = ns->resources ; *res ; res++ ) {
+		rec = (*res)->export;
+		if ( ! rec )
+			continue;
+		seq = export_lock ( rec );
+		rec->desc = EXPORT_REMOVED;
+		export_unlock ( rec, seq );
+		resource_detach ( &(*res)->export );
+	}
+}
+
+/** Shared-memory export namespace removal hook */
+struct namespace_hook export_namespace_hook __namespace_hook = {
+	.forget = export_forget,
+};
+
+/**
+ * Map exported segment
+ *
+ * @v name		Segment name
+ * @v len		Length of segment
+ * @ret hdr		Segment header to fill in
+ * @ret rc		Return status code
+ *
+ * The segment is zero-filled.  On platforms without POSIX shared
+ * memory, the segment is allocated from the heap and is visible only
+ * within this process.
+ */
+static int export_map ( const char *name, size_t len,
+			struct export_header **hdr ) {
+#ifdef __linux__
+	void *map;
+	int fd;
+	int rc;
+
+	/* Open and size shared-memory object */
+	fd = shm_open ( name, ( O_RDWR | O_CREAT | O_TRUNC ), 0644 );
+	if ( fd < 0 ) {
+		rc = -errno;
+		goto err_open;
+	}
+	if ( ftruncate ( fd, len ) != 0 ) {
+		rc = -errno;
+		goto err_truncate;
+	}
+
+	/* Map shared-memory object */
+	map = mmap ( NULL, len, ( PROT_READ | PROT_WRITE ), MAP_SHARED,
+		     fd, 0 );
+	if ( map == MAP_FAILED ) {
+		rc = -errno;
+		goto err_mmap;
+	}
+	close ( fd );
+	*hdr = map;
+	return 0;
+
+ err_mmap:
+ err_truncate:
+	shm_unlink ( name );
+	close ( fd );
+ err_open:
+	*hdr = NULL;
+	return rc;
+#else
+	( void ) name;
+	*hdr = calloc ( 1, len );
+	return ( *hdr ? 0 : -ENOMEM );
+#endif
+}
+
+/**
+ * Unmap exported segment
+ *
+ * @v name		Segment name
+ * @v hdr		Segment header
+ */
+static void export_unmap ( const char *name, struct export_header *hdr ) {
+#ifdef __linux__
+	munmap ( hdr, hdr->len );
+	shm_unlink ( name );
+#else
+	( void ) name;
+	free ( hdr );
+#endif
+}
+
+/**
+ * Find or add exported resource descriptor
+ *
+ * @v descs		Resource descriptor list
+ * @v num_descs		Number of resource descriptors
+ * @v desc		Resource descriptor
+ * @ret index		Resource descriptor index
+ */
+static unsigned int
+export_descriptor ( const struct resource_descriptor **descs,
+		    unsigned int *num_descs,
+		    const struct resource_descriptor *desc ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < *num_descs ; i++ ) {
+		if ( descs[i] == desc )
+			return i;
+	}
+	descs[(*num_descs)++] = desc;
+	return i;
+}
+
+/**
+ * Add string to exported segment
+ *
+ * @v hdr		Segment header
+ * @v offset		Next free offset within string table
+ * @v string		String
+ * @ret string		String offset
+ */
+static uint32_t export_string ( struct export_header *hdr, uint32_t *offset,
+				const char *string ) {
+	uint32_t start = *offset;
+	size_t len = ( strlen ( string ) + 1 /* NUL */ );
+
+	memcpy ( export_ptr ( hdr, start ), string, len );
+	*offset += len;
+	return start;
+}
+
+/**
+ * Create exported segment
+ *
+ * @v name		Segment name
+ * @ret rc		Return status code
+ */
+static int export_create ( const char *name ) {
+	const struct resource_descriptor **descs;
+	const struct resource_descriptor *desc;
+	struct export_descriptor *edesc;
+	struct export_property *eprop;
+	struct export_resource *rec;
+	struct export_header *hdr;
+	struct property *prop;
+	struct resource *res;
+	unsigned int num_descs = 0;
+	unsigned int num_props = 0;
+	unsigned int count = resource_index_count;
+	size_t states_len = 0;
+	size_t strings_len = 1 /* empty string */;
+	size_t len;
+	uint32_t states;
+	uint32_t strings;
+	uint32_t offset;
+	unsigned int i;
+	unsigned int j;
+	int rc;
+
+	/* Identify distinct resource descriptors */
+	descs = malloc ( count * sizeof ( descs[0] ) );
+	if ( count && ( ! descs ) ) {
+		rc = -ENOMEM;
+		goto err_descs;
+	}
+	for ( i = 0 ; i < count ; i++ ) {
+		res = resource_index[i];
+		desc = res->desc;
+		j = num_descs;
+		export_descriptor ( descs, &num_descs, desc );
+		if ( num_descs != j ) {
+			num_props += desc->count;
+			if ( desc->rt )
+				strings_len += ( strlen ( desc->rt ) + 1 );
+			for ( j = 0 ; j < desc->count ; j++ ) {
+				prop = &desc->props[j];
+				strings_len += ( strlen ( prop->name ) + 1 +
+						 strlen ( prop->type->name ) +
+						 1 );
+			}
+		}
+		states_len += export_align ( desc->len );
+		strings_len += ( resource_uri ( res, NULL, 0 ) + 1 /* NUL */ );
+	}
+
+	/* Calculate layout */
+	len = export_align ( sizeof ( *hdr ) +
+			     ( num_descs * sizeof ( *edesc ) ) +
+			     ( num_props * sizeof ( *eprop ) ) +
+			     ( count * sizeof ( *rec ) ) );
+	states = len;
+	strings = ( states + states_len );
+	len = ( strings + strings_len );
+
+	/* Map segment */
+	if ( ( rc = export_map ( name, len, &hdr ) ) != 0 )
+		goto err_map;
+	hdr->version = EXPORT_VERSION;
+	hdr->header_len = sizeof ( *hdr );
+	hdr->len = len;
+	hdr->num_descs = num_descs;
+	hdr->descs = sizeof ( *hdr );
+	hdr->num_resources = count;
+	hdr->resources = ( hdr->descs + ( num_descs * sizeof ( *edesc ) ) +
+			   ( num_props * sizeof ( *eprop ) ) );
+	hdr->strings = strings;
+	offset = ( strings + 1 /* empty string */ );
+
+	/* Populate resource descriptor and property tables */
+	edesc = export_ptr ( hdr, hdr->descs );
+	eprop = ( ( void * ) ( edesc + num_descs ) );
+	for ( i = 0 ; i < num_descs ; i++, edesc++ ) {
+		desc = descs[i];
+		if ( desc->rt )
+			edesc->rt = export_string ( hdr, &offset, desc->rt );
+		edesc->len = desc->len;
+		edesc->count = desc->count;
+		edesc->props = ( ( ( void * ) eprop ) - ( ( void * ) hdr ) );
+		for ( j = 0 ; j < desc->count ; j++, eprop++ ) {
+			prop = &desc->props[j];
+			eprop->name = export_string ( hdr, &offset,
+						      prop->name );
+			eprop->type = export_string ( hdr, &offset,
+						      prop->type->name );
+			eprop->offset = prop->offset;
+			eprop->len = prop->len;
+			eprop->flags = prop->flags;
+			if ( property_is_indirect ( prop ) )
+				eprop->flags |= EXPORT_PROP_INDIRECT;
+			eprop->param = prop->param;
+		}
+	}
+
+	/* Populate resource table with initial states */
+	rec = export_ptr ( hdr, hdr->resources );
+	for ( i = 0 ; i < count ; i++, rec++ ) {
+		res = resource_index[i];
+		rec->desc = export_descriptor ( descs, &num_descs, res->desc );
+		rec->uri = offset;
+		offset += ( resource_uri ( res, export_ptr ( hdr, offset ),
+					   ( len - offset ) ) + 1 /* NUL */ );
+		rec->state = states;
+		states += export_align ( res->desc->len );
+		memcpy ( export_ptr ( hdr, rec->state ),
+			 resource_retrieve ( res ), res->desc->len );
+	}
+
+	/* Mark segment as valid */
+	__atomic_store_n ( &hdr->magic, EXPORT_MAGIC, __ATOMIC_RELEASE );
+
+	/* Start recording state changes.  The segment must be
+	 * recorded before any resource can refer to it.
+	 */
+	export_hdr = hdr;
+	rec = export_ptr ( hdr, hdr->resources );
+	for ( i = 0 ; i < count ; i++ )
+		__atomic_store_n ( &resource_index[i]->export, &rec[i],
+				   __ATOMIC_RELEASE );
+
+	free ( descs );
+	return 0;
+
+ err_map:
+	free ( descs );
+ err_descs:
+	return rc;
+}
+
+/**
+ * Destroy exported segment
+ *
+ */
+static void export_destroy ( void ) {
+	struct export_header *hdr = export_hdr;
+	unsigned int i;
+
+	/* Stop recording state changes */
+	for ( i = 0 ; i < resource_index_count ; i++ )
+		resource_detach ( &resource_index[i]->export );
+
+	/* Wait for any writers still using the segment */
+	resource_quiesce ( &export_writers );
+
+	/* Mark segment as invalid, for the benefit of existing readers */
+	__atomic_store_n ( &hdr->magic, 0, __ATOMIC_RELEASE );
+
+	/* Unmap segment */
+	export_unmap ( export_name, hdr );
+	export_hdr = NULL;
+}
+
+/** "export" options */
+struct export_options {
+	/** Stop exporting */
+	int stop;
+};
+
+/** "export" option list */
+static struct option_descriptor export_opts[] = {
+	OPTION_DESC ( "stop", 'd', no_argument,
+		      struct export_options, stop, parse_flag ),
+};
+
+/** "export" command descriptor */
+static struct command_descriptor export_cmd =
+	COMMAND_DESC ( struct export_options, export_opts, 0, 1, "[<name>]" );
+
+/**
+ * "export" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int export_exec ( int argc, char **argv ) {
+	struct export_options opts;
+	const char *name;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &export_cmd, &opts ) ) != 0 )
+		return rc;
+	name = ( ( optind < argc ) ? argv[optind] : EXPORT_NAME );
+
+	/* Stop exporting, if applicable */
+	if ( opts.stop ) {
+		if ( export_hdr ) {
+			export_destroy();
+			free ( export_name );
+			export_name = NULL;
+		}
+		return 0;
+	}
+
+	/* Show segment, if already exporting */
+	if ( export_hdr ) {
+		cprintf ( "export: %s resources=%u descriptors=%u bytes=%u\n",
+			  export_name, export_hdr->num_resources,
+			  export_hdr->num_descs, export_hdr->len );
+		return 0;
+	}
+
+	/* Otherwise, create segment */
+	export_name = strdup ( name );
+	if ( ! export_name )
+		return -ENOMEM;
+	if ( ( rc = export_create ( export_name ) ) != 0 ) {
+		cprintf ( "\"%s\": could not export: %s\n",
+			  export_name, strerror ( rc ) );
+		free ( export_name );
+		export_name = NULL;
+		return rc;
+	}
+
+	return 0;
+}
+
+/** "export" command */
+struct command export_command __command = {
+	.name = "export",
+	.exec = export_exec,
+};
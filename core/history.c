@@ -0,0 +1,475 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Resource state history
+ *
+ * A resource may optionally provide a fixed-size history, which
+ * captures a snapshot of the resource state each time that observers
+ * are notified.  Integer properties are additionally downsampled
+ * into one-second and one-minute buckets recording the minimum,
+ * maximum, and average values.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <uniport/history.h>
+#include <uniport/interface.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/timer.h>
+
+/** History bucket periods */
+static const unsigned long history_periods[HISTORY_NUM_RESOLUTIONS] = {
+	[HISTORY_SECOND] = TICKS_PER_SEC,
+	[HISTORY_MINUTE] = ( 60 * TICKS_PER_SEC ),
+};
+
+/** History resolution names */
+static const char *history_names[HISTORY_NUM_RESOLUTIONS] = {
+	[HISTORY_RAW] = "raw",
+	[HISTORY_SECOND] = "1s",
+	[HISTORY_MINUTE] = "1m",
+};
+
+/** History lock
+ *
+ * This protects the contents of all history rings, which may be
+ * recorded into by any thread notifying observers while also being
+ * printed by a command.
+ */
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Alignment of history entries */
+#define HISTORY_ALIGN 8
+
+/**
+ * Round up to history entry alignment
+ *
+ * @v len		Length
+ * @ret len		Aligned length
+ */
+static inline size_t history_align ( size_t len ) {
+
+	return ( ( len + HISTORY_ALIGN - 1 ) & ~( HISTORY_ALIGN - 1 ) );
+}
+
+/**
+ * Get history entry
+ *
+ * @v hist		History
+ * @v resolution	Resolution
+ * @v index		Entry index (before wrapping)
+ * @ret entry		History entry
+ */
+static inline void * history_entry ( struct history *hist,
+				     unsigned int resolution,
+				     unsigned int index ) {
+	struct history_ring *ring = &hist->rings[resolution];
+
+	return ( ring->entries +
+		 ( ( index % hist->depth[resolution] ) * ring->size ) );
+}
+
+/**
+ * Check if property may be aggregated into statistics
+ *
+ * @v prop		Property
+ * @ret is_integer	Property is stored as an integer
+ */
+static inline bool history_is_integer ( struct property *prop ) {
+
+	return ( ( prop->type == &integer_property ) ||
+		 ( prop->type == &fixed_property ) );
+}
+
+/**
+ * Reserve storage for resource history
+ *
+ * @v res		Resource
+ * @ret rc		Return status code
+ */
+int history_reserve ( struct resource *res ) {
+	const struct resource_descriptor *desc = res->desc;
+	struct history *hist = res->history;
+	struct history_ring *ring;
+	struct property **ints;
+	struct property *prop;
+	size_t len;
+	void *data;
+	unsigned int i;
+
+	/* Count integer properties */
+	hist->num_ints = 0;
+	for ( i = 0 ; i < desc->count ; i++ ) {
+		if ( history_is_integer ( &desc->props[i] ) )
+			hist->num_ints++;
+	}
+
+	/* Calculate entry sizes and total length */
+	hist->rings[HISTORY_RAW].size =
+		history_align ( sizeof ( struct history_sample ) + desc->len );
+	for ( i = HISTORY_SECOND ; i < HISTORY_NUM_RESOLUTIONS ; i++ ) {
+		hist->rings[i].size =
+			history_align ( sizeof ( struct history_bucket ) +
+					( hist->num_ints *
+					  sizeof ( struct history_stat ) ) );
+	}
+	len = history_align ( hist->num_ints * sizeof ( hist->ints[0] ) );
+	for ( i = 0 ; i < HISTORY_NUM_RESOLUTIONS ; i++ )
+		len += ( hist->depth[i] * hist->rings[i].size );
+
+	/* Allocate all storage in a single block (if any is needed) */
+	data = NULL;
+	if ( len ) {
+		data = malloc ( len );
+		if ( ! data )
+			return -ENOMEM;
+	}
+
+	/* Record integer properties */
+	hist->ints = ints = data;
+	for ( i = 0 ; i < desc->count ; i++ ) {
+		prop = &desc->props[i];
+		if ( history_is_integer ( prop ) )
+			*(ints++) = prop;
+	}
+	data += history_align ( hist->num_ints * sizeof ( hist->ints[0] ) );
+
+	/* Assign ring storage */
+	for ( i = 0 ; i < HISTORY_NUM_RESOLUTIONS ; i++ ) {
+		ring = &hist->rings[i];
+		ring->entries = data;
+		ring->prod = 0;
+		data += ( hist->depth[i] * ring->size );
+	}
+
+	return 0;
+}
+
+/**
+ * Release storage for resource history
+ *
+ * @v res		Resource
+ */
+void history_release ( struct resource *res ) {
+	struct history *hist = res->history;
+	unsigned int i;
+
+	/* Free storage (allocated as a single block) */
+	free ( hist->ints );
+	hist->ints = NULL;
+	for ( i = 0 ; i < HISTORY_NUM_RESOLUTIONS ; i++ )
+		hist->rings[i].entries = NULL;
+}
+
+/**
+ * Record resource state in history
+ *
+ * @v res		Resource
+ * @v state		Resource state
+ */
+void history_record ( struct resource *res, const void *state ) {
+	struct history *hist = res->history;
+	struct history_sample *sample;
+	struct history_bucket *bucket;
+	struct history_stat *stat;
+	struct history_ring *ring;
+	unsigned long now;
+	unsigned long elapsed;
+	unsigned long period;
+	unsigned long start;
+	unsigned int i;
+	unsigned int j;
+	int value;
+
+	/* Record raw sample */
+	pthread_mutex_lock ( &history_lock );
+	now = currticks();
+	ring = &hist->rings[HISTORY_RAW];
+	if ( hist->depth[HISTORY_RAW] ) {
+		sample = history_entry ( hist, HISTORY_RAW, ring->prod++ );
+		sample->time = now;
+		memcpy ( sample->state, state, res->desc->len );
+	}
+
+	/* Update downsampled buckets */
+	for ( i = HISTORY_SECOND ; i < HISTORY_NUM_RESOLUTIONS ; i++ ) {
+
+		/* Skip unused resolutions */
+		ring = &hist->rings[i];
+		if ( ! hist->depth[i] )
+			continue;
+
+		/* Start a new bucket if the current bucket has expired.
+		 * Each bucket is aligned relative to its predecessor,
+		 * rather than to the absolute time, since the tick
+		 * counter may wrap.
+		 */
+		period = history_periods[i];
+		if ( ring->prod ) {
+			bucket = history_entry ( hist, i, ( ring->prod - 1 ) );
+			elapsed = ( now - bucket->start );
+			start = ( bucket->start +
+				  ( elapsed - ( elapsed % period ) ) );
+		} else {
+			elapsed = period;
+			start = ( now - ( now % period ) );
+		}
+		if ( elapsed >= period ) {
+			bucket = history_entry ( hist, i, ring->prod++ );
+			bucket->start = start;
+			bucket->count = 0;
+		}
+
+		/* Accumulate integer property values */
+		for ( j = 0 ; j < hist->num_ints ; j++ ) {
+			stat = &bucket->stats[j];
+			value = *( ( const int * )
+				   ( state + hist->ints[j]->offset ) );
+			if ( ( ! bucket->count ) || ( value < stat->min ) )
+				stat->min = value;
+			if ( ( ! bucket->count ) || ( value > stat->max ) )
+				stat->max = value;
+			if ( ! bucket->count )
+				stat->sum = 0;
+			stat->sum += value;
+		}
+		bucket->count++;
+	}
+	pthread_mutex_unlock ( &history_lock );
+}
+
+/**
+ * Print age of history entry
+ *
+ * @v now		Current time
+ * @v time		Time of history entry
+ */
+static void history_print_age ( unsigned long now, unsigned long time ) {
+	unsigned long age = ( now - time );
+
+	cprintf ( "-%lu.%03lus ", ( age / TICKS_PER_SEC ),
+		  ( ( age % TICKS_PER_SEC ) / ( TICKS_PER_SEC / 1000 ) ) );
+}
+
+/**
+ * Copy history entry
+ *
+ * @v hist		History
+ * @v resolution	Resolution
+ * @v index		Entry index (before wrapping)
+ * @v copy		Buffer to fill in
+ * @ret rc		Return status code
+ *
+ * The entry is copied with the history lock held, so that it cannot
+ * be printed while partially recorded.
+ */
+static int history_copy ( struct history *hist, unsigned int resolution,
+			  unsigned int index, void *copy ) {
+	struct history_ring *ring = &hist->rings[resolution];
+	int rc;
+
+	pthread_mutex_lock ( &history_lock );
+	if ( ( ring->prod - index ) <= hist->depth[resolution] ) {
+		memcpy ( copy, history_entry ( hist, resolution, index ),
+			 ring->size );
+		rc = 0;
+	} else {
+		/* Entry has been overwritten */
+		rc = -ENOENT;
+	}
+	pthread_mutex_unlock ( &history_lock );
+
+	return rc;
+}
+
+/**
+ * Print resource history
+ *
+ * @v res		Resource
+ * @v intf		Interface
+ * @v resolution	Resolution
+ * @ret rc		Return status code
+ */
+static int history_print ( struct resource *res, struct interface *intf,
+			   unsigned int resolution ) {
+	struct history *hist = res->history;
+	struct history_ring *ring = &hist->rings[resolution];
+	struct history_sample *sample;
+	struct history_bucket *bucket;
+	struct history_stat *stat;
+	struct property *prop;
+	char min[PROPERTY_FORMAT_LEN];
+	char avg[PROPERTY_FORMAT_LEN];
+	char max[PROPERTY_FORMAT_LEN];
+	unsigned long now;
+	unsigned int prod;
+	unsigned int fill;
+	int average;
+	unsigned int index;
+	unsigned int i;
+	void *copy;
+
+	/* Allocate buffer for a copy of each entry */
+	copy = malloc ( ring->size );
+	if ( ! copy )
+		return -ENOMEM;
+	sample = copy;
+	bucket = copy;
+
+	/* Identify current entries */
+	pthread_mutex_lock ( &history_lock );
+	now = currticks();
+	prod = ring->prod;
+	pthread_mutex_unlock ( &history_lock );
+	fill = ( ( prod < hist->depth[resolution] ) ?
+		 prod : hist->depth[resolution] );
+
+	/* Print each entry, oldest first, skipping any overwritten
+	 * while printing.
+	 */
+	for ( index = ( prod - fill ) ; index != prod ; index++ ) {
+		if ( history_copy ( hist, resolution, index, copy ) != 0 )
+			continue;
+		if ( resolution == HISTORY_RAW ) {
+			history_print_age ( now, sample->time );
+			resource_print ( res, intf, sample->state );
+		} else {
+			history_print_age ( now, bucket->start );
+			cprintf ( "%s: n=%u", res->uri, bucket->count );
+			for ( i = 0 ; i < hist->num_ints ; i++ ) {
+				prop = hist->ints[i];
+				if ( ! interface_mask_test (
+					     intf, res->desc, INTERFACE_VISIBLE,
+					     ( prop - res->desc->props ) ) )
+					continue;
+				stat = &bucket->stats[i];
+				average = ( stat->sum / bucket->count );
+				prop->type->format ( prop, min, sizeof ( min ),
+						     &stat->min );
+				prop->type->format ( prop, avg, sizeof ( avg ),
+						     &average );
+				prop->type->format ( prop, max, sizeof ( max ),
+						     &stat->max );
+				cprintf ( " %s=%s/%s/%s", prop->name, min, avg,
+					  max );
+			}
+			cprintf ( "\n" );
+		}
+	}
+
+	free ( copy );
+	return 0;
+}
+
+/**
+ * Parse history resolution
+ *
+ * @v text		Text
+ * @ret resolution	History resolution
+ * @ret rc		Return status code
+ */
+static int parse_history_resolution ( char *text, unsigned int *resolution ) {
+	unsigned int i;
+
+	/* Find resolution */
+	for ( i = 0 ; i < HISTORY_NUM_RESOLUTIONS ; i++ ) {
+		if ( strcmp ( text, history_names[i] ) == 0 ) {
+			*resolution = i;
+			return 0;
+		}
+	}
+
+	cprintf ( "\"%s\": no such resolution\n", text );
+	return -EINVAL;
+}
+
+/** "history" options */
+struct history_options {
+	/** Interface in use */
+	struct interface *intf;
+	/** Resolution */
+	unsigned int resolution;
+};
+
+/** "history" option list */
+static struct option_descriptor history_opts[] = {
+	OPTION_DESC ( "interface", 'i', required_argument,
+		      struct history_options, intf, parse_interface ),
+	OPTION_DESC ( "resolution", 'r', required_argument,
+		      struct history_options, resolution,
+		      parse_history_resolution ),
+};
+
+/** "history" command descriptor */
+static struct command_descriptor history_cmd =
+	COMMAND_DESC ( struct history_options, history_opts, 1, 1, "<uri>" );
+
+/**
+ * "history" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int history_exec ( int argc, char **argv ) {
+	struct history_options opts;
+	struct resource *res;
+	char *uri;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &history_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Parse resource URI */
+	uri = argv[optind];
+	if ( ( rc = parse_resource ( uri, &res ) ) != 0 )
+		return rc;
+
+	/* Default to baseline interface where not specified */
+	if ( ! opts.intf )
+		opts.intf = &oic_if_baseline;
+
+	/* Check that resource has a history at this resolution */
+	if ( ! ( res->history && res->history->depth[opts.resolution] ) ) {
+		cprintf ( "\"%s\": no %s history\n",
+			  uri, history_names[opts.resolution] );
+		return -ENOTSUP;
+	}
+
+	/* Print history */
+	if ( ( rc = history_print ( res, opts.intf, opts.resolution ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/** "history" command */
+struct command history_command __command = {
+	.name = "history",
+	.exec = history_exec,
+};
@@ -17,7 +17,9 @@
  * 02110-1301, USA.
  */
 
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <uniport/tables.h>
 #include <uniport/interface.h>
 
@@ -77,3 +79,59 @@ struct interface * interface_find ( const char * name ) {
 	}
 	return NULL;
 }
+
+/**
+ * Calculate per-interface property masks for a resource descriptor
+ *
+ * @v desc		Resource descriptor
+ * @ret rc		Return status code
+ *
+ * The masks are calculated once (when the first resource using the
+ * descriptor is registered) and recorded in the mask storage
+ * provided by RESOURCE_DESC().  They are never freed, since resource
+ * descriptors are static.
+ */
+int interface_mask_init ( const struct resource_descriptor *desc ) {
+	struct interface *intf;
+	struct property *prop;
+	unsigned int words = interface_mask_words ( desc );
+	unsigned long *visible;
+	unsigned long *writable;
+	unsigned long *masks;
+	unsigned long bit;
+	unsigned int i;
+
+	/* Require mask storage (provided by RESOURCE_DESC()) */
+	if ( ! desc->masks )
+		return -EINVAL;
+
+	/* Do nothing if masks have already been calculated */
+	if ( *desc->masks )
+		return 0;
+
+	/* Allocate masks */
+	masks = calloc ( ( 2 * table_num_entries ( INTERFACES ) * words ),
+			 sizeof ( masks[0] ) );
+	if ( ( ! masks ) && words )
+		return -ENOMEM;
+
+	/* Calculate masks */
+	for_each_table_entry ( intf, INTERFACES ) {
+		visible = ( masks + ( ( 2 * table_index ( INTERFACES, intf ) +
+					INTERFACE_VISIBLE ) * words ) );
+		writable = ( masks + ( ( 2 * table_index ( INTERFACES, intf ) +
+					 INTERFACE_WRITABLE ) * words ) );
+		for ( i = 0 ; i < desc->count ; i++ ) {
+			prop = &desc->props[i];
+			if ( ! interface_has_property ( intf, prop ) )
+				continue;
+			bit = ( 1UL << ( i % INTERFACE_MASK_BITS ) );
+			visible[ i / INTERFACE_MASK_BITS ] |= bit;
+			if ( prop->flags & PROP_RW )
+				writable[ i / INTERFACE_MASK_BITS ] |= bit;
+		}
+	}
+
+	*desc->masks = masks;
+	return 0;
+}
@@ -0,0 +1,1019 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * MQTT bridge
+ *
+ * The bridge observes a set of resources and publishes each change
+ * of state to an MQTT (version 3.1.1) broker, using the topic
+ *
+ *     <prefix>/state<uri>
+ *
+ * with a payload of space-separated "<prop>=<value>" pairs.  Payloads
+ * of the same form published to
+ *
+ *     <prefix>/set<uri>
+ *
+ * are applied to bridged resources via resource_update().
+ *
+ * Publications are constructed directly within the outbound buffer of
+ * a batched stream channel by the notifying thread, without any
+ * system calls, so that many publications share each write().  A
+ * publication too large to fit within an empty buffer is dropped and
+ * counted.  The CONNECT and SUBSCRIBE
+ * packets are likewise pipelined with the first publications, rather
+ * than waiting for each acknowledgement in turn.
+ *
+ * When the outbound buffer is full (or, for QoS 1, when too many
+ * publications are awaiting acknowledgement), a resource is marked
+ * as pending rather than blocking the notifying thread.  Pending
+ * resources are republished with their then-current state once space
+ * becomes available, so that a slow broker sees fewer intermediate
+ * states but never misses the most recent state.  A copy of each
+ * unacknowledged QoS 1 publication is retained, and is retransmitted
+ * with the same packet identifier and with the DUP flag set.
+ *
+ * The bridge may be attached to any connected stream socket via
+ * mqtt_open(), allowing it to be exercised against an in-process
+ * broker stand-in via socketpair().
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <uniport/mqtt.h>
+#include <uniport/interface.h>
+#include <uniport/serialise.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/string.h>
+#include <uniport/timer.h>
+
+/** Protocol name and level (MQTT 3.1.1) */
+static const uint8_t mqtt_protocol[] = { 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04 };
+
+/** The bridge, if any */
+static struct mqtt_bridge *mqtt;
+
+/**
+ * Get length of remaining length field
+ *
+ * @v len		Remaining length
+ * @ret field_len	Length of remaining length field
+ */
+static size_t mqtt_varint_len ( size_t len ) {
+	size_t field_len = 1;
+
+	while ( len >= 0x80 ) {
+		len >>= 7;
+		field_len++;
+	}
+	return field_len;
+}
+
+/**
+ * Construct remaining length field
+ *
+ * @v data		Data pointer
+ * @v len		Remaining length
+ * @ret data		Updated data pointer
+ */
+static uint8_t * mqtt_put_varint ( uint8_t *data, size_t len ) {
+
+	do {
+		*data = ( len & 0x7f );
+		len >>= 7;
+		if ( len )
+			*data |= 0x80;
+		data++;
+	} while ( len );
+	return data;
+}
+
+/**
+ * Construct 16-bit field
+ *
+ * @v data		Data pointer
+ * @v value		Value
+ * @ret data		Updated data pointer
+ */
+static uint8_t * mqtt_put_u16 ( uint8_t *data, unsigned int value ) {
+
+	*(data++) = ( value >> 8 );
+	*(data++) = ( value & 0xff );
+	return data;
+}
+
+/**
+ * Construct length-prefixed string
+ *
+ * @v data		Data pointer
+ * @v string		String
+ * @v len		Length of string
+ * @ret data		Updated data pointer
+ */
+static uint8_t * mqtt_put_string ( uint8_t *data, const char *string,
+				   size_t len ) {
+
+	data = mqtt_put_u16 ( data, len );
+	memcpy ( data, string, len );
+	return ( data + len );
+}
+
+/**
+ * Queue fixed-length packet
+ *
+ * @v bridge		MQTT bridge
+ * @v type		Packet type
+ * @v id		Packet identifier (for acknowledgements)
+ * @ret rc		Return status code
+ *
+ * Must be called with the bridge lock held.
+ */
+static int mqtt_queue ( struct mqtt_bridge *bridge, unsigned int type,
+			unsigned int id ) {
+	size_t len = ( ( type == MQTT_PUBACK ) ? 2 : 0 );
+	uint8_t *data;
+
+	data = channel_reserve ( &bridge->chan, ( 2 /* header */ + len ) );
+	if ( ! data )
+		return -ENOBUFS;
+	*(data++) = ( type << 4 );
+	*(data++) = len;
+	if ( len )
+		mqtt_put_u16 ( data, id );
+	return 0;
+}
+
+/**
+ * Queue resource state publication
+ *
+ * @v mobs		Bridged resource
+ * @v state		Resource state
+ * @ret rc		Return status code
+ *
+ * Must be called with the bridge lock held.
+ */
+static int mqtt_publish ( struct mqtt_observer *mobs, const void *state ) {
+	struct mqtt_bridge *bridge = mobs->bridge;
+	struct resource *res = mobs->obs.res;
+	struct mqtt_inflight *inflight = NULL;
+	size_t prefix_len = strlen ( bridge->prefix );
+	size_t uri_len = resource_uri ( res, NULL, 0 );
+	size_t topic_len;
+	size_t payload_len;
+	size_t remaining;
+	size_t len;
+	uint8_t *packet;
+	uint8_t *data;
+	unsigned int i;
+
+	/* Calculate packet length */
+	topic_len = ( prefix_len + 6 /* "/state" */ + uri_len );
+	payload_len = resource_serialise ( res, mobs->obs.intf, state,
+					   NULL, 0 );
+	remaining = ( 2 + topic_len + ( bridge->qos ? 2 : 0 ) + payload_len );
+	len = ( 1 + mqtt_varint_len ( remaining ) + remaining );
+
+	/* Fail if packet could never fit within the outbound buffer */
+	if ( ( len + 1 /* NUL */ ) > MQTT_TX_LEN )
+		return -EMSGSIZE;
+
+	/* Find a free in-flight slot, if applicable */
+	if ( bridge->qos ) {
+		for ( i = 0 ; i < MQTT_INFLIGHT ; i++ ) {
+			if ( ! bridge->inflight[i].mobs ) {
+				inflight = &bridge->inflight[i];
+				break;
+			}
+		}
+		if ( ! inflight )
+			return -ENOBUFS;
+	}
+
+	/* Reserve space */
+	packet = channel_reserve ( &bridge->chan, len );
+	if ( ! packet )
+		return -ENOBUFS;
+	data = packet;
+
+	/* Construct fixed header and topic */
+	*(data++) = ( ( MQTT_PUBLISH << 4 ) | ( bridge->qos << 1 ) );
+	data = mqtt_put_varint ( data, remaining );
+	data = mqtt_put_u16 ( data, topic_len );
+	memcpy ( data, bridge->prefix, prefix_len );
+	data += prefix_len;
+	memcpy ( data, "/state", 6 );
+	data += 6;
+	data += resource_uri ( res, ( char * ) data,
+			      ( uri_len + 1 /* NUL */ ) );
+
+	/* Construct packet identifier, if applicable */
+	if ( inflight ) {
+		if ( ! ++bridge->next_id )
+			bridge->next_id++;
+		data = mqtt_put_u16 ( data, bridge->next_id );
+	}
+
+	/* Construct payload */
+	resource_serialise ( res, mobs->obs.intf, state, ( char * ) data,
+			     ( payload_len + 1 /* NUL */ ) );
+
+	/* Retain copy for retransmission, if applicable */
+	if ( inflight ) {
+		inflight->mobs = mobs;
+		inflight->id = bridge->next_id;
+		inflight->sent = currticks();
+		memcpy ( inflight->packet, packet, len );
+		inflight->len = len;
+	}
+
+	bridge->stats.published++;
+	return 0;
+}
+
+/**
+ * Handle notification of bridged resource state change
+ *
+ * @v obs		Observer
+ * @v state		Resource state
+ */
+static void mqtt_notify ( struct observer *obs, const void *state ) {
+	struct mqtt_observer *mobs =
+		container_of ( obs, struct mqtt_observer, obs );
+	struct mqtt_bridge *bridge = mobs->bridge;
+	int rc;
+
+	pthread_mutex_lock ( &bridge->chan.lock );
+	if ( mobs->obs.res && ( ! mobs->pending ) ) {
+		rc = mqtt_publish ( mobs, state );
+		if ( rc == -EMSGSIZE ) {
+			bridge->stats.oversized++;
+		} else if ( rc != 0 ) {
+			mobs->pending = 1;
+			bridge->backlog = 1;
+			bridge->stats.deferred++;
+		}
+	}
+	pthread_mutex_unlock ( &bridge->chan.lock );
+}
+
+/**
+ * Republish resources awaiting space in the outbound buffer
+ *
+ * @v chan		Channel
+ */
+static void mqtt_republish ( struct channel *chan ) {
+	struct mqtt_bridge *bridge =
+		container_of ( chan, struct mqtt_bridge, chan );
+	struct mqtt_observer *mobs;
+	unsigned int i;
+	int rc;
+
+	/* Republish current state of each pending resource.  The lock
+	 * is held throughout, so that no resource can be forgotten
+	 * while its state is being retrieved.
+	 */
+	pthread_mutex_lock ( &chan->lock );
+	if ( bridge->backlog ) {
+		bridge->backlog = 0;
+		for ( i = 0 ; i < bridge->count ; i++ ) {
+			mobs = &bridge->mobs[i];
+			if ( ! ( mobs->pending && mobs->obs.res ) )
+				continue;
+			rc = mqtt_publish ( mobs, resource_retrieve (
+							  mobs->obs.res ) );
+			if ( rc == -ENOBUFS ) {
+				bridge->backlog = 1;
+				break;
+			}
+			if ( rc != 0 )
+				bridge->stats.oversized++;
+			mobs->pending = 0;
+		}
+	}
+	pthread_mutex_unlock ( &chan->lock );
+}
+
+/**
+ * Retransmit unacknowledged publications
+ *
+ * @v bridge		MQTT bridge
+ * @v now		Current time
+ *
+ * Must be called with the bridge lock held.
+ */
+static void mqtt_retry ( struct mqtt_bridge *bridge, unsigned long now ) {
+	struct mqtt_inflight *inflight;
+	uint8_t *data;
+	unsigned int i;
+
+	for ( i = 0 ; i < MQTT_INFLIGHT ; i++ ) {
+		inflight = &bridge->inflight[i];
+		if ( ! inflight->mobs )
+			continue;
+		if ( ( now - inflight->sent ) < bridge->retry )
+			continue;
+		data = channel_reserve ( &bridge->chan, inflight->len );
+		if ( ! data )
+			break;
+		inflight->packet[0] |= MQTT_DUP;
+		memcpy ( data, inflight->packet, inflight->len );
+		inflight->sent = now;
+		bridge->stats.retried++;
+	}
+}
+
+/**
+ * Perform periodic work
+ *
+ * @v chan		Channel
+ * @v now		Current time
+ */
+static void mqtt_step ( struct channel *chan, unsigned long now ) {
+	struct mqtt_bridge *bridge =
+		container_of ( chan, struct mqtt_bridge, chan );
+	unsigned long keepalive = ( bridge->keepalive * TICKS_PER_SEC / 2 );
+
+	pthread_mutex_lock ( &chan->lock );
+
+	/* Retransmit unacknowledged publications */
+	if ( bridge->qos )
+		mqtt_retry ( bridge, now );
+
+	/* Send keepalive, if applicable */
+	if ( keepalive && ( ( now - chan->active ) >= keepalive ) ) {
+		if ( mqtt_queue ( bridge, MQTT_PINGREQ, 0 ) == 0 )
+			chan->active = now;
+	}
+
+	pthread_mutex_unlock ( &chan->lock );
+}
+
+/**
+ * Acknowledge publication
+ *
+ * @v bridge		MQTT bridge
+ * @v id		Packet identifier
+ */
+static void mqtt_ack ( struct mqtt_bridge *bridge, unsigned int id ) {
+	struct mqtt_inflight *inflight;
+	unsigned int i;
+
+	pthread_mutex_lock ( &bridge->chan.lock );
+	for ( i = 0 ; i < MQTT_INFLIGHT ; i++ ) {
+		inflight = &bridge->inflight[i];
+		if ( inflight->mobs && ( inflight->id == id ) ) {
+			inflight->mobs = NULL;
+			bridge->stats.acked++;
+			/* Space is now available for deferred resources */
+			break;
+		}
+	}
+	pthread_mutex_unlock ( &bridge->chan.lock );
+}
+
+/**
+ * Apply received update
+ *
+ * @v bridge		MQTT bridge
+ * @v topic		Topic
+ * @v payload		Payload (will be modified)
+ * @ret rc		Return status code
+ */
+static int mqtt_update ( struct mqtt_bridge *bridge, const char *topic,
+			 char *payload ) {
+	struct interface *intf = NULL;
+	struct resource *res;
+	size_t prefix_len = strlen ( bridge->prefix );
+	void *state;
+	unsigned int i;
+	int rc;
+
+	/* Identify bridged resource.  The resource index lock is held
+	 * until the update is complete, so that the resource cannot be
+	 * unregistered in the meantime.
+	 */
+	if ( ( strncmp ( topic, bridge->prefix, prefix_len ) != 0 ) ||
+	     ( strncmp ( ( topic + prefix_len ), "/set", 4 ) != 0 ) ) {
+		rc = -ENOENT;
+		goto err_topic;
+	}
+	resource_index_lock();
+	res = resource_find ( topic + prefix_len + 4 /* "/set" */ );
+	pthread_mutex_lock ( &bridge->chan.lock );
+	for ( i = 0 ; res && ( i < bridge->count ) ; i++ ) {
+		if ( bridge->mobs[i].obs.res == res ) {
+			intf = bridge->mobs[i].obs.intf;
+			break;
+		}
+	}
+	pthread_mutex_unlock ( &bridge->chan.lock );
+	if ( ! intf ) {
+		rc = -ENOENT;
+		goto err_resource;
+	}
+
+	/* Allocate and populate copy of resource state */
+	state = malloc ( res->desc->len );
+	if ( ! state ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	memcpy ( state, resource_retrieve ( res ), res->desc->len );
+
+	/* Parse properties */
+	if ( ( rc = resource_deserialise ( res, intf, payload,
+					   state ) ) != 0 )
+		goto err_parse;
+
+	/* Update resource state */
+	rc = resource_update ( res, state );
+
+ err_parse:
+	resource_discard ( res, state );
+	free ( state );
+ err_alloc:
+ err_resource:
+	resource_index_unlock();
+ err_topic:
+	return rc;
+}
+
+/**
+ * Handle received PUBLISH packet
+ *
+ * @v bridge		MQTT bridge
+ * @v flags		Packet flags
+ * @v data		Packet body
+ * @v len		Length of packet body
+ * @ret rc		Return status code
+ */
+static int mqtt_rx_publish ( struct mqtt_bridge *bridge, unsigned int flags,
+			     const uint8_t *data, size_t len ) {
+	unsigned int qos = ( ( flags >> 1 ) & 0x03 );
+	size_t topic_len;
+	size_t header_len;
+	unsigned int id = 0;
+	int rc;
+
+	/* Parse variable header */
+	if ( len < 2 )
+		return -EINVAL;
+	topic_len = ( ( data[0] << 8 ) | data[1] );
+	header_len = ( 2 + topic_len + ( qos ? 2 : 0 ) );
+	if ( header_len > len )
+		return -EINVAL;
+	if ( qos )
+		id = ( ( data[ header_len - 2 ] << 8 ) |
+		       data[ header_len - 1 ] );
+
+	/* Construct NUL-terminated topic and payload */
+	{
+		char topic[ topic_len + 1 /* NUL */ ];
+		char payload[ len - header_len + 1 /* NUL */ ];
+
+		memcpy ( topic, ( data + 2 ), topic_len );
+		topic[topic_len] = '\0';
+		memcpy ( payload, ( data + header_len ), ( len - header_len ) );
+		payload[ len - header_len ] = '\0';
+
+		/* Apply update */
+		bridge->stats.updates++;
+		if ( ( rc = mqtt_update ( bridge, topic, payload ) ) != 0 )
+			bridge->stats.failed++;
+	}
+
+	/* Acknowledge, if applicable.  A failure to queue the
+	 * acknowledgement will cause the broker to retransmit.
+	 */
+	if ( qos ) {
+		pthread_mutex_lock ( &bridge->chan.lock );
+		mqtt_queue ( bridge, MQTT_PUBACK, id );
+		pthread_mutex_unlock ( &bridge->chan.lock );
+	}
+
+	return 0;
+}
+
+/**
+ * Handle received packet
+ *
+ * @v bridge		MQTT bridge
+ * @v header		Packet type and flags
+ * @v data		Packet body
+ * @v len		Length of packet body
+ * @ret rc		Return status code
+ */
+static int mqtt_rx ( struct mqtt_bridge *bridge, unsigned int header,
+		     const uint8_t *data, size_t len ) {
+
+	switch ( header >> 4 ) {
+	case MQTT_CONNACK:
+		if ( ( len < 2 ) || data[1] ) {
+			printf ( "mqtt: connection refused (%d)\n",
+				 ( ( len < 2 ) ? -1 : data[1] ) );
+			return -ECONNREFUSED;
+		}
+		return 0;
+	case MQTT_PUBLISH:
+		return mqtt_rx_publish ( bridge, ( header & 0x0f ), data, len );
+	case MQTT_PUBACK:
+		if ( len >= 2 )
+			mqtt_ack ( bridge, ( ( data[0] << 8 ) | data[1] ) );
+		return 0;
+	case MQTT_SUBACK:
+		if ( ( len >= 3 ) && ( data[2] & 0x80 ) )
+			printf ( "mqtt: subscription refused\n" );
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Receive data
+ *
+ * @v chan		Channel
+ * @ret rc		Return status code
+ */
+static int mqtt_receive ( struct channel *chan ) {
+	struct mqtt_bridge *bridge =
+		container_of ( chan, struct mqtt_bridge, chan );
+	const uint8_t *data;
+	ssize_t len;
+	size_t remaining;
+	size_t offset;
+	size_t used = 0;
+	unsigned int shift;
+	int rc;
+
+	/* Read data */
+	len = channel_read ( chan, ( bridge->rx + bridge->rx_len ),
+			     ( sizeof ( bridge->rx ) - bridge->rx_len ) );
+	if ( len < 0 )
+		return len;
+	bridge->rx_len += len;
+
+	/* Process complete packets */
+	while ( 1 ) {
+		data = ( bridge->rx + used );
+		len = ( bridge->rx_len - used );
+
+		/* Parse fixed header */
+		remaining = 0;
+		shift = 0;
+		for ( offset = 1 ; offset < ( size_t ) len ; offset++ ) {
+			remaining |= ( ( data[offset] & 0x7f ) << shift );
+			shift += 7;
+			if ( ! ( data[offset] & 0x80 ) )
+				break;
+			if ( offset == 4 )
+				return -EINVAL;
+		}
+		if ( offset >= ( size_t ) len )
+			break;
+		offset++;
+
+		/* Wait for complete packet */
+		if ( ( offset + remaining ) > sizeof ( bridge->rx ) )
+			return -EMSGSIZE;
+		if ( ( offset + remaining ) > ( size_t ) len )
+			break;
+
+		/* Handle packet */
+		if ( ( rc = mqtt_rx ( bridge, data[0], ( data + offset ),
+				      remaining ) ) != 0 )
+			return rc;
+		used += ( offset + remaining );
+	}
+
+	/* Discard processed packets */
+	memmove ( bridge->rx, ( bridge->rx + used ),
+		  ( bridge->rx_len - used ) );
+	bridge->rx_len -= used;
+
+	return 0;
+}
+
+/** MQTT bridge channel operations */
+static struct channel_operations mqtt_operations = {
+	.receive = mqtt_receive,
+	.step = mqtt_step,
+	.refill = mqtt_republish,
+};
+
+/**
+ * Queue CONNECT and SUBSCRIBE packets
+ *
+ * @v bridge		MQTT bridge
+ * @ret rc		Return status code
+ *
+ * Must be called with the bridge lock held.
+ */
+static int mqtt_handshake ( struct mqtt_bridge *bridge ) {
+	size_t client_len = strlen ( bridge->client );
+	size_t prefix_len = strlen ( bridge->prefix );
+	size_t filter_len = ( prefix_len + 6 /* "/set/#" */ );
+	size_t remaining;
+	uint8_t *data;
+
+	/* Construct CONNECT with a clean session */
+	remaining = ( sizeof ( mqtt_protocol ) + 1 /* flags */ +
+		      2 /* keepalive */ + 2 + client_len );
+	data = channel_reserve ( &bridge->chan,
+				 ( 1 + mqtt_varint_len ( remaining ) +
+				   remaining ) );
+	if ( ! data )
+		return -ENOBUFS;
+	*(data++) = ( MQTT_CONNECT << 4 );
+	data = mqtt_put_varint ( data, remaining );
+	memcpy ( data, mqtt_protocol, sizeof ( mqtt_protocol ) );
+	data += sizeof ( mqtt_protocol );
+	*(data++) = 0x02; /* Clean session */
+	data = mqtt_put_u16 ( data, bridge->keepalive );
+	mqtt_put_string ( data, bridge->client, client_len );
+
+	/* Construct SUBSCRIBE for "<prefix>/set/#" */
+	remaining = ( 2 /* id */ + 2 + filter_len + 1 /* qos */ );
+	data = channel_reserve ( &bridge->chan,
+				 ( 1 + mqtt_varint_len ( remaining ) +
+				   remaining ) );
+	if ( ! data )
+		return -ENOBUFS;
+	*(data++) = ( ( MQTT_SUBSCRIBE << 4 ) | 0x02 );
+	data = mqtt_put_varint ( data, remaining );
+	data = mqtt_put_u16 ( data, ++bridge->next_id );
+	data = mqtt_put_u16 ( data, filter_len );
+	memcpy ( data, bridge->prefix, prefix_len );
+	data += prefix_len;
+	memcpy ( data, "/set/#", 6 );
+	data += 6;
+	*data = bridge->qos;
+
+	return 0;
+}
+
+/**
+ * Open MQTT bridge on a connected socket
+ *
+ * @v bridge		MQTT bridge
+ * @v fd		Connected stream socket (will be owned by the bridge)
+ * @ret rc		Return status code
+ */
+int mqtt_open ( struct mqtt_bridge *bridge, int fd ) {
+	unsigned int i;
+	int rc;
+
+	/* Initialise bridge */
+	channel_init ( &bridge->chan, "mqtt", &mqtt_operations, bridge->buf,
+		       MQTT_TX_LEN );
+	bridge->rx_len = 0;
+	bridge->backlog = 0;
+	bridge->retained = NULL;
+	memset ( bridge->inflight, 0, sizeof ( bridge->inflight ) );
+	memset ( &bridge->stats, 0, sizeof ( bridge->stats ) );
+
+	/* Open channel */
+	if ( ( rc = channel_open ( &bridge->chan, fd ) ) != 0 )
+		goto err_open;
+
+	/* Allocate storage for retransmission, if applicable */
+	if ( bridge->qos ) {
+		bridge->retained = malloc ( MQTT_INFLIGHT * MQTT_TX_LEN );
+		if ( ! bridge->retained ) {
+			rc = -ENOMEM;
+			goto err_retained;
+		}
+		for ( i = 0 ; i < MQTT_INFLIGHT ; i++ ) {
+			bridge->inflight[i].packet =
+				( bridge->retained + ( i * MQTT_TX_LEN ) );
+		}
+	}
+
+	/* Queue connection handshake */
+	pthread_mutex_lock ( &bridge->chan.lock );
+	rc = mqtt_handshake ( bridge );
+	pthread_mutex_unlock ( &bridge->chan.lock );
+	if ( rc != 0 )
+		goto err_handshake;
+
+	/* Start observing bridged resources */
+	for ( i = 0 ; i < bridge->count ; i++ ) {
+		bridge->mobs[i].bridge = bridge;
+		bridge->mobs[i].pending = 0;
+		resource_observe ( &bridge->mobs[i].obs );
+	}
+
+	return 0;
+
+ err_handshake:
+	free ( bridge->retained );
+	bridge->retained = NULL;
+ err_retained:
+	channel_close ( &bridge->chan );
+ err_open:
+	return rc;
+}
+
+/**
+ * Connect MQTT bridge to broker
+ *
+ * @v bridge		MQTT bridge
+ * @ret rc		Return status code
+ */
+int mqtt_connect ( struct mqtt_bridge *bridge ) {
+	int fd;
+	int rc;
+
+	/* Connect to broker */
+	fd = socket ( AF_INET, SOCK_STREAM, 0 );
+	if ( fd < 0 ) {
+		rc = -errno;
+		goto err_socket;
+	}
+	if ( connect ( fd, ( struct sockaddr * ) &bridge->server,
+		       sizeof ( bridge->server ) ) != 0 ) {
+		rc = -errno;
+		goto err_connect;
+	}
+
+	/* Open bridge */
+	return mqtt_open ( bridge, fd );
+
+ err_connect:
+	close ( fd );
+ err_socket:
+	return rc;
+}
+
+/**
+ * Close MQTT bridge
+ *
+ * @v bridge		MQTT bridge
+ */
+void mqtt_close ( struct mqtt_bridge *bridge ) {
+	struct mqtt_observer *mobs;
+	unsigned int i;
+
+	/* Stop observing bridged resources */
+	for ( i = 0 ; i < bridge->count ; i++ ) {
+		mobs = &bridge->mobs[i];
+		if ( mobs->obs.res )
+			resource_unobserve ( &mobs->obs );
+	}
+
+	/* Disconnect cleanly, if possible */
+	pthread_mutex_lock ( &bridge->chan.lock );
+	mqtt_queue ( bridge, MQTT_DISCONNECT, 0 );
+	pthread_mutex_unlock ( &bridge->chan.lock );
+
+	/* Close channel */
+	channel_close ( &bridge->chan );
+	free ( bridge->retained );
+	bridge->retained = NULL;
+}
+
+/**
+ * Remove namespace from MQTT bridge
+ *
+ * @v ns		Resource namespace
+ *
+ * Bridged resources within the namespace are marked as forgotten
+ * (with a NULL resource pointer) rather than being removed, since
+ * each observer remains referenced by the bridge's own arrays.
+ */
+static void mqtt_forget ( struct namespace *ns ) {
+	struct mqtt_bridge *bridge = mqtt;
+	struct mqtt_observer *mobs;
+	unsigned int i;
+	unsigned int j;
+
+	/* Do nothing unless a bridge exists */
+	if ( ! bridge )
+		return;
+
+	/* Stop observing resources within this namespace */
+	for ( i = 0 ; i < bridge->count ; i++ ) {
+		mobs = &bridge->mobs[i];
+		if ( mobs->obs.res && ( mobs->obs.res->ns == ns ) )
+			resource_unobserve ( &mobs->obs );
+	}
+
+	/* Forget resources and any unacknowledged publications */
+	pthread_mutex_lock ( &bridge->chan.lock );
+	for ( i = 0 ; i < bridge->count ; i++ ) {
+		mobs = &bridge->mobs[i];
+		if ( ! ( mobs->obs.res && ( mobs->obs.res->ns == ns ) ) )
+			continue;
+		mobs->obs.res = NULL;
+		mobs->pending = 0;
+		for ( j = 0 ; j < MQTT_INFLIGHT ; j++ ) {
+			if ( bridge->inflight[j].mobs == mobs )
+				bridge->inflight[j].mobs = NULL;
+		}
+	}
+	pthread_mutex_unlock ( &bridge->chan.lock );
+}
+
+/** MQTT bridge namespace removal hook */
+struct namespace_hook mqtt_namespace_hook __namespace_hook = {
+	.forget = mqtt_forget,
+};
+
+/** "mqtt" options */
+struct mqtt_options {
+	/** Broker address */
+	struct in_addr server;
+	/** Broker port */
+	unsigned int port;
+	/** Client identifier */
+	char *client;
+	/** Topic prefix */
+	char *prefix;
+	/** Quality of service */
+	unsigned int qos;
+	/** Keepalive interval (in seconds) */
+	unsigned int keepalive;
+	/** Retransmission interval (in milliseconds) */
+	unsigned int retry;
+	/** Stop bridge */
+	int stop;
+};
+
+/** "mqtt" option list */
+static struct option_descriptor mqtt_opts[] = {
+	OPTION_DESC ( "server", 's', required_argument,
+		      struct mqtt_options, server, parse_address ),
+	OPTION_DESC ( "port", 'p', required_argument,
+		      struct mqtt_options, port, parse_integer ),
+	OPTION_DESC ( "client", 'c', required_argument,
+		      struct mqtt_options, client, parse_string ),
+	OPTION_DESC ( "topic", 't', required_argument,
+		      struct mqtt_options, prefix, parse_string ),
+	OPTION_DESC ( "qos", 'q', required_argument,
+		      struct mqtt_options, qos, parse_integer ),
+	OPTION_DESC ( "keepalive", 'k', required_argument,
+		      struct mqtt_options, keepalive, parse_integer ),
+	OPTION_DESC ( "retry", 'r', required_argument,
+		      struct mqtt_options, retry, parse_integer ),
+	OPTION_DESC ( "stop", 'd', no_argument,
+		      struct mqtt_options, stop, parse_flag ),
+};
+
+/** "mqtt" command descriptor */
+static struct command_descriptor mqtt_cmd =
+	COMMAND_DESC ( struct mqtt_options, mqtt_opts, 0, 1,
+		       "[<uri-pattern>]" );
+
+/**
+ * Create and connect MQTT bridge
+ *
+ * @v opts		"mqtt" options
+ * @v pattern		Resource URI pattern
+ * @ret rc		Return status code
+ */
+static int mqtt_create ( struct mqtt_options *opts, const char *pattern ) {
+	struct mqtt_bridge *bridge;
+	struct resource *res;
+	size_t prefix_len = glob_prefix_len ( pattern );
+	size_t client_len = ( strlen ( opts->client ) + 1 /* NUL */ );
+	size_t topic_len = ( strlen ( opts->prefix ) + 1 /* NUL */ );
+	unsigned int first;
+	unsigned int i;
+	int rc;
+
+	/* Allocate and initialise bridge */
+	bridge = calloc ( 1, ( sizeof ( *bridge ) + client_len + topic_len ) );
+	if ( ! bridge ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	bridge->client = memcpy ( ( bridge + 1 ), opts->client, client_len );
+	bridge->prefix = memcpy ( ( ( ( void * ) ( bridge + 1 ) ) +
+				    client_len ), opts->prefix, topic_len );
+	bridge->server.sin_family = AF_INET;
+	bridge->server.sin_addr = opts->server;
+	bridge->server.sin_port = htons ( opts->port );
+	bridge->qos = ( opts->qos ? 1 : 0 );
+	bridge->keepalive = opts->keepalive;
+	bridge->retry = ( opts->retry * TICKS_PER_MS );
+
+	/* Find matching resources within the resource index */
+	first = resource_index_lower ( pattern, prefix_len );
+	bridge->mobs = calloc ( ( resource_index_count - first ),
+				sizeof ( bridge->mobs[0] ) );
+	if ( ( ! bridge->mobs ) && ( resource_index_count - first ) ) {
+		rc = -ENOMEM;
+		goto err_mobs;
+	}
+	for ( i = first ; i < resource_index_count ; i++ ) {
+		res = resource_index[i];
+		if ( resource_uri_ncmp ( res, pattern, prefix_len ) != 0 )
+			break;
+		if ( ! resource_uri_match ( res, pattern ) )
+			continue;
+		observer_init ( &bridge->mobs[bridge->count++].obs, res,
+				&oic_if_baseline, mqtt_notify );
+	}
+
+	/* Connect to broker */
+	if ( ( rc = mqtt_connect ( bridge ) ) != 0 )
+		goto err_connect;
+
+	mqtt = bridge;
+	return 0;
+
+ err_connect:
+	free ( bridge->mobs );
+ err_mobs:
+	free ( bridge );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * "mqtt" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int mqtt_exec ( int argc, char **argv ) {
+	struct mqtt_options opts;
+	struct mqtt_stats *stats;
+	int rc;
+
+	/* Parse options, with defaults */
+	memset ( &opts, 0, sizeof ( opts ) );
+	inet_aton ( "127.0.0.1", &opts.server );
+	opts.port = MQTT_PORT;
+	opts.client = "uniport";
+	opts.prefix = MQTT_PREFIX;
+	opts.keepalive = MQTT_KEEPALIVE;
+	opts.retry = MQTT_RETRY_MS;
+	if ( ( rc = reparse_options ( argc, argv, &mqtt_cmd, &opts ) ) != 0 )
+		return rc;
+	if ( ! opts.retry ) {
+		cprintf ( "%s: retry interval must be non-zero\n", argv[0] );
+		return -EINVAL;
+	}
+
+	/* Stop bridge, if applicable */
+	if ( opts.stop ) {
+		if ( mqtt ) {
+			mqtt_close ( mqtt );
+			free ( mqtt->mobs );
+			free ( mqtt );
+			mqtt = NULL;
+		}
+		return 0;
+	}
+
+	/* Show statistics, if bridge is already running */
+	if ( mqtt ) {
+		stats = &mqtt->stats;
+		cprintf ( "mqtt: %s resources=%u published=%lu acked=%lu "
+			  "deferred=%lu retried=%lu oversized=%lu writes=%lu "
+			  "bytes=%llu updates=%lu failed=%lu\n",
+			  ( mqtt->chan.running ? "connected" : "disconnected" ),
+			  mqtt->count, stats->published, stats->acked,
+			  stats->deferred, stats->retried, stats->oversized,
+			  mqtt->chan.stats.writes, mqtt->chan.stats.bytes,
+			  stats->updates, stats->failed );
+		return 0;
+	}
+
+	/* Otherwise, create bridge */
+	return mqtt_create ( &opts, ( ( optind < argc ) ?
+				      argv[optind] : "*" ) );
+}
+
+/** "mqtt" command */
+struct command mqtt_command __command = {
+	.name = "mqtt",
+	.exec = mqtt_exec,
+};
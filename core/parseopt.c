@@ -22,11 +22,18 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
 #include <assert.h>
 #include <getopt.h>
+#include <arpa/inet.h>
 #include <uniport/resource.h>
 #include <uniport/interface.h>
+#include <uniport/string.h>
+#include <uniport/temperature.h>
+#include <uniport/bench.h>
+#include <uniport/timer.h>
+#include <uniport/command.h>
 #include <uniport/parseopt.h>
 
 /** @file
@@ -63,17 +70,28 @@ int parse_string ( char *text, char **value ) {
  * @ret rc		Return status code
  */
 int parse_integer ( char *text, unsigned int *value ) {
+	unsigned long result;
 	char *endp;
 
 	/* Sanity check */
 	assert ( text != NULL );
 
 	/* Parse integer */
-	*value = strtoul ( text, &endp, 0 );
+	if ( digit_value ( *text ) >= 10 ) {
+		cprintf ( "\"%s\": invalid integer value\n", text );
+		return -EINVAL;
+	}
+	errno = 0;
+	result = strtoul ( text, &endp, 0 );
 	if ( *endp ) {
-		printf ( "\"%s\": invalid integer value\n", text );
+		cprintf ( "\"%s\": invalid integer value\n", text );
 		return -EINVAL;
 	}
+	if ( ( errno == ERANGE ) || ( result > UINT_MAX ) ) {
+		cprintf ( "\"%s\": integer value out of range\n", text );
+		return -ERANGE;
+	}
+	*value = result;
 
 	return 0;
 }
@@ -105,7 +123,7 @@ int parse_resource ( char *text, struct resource **res ) {
 	/* Find resource */
 	*res = resource_find ( text );
 	if ( ! *res ) {
-		printf ( "\"%s\": no such resource\n", text );
+		cprintf ( "\"%s\": no such resource\n", text );
 		return -ENOENT;
 	}
 
@@ -124,13 +142,48 @@ int parse_interface ( char *text, struct interface **intf ) {
 	/* Find interface */
 	*intf = interface_find ( text );
 	if ( ! *intf ) {
-		printf ( "\"%s\": no such interface\n", text );
+		cprintf ( "\"%s\": no such interface\n", text );
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+/**
+ * Parse property type name
+ *
+ * @v text		Text
+ * @ret type		Property type
+ * @ret rc		Return status code
+ */
+int parse_property_type ( char *text, const struct property_type **type ) {
+
+	/* Find property type */
+	*type = property_type_find ( text );
+	if ( ! *type ) {
+		cprintf ( "\"%s\": no such property type\n", text );
 		return -ENOENT;
 	}
 
 	return 0;
 }
 
+/**
+ * Parse IPv4 address
+ *
+ * @v text		Text
+ * @v addr		Address to fill in
+ * @ret rc		Return status code
+ */
+int parse_address ( char *text, struct in_addr *addr ) {
+
+	if ( inet_aton ( text, addr ) == 0 ) {
+		cprintf ( "\"%s\": invalid address\n", text );
+		return -EINVAL;
+	}
+	return 0;
+}
+
 /**
  * Print command usage message
  *
@@ -142,20 +195,20 @@ void print_usage ( struct command_descriptor *cmd, char **argv ) {
 	unsigned int i;
 	int is_optional;
 
-	printf ( "Usage:\n\n  %s", argv[0] );
+	cprintf ( "Usage:\n\n  %s", argv[0] );
 	for ( i = 0 ; i < cmd->num_options ; i++ ) {
 		option = &cmd->options[i];
-		printf ( " [-%c|--%s", option->shortopt, option->longopt );
+		cprintf ( " [-%c|--%s", option->shortopt, option->longopt );
 		if ( option->has_arg ) {
 			is_optional = ( option->has_arg == optional_argument );
-			printf ( " %s<%s>%s", ( is_optional ? "[" : "" ),
-				 option->longopt, ( is_optional ? "]" : "" ) );
+			cprintf ( " %s<%s>%s", ( is_optional ? "[" : "" ),
+				  option->longopt, ( is_optional ? "]" : "" ) );
 		}
-		printf ( "]" );
+		cprintf ( "]" );
 	}
 	if ( cmd->usage )
-		printf ( " %s", cmd->usage );
-	printf ( "\n\n" );
+		cprintf ( " %s", cmd->usage );
+	cprintf ( "\n\n" );
 }
 
 /**
@@ -256,3 +309,155 @@ int parse_options ( int argc, char **argv, struct command_descriptor *cmd,
 
 	return reparse_options ( argc, argv, cmd, opts );
 }
+
+/** Number of entries in a parsing benchmark table */
+#define PARSE_BENCH_NUM( _table ) ( sizeof ( _table ) / sizeof ( _table[0] ) )
+
+/** Parsing benchmark integers (drawn from tests/data/fuzz/integer) */
+static const char *parse_bench_integers[] = {
+	"0", "42", "-1", "+7", "-2147483648", "2147483647", "0x7fffffff",
+	"017", "2147483648", "12abc", "", " 1",
+};
+
+/** Parsing benchmark UUIDs (drawn from tests/data/fuzz/uuid) */
+static const char *parse_bench_uuids[] = {
+	"00000000-0000-0000-0000-000000000000",
+	"6ba7b810-9dad-11d1-80b4-00c04fd430c8",
+	"6ba7b8109dad11d180b400c04fd430c8",
+	"6BA7B810-9DAD-11D1-80B4-00C04FD430C8",
+	"6ba7b810-9dad-11d1-80b4-00c04fd430c8x",
+	"g0000000-0000-0000-0000-000000000000",
+};
+
+/** Parsing benchmark temperature units (drawn from tests/data/fuzz/units) */
+static const char *parse_bench_units[] = {
+	"C", "f", "K", "Celsius", "Fahrenheit", "Kelvin", "degC",
+	"\xc2\xb0""F", "CF", "",
+};
+
+/** Parsing benchmark command lines (drawn from tests/data/fuzz/command) */
+static const char *parse_bench_commands[] = {
+	"cmd",
+	"cmd -n 10 -f a b",
+	"cmd --count=5 --flag",
+	"cmd --text=x a b",
+	"cmd -tvalue -- -n",
+	"cmd -n 0x10 a",
+};
+
+/** Parsing benchmark command options */
+struct parse_bench_options {
+	/** Integer */
+	unsigned int count;
+	/** Flag */
+	int flag;
+	/** String */
+	char *text;
+};
+
+/** Parsing benchmark command option list */
+static struct option_descriptor parse_bench_opts[] = {
+	OPTION_DESC ( "count", 'n', required_argument,
+		      struct parse_bench_options, count, parse_integer ),
+	OPTION_DESC ( "flag", 'f', no_argument,
+		      struct parse_bench_options, flag, parse_flag ),
+	OPTION_DESC ( "text", 't', required_argument,
+		      struct parse_bench_options, text, parse_string ),
+};
+
+/** Parsing benchmark command descriptor */
+static struct command_descriptor parse_bench_cmd =
+	COMMAND_DESC ( struct parse_bench_options, parse_bench_opts, 0, 2,
+		       "[<arg>...]" );
+
+/**
+ * Split and parse benchmark command line
+ *
+ * @v command		Command line (will be modified)
+ * @ret rc		Return status code
+ */
+static int parse_bench_command ( char *command ) {
+	int argc = split_command ( command, NULL );
+	char *argv[ argc + 1 ];
+	struct parse_bench_options opts;
+
+	split_command ( command, argv );
+	argv[argc] = NULL;
+	optind = 0;
+	return parse_options ( argc, argv, &parse_bench_cmd, &opts );
+}
+
+/**
+ * Benchmark parsing of untrusted text
+ *
+ * @v count		Number of iterations
+ * @ret rc		Return status code
+ *
+ * Each parser is run over a mixture of valid and malformed inputs
+ * drawn from its fuzzing corpus.  Every benchmark command line is
+ * valid, since a rejected command line would print a usage message.
+ */
+static int parse_bench ( unsigned int count ) {
+	enum temperature_units units;
+	union uuid uuid;
+	char command[64];
+	const char *string;
+	unsigned long start;
+	unsigned int i;
+	int saved_optind;
+	int integer;
+	int rc = 0;
+
+	/* Integers */
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		string = parse_bench_integers[ i % PARSE_BENCH_NUM (
+					       parse_bench_integers ) ];
+		integer_parse ( NULL, string, &integer );
+	}
+	bench_report ( "parse", "integer", ( currticks() - start ), count );
+
+	/* UUIDs */
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		string = parse_bench_uuids[ i % PARSE_BENCH_NUM (
+					    parse_bench_uuids ) ];
+		uuid_parse ( NULL, string, &uuid );
+	}
+	bench_report ( "parse", "uuid", ( currticks() - start ), count );
+
+	/* Temperature units */
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		string = parse_bench_units[ i % PARSE_BENCH_NUM (
+					    parse_bench_units ) ];
+		temperature_units_parse ( NULL, string, &units );
+	}
+	bench_report ( "parse", "units", ( currticks() - start ), count );
+
+	/* Command lines (including copying each line before splitting).
+	 * The "bench" command's own arguments are still in use, so
+	 * preserve getopt()'s position within them.
+	 */
+	saved_optind = optind;
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		string = parse_bench_commands[ i % PARSE_BENCH_NUM (
+					       parse_bench_commands ) ];
+		snprintf ( command, sizeof ( command ), "%s", string );
+		if ( ( rc = parse_bench_command ( command ) ) != 0 )
+			break;
+	}
+	optind = saved_optind;
+	if ( rc != 0 )
+		return rc;
+	bench_report ( "parse", "command", ( currticks() - start ), count );
+
+	return 0;
+}
+
+/** Parsing benchmark */
+struct benchmark parse_benchmark __benchmark = {
+	.name = "parse",
+	.run = parse_bench,
+};
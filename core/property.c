@@ -25,14 +25,20 @@
  */
 
 #include <stdbool.h>
-#include <stdlib.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
+#include <math.h>
+#include <float.h>
 #include <assert.h>
 #include <arpa/inet.h>
 #include <uniport/string.h>
 #include <uniport/property.h>
+#include <uniport/bench.h>
+#include <uniport/command.h>
+#include <uniport/timer.h>
 
 /*****************************************************************************
  *
@@ -50,11 +56,15 @@
  * @v value		State variable
  * @ret len		Length of string
  */
-static size_t boolean_format ( struct property *prop __unused, char *buf,
-			       size_t len, const bool *value ) {
+size_t boolean_format ( struct property *prop __unused, char *buf,
+			size_t len, const bool *value ) {
 
 	/* Format string */
-	return snprintf ( buf, len, "%s", ( *value ? "true" : "false" ) );
+	if ( *value ) {
+		return format_string ( buf, len, "true", 4 );
+	} else {
+		return format_string ( buf, len, "false", 5 );
+	}
 }
 
 /**
@@ -65,8 +75,8 @@ static size_t boolean_format ( struct property *prop __unused, char *buf,
  * @v value		State variable
  * @ret rc		Return status code
  */
-static int boolean_parse ( struct property *prop __unused, const char *string,
-			   bool *value ) {
+int boolean_parse ( struct property *prop __unused, const char *string,
+		    bool *value ) {
 
 	/* Parse string */
 	if ( ( strcasecmp ( string, "true" ) == 0 ) ||
@@ -83,7 +93,7 @@ static int boolean_parse ( struct property *prop __unused, const char *string,
 }
 
 /** Boolean property type */
-const struct property_type boolean_property =
+const struct property_type boolean_property __property_type =
 	PROPERTY_TYPE ( "boolean", bool, boolean_format, boolean_parse );
 
 /*****************************************************************************
@@ -102,11 +112,11 @@ const struct property_type boolean_property =
  * @v value		State variable
  * @ret len		Length of string
  */
-static size_t integer_format ( struct property *prop __unused, char *buf,
-			       size_t len, const int *value ) {
+size_t integer_format ( struct property *prop __unused, char *buf,
+			size_t len, const int *value ) {
 
 	/* Format string */
-	return snprintf ( buf, len, "%d", *value );
+	return format_decimal ( buf, len, *value );
 }
 
 /**
@@ -117,12 +127,14 @@ static size_t integer_format ( struct property *prop __unused, char *buf,
  * @v value		State variable
  * @ret rc		Return status code
  */
-static int integer_parse ( struct property *prop __unused, const char *string,
-			   int *value ) {
-	char *end;
+int integer_parse ( struct property *prop __unused, const char *string,
+		    int *value ) {
+	const char *end;
+	int rc;
 
 	/* Parse string */
-	*value = strtol ( string, &end, 0 );
+	if ( ( rc = parse_int ( string, &end, value ) ) != 0 )
+		return rc;
 	if ( *end )
 		return -EINVAL;
 
@@ -130,7 +142,7 @@ static int integer_parse ( struct property *prop __unused, const char *string,
 }
 
 /** Integer property type */
-const struct property_type integer_property =
+const struct property_type integer_property __property_type =
 	PROPERTY_TYPE ( "integer", int, integer_format, integer_parse );
 
 /*****************************************************************************
@@ -149,11 +161,11 @@ const struct property_type integer_property =
  * @v value		State variable
  * @ret len		Length of string
  */
-static size_t string_format ( struct property *prop __unused, char *buf,
-			      size_t len, const char **value ) {
+size_t string_format ( struct property *prop __unused, char *buf,
+		       size_t len, const char **value ) {
 
 	/* Format string */
-	return snprintf ( buf, len, "%s", *value );
+	return format_string ( buf, len, *value, strlen ( *value ) );
 }
 
 /**
@@ -164,17 +176,43 @@ static size_t string_format ( struct property *prop __unused, char *buf,
  * @v value		State variable
  * @ret rc		Return status code
  */
-static int string_parse ( struct property *prop __unused, const char *string,
-			  const char **value ) {
+int string_parse ( struct property *prop __unused, const char *string,
+		   const char **value ) {
 
 	/* Parse string */
 	*value = string;
 	return 0;
 }
 
+/**
+ * Format part of property as string
+ *
+ * @v prop		Property
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		State variable
+ * @v offset		Starting offset within formatted string
+ * @v hint		Position hint (unused)
+ * @ret len		Length of remainder of string
+ */
+static size_t string_format_part ( struct property *prop __unused, char *buf,
+				   size_t len, const char **value,
+				   size_t offset,
+				   struct property_hint *hint __unused ) {
+	size_t string_len = strlen ( *value );
+
+	/* Format remainder of string */
+	if ( offset > string_len )
+		offset = string_len;
+	return format_string ( buf, len, ( *value + offset ),
+			       ( string_len - offset ) );
+}
+
 /** String property type */
-const struct property_type string_property =
-	PROPERTY_TYPE ( "string", const char *, string_format, string_parse );
+const struct property_type string_property __property_type =
+	PROPERTY_TYPE ( "string", const char *, string_format, string_parse,
+			.format_part = PROPERTY_FORMAT_PART ( const char *,
+							      string_format_part ) );
 
 /*****************************************************************************
  *
@@ -192,19 +230,27 @@ const struct property_type string_property =
  * @v value		State variable
  * @ret len		Length of string
  */
-static size_t uuid_format ( struct property *prop __unused, char *buf,
-			    size_t len, const union uuid *value ) {
+size_t uuid_format ( struct property *prop __unused, char *buf,
+		     size_t len, const union uuid *value ) {
+	char string[ UUID_STRING_LEN ];
+	char *tmp = string;
+
+	/* Construct canonical form "00000000-0000-0000-0000-000000000000"
+	 * directly from the raw (big-endian) bytes.
+	 */
+	tmp = hex_encode ( tmp, &value->raw[0], 4 );
+	*(tmp++) = '-';
+	tmp = hex_encode ( tmp, &value->raw[4], 2 );
+	*(tmp++) = '-';
+	tmp = hex_encode ( tmp, &value->raw[6], 2 );
+	*(tmp++) = '-';
+	tmp = hex_encode ( tmp, &value->raw[8], 2 );
+	*(tmp++) = '-';
+	tmp = hex_encode ( tmp, &value->raw[10], 6 );
+	assert ( tmp == &string[ sizeof ( string ) ] );
 
 	/* Format string */
-	return snprintf ( buf, len,
-			  "%08x-%04x-%04x-%04x-%02x%02x%02x%02x%02x%02x",
-			  ntohl ( value->canonical.a ),
-			  ntohs ( value->canonical.b ),
-			  ntohs ( value->canonical.c ),
-			  ntohs ( value->canonical.d ),
-			  value->canonical.e[0], value->canonical.e[1],
-			  value->canonical.e[2], value->canonical.e[3],
-			  value->canonical.e[4], value->canonical.e[5] );
+	return format_string ( buf, len, string, sizeof ( string ) );
 }
 
 /**
@@ -215,8 +261,8 @@ static size_t uuid_format ( struct property *prop __unused, char *buf,
  * @v value		State variable
  * @ret rc		Return status code
  */
-static int uuid_parse ( struct property *prop __unused, const char *string,
-			union uuid *value ) {
+int uuid_parse ( struct property *prop __unused, const char *string,
+		 union uuid *value ) {
 	uint8_t *byte = value->raw;
 	unsigned int character;
 	unsigned int digit;
@@ -240,13 +286,517 @@ static int uuid_parse ( struct property *prop __unused, const char *string,
 			byte++;
 	}
 
+	/* Reject any trailing characters */
+	if ( *string )
+		return -EINVAL;
+
 	return 0;
 }
 
 /** UUID property type */
-const struct property_type uuid_property =
+const struct property_type uuid_property __property_type =
 	PROPERTY_TYPE ( "uuid", union uuid, uuid_format, uuid_parse );
 
+/*****************************************************************************
+ *
+ * Fixed-point properties
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Format property as string
+ *
+ * @v prop		Property
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		State variable
+ * @ret len		Length of string
+ */
+size_t fixed_format ( struct property *prop, char *buf, size_t len,
+		      const int *value ) {
+
+	/* Format string */
+	return format_fixed ( buf, len, *value, prop->param );
+}
+
+/**
+ * Parse property from a string
+ *
+ * @v prop		Property
+ * @v string		String
+ * @v value		State variable
+ * @ret rc		Return status code
+ */
+int fixed_parse ( struct property *prop, const char *string,
+		  int *value ) {
+	int64_t fixed;
+	int rc;
+
+	/* Parse string */
+	if ( ( rc = parse_fixed ( string, prop->param, &fixed ) ) != 0 )
+		return rc;
+	if ( ( fixed < INT_MIN ) || ( fixed > INT_MAX ) )
+		return -ERANGE;
+	*value = fixed;
+
+	return 0;
+}
+
+/** Fixed-point property type */
+const struct property_type fixed_property __property_type =
+	PROPERTY_TYPE ( "fixed", int, fixed_format, fixed_parse );
+
+/*****************************************************************************
+ *
+ * Floating-point properties
+ *
+ *****************************************************************************
+ */
+
+/** Magnitude above which floating-point values use an exponent */
+#define FLOAT_EXPONENT_MIN 1e18f
+
+/** Significant digits required to reproduce a single-precision value
+ *
+ * Defined by C11, but not by earlier standards.
+ */
+#ifndef FLT_DECIMAL_DIG
+#define FLT_DECIMAL_DIG 9
+#endif
+
+/** Magnitude limit for a floating-point mantissa */
+#define FLOAT_MANTISSA_MAX ( ( double ) powers_of_ten[FLT_DECIMAL_DIG] )
+
+/**
+ * Format property as string
+ *
+ * @v prop		Property
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		State variable
+ * @ret len		Length of string
+ *
+ * The value is rounded to a fixed-point number and formatted using
+ * only integer operations, avoiding the cost of a floating-point
+ * printf() on platforms without hardware double-precision support.
+ * Only values too large for a fixed-point representation use
+ * double-precision arithmetic, to extract an exact mantissa.
+ */
+size_t float_format ( struct property *prop, char *buf, size_t len,
+		      const float *value ) {
+	char suffix[ 1 /* "e" */ + DECIMAL_MAX_LEN + 1 /* NUL */ ];
+	unsigned int scale = prop->param;
+	unsigned int exponent = 0;
+	size_t suffix_len;
+	size_t offset;
+	size_t used;
+	double mantissa;
+	int64_t fixed;
+	float scaled;
+
+	assert ( scale <= FIXED_SCALE_MAX );
+	assert ( FLT_DECIMAL_DIG <= FIXED_SCALE_MAX );
+
+	/* Format non-finite values */
+	if ( isnan ( *value ) )
+		return format_string ( buf, len, "nan", 3 );
+	if ( isinf ( *value ) ) {
+		return ( ( *value < 0 ) ? format_string ( buf, len, "-inf", 4 ) :
+			 format_string ( buf, len, "inf", 3 ) );
+	}
+
+	/* Scale and round value, falling back to an integer mantissa
+	 * of at most FLT_DECIMAL_DIG digits and a decimal exponent for
+	 * values too large to represent.
+	 */
+	scaled = ( *value * powers_of_ten[scale] );
+	if ( ( scaled < FLOAT_EXPONENT_MIN ) &&
+	     ( scaled > -FLOAT_EXPONENT_MIN ) ) {
+		fixed = ( scaled + ( ( scaled < 0 ) ? -0.5f : 0.5f ) );
+	} else {
+		scale = 0;
+		for ( mantissa = *value ;
+		      fabs ( mantissa ) >= FLOAT_MANTISSA_MAX ;
+		      mantissa /= 10 ) {
+			exponent++;
+		}
+		fixed = ( mantissa + ( ( mantissa < 0 ) ? -0.5 : 0.5 ) );
+
+		/* Strip trailing zeros, including any carry from rounding */
+		for ( ; ( ( fixed % 10 ) == 0 ) ; fixed /= 10 )
+			exponent++;
+	}
+
+	/* Format rounded mantissa */
+	used = format_fixed ( buf, len, fixed, scale );
+	if ( ! exponent )
+		return used;
+
+	/* Append exponent */
+	suffix[0] = 'e';
+	suffix_len = ( 1 + format_decimal ( &suffix[1],
+					    ( sizeof ( suffix ) - 1 ),
+					    exponent ) );
+	offset = ( ( used < len ) ? used : len );
+	used += format_string ( ( buf + offset ), ( len - offset ),
+				suffix, suffix_len );
+
+	return used;
+}
+
+/**
+ * Parse property from a string
+ *
+ * @v prop		Property
+ * @v string		String
+ * @v value		State variable
+ * @ret rc		Return status code
+ */
+int float_parse ( struct property *prop __unused, const char *string,
+		  float *value ) {
+	float parsed;
+	char *end;
+
+	/* Parse string */
+	errno = 0;
+	parsed = strtof ( string, &end );
+	if ( ( end == string ) || *end )
+		return -EINVAL;
+	if ( ( errno == ERANGE ) && isinf ( parsed ) )
+		return -ERANGE;
+	*value = parsed;
+
+	return 0;
+}
+
+/** Floating-point property type */
+const struct property_type float_property __property_type =
+	PROPERTY_TYPE ( "float", float, float_format, float_parse );
+
+/*****************************************************************************
+ *
+ * Integer array properties
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Get array elements
+ *
+ * @v value		State variable
+ * @ret data		Elements, including any staged new value
+ */
+static inline const void * array_elements ( const struct property_array
+					    *value ) {
+
+	return ( value->staged ? value->staged : value->data );
+}
+
+/**
+ * Format integer array from a given offset
+ *
+ * @v value		State variable
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v offset		Starting offset within formatted string
+ * @v hint		Position hint (updated), or NULL
+ * @ret len		Length of remainder of string
+ *
+ * If a hint is provided, formatting resumes from the hinted element
+ * and stops as soon as the buffer is full, recording the element
+ * from which the next part should resume.  Otherwise, the exact
+ * length of the remainder is calculated.
+ */
+static size_t array_format_from ( const struct property_array *value,
+				  char *buf, size_t len, size_t offset,
+				  struct property_hint *hint ) {
+	const int *data = array_elements ( value );
+	char element[ 1 /* "," */ + DECIMAL_MAX_LEN + 1 /* NUL */ ];
+	size_t element_len;
+	size_t position = 0;
+	size_t used = 0;
+	size_t skip;
+	size_t copy;
+	size_t i = 0;
+
+	/* Resume from hinted element, if applicable */
+	if ( hint && ( hint->element < value->count ) &&
+	     ( hint->position <= offset ) ) {
+		i = hint->element;
+		position = hint->position;
+	}
+
+	for ( ; i < value->count ; i++ ) {
+
+		/* Stop once buffer is full, if applicable */
+		if ( ( used >= len ) && hint )
+			break;
+
+		/* Format element */
+		element_len = 0;
+		if ( i )
+			element[element_len++] = ',';
+		element_len += format_decimal ( &element[element_len],
+						( sizeof ( element ) -
+						  element_len ), data[i] );
+
+		/* Copy any part of element lying beyond starting offset */
+		if ( ( position + element_len ) > offset ) {
+			skip = ( ( offset > position ) ?
+				 ( offset - position ) : 0 );
+			if ( used < len ) {
+				copy = ( element_len - skip );
+				if ( copy > ( len - used ) )
+					copy = ( len - used );
+				memcpy ( ( buf + used ), &element[skip], copy );
+			}
+			used += ( element_len - skip );
+
+			/* Record element from which to resume */
+			if ( hint ) {
+				hint->element = i;
+				hint->position = position;
+			}
+		}
+		position += element_len;
+	}
+
+	/* Terminate string */
+	if ( len )
+		buf[ ( used < len ) ? used : ( len - 1 ) ] = '\0';
+
+	return used;
+}
+
+/**
+ * Format property as string
+ *
+ * @v prop		Property
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		State variable
+ * @ret len		Length of string
+ */
+size_t array_format ( struct property *prop __unused, char *buf,
+		      size_t len, const struct property_array *value ) {
+
+	/* Format string */
+	return array_format_from ( value, buf, len, 0, NULL );
+}
+
+/**
+ * Format part of property as string
+ *
+ * @v prop		Property
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		State variable
+ * @v offset		Starting offset within formatted string
+ * @v hint		Position hint (updated), or NULL
+ * @ret len		Length of remainder of string
+ */
+static size_t array_format_part ( struct property *prop __unused, char *buf,
+				  size_t len,
+				  const struct property_array *value,
+				  size_t offset, struct property_hint *hint ) {
+
+	/* Format remainder of string */
+	return array_format_from ( value, buf, len, offset, hint );
+}
+
+/**
+ * Parse property from a string
+ *
+ * @v prop		Property
+ * @v string		String
+ * @v value		State variable
+ * @ret rc		Return status code
+ *
+ * The elements are parsed into a staging buffer sized to hold them,
+ * which is committed to the array buffer only if the resource's
+ * update method accepts the new state.
+ */
+int array_parse ( struct property *prop, const char *string,
+		  struct property_array *value ) {
+	const char *tmp;
+	const char *end;
+	size_t count = 0;
+	size_t i;
+	int element;
+	int *data;
+	int rc;
+
+	/* Validate and count elements before modifying the value */
+	for ( tmp = string ; *tmp ; tmp = ( end + 1 ) ) {
+		if ( ( rc = parse_int ( tmp, &end, &element ) ) != 0 )
+			return rc;
+		if ( ++count > prop->param )
+			return -ERANGE;
+		if ( ! *end )
+			break;
+		if ( ( *end != ',' ) || ( ! end[1] ) )
+			return -EINVAL;
+	}
+
+	/* Replace any previous staging buffer */
+	free ( value->staged );
+	value->staged = NULL;
+	value->count = 0;
+	if ( count ) {
+		value->staged = malloc ( count * sizeof ( data[0] ) );
+		if ( ! value->staged )
+			return -ENOMEM;
+	}
+
+	/* Parse elements */
+	data = value->staged;
+	for ( tmp = string, i = 0 ; i < count ; tmp = ( end + 1 ), i++ )
+		parse_int ( tmp, &end, &data[i] );
+	value->count = count;
+
+	return 0;
+}
+
+/** Integer array property type */
+const struct property_type array_property __property_type =
+	PROPERTY_TYPE ( "array", struct property_array, array_format,
+			array_parse,
+			.format_part = PROPERTY_FORMAT_PART (
+				struct property_array, array_format_part ) );
+
+/*****************************************************************************
+ *
+ * Binary blob properties
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Format part of property as string
+ *
+ * @v prop		Property
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		State variable
+ * @v offset		Starting offset within formatted string
+ * @v hint		Position hint (unused)
+ * @ret len		Length of remainder of string
+ */
+static size_t blob_format_part ( struct property *prop __unused, char *buf,
+				 size_t len, const struct property_array *value,
+				 size_t offset,
+				 struct property_hint *hint __unused ) {
+	const uint8_t *data = array_elements ( value );
+	size_t total = ( value->count * 2 /* digits */ );
+	size_t remaining;
+	size_t count;
+	size_t index;
+	char pair[2];
+	char *tmp = buf;
+
+	/* Calculate remaining length */
+	if ( offset > total )
+		offset = total;
+	remaining = ( total - offset );
+	if ( ! len )
+		return remaining;
+	count = ( ( remaining < len ) ? remaining : ( len - 1 ) );
+	index = ( offset / 2 );
+
+	/* Encode second digit of any partially consumed byte */
+	if ( ( offset & 1 ) && count ) {
+		hex_encode ( pair, &data[index++], 1 );
+		*(tmp++) = pair[1];
+		count--;
+	}
+
+	/* Encode complete bytes */
+	tmp = hex_encode ( tmp, &data[index], ( count / 2 ) );
+	index += ( count / 2 );
+
+	/* Encode first digit of any partially formatted byte */
+	if ( count & 1 ) {
+		hex_encode ( pair, &data[index], 1 );
+		*(tmp++) = pair[0];
+	}
+	*tmp = '\0';
+
+	return remaining;
+}
+
+/**
+ * Format property as string
+ *
+ * @v prop		Property
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		State variable
+ * @ret len		Length of string
+ */
+size_t blob_format ( struct property *prop, char *buf, size_t len,
+		     const struct property_array *value ) {
+
+	/* Format string */
+	return blob_format_part ( prop, buf, len, value, 0, NULL );
+}
+
+/**
+ * Parse property from a string
+ *
+ * @v prop		Property
+ * @v string		String
+ * @v value		State variable
+ * @ret rc		Return status code
+ *
+ * The bytes are decoded into a staging buffer sized to hold them,
+ * which is committed to the blob buffer only if the resource's update
+ * method accepts the new state.
+ */
+int blob_parse ( struct property *prop, const char *string,
+		 struct property_array *value ) {
+	size_t string_len = strlen ( string );
+	uint8_t *data;
+	size_t i;
+
+	/* Validate string before modifying the value */
+	if ( string_len & 1 )
+		return -EINVAL;
+	if ( ( string_len / 2 ) > prop->param )
+		return -ERANGE;
+	for ( i = 0 ; i < string_len ; i++ ) {
+		if ( digit_value ( string[i] ) >= 16 )
+			return -EINVAL;
+	}
+
+	/* Replace any previous staging buffer */
+	free ( value->staged );
+	value->staged = NULL;
+	value->count = 0;
+	if ( string_len ) {
+		value->staged = malloc ( string_len / 2 );
+		if ( ! value->staged )
+			return -ENOMEM;
+	}
+
+	/* Decode bytes */
+	data = value->staged;
+	for ( i = 0 ; i < ( string_len / 2 ) ; i++ ) {
+		data[i] = ( ( digit_value ( string[ 2 * i ] ) << 4 ) |
+			    digit_value ( string[ 2 * i + 1 ] ) );
+	}
+	value->count = ( string_len / 2 );
+
+	return 0;
+}
+
+/** Binary blob property type */
+const struct property_type blob_property __property_type =
+	PROPERTY_TYPE ( "blob", struct property_array, blob_format,
+			blob_parse,
+			.format_part = PROPERTY_FORMAT_PART (
+				struct property_array, blob_format_part ) );
+
 /*****************************************************************************
  *
  * Generic interface
@@ -254,6 +804,22 @@ const struct property_type uuid_property =
  *****************************************************************************
  */
 
+/**
+ * Find property type
+ *
+ * @v name		Property type name
+ * @ret type		Property type, or NULL if not found
+ */
+const struct property_type * property_type_find ( const char *name ) {
+	const struct property_type *type;
+
+	for_each_table_entry ( type, PROPERTY_TYPES ) {
+		if ( strcmp ( name, type->name ) == 0 )
+			return type;
+	}
+	return NULL;
+}
+
 /**
  * Format property as string
  *
@@ -279,25 +845,80 @@ size_t property_format ( struct property *prop, char *buf, size_t len,
  * The caller is responsible for freeing the allocated string.
  */
 char * property_format_alloc ( struct property *prop, const void *state ) {
+	char tmp[PROPERTY_FORMAT_LEN];
 	char *buf;
 	size_t len;
 	size_t check;
 
-	/* Calculate length */
-	len = property_format ( prop, NULL, 0, state );
+	/* Format into temporary buffer, obtaining the exact length */
+	len = property_format ( prop, tmp, sizeof ( tmp ), state );
 
 	/* Allocate string */
 	buf = malloc ( len + 1 /* NUL */ );
 	if ( ! buf )
 		return NULL;
 
-	/* Format string */
-	check = property_format ( prop, buf, ( len + 1 /* NUL */ ), state );
-	assert ( check == len );
+	/* Copy string, or reformat if it did not fit within the
+	 * temporary buffer.
+	 */
+	if ( len < sizeof ( tmp ) ) {
+		memcpy ( buf, tmp, ( len + 1 /* NUL */ ) );
+	} else {
+		check = property_format ( prop, buf, ( len + 1 /* NUL */ ),
+					  state );
+		assert ( check == len );
+	}
 
 	return buf;
 }
 
+/**
+ * Format part of property as string
+ *
+ * @v prop		Property
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v state		Resource state
+ * @v offset		Starting offset within formatted string
+ * @v hint		Position hint (updated), or NULL
+ * @ret len		Length of remainder of string
+ *
+ * The remainder of the string may be reported as any length of at
+ * least @c len if it does not fit within the buffer.  The hint, if
+ * provided, must be zeroed before formatting the first part.
+ */
+size_t property_format_part ( struct property *prop, char *buf, size_t len,
+			      const void *state, size_t offset,
+			      struct property_hint *hint ) {
+	const void *value = ( state + prop->offset );
+	char tmp[PROPERTY_FORMAT_LEN];
+	char *full;
+	size_t full_len;
+
+	/* Use type-specific method, if any */
+	if ( prop->type->format_part ) {
+		return prop->type->format_part ( prop, buf, len, value,
+						 offset, hint );
+	}
+
+	/* Otherwise, format the whole value and extract the part */
+	full_len = prop->type->format ( prop, tmp, sizeof ( tmp ), value );
+	if ( offset > full_len )
+		offset = full_len;
+	if ( full_len < sizeof ( tmp ) ) {
+		return format_string ( buf, len, &tmp[offset],
+				       ( full_len - offset ) );
+	}
+	full = property_format_alloc ( prop, state );
+	if ( ! full )
+		return format_string ( buf, len, "", 0 );
+	full_len = format_string ( buf, len, &full[offset],
+				   ( full_len - offset ) );
+	free ( full );
+
+	return full_len;
+}
+
 /**
  * Parse property from a string
  *
@@ -310,3 +931,239 @@ int property_parse ( struct property *prop, const char *string, void *state ) {
 
 	return prop->type->parse ( prop, string, ( state + prop->offset ) );
 }
+
+/**
+ * Commit staged property value
+ *
+ * @v prop		Property
+ * @v state		Resource's own state, copied from the new state
+ *
+ * Any new value staged by property_parse() is copied into the buffer
+ * owned by the resource, and the reference to the staging buffer is
+ * cleared.  The staging buffer itself remains owned by the new state,
+ * and is freed by property_discard().
+ */
+void property_commit ( struct property *prop, void *state ) {
+	struct property_array *value = ( state + prop->offset );
+	size_t len;
+
+	/* Do nothing unless a value has been staged */
+	if ( ! ( property_is_array ( prop ) && value->staged ) )
+		return;
+
+	/* Copy staged value into resource's buffer */
+	len = ( ( prop->type == &array_property ) ? sizeof ( int ) :
+		sizeof ( uint8_t ) );
+	memcpy ( value->data, value->staged, ( value->count * len ) );
+	value->staged = NULL;
+}
+
+/**
+ * Discard staged property value
+ *
+ * @v prop		Property
+ * @v state		Copy of resource state
+ */
+void property_discard ( struct property *prop, void *state ) {
+	struct property_array *value = ( state + prop->offset );
+
+	/* Free any staging buffer */
+	if ( property_is_array ( prop ) ) {
+		free ( value->staged );
+		value->staged = NULL;
+	}
+}
+
+/*****************************************************************************
+ *
+ * Benchmarks
+ *
+ *****************************************************************************
+ */
+
+/** Number of entries in a formatting benchmark table */
+#define FORMAT_BENCH_NUM( _table ) ( sizeof ( _table ) / sizeof ( _table[0] ) )
+
+/** Formatting benchmark integers */
+static const int format_bench_integers[] = {
+	0, 7, -42, 1234, -98765, 2147483647, ( -2147483647 - 1 ), 500000,
+};
+
+/** Formatting benchmark strings */
+static const char *format_bench_strings[] = {
+	"", "on", "Oven", "oic.r.temperature", "The quick brown fox",
+};
+
+/** Formatting benchmark UUID */
+static const union uuid format_bench_uuid = {
+	.raw = { 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0,
+		 0x0f, 0xed, 0xcb, 0xa9, 0x87, 0x65, 0x43, 0x21 },
+};
+
+/**
+ * Format UUID using snprintf() (for comparison)
+ *
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		UUID
+ * @ret len		Length of string
+ */
+static size_t format_bench_uuid_snprintf ( char *buf, size_t len,
+					   const union uuid *value ) {
+
+	return snprintf ( buf, len,
+			  "%08x-%04x-%04x-%04x-%02x%02x%02x%02x%02x%02x",
+			  ntohl ( value->canonical.a ),
+			  ntohs ( value->canonical.b ),
+			  ntohs ( value->canonical.c ),
+			  ntohs ( value->canonical.d ),
+			  value->canonical.e[0], value->canonical.e[1],
+			  value->canonical.e[2], value->canonical.e[3],
+			  value->canonical.e[4], value->canonical.e[5] );
+}
+
+/**
+ * Check and report formatting benchmark
+ *
+ * @v type		Property type name
+ * @v table		Table-driven time (in ticks)
+ * @v table_len		Table-driven total length
+ * @v reference		snprintf() time (in ticks)
+ * @v reference_len	snprintf() total length
+ * @v ops		Number of operations
+ * @ret rc		Return status code
+ */
+static int format_bench_report ( const char *type, unsigned long table,
+				 size_t table_len, unsigned long reference,
+				 size_t reference_len,
+				 unsigned long long ops ) {
+	char variant[24];
+
+	snprintf ( variant, sizeof ( variant ), "%s", type );
+	bench_report ( "format", variant, table, ops );
+	snprintf ( variant, sizeof ( variant ), "%s/snprintf", type );
+	bench_report ( "format", variant, reference, ops );
+	if ( table_len != reference_len ) {
+		cprintf ( "format: %s length %zd != snprintf length %zd\n",
+			  type, table_len, reference_len );
+		return -EIO;
+	}
+	return 0;
+}
+
+/**
+ * Benchmark property formatting
+ *
+ * @v count		Number of iterations
+ * @ret rc		Return status code
+ *
+ * Each core property type is formatted using its table-driven
+ * formatter and using the snprintf() equivalent that it replaced.
+ */
+static int format_bench ( unsigned int count ) {
+	char buf[PROPERTY_FORMAT_LEN];
+	unsigned long table;
+	unsigned long reference;
+	unsigned long start;
+	size_t table_len;
+	size_t reference_len;
+	const char *string;
+	unsigned int i;
+	bool boolean;
+	int integer;
+	int rc;
+
+	/* Booleans */
+	table_len = reference_len = 0;
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		boolean = ( i & 1 );
+		table_len += boolean_format ( NULL, buf, sizeof ( buf ),
+					      &boolean );
+	}
+	table = ( currticks() - start );
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		boolean = ( i & 1 );
+		reference_len += snprintf ( buf, sizeof ( buf ), "%s",
+					    ( boolean ? "true" : "false" ) );
+	}
+	reference = ( currticks() - start );
+	if ( ( rc = format_bench_report ( "boolean", table, table_len,
+					  reference, reference_len,
+					  count ) ) != 0 )
+		return rc;
+
+	/* Integers */
+	table_len = reference_len = 0;
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		integer = format_bench_integers[ i % FORMAT_BENCH_NUM (
+						 format_bench_integers ) ];
+		table_len += integer_format ( NULL, buf, sizeof ( buf ),
+					      &integer );
+	}
+	table = ( currticks() - start );
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		integer = format_bench_integers[ i % FORMAT_BENCH_NUM (
+						 format_bench_integers ) ];
+		reference_len += snprintf ( buf, sizeof ( buf ), "%d",
+					    integer );
+	}
+	reference = ( currticks() - start );
+	if ( ( rc = format_bench_report ( "integer", table, table_len,
+					  reference, reference_len,
+					  count ) ) != 0 )
+		return rc;
+
+	/* Strings */
+	table_len = reference_len = 0;
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		string = format_bench_strings[ i % FORMAT_BENCH_NUM (
+					       format_bench_strings ) ];
+		table_len += string_format ( NULL, buf, sizeof ( buf ),
+					     &string );
+	}
+	table = ( currticks() - start );
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		string = format_bench_strings[ i % FORMAT_BENCH_NUM (
+					       format_bench_strings ) ];
+		reference_len += snprintf ( buf, sizeof ( buf ), "%s",
+					    string );
+	}
+	reference = ( currticks() - start );
+	if ( ( rc = format_bench_report ( "string", table, table_len,
+					  reference, reference_len,
+					  count ) ) != 0 )
+		return rc;
+
+	/* UUIDs */
+	table_len = reference_len = 0;
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		table_len += uuid_format ( NULL, buf, sizeof ( buf ),
+					   &format_bench_uuid );
+	}
+	table = ( currticks() - start );
+	start = currticks();
+	for ( i = 0 ; i < count ; i++ ) {
+		reference_len += format_bench_uuid_snprintf (
+			buf, sizeof ( buf ), &format_bench_uuid );
+	}
+	reference = ( currticks() - start );
+	if ( ( rc = format_bench_report ( "uuid", table, table_len,
+					  reference, reference_len,
+					  count ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/** Property formatting benchmark */
+struct benchmark format_benchmark __benchmark = {
+	.name = "format",
+	.run = format_bench,
+};
@@ -0,0 +1,923 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * State replication
+ *
+ * A primary node streams each successful resource_update() of a
+ * replicated resource to a standby node as a compact binary log
+ * entry.  Only writable properties are replicated.  Values held
+ * within the resource state are sent as raw bytes, and indirect
+ * values (such as strings) are sent in their formatted form.  Both
+ * nodes are therefore assumed to be running the same build.
+ *
+ * Each entry carries a sequence number.  The standby applies each
+ * entry via resource_update() and acknowledges the highest applied
+ * sequence number, so that on failover the standby's state is current
+ * to at least the last acknowledged entry.  Once an entry fails to
+ * apply, the standby stops advancing its sequence number until a
+ * complete checkpoint sent after the failure has been applied
+ * without further failures.  The primary measures the
+ * replication lag as the time between recording an entry and
+ * receiving its acknowledgement.
+ *
+ * Entries are constructed directly within the outbound buffer of a
+ * batched stream channel by the updating thread, and written out in
+ * batches by the channel thread.  If the buffer fills up, further entries are
+ * dropped and a full-state checkpoint is sent instead, so that the
+ * updating thread is never blocked.  Checkpoints are also sent
+ * periodically, to bound the effect of any divergence.
+ *
+ * A replication endpoint may be attached to any connected stream
+ * socket (TCP or Unix) via replica_open().
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <uniport/replica.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/string.h>
+#include <uniport/timer.h>
+
+/** Primary endpoint, if any */
+static struct replica *replica_primary;
+
+/** Standby endpoint, if any */
+static struct replica *replica_standby;
+
+/** Listening socket for standby endpoint, if any */
+static int replica_listener = -1;
+
+/** Number of updating threads that may be using an endpoint */
+static unsigned int replica_writers;
+
+/**
+ * Queue frame with no body
+ *
+ * @v replica		Replication endpoint
+ * @v type		Frame type
+ * @v seq		Sequence number
+ * @ret rc		Return status code
+ *
+ * Must be called with the endpoint lock held.
+ */
+static int replica_queue ( struct replica *replica, unsigned int type,
+			   uint32_t seq ) {
+	struct replica_frame *frame;
+
+	frame = ( ( void * ) channel_reserve ( &replica->chan,
+					       sizeof ( *frame ) ) );
+	if ( ! frame )
+		return -ENOBUFS;
+	frame->type = type;
+	frame->reserved = 0;
+	frame->len = 0;
+	frame->seq = htonl ( seq );
+	return 0;
+}
+
+/**
+ * Get length of encoded property value
+ *
+ * @v prop		Property
+ * @v state		Resource state
+ * @ret len		Length of encoded value
+ */
+static size_t replica_value_len ( struct property *prop, const void *state ) {
+
+	if ( property_is_indirect ( prop ) )
+		return property_format ( prop, NULL, 0, state );
+	return prop->len;
+}
+
+/**
+ * Queue update entry
+ *
+ * @v replica		Replication endpoint
+ * @v res		Resource
+ * @v state		Resource state
+ * @ret rc		Return status code
+ *
+ * Must be called with the endpoint lock held.
+ */
+static int replica_encode ( struct replica *replica, struct resource *res,
+			    const void *state ) {
+	const struct resource_descriptor *desc = res->desc;
+	struct replica_frame *frame;
+	struct property *prop;
+	size_t uri_len = resource_uri ( res, NULL, 0 );
+	size_t value_len;
+	size_t len;
+	uint8_t *data;
+	unsigned int i;
+
+	/* Calculate body length */
+	len = ( 1 /* URI length */ + uri_len );
+	for ( i = 0 ; i < desc->count ; i++ ) {
+		prop = &desc->props[i];
+		if ( prop->flags & PROP_RW ) {
+			len += ( 1 /* index */ + 2 /* length */ +
+				 replica_value_len ( prop, state ) );
+		}
+	}
+	if ( ( uri_len > 0xff ) ||
+	     ( ( sizeof ( *frame ) + len ) > REPLICA_RX_LEN ) )
+		return -ERANGE;
+
+	/* Reserve space */
+	frame = ( ( void * ) channel_reserve ( &replica->chan,
+					       ( sizeof ( *frame ) + len ) ) );
+	if ( ! frame )
+		return -ENOBUFS;
+
+	/* Construct frame header */
+	replica->seq++;
+	replica->times[ replica->seq % REPLICA_TIMES ] = currticks();
+	frame->type = REPLICA_UPDATE;
+	frame->reserved = 0;
+	frame->len = htons ( len );
+	frame->seq = htonl ( replica->seq );
+
+	/* Construct URI */
+	data = ( ( void * ) ( frame + 1 ) );
+	*(data++) = uri_len;
+	data += resource_uri ( res, ( char * ) data,
+			       ( uri_len + 1 /* NUL */ ) );
+
+	/* Construct property values */
+	for ( i = 0 ; i < desc->count ; i++ ) {
+		prop = &desc->props[i];
+		if ( ! ( prop->flags & PROP_RW ) )
+			continue;
+		value_len = replica_value_len ( prop, state );
+		*(data++) = i;
+		*(data++) = ( value_len >> 8 );
+		*(data++) = ( value_len & 0xff );
+		if ( property_is_indirect ( prop ) ) {
+			property_format ( prop, ( char * ) data,
+					  ( value_len + 1 /* NUL */ ), state );
+		} else {
+			memcpy ( data, ( state + prop->offset ), value_len );
+		}
+		data += value_len;
+	}
+
+	replica->stats.entries++;
+	return 0;
+}
+
+/**
+ * Record resource update
+ *
+ * @v res		Resource
+ * @v state		New resource state
+ *
+ * The caller should check that the resource is replicated, to avoid
+ * touching the shared writer count.
+ */
+void replica_record ( struct resource *res, const void *state ) {
+	struct replica *replica;
+	int rc;
+
+	replica = resource_attachment_get ( &replica_writers, &res->replica );
+	if ( replica ) {
+		pthread_mutex_lock ( &replica->chan.lock );
+		if ( ! replica->resync ) {
+			rc = replica_encode ( replica, res, state );
+			if ( rc == -ENOBUFS ) {
+				/* Drop entries until a checkpoint is sent */
+				replica->resync = 1;
+				replica->stats.resyncs++;
+			} else if ( rc != 0 ) {
+				replica->stats.failed++;
+			}
+		}
+		pthread_mutex_unlock ( &replica->chan.lock );
+	}
+	resource_attachment_put ( &replica_writers );
+}
+
+/**
+ * Continue sending checkpoint
+ *
+ * @v chan		Channel
+ * @v now		Current time
+ */
+static void replica_checkpoint ( struct channel *chan, unsigned long now ) {
+	struct replica *replica = container_of ( chan, struct replica, chan );
+	struct resource *res;
+	int rc;
+
+	/* Do nothing unless this is a primary endpoint */
+	if ( replica->standby )
+		return;
+
+	pthread_mutex_lock ( &replica->chan.lock );
+
+	/* Start checkpoint, if applicable */
+	if ( ( ! replica->checkpoint ) &&
+	     ( replica->resync ||
+	       ( ( now - replica->checkpointed ) >= replica->interval ) ) ) {
+		replica->checkpoint = 1;
+		replica->checkpointed = now;
+		replica->resync = 0;
+	}
+
+	/* Send as much of the checkpoint as will fit.  The state is
+	 * retrieved with the lock held, so that any concurrent update
+	 * is guaranteed to be recorded after the checkpoint entry.
+	 */
+	while ( replica->checkpoint ) {
+		if ( replica->checkpoint > replica->count ) {
+			if ( replica_queue ( replica, REPLICA_CHECKPOINT,
+					     replica->seq ) != 0 )
+				break;
+			replica->checkpoint = 0;
+			replica->stats.checkpoints++;
+			break;
+		}
+		res = replica->resources[ replica->checkpoint - 1 ];
+		rc = replica_encode ( replica, res, resource_retrieve ( res ) );
+		if ( rc == -ENOBUFS )
+			break;
+		if ( rc != 0 )
+			replica->stats.failed++;
+		replica->checkpoint++;
+	}
+
+	pthread_mutex_unlock ( &replica->chan.lock );
+}
+
+/**
+ * Apply update entry
+ *
+ * @v replica		Replication endpoint
+ * @v data		Frame body
+ * @v len		Length of frame body
+ * @ret rc		Return status code
+ */
+static int replica_apply ( struct replica *replica, const uint8_t *data,
+			   size_t len ) {
+	const uint8_t *end = ( data + len );
+	size_t uri_len;
+	size_t from_len = strlen ( replica->from );
+	size_t to_len = strlen ( replica->to );
+	struct resource *res;
+	struct property *prop;
+	size_t value_len;
+	unsigned int index;
+	char text[len];
+	char *value = text;
+	void *state;
+	int rc;
+
+	/* Identify resource, replacing URI prefix if applicable */
+	uri_len = *(data++);
+	if ( ( data + uri_len ) > end )
+		return -EINVAL;
+	{
+		char uri[ uri_len + to_len + 1 /* NUL */ ];
+
+		if ( ( uri_len >= from_len ) &&
+		     ( memcmp ( data, replica->from, from_len ) == 0 ) ) {
+			memcpy ( uri, replica->to, to_len );
+			memcpy ( ( uri + to_len ), ( data + from_len ),
+				 ( uri_len - from_len ) );
+			uri[ to_len + uri_len - from_len ] = '\0';
+		} else {
+			memcpy ( uri, data, uri_len );
+			uri[uri_len] = '\0';
+		}
+		res = resource_find ( uri );
+	}
+	if ( ! res )
+		return -ENOENT;
+	data += uri_len;
+
+	/* Allocate and populate copy of resource state */
+	state = malloc ( res->desc->len );
+	if ( ! state ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	memcpy ( state, resource_retrieve ( res ), res->desc->len );
+
+	/* Decode property values */
+	while ( data < end ) {
+		if ( ( data + 3 ) > end ) {
+			rc = -EINVAL;
+			goto err_decode;
+		}
+		index = data[0];
+		value_len = ( ( data[1] << 8 ) | data[2] );
+		data += 3;
+		if ( ( index >= res->desc->count ) ||
+		     ( ( data + value_len ) > end ) ) {
+			rc = -EINVAL;
+			goto err_decode;
+		}
+		prop = &res->desc->props[index];
+		if ( ! ( prop->flags & PROP_RW ) ) {
+			rc = -EPERM;
+			goto err_decode;
+		}
+		if ( property_is_indirect ( prop ) ) {
+			/* Parse formatted value (which must remain
+			 * valid until the update is complete).
+			 */
+			memcpy ( value, data, value_len );
+			value[value_len] = '\0';
+			if ( ( rc = property_parse ( prop, value,
+						     state ) ) != 0 )
+				goto err_decode;
+			value += ( value_len + 1 /* NUL */ );
+		} else if ( value_len == prop->len ) {
+			memcpy ( ( state + prop->offset ), data, value_len );
+		} else {
+			rc = -EINVAL;
+			goto err_decode;
+		}
+		data += value_len;
+	}
+
+	/* Update resource state */
+	rc = resource_update ( res, state );
+
+ err_decode:
+	resource_discard ( res, state );
+	free ( state );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Handle received frame
+ *
+ * @v replica		Replication endpoint
+ * @v frame		Frame header
+ * @ret rc		Return status code
+ */
+static int replica_rx ( struct replica *replica,
+			const struct replica_frame *frame ) {
+	uint32_t seq = ntohl ( frame->seq );
+	unsigned long now = currticks();
+	int rc;
+
+	switch ( frame->type ) {
+	case REPLICA_UPDATE:
+		rc = replica_apply ( replica, ( ( void * ) ( frame + 1 ) ),
+				     ntohs ( frame->len ) );
+		if ( rc == 0 ) {
+			replica->stats.entries++;
+			if ( ! replica->diverged )
+				replica->seq = seq;
+		} else {
+			/* Wait for the end of this checkpoint interval
+			 * and then for one complete further checkpoint.
+			 */
+			replica->stats.failed++;
+			replica->diverged = 2;
+		}
+		return 0;
+	case REPLICA_CHECKPOINT:
+		replica->stats.checkpoints++;
+		if ( replica->diverged )
+			replica->diverged--;
+		if ( ! replica->diverged )
+			replica->seq = seq;
+		return 0;
+	case REPLICA_ACK:
+		pthread_mutex_lock ( &replica->chan.lock );
+		if ( ( replica->seq - seq ) < REPLICA_TIMES ) {
+			replica->stats.lag =
+				( now - replica->times[ seq % REPLICA_TIMES ] );
+			if ( replica->stats.lag > replica->stats.max_lag )
+				replica->stats.max_lag = replica->stats.lag;
+		}
+		replica->acked = seq;
+		pthread_mutex_unlock ( &replica->chan.lock );
+		return 0;
+	default:
+		return -ENOTSUP;
+	}
+}
+
+/**
+ * Receive data
+ *
+ * @v chan		Channel
+ * @ret rc		Return status code
+ */
+static int replica_receive ( struct channel *chan ) {
+	struct replica *replica = container_of ( chan, struct replica, chan );
+	const struct replica_frame *frame;
+	ssize_t len;
+	size_t frame_len;
+	size_t used = 0;
+	int rc;
+
+	/* Read data */
+	len = channel_read ( chan, ( replica->rx + replica->rx_len ),
+			     ( sizeof ( replica->rx ) - replica->rx_len ) );
+	if ( len < 0 )
+		return len;
+	replica->rx_len += len;
+
+	/* Process complete frames */
+	while ( ( replica->rx_len - used ) >= sizeof ( *frame ) ) {
+		frame = ( ( void * ) ( replica->rx + used ) );
+		frame_len = ( sizeof ( *frame ) + ntohs ( frame->len ) );
+		if ( frame_len > sizeof ( replica->rx ) )
+			return -EMSGSIZE;
+		if ( frame_len > ( replica->rx_len - used ) )
+			break;
+		if ( ( rc = replica_rx ( replica, frame ) ) != 0 )
+			return rc;
+		used += frame_len;
+	}
+
+	/* Discard processed frames */
+	memmove ( replica->rx, ( replica->rx + used ),
+		  ( replica->rx_len - used ) );
+	replica->rx_len -= used;
+
+	/* Acknowledge applied entries, if applicable */
+	if ( replica->standby && ( replica->acked != replica->seq ) ) {
+		pthread_mutex_lock ( &replica->chan.lock );
+		if ( replica_queue ( replica, REPLICA_ACK,
+				     replica->seq ) == 0 )
+			replica->acked = replica->seq;
+		pthread_mutex_unlock ( &replica->chan.lock );
+	}
+
+	return 0;
+}
+
+/**
+ * Check for checkpoint in progress
+ *
+ * @v chan		Channel
+ * @ret busy		Checkpoint is in progress
+ */
+static int replica_busy ( struct channel *chan ) {
+	struct replica *replica = container_of ( chan, struct replica, chan );
+
+	return ( replica->checkpoint != 0 );
+}
+
+/** Replication endpoint channel operations */
+static struct channel_operations replica_operations = {
+	.receive = replica_receive,
+	.step = replica_checkpoint,
+	.busy = replica_busy,
+};
+
+/**
+ * Open replication endpoint on a connected socket
+ *
+ * @v replica		Replication endpoint
+ * @v fd		Connected stream socket (will be owned by the endpoint)
+ * @ret rc		Return status code
+ */
+int replica_open ( struct replica *replica, int fd ) {
+	unsigned int i;
+	int rc;
+
+	/* Initialise endpoint */
+	channel_init ( &replica->chan, "replica", &replica_operations,
+		       replica->buf, REPLICA_TX_LEN );
+	replica->rx_len = 0;
+	replica->seq = 0;
+	replica->acked = 0;
+	replica->checkpoint = 0;
+	replica->checkpointed = currticks();
+	replica->resync = ( ! replica->standby );
+	replica->diverged = 0;
+	memset ( &replica->stats, 0, sizeof ( replica->stats ) );
+
+	/* Open channel */
+	if ( ( rc = channel_open ( &replica->chan, fd ) ) != 0 )
+		return rc;
+
+	/* Start recording updates to replicated resources.  The
+	 * initial checkpoint (forced via the resync flag) will bring
+	 * the standby up to date.
+	 */
+	for ( i = 0 ; i < replica->count ; i++ )
+		replica->resources[i]->replica = replica;
+
+	return 0;
+}
+
+/**
+ * Close replication endpoint
+ *
+ * @v replica		Replication endpoint
+ */
+void replica_close ( struct replica *replica ) {
+	unsigned int i;
+
+	/* Stop recording updates */
+	for ( i = 0 ; i < replica->count ; i++ )
+		resource_detach ( &replica->resources[i]->replica );
+	resource_quiesce ( &replica_writers );
+
+	/* Close channel */
+	channel_close ( &replica->chan );
+}
+
+/**
+ * Remove namespace from replication
+ *
+ * @v ns		Resource namespace
+ */
+static void replica_forget ( struct namespace *ns ) {
+	struct replica *replica = replica_primary;
+	unsigned int i;
+
+	/* Do nothing unless this namespace is replicated */
+	if ( ! replica )
+		return;
+
+	/* Remove all resources within this namespace */
+	pthread_mutex_lock ( &replica->chan.lock );
+	for ( i = 0 ; i < replica->count ; ) {
+		if ( replica->resources[i]->ns == ns ) {
+			resource_detach ( &replica->resources[i]->replica );
+			replica->resources[i] =
+				replica->resources[ --replica->count ];
+		} else {
+			i++;
+		}
+	}
+
+	/* Restart any checkpoint in progress */
+	if ( replica->checkpoint ) {
+		replica->checkpoint = 0;
+		replica->resync = 1;
+	}
+	pthread_mutex_unlock ( &replica->chan.lock );
+
+	/* Wait for any update still recording a forgotten resource */
+	resource_quiesce ( &replica_writers );
+}
+
+/** Replication namespace removal hook */
+struct namespace_hook replica_namespace_hook __namespace_hook = {
+	.forget = replica_forget,
+};
+
+/**
+ * Check if resource has any writable properties
+ *
+ * @v res		Resource
+ * @ret writable	Resource has writable properties
+ */
+static int replica_is_writable ( struct resource *res ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < res->desc->count ; i++ ) {
+		if ( res->desc->props[i].flags & PROP_RW )
+			return 1;
+	}
+	return 0;
+}
+
+/** "replica" options */
+struct replica_options {
+	/** Run as standby */
+	int standby;
+	/** Peer (or listening) address */
+	struct in_addr address;
+	/** Port */
+	unsigned int port;
+	/** Checkpoint interval (in seconds) */
+	unsigned int interval;
+	/** URI prefix mapping (standby only) */
+	char *map;
+	/** Stop endpoint */
+	int stop;
+};
+
+/** "replica" option list */
+static struct option_descriptor replica_opts[] = {
+	OPTION_DESC ( "listen", 'l', no_argument,
+		      struct replica_options, standby, parse_flag ),
+	OPTION_DESC ( "address", 'a', required_argument,
+		      struct replica_options, address, parse_address ),
+	OPTION_DESC ( "port", 'p', required_argument,
+		      struct replica_options, port, parse_integer ),
+	OPTION_DESC ( "checkpoint", 'k', required_argument,
+		      struct replica_options, interval, parse_integer ),
+	OPTION_DESC ( "map", 'm', required_argument,
+		      struct replica_options, map, parse_string ),
+	OPTION_DESC ( "stop", 'd', no_argument,
+		      struct replica_options, stop, parse_flag ),
+};
+
+/** "replica" command descriptor */
+static struct command_descriptor replica_cmd =
+	COMMAND_DESC ( struct replica_options, replica_opts, 0, 1,
+		       "[<uri-pattern>]" );
+
+/**
+ * Create primary endpoint
+ *
+ * @v opts		"replica" options
+ * @v pattern		Resource URI pattern
+ * @ret rc		Return status code
+ */
+static int replica_create_primary ( struct replica_options *opts,
+				    const char *pattern ) {
+	struct sockaddr_in peer;
+	struct replica *replica;
+	struct resource *res;
+	size_t prefix_len = glob_prefix_len ( pattern );
+	unsigned int first;
+	unsigned int i;
+	int fd;
+	int rc;
+
+	/* Allocate and initialise endpoint */
+	replica = calloc ( 1, sizeof ( *replica ) );
+	if ( ! replica ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	replica->interval = ( opts->interval * TICKS_PER_SEC );
+
+	/* Find matching writable resources within the resource index */
+	first = resource_index_lower ( pattern, prefix_len );
+	replica->resources = calloc ( ( resource_index_count - first ),
+				      sizeof ( replica->resources[0] ) );
+	if ( ( ! replica->resources ) && ( resource_index_count - first ) ) {
+		rc = -ENOMEM;
+		goto err_resources;
+	}
+	for ( i = first ; i < resource_index_count ; i++ ) {
+		res = resource_index[i];
+		if ( resource_uri_ncmp ( res, pattern, prefix_len ) != 0 )
+			break;
+		if ( resource_uri_match ( res, pattern ) &&
+		     replica_is_writable ( res ) )
+			replica->resources[replica->count++] = res;
+	}
+
+	/* Connect to standby */
+	fd = socket ( AF_INET, SOCK_STREAM, 0 );
+	if ( fd < 0 ) {
+		rc = -errno;
+		goto err_socket;
+	}
+	memset ( &peer, 0, sizeof ( peer ) );
+	peer.sin_family = AF_INET;
+	peer.sin_addr = opts->address;
+	peer.sin_port = htons ( opts->port );
+	if ( connect ( fd, ( struct sockaddr * ) &peer,
+		       sizeof ( peer ) ) != 0 ) {
+		rc = -errno;
+		goto err_connect;
+	}
+
+	/* Open endpoint (which takes ownership of the socket) */
+	if ( ( rc = replica_open ( replica, fd ) ) != 0 )
+		goto err_open;
+
+	replica_primary = replica;
+	return 0;
+
+ err_connect:
+	close ( fd );
+ err_open:
+ err_socket:
+	free ( replica->resources );
+ err_resources:
+	free ( replica );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Accept connection from primary
+ *
+ * @v arg		Standby endpoint
+ * @ret arg		Unused
+ */
+static void * replica_accept ( void *arg ) {
+	struct replica *replica = arg;
+	int fd;
+	int rc;
+
+	/* Wait for primary to connect */
+	fd = accept ( replica_listener, NULL, NULL );
+	if ( fd < 0 ) {
+		/* Listener closed before connection */
+		return NULL;
+	}
+
+	/* Open endpoint */
+	if ( ( rc = replica_open ( replica, fd ) ) != 0 ) {
+		printf ( "replica: could not accept: %s\n", strerror ( rc ) );
+		return NULL;
+	}
+
+	return NULL;
+}
+
+/**
+ * Create standby endpoint
+ *
+ * @v opts		"replica" options
+ * @ret rc		Return status code
+ */
+static int replica_create_standby ( struct replica_options *opts ) {
+	struct sockaddr_in local;
+	struct replica *replica;
+	pthread_t thread;
+	char *to;
+	int one = 1;
+	int rc;
+
+	/* Allocate and initialise endpoint */
+	replica = calloc ( 1, ( sizeof ( *replica ) +
+				strlen ( opts->map ) + 1 /* NUL */ ) );
+	if ( ! replica ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	replica->standby = 1;
+	replica->chan.fd = -1;
+	replica->from = strcpy ( ( ( void * ) ( replica + 1 ) ), opts->map );
+	to = strchr ( replica->from, '=' );
+	if ( to ) {
+		*(to++) = '\0';
+		replica->to = to;
+	} else {
+		replica->to = replica->from;
+	}
+
+	/* Listen for primary */
+	replica_listener = socket ( AF_INET, SOCK_STREAM, 0 );
+	if ( replica_listener < 0 ) {
+		rc = -errno;
+		goto err_socket;
+	}
+	setsockopt ( replica_listener, SOL_SOCKET, SO_REUSEADDR,
+		     &one, sizeof ( one ) );
+	memset ( &local, 0, sizeof ( local ) );
+	local.sin_family = AF_INET;
+	local.sin_addr = opts->address;
+	local.sin_port = htons ( opts->port );
+	if ( bind ( replica_listener, ( struct sockaddr * ) &local,
+		    sizeof ( local ) ) != 0 ) {
+		rc = -errno;
+		goto err_bind;
+	}
+	if ( listen ( replica_listener, 1 ) != 0 ) {
+		rc = -errno;
+		goto err_listen;
+	}
+
+	/* Accept connection in the background */
+	if ( ( rc = pthread_create ( &thread, NULL, replica_accept,
+				     replica ) ) != 0 ) {
+		rc = -rc;
+		goto err_thread;
+	}
+	pthread_detach ( thread );
+
+	replica_standby = replica;
+	return 0;
+
+ err_thread:
+ err_listen:
+ err_bind:
+	close ( replica_listener );
+	replica_listener = -1;
+ err_socket:
+	free ( replica );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Show replication endpoint status
+ *
+ * @v replica		Replication endpoint
+ */
+static void replica_show ( struct replica *replica ) {
+	struct replica_stats *stats = &replica->stats;
+	unsigned long per_us = ( TICKS_PER_SEC / 1000000 );
+
+	cprintf ( "replica: %s %s",
+		  ( replica->standby ? "standby" : "primary" ),
+		  ( replica->chan.running ? "connected" : "disconnected" ) );
+	if ( ! replica->standby )
+		cprintf ( " resources=%u", replica->count );
+	cprintf ( " seq=%u acked=%u entries=%lu failed=%lu checkpoints=%lu",
+		  replica->seq, replica->acked, stats->entries, stats->failed,
+		  stats->checkpoints );
+	if ( ! replica->standby ) {
+		cprintf ( " resyncs=%lu writes=%lu bytes=%llu lag=%luus "
+			  "max=%luus", stats->resyncs,
+			  replica->chan.stats.writes, replica->chan.stats.bytes,
+			  ( stats->lag / per_us ),
+			  ( stats->max_lag / per_us ) );
+	}
+	cprintf ( "\n" );
+}
+
+/**
+ * "replica" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int replica_exec ( int argc, char **argv ) {
+	struct replica_options opts;
+	struct replica **replica;
+	int rc;
+
+	/* Parse options, with defaults */
+	memset ( &opts, 0, sizeof ( opts ) );
+	inet_aton ( "127.0.0.1", &opts.address );
+	opts.port = REPLICA_PORT;
+	opts.interval = REPLICA_INTERVAL;
+	opts.map = "";
+	if ( ( rc = reparse_options ( argc, argv, &replica_cmd,
+				      &opts ) ) != 0 )
+		return rc;
+	replica = ( opts.standby ? &replica_standby : &replica_primary );
+
+	/* Stop endpoint, if applicable */
+	if ( opts.stop ) {
+		if ( opts.standby && ( replica_listener >= 0 ) ) {
+			shutdown ( replica_listener, SHUT_RDWR );
+			close ( replica_listener );
+			replica_listener = -1;
+		}
+		if ( *replica ) {
+			if ( (*replica)->chan.fd >= 0 )
+				replica_close ( *replica );
+			free ( (*replica)->resources );
+			free ( *replica );
+			*replica = NULL;
+		}
+		return 0;
+	}
+
+	/* Show status, if no endpoint is being created */
+	if ( ( ! opts.standby ) && ( optind == argc ) ) {
+		if ( replica_primary )
+			replica_show ( replica_primary );
+		if ( replica_standby )
+			replica_show ( replica_standby );
+		return 0;
+	}
+
+	/* Otherwise, create endpoint */
+	if ( *replica ) {
+		cprintf ( "replica: already running\n" );
+		return -EALREADY;
+	}
+	if ( opts.standby )
+		return replica_create_standby ( &opts );
+	if ( ! opts.interval ) {
+		cprintf ( "%s: checkpoint interval must be non-zero\n",
+			  argv[0] );
+		return -EINVAL;
+	}
+	return replica_create_primary ( &opts, argv[optind] );
+}
+
+/** "replica" command */
+struct command replica_command __command = {
+	.name = "replica",
+	.exec = replica_exec,
+};
@@ -25,14 +25,61 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 #include <uniport/resource.h>
+#include <uniport/command.h>
 #include <uniport/interface.h>
+#include <uniport/history.h>
+#include <uniport/cache.h>
+#include <uniport/discovery.h>
+#include <uniport/export.h>
+#include <uniport/replica.h>
+#include <uniport/string.h>
 
 /** List of resource namespaces */
 struct list_head namespaces = LIST_HEAD_INIT ( namespaces );
 
+/** Index of all registered resources, sorted by URI */
+struct resource **resource_index;
+
+/** Number of entries in resource index */
+unsigned int resource_index_count;
+
+/** Resource type index (sorted by type and then by URI) */
+struct resource **resource_type_index;
+
+/** Number of entries in resource type index */
+unsigned int resource_type_count;
+
+/** Resource index lock */
+static pthread_mutex_t resource_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Lock resource indices
+ *
+ * The resource index and resource type index are modified only with
+ * this lock held.  Code running outside of the command thread must
+ * hold this lock while using either index, or any resource found via
+ * either index.
+ */
+void resource_index_lock ( void ) {
+
+	pthread_mutex_lock ( &resource_index_mutex );
+}
+
+/**
+ * Unlock resource indices
+ *
+ */
+void resource_index_unlock ( void ) {
+
+	pthread_mutex_unlock ( &resource_index_mutex );
+}
+
 /**
  * Retrieve resource state
  *
@@ -41,25 +88,92 @@ struct list_head namespaces = LIST_HEAD_INIT ( namespaces );
  */
 const void * resource_retrieve ( struct resource *res ) {
 
+	/* Retrieve resource state via cache, if applicable */
+	if ( res->cache )
+		return cache_retrieve ( res );
+
 	/* Retrieve resource state */
 	return res->desc->retrieve ( res );
 }
 
+/**
+ * Discard staged property values
+ *
+ * @v res		Resource
+ * @v state		Copy of resource state
+ *
+ * Any property values staged within a copy of the resource state by
+ * property_parse() are released without being applied.  This must be
+ * called before freeing a copy that was not passed to
+ * resource_update().
+ */
+void resource_discard ( struct resource *res, void *state ) {
+	const struct resource_descriptor *desc = res->desc;
+	unsigned int i;
+
+	for ( i = 0 ; i < desc->count ; i++ )
+		property_discard ( &desc->props[i], state );
+}
+
+/**
+ * Commit staged property values
+ *
+ * @v res		Resource
+ * @v state		Resource's own state, copied from the new state
+ *
+ * An update method must call this, with its own lock held, after
+ * accepting a new state containing array-valued properties and
+ * copying it into the resource's own state.  Any staged values are
+ * copied into the resource's own buffers, and the resource's state
+ * is left referring only to those buffers.
+ */
+void resource_commit ( struct resource *res, void *state ) {
+	const struct resource_descriptor *desc = res->desc;
+	unsigned int i;
+
+	for ( i = 0 ; i < desc->count ; i++ )
+		property_commit ( &desc->props[i], state );
+}
+
 /**
  * Update resource state
  *
  * @v res		Resource
  * @v state		New resource state
  * @ret rc		Return status code
+ *
+ * Any property values staged within the new state are visible to the
+ * update method, which may validate them before committing them using
+ * resource_commit().  The resource's own buffers are therefore left
+ * untouched if the update fails.  The staged values are released
+ * once the update method returns.
  */
-int resource_update ( struct resource *res, const void *state ) {
+int resource_update ( struct resource *res, void *state ) {
+	const struct resource_descriptor *desc = res->desc;
+	int rc;
 
 	/* Fail if resource is not updatable */
-	if ( ! res->desc->update )
+	if ( ! desc->update ) {
+		resource_discard ( res, state );
 		return -ENOTSUP;
+	}
 
 	/* Update resource state */
-	return res->desc->update ( res, state );
+	rc = desc->update ( res, state );
+
+	/* Release any staged property values */
+	resource_discard ( res, state );
+
+	/* Invalidate any cached state */
+	if ( res->cache )
+		cache_invalidate ( res );
+
+	/* Replicate successful update, if applicable */
+	if ( ( rc == 0 ) &&
+	     __atomic_load_n ( &res->replica, __ATOMIC_RELAXED ) )
+		replica_record ( res, state );
+
+	return rc;
 }
 
 /**
@@ -70,28 +184,39 @@ int resource_update ( struct resource *res, const void *state ) {
 void resource_observe ( struct observer *obs ) {
 	struct resource *res = obs->res;
 
+	pthread_mutex_lock ( &res->observers_lock );
+
 	/* Add to list of observers */
 	list_add_tail ( &obs->list, &res->observers );
 
 	/* Update observation state, if applicable */
 	if ( res->desc->observe )
 		res->desc->observe ( res );
+
+	pthread_mutex_unlock ( &res->observers_lock );
 }
 
 /**
  * Remove observer
  *
  * @v obs		Observer
+ *
+ * This waits for any notification in progress on another thread, so
+ * that the observer may be freed once this function returns.
  */
 void resource_unobserve ( struct observer *obs ) {
 	struct resource *res = obs->res;
 
+	pthread_mutex_lock ( &res->observers_lock );
+
 	/* Remove from list of observers */
 	list_del ( &obs->list );
 
 	/* Update observation state, if applicable */
 	if ( res->desc->observe )
 		res->desc->observe ( res );
+
+	pthread_mutex_unlock ( &res->observers_lock );
 }
 
 /**
@@ -103,16 +228,186 @@ void resource_notify ( struct resource *res ) {
 	struct observer *obs;
 	const void *state;
 
+	/* Invalidate any cached state */
+	if ( res->cache )
+		cache_invalidate ( res );
+
 	/* Retrieve resource state */
 	state = resource_retrieve ( res );
 
+	/* Record state history, if applicable */
+	if ( res->history )
+		history_record ( res, state );
+
+	/* Update shared-memory export, if applicable */
+	if ( __atomic_load_n ( &res->export, __ATOMIC_RELAXED ) )
+		export_record ( res, state );
+
 	/* Notify each observer */
+	pthread_mutex_lock ( &res->observers_lock );
 	list_for_each_entry ( obs, &res->observers, list )
 		obs->notify ( obs, state );
+	pthread_mutex_unlock ( &res->observers_lock );
 }
 
 /**
- * Print resource state (for debugging)
+ * Wait for writers to finish using detached attachments
+ *
+ * @v writers		Writer count for this kind of attachment
+ *
+ * Once this returns, no writer is still using any attachment that
+ * was detached using resource_detach() before the call.
+ */
+void resource_quiesce ( unsigned int *writers ) {
+
+	while ( __atomic_load_n ( writers, __ATOMIC_SEQ_CST ) )
+		sched_yield();
+}
+
+/**
+ * Format part of a fixed string
+ *
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v text		Text
+ * @v offset		Starting offset within text
+ * @ret len		Length of remainder of text
+ */
+static size_t resource_format_text ( char *buf, size_t len, const char *text,
+				     size_t offset ) {
+	size_t text_len = strlen ( text );
+
+	if ( offset > text_len )
+		offset = text_len;
+	return format_string ( buf, len, ( text + offset ),
+			       ( text_len - offset ) );
+}
+
+/**
+ * Format next block of resource state
+ *
+ * @v res		Resource
+ * @v intf		Interface
+ * @v cursor		Cursor (updated to follow the formatted block)
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @ret len		Length of block, or zero if there is no more state
+ *
+ * The block is NUL-terminated, and so will contain at most ( len - 1 )
+ * characters.  Every block other than the last is filled completely.
+ * Formatting a resource in blocks requires no memory beyond the
+ * buffer itself, regardless of the size of the resource state.
+ */
+size_t resource_format_block ( struct resource *res, struct interface *intf,
+			       struct resource_cursor *cursor,
+			       char *buf, size_t len ) {
+	const struct resource_descriptor *desc = res->desc;
+	struct property *prop;
+	unsigned int index;
+	size_t remaining;
+	size_t avail;
+	size_t used = 0;
+	char *out;
+
+	/* Terminate string in case there is nothing to format */
+	if ( len )
+		buf[0] = '\0';
+
+	/* Format segments until buffer is full */
+	while ( ( used + 1 ) < len ) {
+		out = ( buf + used );
+		avail = ( len - used );
+		if ( cursor->segment == 0 ) {
+			remaining = resource_format_text ( out, avail, res->uri,
+							   cursor->offset );
+		} else if ( cursor->segment == 1 ) {
+			remaining = resource_format_text ( out, avail, ":",
+							   cursor->offset );
+		} else {
+			index = ( ( cursor->segment - 2 ) / 4 );
+			if ( index >= desc->count ) {
+				if ( cursor->segment > ( 2 + ( 4 * index ) ) )
+					break;
+				remaining = resource_format_text ( out, avail,
+								   "\n",
+								   cursor->offset );
+			} else {
+				prop = &desc->props[index];
+				if ( ! interface_mask_test ( intf, desc,
+							     INTERFACE_VISIBLE,
+							     index ) ) {
+					/* Skip to next visible property */
+					index = interface_mask_next (
+						intf, desc, INTERFACE_VISIBLE,
+						index );
+					cursor->segment = ( 2 + ( 4 * index ) );
+					continue;
+				}
+				switch ( ( cursor->segment - 2 ) % 4 ) {
+				case 0:
+					remaining = resource_format_text (
+						out, avail, " ",
+						cursor->offset );
+					break;
+				case 1:
+					remaining = resource_format_text (
+						out, avail, prop->name,
+						cursor->offset );
+					break;
+				case 2:
+					remaining = resource_format_text (
+						out, avail, "=",
+						cursor->offset );
+					break;
+				default:
+					remaining = property_format_part (
+						prop, out, avail,
+						cursor->state, cursor->offset,
+						&cursor->hint );
+					break;
+				}
+			}
+		}
+
+		/* Move to next segment, or record partial progress */
+		if ( remaining < avail ) {
+			used += remaining;
+			cursor->segment++;
+			cursor->offset = 0;
+			memset ( &cursor->hint, 0, sizeof ( cursor->hint ) );
+		} else {
+			used += ( avail - 1 );
+			cursor->offset += ( avail - 1 );
+		}
+	}
+
+	return used;
+}
+
+/**
+ * Print resource state to a stream
+ *
+ * @v out		Output stream
+ * @v res		Resource
+ * @v intf		Interface
+ * @v state		Resource state
+ */
+void resource_fprint ( FILE *out, struct resource *res,
+		       struct interface *intf, const void *state ) {
+	struct resource_cursor cursor;
+	char buf[RESOURCE_BLOCK_LEN];
+	size_t len;
+
+	/* Print state one block at a time */
+	resource_cursor_init ( &cursor, state );
+	while ( ( len = resource_format_block ( res, intf, &cursor,
+						buf, sizeof ( buf ) ) ) ) {
+		fwrite ( buf, 1, len, out );
+	}
+}
+
+/**
+ * Print resource state to command output
  *
  * @v res		Resource
  * @v state		Resource state
@@ -120,21 +415,371 @@ void resource_notify ( struct resource *res ) {
  */
 void resource_print ( struct resource *res, struct interface *intf,
 		      const void *state ) {
-	struct property *prop;
-	char *value;
+
+	resource_fprint ( command_output(), res, intf, state );
+}
+
+/**
+ * Construct resource URI
+ *
+ * @v res		Resource
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @ret len		Length of URI
+ */
+size_t resource_uri ( struct resource *res, char *buf, size_t len ) {
+	size_t prefix_len = strlen ( res->ns->uri );
+	size_t suffix_len = strlen ( res->uri );
+
+	/* Construct URI from namespace prefix and resource suffix */
+	if ( prefix_len < len ) {
+		memcpy ( buf, res->ns->uri, prefix_len );
+		format_string ( ( buf + prefix_len ), ( len - prefix_len ),
+				res->uri, suffix_len );
+	} else {
+		format_string ( buf, len, res->ns->uri, prefix_len );
+	}
+
+	return ( prefix_len + suffix_len );
+}
+
+/**
+ * Compare resource URI against a string
+ *
+ * @v res		Resource
+ * @v uri		URI
+ * @v len		Maximum number of characters to compare
+ * @ret diff		Difference (as for strncmp())
+ */
+int resource_uri_ncmp ( struct resource *res, const char *uri, size_t len ) {
+	size_t prefix_len = strlen ( res->ns->uri );
+	int diff;
+
+	/* Compare namespace prefix */
+	if ( len <= prefix_len )
+		return strncmp ( res->ns->uri, uri, len );
+	diff = strncmp ( res->ns->uri, uri, prefix_len );
+	if ( diff )
+		return diff;
+
+	/* Compare resource suffix */
+	return strncmp ( res->uri, ( uri + prefix_len ), ( len - prefix_len ) );
+}
+
+/**
+ * Match resource URI against a glob pattern
+ *
+ * @v res		Resource
+ * @v pattern		URI pattern
+ * @ret match		Resource URI matches pattern
+ */
+bool resource_uri_match ( struct resource *res, const char *pattern ) {
+	size_t prefix_len = glob_prefix_len ( pattern );
+	char uri[ resource_uri ( res, NULL, 0 ) + 1 /* NUL */ ];
+
+	/* Compare directly if pattern has no wildcards */
+	if ( ! pattern[prefix_len] ) {
+		return ( resource_uri_ncmp ( res, pattern,
+					     ( prefix_len + 1 /* NUL */ ) )
+			 == 0 );
+	}
+
+	/* Match against constructed URI */
+	resource_uri ( res, uri, sizeof ( uri ) );
+	return glob_match ( pattern, uri );
+}
+
+/**
+ * Compare resource URIs
+ *
+ * @v a			Resource
+ * @v b			Resource
+ * @ret diff		Difference (as for strcmp())
+ */
+static int resource_uri_cmp ( struct resource *a, struct resource *b ) {
+	const char *x = a->ns->uri;
+	const char *y = b->ns->uri;
+	int x_suffix = 0;
+	int y_suffix = 0;
+
+	/* Resources within the same namespace differ only by suffix */
+	if ( a->ns == b->ns )
+		return strcmp ( a->uri, b->uri );
+
+	/* Compare concatenated prefix and suffix */
+	while ( 1 ) {
+		if ( ( ! *x ) && ( ! x_suffix++ ) )
+			x = a->uri;
+		if ( ( ! *y ) && ( ! y_suffix++ ) )
+			y = b->uri;
+		if ( ( *x != *y ) || ( ! *x ) ) {
+			return ( ( ( unsigned char ) *x ) -
+				 ( ( unsigned char ) *y ) );
+		}
+		x++;
+		y++;
+	}
+}
+
+/**
+ * Compare resource index entries (for qsort())
+ *
+ * @v a			Index entry
+ * @v b			Index entry
+ * @ret diff		Difference
+ */
+static int resource_index_cmp ( const void *a, const void *b ) {
+	struct resource * const *x = a;
+	struct resource * const *y = b;
+
+	return resource_uri_cmp ( *x, *y );
+}
+
+/**
+ * Compare resource type index entries (for qsort())
+ *
+ * @v a			Index entry
+ * @v b			Index entry
+ * @ret diff		Difference
+ */
+static int resource_type_cmp ( const void *a, const void *b ) {
+	struct resource * const *x = a;
+	struct resource * const *y = b;
+	int diff;
+
+	diff = strcmp ( (*x)->desc->rt, (*y)->desc->rt );
+	if ( diff )
+		return diff;
+	return resource_uri_cmp ( *x, *y );
+}
+
+/**
+ * Find first resource index entry not less than a URI prefix
+ *
+ * @v uri		URI prefix
+ * @v len		Length of URI prefix
+ * @ret index		Index of first matching entry
+ */
+unsigned int resource_index_lower ( const char *uri, size_t len ) {
+	unsigned int lower = 0;
+	unsigned int upper = resource_index_count;
+	unsigned int mid;
+
+	/* Binary search */
+	while ( lower < upper ) {
+		mid = ( lower + ( ( upper - lower ) / 2 ) );
+		if ( resource_uri_ncmp ( resource_index[mid], uri, len ) < 0 ) {
+			lower = ( mid + 1 );
+		} else {
+			upper = mid;
+		}
+	}
+	return lower;
+}
+
+/**
+ * Merge resources into a sorted index
+ *
+ * @v index		Sorted index
+ * @v count		Number of entries in sorted index
+ * @v add		Resources to add (will be sorted)
+ * @v num_add		Number of resources to add
+ * @v cmp		Comparison function (as for qsort())
+ * @ret rc		Return status code
+ */
+static int resource_index_merge ( struct resource ***index,
+				  unsigned int *count,
+				  struct resource **add,
+				  unsigned int num_add,
+				  int ( * cmp ) ( const void *a,
+						  const void *b ) ) {
+	struct resource **expanded;
+	struct resource **new;
+	struct resource **old;
+	struct resource **out;
+
+	/* Sort new resources */
+	qsort ( add, num_add, sizeof ( add[0] ), cmp );
+
+	/* Expand index */
+	expanded = realloc ( *index, ( ( *count + num_add ) *
+				       sizeof ( expanded[0] ) ) );
+	if ( ( ! expanded ) && ( *count + num_add ) )
+		return -ENOMEM;
+	*index = expanded;
+
+	/* Merge new resources into existing index, working backwards
+	 * from the end of the expanded index.
+	 */
+	out = &expanded[ *count + num_add ];
+	old = &expanded[*count];
+	new = &add[num_add];
+	while ( new > add ) {
+		if ( ( old > expanded ) &&
+		     ( cmp ( &old[-1], &new[-1] ) > 0 ) ) {
+			*(--out) = *(--old);
+		} else {
+			*(--out) = *(--new);
+		}
+	}
+	*count += num_add;
+
+	return 0;
+}
+
+/**
+ * Remove namespace from a sorted index
+ *
+ * @v index		Sorted index
+ * @v count		Number of entries in sorted index
+ * @v ns		Resource namespace
+ */
+static void resource_index_remove ( struct resource **index,
+				    unsigned int *count,
+				    struct namespace *ns ) {
 	unsigned int i;
+	unsigned int j;
 
-	/* Print properties */
-	printf ( "%s:", res->uri );
-	for ( i = 0 ; i < res->desc->count ; i++ ) {
-		prop = &res->desc->props[i];
-		if ( ! interface_has_property ( intf, prop ) )
-			continue;
-		value = property_format_alloc ( prop, state );
-		printf ( " %s=%s", prop->name, ( value ? value : "<ENOMEM>" ) );
-		free ( value );
+	/* Compact index, preserving order */
+	for ( i = 0, j = 0 ; i < *count ; i++ ) {
+		if ( index[i]->ns != ns )
+			index[j++] = index[i];
 	}
-	printf ( "\n" );
+	*count = j;
+}
+
+/**
+ * Add namespace to resource index
+ *
+ * @v ns		Resource namespace
+ * @ret rc		Return status code
+ *
+ * Resources with a resource type are also added to the resource type
+ * index.
+ */
+static int resource_index_add ( struct namespace *ns ) {
+	struct resource **add;
+	unsigned int count;
+	unsigned int typed;
+	unsigned int i;
+	int rc;
+
+	/* Count resources */
+	for ( count = 0 ; ns->resources[count] ; count++ ) {}
+
+	/* Allocate temporary space for sorting new resources */
+	add = malloc ( count * sizeof ( add[0] ) );
+	if ( ( ! add ) && count ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+
+	/* Add to resource index */
+	resource_index_lock();
+	memcpy ( add, ns->resources, ( count * sizeof ( add[0] ) ) );
+	if ( ( rc = resource_index_merge ( &resource_index,
+					   &resource_index_count, add, count,
+					   resource_index_cmp ) ) != 0 )
+		goto err_index;
+
+	/* Add typed resources to resource type index */
+	for ( i = 0, typed = 0 ; i < count ; i++ ) {
+		if ( ns->resources[i]->desc->rt )
+			add[typed++] = ns->resources[i];
+	}
+	if ( ( rc = resource_index_merge ( &resource_type_index,
+					   &resource_type_count, add, typed,
+					   resource_type_cmp ) ) != 0 )
+		goto err_type;
+
+	resource_index_unlock();
+	free ( add );
+	return 0;
+
+ err_type:
+	resource_index_remove ( resource_index, &resource_index_count, ns );
+ err_index:
+	resource_index_unlock();
+	free ( add );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Remove namespace from resource index
+ *
+ * @v ns		Resource namespace
+ */
+static void resource_index_del ( struct namespace *ns ) {
+
+	resource_index_lock();
+	resource_index_remove ( resource_type_index, &resource_type_count,
+				ns );
+	resource_index_remove ( resource_index, &resource_index_count, ns );
+	resource_index_unlock();
+}
+
+/**
+ * Reserve per-resource storage
+ *
+ * @v res		Resource
+ * @ret rc		Return status code
+ */
+static int resource_reserve ( struct resource *res ) {
+	pthread_mutexattr_t attr;
+	int rc;
+
+	/* Calculate per-interface property masks, if not yet done */
+	if ( ( rc = interface_mask_init ( res->desc ) ) != 0 )
+		goto err_masks;
+
+	/* Initialise observer lock, allowing an observer to update
+	 * (and so notify) the resource that it is observing.
+	 */
+	pthread_mutexattr_init ( &attr );
+	pthread_mutexattr_settype ( &attr, PTHREAD_MUTEX_RECURSIVE );
+	rc = -pthread_mutex_init ( &res->observers_lock, &attr );
+	pthread_mutexattr_destroy ( &attr );
+	if ( rc != 0 )
+		goto err_lock;
+
+	/* Reserve storage for state history, if applicable */
+	if ( res->history && ( ( rc = history_reserve ( res ) ) != 0 ) )
+		goto err_history;
+
+	/* Reserve retrieval cache, if applicable */
+	if ( res->desc->ttl && ( ( rc = cache_reserve ( res ) ) != 0 ) )
+		goto err_cache;
+
+	return 0;
+
+ err_cache:
+	if ( res->history )
+		history_release ( res );
+ err_history:
+	pthread_mutex_destroy ( &res->observers_lock );
+ err_lock:
+ err_masks:
+	return rc;
+}
+
+/**
+ * Release per-resource storage
+ *
+ * @v res		Resource
+ */
+static void resource_release ( struct resource *res ) {
+
+	/* Release retrieval cache, if applicable */
+	if ( res->cache )
+		cache_release ( res );
+
+	/* Release storage for state history, if applicable */
+	if ( res->history )
+		history_release ( res );
+
+	/* Destroy observer lock */
+	pthread_mutex_destroy ( &res->observers_lock );
 }
 
 /**
@@ -163,22 +808,42 @@ static struct namespace * resource_namespace ( const char *uri ) {
  */
 int resource_register ( struct namespace *ns ) {
 	struct resource **res;
+	int rc;
 
 	/* Sanity check */
 	if ( resource_namespace ( ns->uri ) != NULL )
 		return -EINVAL;
 
-	/* Add to list of namespaces */
-	list_add_tail ( &ns->list, &namespaces );
+	/* Record owning namespace */
+	for ( res = ns->resources ; *res ; res++ )
+		(*res)->ns = ns;
 
-	/* Print initial resource state for diagnostics */
-	printf ( "Namespace %s...\n", ns->uri );
+	/* Reserve per-resource storage */
 	for ( res = ns->resources ; *res ; res++ ) {
-		resource_print ( *res, &oic_if_baseline,
-				 resource_retrieve ( *res ) );
+		if ( ( rc = resource_reserve ( *res ) ) != 0 )
+			goto err_reserve;
 	}
 
+	/* Add to resource index */
+	if ( ( rc = resource_index_add ( ns ) ) != 0 )
+		goto err_index;
+
+	/* Add to discovery links */
+	if ( ( rc = discovery_add ( ns ) ) != 0 )
+		goto err_discovery;
+
+	/* Add to list of namespaces */
+	list_add_tail ( &ns->list, &namespaces );
+
 	return 0;
+
+ err_discovery:
+	resource_index_del ( ns );
+ err_index:
+ err_reserve:
+	while ( res-- != ns->resources )
+		resource_release ( *res );
+	return rc;
 }
 
 /**
@@ -187,9 +852,25 @@ int resource_register ( struct namespace *ns ) {
  * @v ns		Resource namespace
  */
 void resource_unregister ( struct namespace *ns ) {
+	struct namespace_hook *hook;
+	struct resource **res;
 
 	/* Remove from list of namespaces */
 	list_del ( &ns->list );
+
+	/* Remove from discovery links */
+	discovery_del ( ns );
+
+	/* Remove from all other subsystems */
+	for_each_table_entry ( hook, NAMESPACE_HOOKS )
+		hook->forget ( ns );
+
+	/* Remove from resource index */
+	resource_index_del ( ns );
+
+	/* Release per-resource storage */
+	for ( res = ns->resources ; *res ; res++ )
+		resource_release ( *res );
 }
 
 /**
@@ -199,24 +880,62 @@ void resource_unregister ( struct namespace *ns ) {
  * @ret res		Resource, or NULL if not found
  */
 struct resource * resource_find ( const char *uri ) {
-	struct namespace *ns;
-	struct resource **res;
-	size_t len;
+	struct resource *res;
+	unsigned int index;
+	size_t len = ( strlen ( uri ) + 1 /* NUL */ );
 
-	/* Find resource namespace */
-	ns = resource_namespace ( uri );
-	if ( ! ns )
+	/* Find matching resource within index */
+	index = resource_index_lower ( uri, len );
+	if ( index >= resource_index_count )
+		return NULL;
+	res = resource_index[index];
+	if ( resource_uri_ncmp ( res, uri, len ) != 0 )
 		return NULL;
 
-	/* Find matching resource */
-	len = strlen ( ns->uri );
-	assert ( ns->uri[ len - 1 ] == '/' );
-	for ( res = ns->resources ; *res ; res++ ) {
-		if ( strcmp ( (*res)->uri, ( uri + len ) ) == 0 )
-			return *res;
+	return res;
+}
+
+/**
+ * Find resources by resource type
+ *
+ * @v rt		Resource type
+ * @v count		Number of matching resources to fill in
+ * @ret res		First matching resource type index entry
+ *
+ * Matching resources occupy a contiguous range of the resource type
+ * index, sorted by URI.
+ */
+struct resource ** resource_find_type ( const char *rt,
+					unsigned int *count ) {
+	unsigned int lower = 0;
+	unsigned int upper = resource_type_count;
+	unsigned int first;
+	unsigned int mid;
+
+	/* Binary search for first matching entry */
+	while ( lower < upper ) {
+		mid = ( lower + ( ( upper - lower ) / 2 ) );
+		if ( strcmp ( resource_type_index[mid]->desc->rt, rt ) < 0 ) {
+			lower = ( mid + 1 );
+		} else {
+			upper = mid;
+		}
+	}
+	first = lower;
+
+	/* Binary search for first following entry */
+	upper = resource_type_count;
+	while ( lower < upper ) {
+		mid = ( lower + ( ( upper - lower ) / 2 ) );
+		if ( strcmp ( resource_type_index[mid]->desc->rt, rt ) <= 0 ) {
+			lower = ( mid + 1 );
+		} else {
+			upper = mid;
+		}
 	}
 
-	return NULL;
+	*count = ( lower - first );
+	return &resource_type_index[first];
 }
 
 /**
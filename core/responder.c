@@ -0,0 +1,901 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Multicast discovery responder
+ *
+ * A responder listens for discovery queries sent to a multicast
+ * group, of the form
+ *
+ *     /oic/res?href=<uri-pattern>&rt=<resource-type>&if=<interface>
+ *
+ * and answers with a unicast datagram containing the links for all
+ * matching resources.  Queries matching no resources are not
+ * answered.  To avoid a burst of simultaneous responses from many
+ * devices, each response is delayed by a random jitter.  Repeated
+ * copies of a query (e.g. retransmissions) from the same requester
+ * are answered only once.
+ *
+ * Several responders may serve disjoint parts of the resource tree
+ * within a single process, each behaving as an independent device.
+ * Responders hold the resource index lock while scanning the index,
+ * and so never see a resource that has been unregistered.  A
+ * responder serving a single namespace is stopped when that
+ * namespace is unregistered.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <uniport/responder.h>
+#include <uniport/discovery.h>
+#include <uniport/interface.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/string.h>
+#include <uniport/timer.h>
+
+/** Interval at which an idle responder checks for being stopped */
+#define RESPONDER_IDLE_MS 100
+
+/** Maximum number of responses recorded by "discover" */
+#define DISCOVER_MAX_RESPONSES 4096
+
+/** List of running responders */
+static LIST_HEAD ( responders );
+
+/** A parsed discovery query */
+struct responder_query {
+	/** Resource URI pattern, or NULL */
+	const char *href;
+	/** Resource type, or NULL */
+	const char *rt;
+	/** Interface, or NULL */
+	struct interface *intf;
+};
+
+/**
+ * Parse discovery query
+ *
+ * @v string		Query string (will be modified)
+ * @v query		Parsed query to fill in
+ * @ret rc		Return status code
+ */
+static int responder_parse ( char *string, struct responder_query *query ) {
+	char *param;
+	char *value;
+	char *next;
+
+	/* Initialise query */
+	query->href = NULL;
+	query->rt = NULL;
+	query->intf = NULL;
+
+	/* Check and strip discovery URI, if present */
+	param = strchr ( string, '?' );
+	if ( param ) {
+		*param = '\0';
+		if ( strcmp ( string, "/oic/res" ) != 0 )
+			return -ENOENT;
+		string = ( param + 1 );
+	}
+
+	/* Parse parameters */
+	for ( param = string ; param ; param = next ) {
+		next = strchr ( param, '&' );
+		if ( next )
+			*(next++) = '\0';
+		value = strchr ( param, '=' );
+		if ( ! value )
+			continue;
+		*(value++) = '\0';
+		if ( strcmp ( param, "href" ) == 0 ) {
+			query->href = value;
+		} else if ( strcmp ( param, "rt" ) == 0 ) {
+			query->rt = value;
+		} else if ( strcmp ( param, "if" ) == 0 ) {
+			query->intf = interface_find ( value );
+			if ( ! query->intf )
+				return -ENOENT;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Construct discovery response
+ *
+ * @v resp		Responder
+ * @v query		Parsed query
+ * @v buf		Response buffer, or NULL to check for any match
+ * @v len		Length of response buffer
+ * @ret len		Length of response (or non-zero if any match)
+ *
+ * Only resources of the query's resource type (if any) within the
+ * range matching the longer of the literal prefixes of the
+ * responder's pattern and the query's URI pattern are scanned.
+ * Links that do not fit within the buffer are omitted.
+ */
+static size_t responder_answer ( struct responder *resp,
+				 struct responder_query *query,
+				 char *buf, size_t len ) {
+	const char *range = resp->pattern;
+	size_t prefix_len = glob_prefix_len ( range );
+	struct resource **candidates;
+	struct resource *res;
+	unsigned int count;
+	size_t link_len;
+	size_t used = 0;
+	size_t start;
+	unsigned int i;
+	int diff;
+
+	/* Choose the narrower index range */
+	if ( query->href &&
+	     ( glob_prefix_len ( query->href ) > prefix_len ) ) {
+		range = query->href;
+		prefix_len = glob_prefix_len ( range );
+	}
+
+	/* Choose candidate resources (sorted by URI) */
+	resource_index_lock();
+	if ( query->rt ) {
+		candidates = resource_find_type ( query->rt, &count );
+	} else {
+		i = resource_index_lower ( range, prefix_len );
+		candidates = &resource_index[i];
+		count = ( resource_index_count - i );
+	}
+
+	for ( i = 0 ; i < count ; i++ ) {
+
+		/* Stop at end of matching prefix range */
+		res = candidates[i];
+		diff = resource_uri_ncmp ( res, range, prefix_len );
+		if ( diff < 0 )
+			continue;
+		if ( diff > 0 )
+			break;
+
+		/* Apply filters */
+		if ( ! resource_uri_match ( res, resp->pattern ) )
+			continue;
+		if ( query->href && ! resource_uri_match ( res, query->href ) )
+			continue;
+		if ( query->intf &&
+		     ! discovery_has_interface ( res, query->intf ) )
+			continue;
+
+		/* Stop at first match if only checking for a match */
+		if ( ! buf ) {
+			used = 1;
+			break;
+		}
+
+		/* Append link, if it fits */
+		start = used;
+		if ( used )
+			buf[used++] = ',';
+		link_len = discovery_link ( res, ( buf + used ),
+					    ( len - used ) );
+		if ( ( used + link_len ) >= len ) {
+			used = start;
+			resp->stats.truncated++;
+			break;
+		}
+		used += link_len;
+	}
+	resource_index_unlock();
+
+	return used;
+}
+
+/**
+ * Calculate query hash
+ *
+ * @v query		Query string
+ * @ret hash		Hash (FNV-1a)
+ */
+static uint32_t responder_hash ( const char *query ) {
+
+	return fnv_hash ( FNV_OFFSET_BASIS, query, strlen ( query ) );
+}
+
+/**
+ * Check for (and record) recently answered query
+ *
+ * @v resp		Responder
+ * @v peer		Requester address
+ * @v hash		Query hash
+ * @v now		Current time
+ * @ret repeated	Query is a repeat of a recently answered query
+ */
+static int responder_repeated ( struct responder *resp,
+				struct sockaddr_in *peer, uint32_t hash,
+				unsigned long now ) {
+	struct responder_recent *recent;
+	unsigned int i;
+
+	/* Check for a matching recent query */
+	for ( i = 0 ; i < RESPONDER_RECENT ; i++ ) {
+		recent = &resp->recent[i];
+		if ( ( recent->hash == hash ) &&
+		     ( recent->peer.sin_addr.s_addr ==
+		       peer->sin_addr.s_addr ) &&
+		     ( recent->peer.sin_port == peer->sin_port ) &&
+		     ( ( now - recent->time ) <
+		       ( RESPONDER_RECENT_MS * TICKS_PER_MS ) ) ) {
+			return 1;
+		}
+	}
+
+	/* Record query, replacing the oldest entry */
+	recent = &resp->recent[ resp->next_recent++ % RESPONDER_RECENT ];
+	memcpy ( &recent->peer, peer, sizeof ( recent->peer ) );
+	recent->time = now;
+	recent->hash = hash;
+
+	return 0;
+}
+
+/**
+ * Receive discovery query
+ *
+ * @v resp		Responder
+ */
+static void responder_receive ( struct responder *resp ) {
+	struct responder_pending *pending;
+	struct responder_query query;
+	struct sockaddr_in peer;
+	socklen_t peer_len = sizeof ( peer );
+	char buf[RESPONDER_QUERY_LEN];
+	char copy[RESPONDER_QUERY_LEN];
+	unsigned long now;
+	ssize_t len;
+
+	/* Receive query */
+	len = recvfrom ( resp->fd, buf, ( sizeof ( buf ) - 1 /* NUL */ ), 0,
+			 ( struct sockaddr * ) &peer, &peer_len );
+	if ( len < 0 )
+		return;
+	buf[len] = '\0';
+	now = currticks();
+	resp->stats.queries++;
+
+	/* Suppress repeated queries */
+	if ( responder_repeated ( resp, &peer, responder_hash ( buf ), now ) ) {
+		resp->stats.suppressed++;
+		return;
+	}
+
+	/* Ignore queries that match no resources */
+	memcpy ( copy, buf, ( len + 1 /* NUL */ ) );
+	if ( ( responder_parse ( copy, &query ) != 0 ) ||
+	     ( ! responder_answer ( resp, &query, NULL, 0 ) ) ) {
+		resp->stats.unmatched++;
+		return;
+	}
+
+	/* Queue response after a random delay */
+	if ( resp->num_pending >= RESPONDER_PENDING ) {
+		resp->stats.dropped++;
+		return;
+	}
+	pending = &resp->pending[ resp->num_pending++ ];
+	memcpy ( &pending->peer, &peer, sizeof ( pending->peer ) );
+	memcpy ( pending->query, buf, ( len + 1 /* NUL */ ) );
+	pending->due = ( now + ( resp->jitter ?
+				 ( rand_r ( &resp->seed ) % resp->jitter ) :
+				 0 ) );
+}
+
+/**
+ * Send discovery response
+ *
+ * @v resp		Responder
+ * @v pending		Queued response
+ * @v buf		Response
+ * @v len		Length of response
+ * @ret rc		Return status code
+ */
+static int responder_reply ( struct responder *resp,
+			     struct responder_pending *pending,
+			     const char *buf, size_t len ) {
+	struct sockaddr *peer = ( ( struct sockaddr * ) &pending->peer );
+
+	if ( sendto ( resp->fd, buf, len, 0, peer,
+		      sizeof ( pending->peer ) ) < 0 ) {
+		return -errno;
+	}
+	return 0;
+}
+
+/**
+ * Send any due discovery responses
+ *
+ * @v resp		Responder
+ * @v now		Current time
+ * @ret timeout		Time until next response is due (in ticks)
+ */
+static unsigned long responder_send ( struct responder *resp,
+				      unsigned long now ) {
+	struct responder_pending *pending;
+	struct responder_query query;
+	char buf[RESPONDER_RESPONSE_LEN];
+	unsigned long timeout = ( RESPONDER_IDLE_MS * TICKS_PER_MS );
+	unsigned int i = 0;
+	size_t len;
+
+	while ( i < resp->num_pending ) {
+
+		/* Skip responses that are not yet due */
+		pending = &resp->pending[i];
+		if ( ( ( long ) ( pending->due - now ) ) > 0 ) {
+			if ( ( pending->due - now ) < timeout )
+				timeout = ( pending->due - now );
+			i++;
+			continue;
+		}
+
+		/* Construct and send response */
+		if ( responder_parse ( pending->query, &query ) == 0 ) {
+			len = responder_answer ( resp, &query, buf,
+						 sizeof ( buf ) );
+			if ( len && ( responder_reply ( resp, pending, buf,
+							len ) == 0 ) ) {
+				resp->stats.responses++;
+			}
+		}
+
+		/* Remove from queue */
+		memcpy ( pending, &resp->pending[ --resp->num_pending ],
+			 sizeof ( *pending ) );
+	}
+
+	return timeout;
+}
+
+/**
+ * Run discovery responder
+ *
+ * @v arg		Responder
+ * @ret result		Result (unused)
+ */
+static void * responder_thread ( void *arg ) {
+	struct responder *resp = arg;
+	struct pollfd pfd;
+	unsigned long timeout;
+
+	pfd.fd = resp->fd;
+	pfd.events = POLLIN;
+	while ( resp->running ) {
+
+		/* Send any due responses */
+		timeout = responder_send ( resp, currticks() );
+
+		/* Wait for a query or for the next response to fall due */
+		if ( poll ( &pfd, 1, ( ( timeout + TICKS_PER_MS - 1 ) /
+				       TICKS_PER_MS ) ) > 0 ) {
+			responder_receive ( resp );
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Start discovery responder
+ *
+ * @v resp		Responder
+ * @ret rc		Return status code
+ */
+int responder_start ( struct responder *resp ) {
+	struct sockaddr_in addr;
+	struct ip_mreq mreq;
+	int one = 1;
+	int rc;
+
+	/* Open socket */
+	resp->fd = socket ( AF_INET, SOCK_DGRAM, 0 );
+	if ( resp->fd < 0 ) {
+		rc = -errno;
+		goto err_socket;
+	}
+
+	/* Allow several responders to share the discovery port */
+	if ( setsockopt ( resp->fd, SOL_SOCKET, SO_REUSEADDR, &one,
+			  sizeof ( one ) ) != 0 ) {
+		rc = -errno;
+		goto err_reuse;
+	}
+
+	/* Bind to discovery port */
+	memset ( &addr, 0, sizeof ( addr ) );
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl ( INADDR_ANY );
+	addr.sin_port = htons ( resp->port );
+	if ( bind ( resp->fd, ( struct sockaddr * ) &addr,
+		    sizeof ( addr ) ) != 0 ) {
+		rc = -errno;
+		goto err_bind;
+	}
+
+	/* Join multicast group */
+	memcpy ( &mreq.imr_multiaddr, &resp->group,
+		 sizeof ( mreq.imr_multiaddr ) );
+	memcpy ( &mreq.imr_interface, &resp->local,
+		 sizeof ( mreq.imr_interface ) );
+	if ( setsockopt ( resp->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+			  sizeof ( mreq ) ) != 0 ) {
+		rc = -errno;
+		goto err_join;
+	}
+
+	/* Start responder thread */
+	resp->seed ^= ( currticks() ^ ( ( intptr_t ) resp ) );
+	resp->num_pending = 0;
+	memset ( resp->recent, 0, sizeof ( resp->recent ) );
+	memset ( &resp->stats, 0, sizeof ( resp->stats ) );
+	resp->running = 1;
+	if ( ( rc = pthread_create ( &resp->thread, NULL, responder_thread,
+				     resp ) ) != 0 ) {
+		rc = -rc;
+		goto err_thread;
+	}
+
+	/* Add to list of responders */
+	list_add_tail ( &resp->list, &responders );
+
+	return 0;
+
+ err_thread:
+	resp->running = 0;
+ err_join:
+ err_bind:
+ err_reuse:
+	close ( resp->fd );
+ err_socket:
+	return rc;
+}
+
+/**
+ * Stop discovery responder
+ *
+ * @v resp		Responder
+ */
+void responder_stop ( struct responder *resp ) {
+
+	/* Stop responder thread */
+	resp->running = 0;
+	pthread_join ( resp->thread, NULL );
+
+	/* Close socket */
+	close ( resp->fd );
+
+	/* Remove from list of responders */
+	list_del ( &resp->list );
+}
+
+/*****************************************************************************
+ *
+ * Command line interface
+ *
+ *****************************************************************************
+ */
+
+/**
+ * Stop and free discovery responder
+ *
+ * @v resp		Responder
+ */
+static void responder_destroy ( struct responder *resp ) {
+
+	responder_stop ( resp );
+	free ( resp );
+}
+
+/**
+ * Stop responders serving a namespace
+ *
+ * @v ns		Resource namespace
+ *
+ * Any responder started for this namespace alone (e.g. via "respond
+ * -e") is stopped.  Other responders need no action, since the
+ * namespace's resources are removed from the index under the index
+ * lock.
+ */
+static void responder_forget ( struct namespace *ns ) {
+	struct responder *resp;
+	struct responder *tmp;
+
+	list_for_each_entry_safe ( resp, tmp, &responders, list ) {
+		if ( resp->ns == ns )
+			responder_destroy ( resp );
+	}
+}
+
+/** Discovery responder namespace removal hook */
+struct namespace_hook responder_namespace_hook __namespace_hook = {
+	.forget = responder_forget,
+};
+
+/**
+ * Create discovery responder
+ *
+ * @v pattern		Resource URI pattern
+ * @v pattern_len	Length of resource URI pattern
+ * @v template		Responder template
+ * @ret rc		Return status code
+ */
+static int responder_create ( const char *pattern, size_t pattern_len,
+			      struct responder *template ) {
+	struct responder *resp;
+	int rc;
+
+	/* Allocate and initialise responder */
+	resp = malloc ( sizeof ( *resp ) + pattern_len + 1 /* NUL */ );
+	if ( ! resp ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	memcpy ( resp, template, sizeof ( *resp ) );
+	resp->pattern = ( ( ( void * ) resp ) + sizeof ( *resp ) );
+	format_string ( resp->pattern, ( pattern_len + 1 /* NUL */ ),
+			pattern, pattern_len );
+
+	/* Start responder */
+	if ( ( rc = responder_start ( resp ) ) != 0 ) {
+		cprintf ( "Could not start responder for %s: %s\n",
+			  resp->pattern, strerror ( rc ) );
+		goto err_start;
+	}
+
+	return 0;
+
+ err_start:
+	free ( resp );
+ err_alloc:
+	return rc;
+}
+
+/** "respond" options */
+struct respond_options {
+	/** Multicast group */
+	struct in_addr group;
+	/** Local interface address */
+	struct in_addr local;
+	/** Port */
+	unsigned int port;
+	/** Maximum response jitter (in milliseconds) */
+	unsigned int jitter;
+	/** Start one responder per namespace */
+	int each;
+	/** Show statistics */
+	int stats;
+	/** Stop all responders */
+	int stop;
+};
+
+/** "respond" option list */
+static struct option_descriptor respond_opts[] = {
+	OPTION_DESC ( "group", 'g', required_argument,
+		      struct respond_options, group, parse_address ),
+	OPTION_DESC ( "local", 'l', required_argument,
+		      struct respond_options, local, parse_address ),
+	OPTION_DESC ( "port", 'p', required_argument,
+		      struct respond_options, port, parse_integer ),
+	OPTION_DESC ( "jitter", 'j', required_argument,
+		      struct respond_options, jitter, parse_integer ),
+	OPTION_DESC ( "each", 'e', no_argument,
+		      struct respond_options, each, parse_flag ),
+	OPTION_DESC ( "stats", 's', no_argument,
+		      struct respond_options, stats, parse_flag ),
+	OPTION_DESC ( "stop", 'd', no_argument,
+		      struct respond_options, stop, parse_flag ),
+};
+
+/** "respond" command descriptor */
+static struct command_descriptor respond_cmd =
+	COMMAND_DESC ( struct respond_options, respond_opts, 0, 1,
+		       "[<uri-pattern>]" );
+
+/**
+ * "respond" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int respond_exec ( int argc, char **argv ) {
+	struct respond_options opts;
+	struct responder template;
+	struct responder *resp;
+	struct responder *tmp;
+	struct namespace *ns;
+	const char *match;
+	char pattern[RESPONDER_QUERY_LEN];
+	unsigned int created = 0;
+	size_t len;
+	int rc;
+
+	/* Parse options, with defaults */
+	memset ( &opts, 0, sizeof ( opts ) );
+	inet_aton ( RESPONDER_GROUP, &opts.group );
+	opts.port = RESPONDER_PORT;
+	opts.jitter = RESPONDER_JITTER_MS;
+	if ( ( rc = reparse_options ( argc, argv, &respond_cmd,
+				      &opts ) ) != 0 )
+		return rc;
+
+	/* Show statistics, if applicable */
+	if ( opts.stats ) {
+		list_for_each_entry ( resp, &responders, list ) {
+			cprintf ( "%s: queries=%lu suppressed=%lu "
+				  "unmatched=%lu dropped=%lu responses=%lu "
+				  "truncated=%lu\n",
+				  resp->pattern, resp->stats.queries,
+				  resp->stats.suppressed, resp->stats.unmatched,
+				  resp->stats.dropped, resp->stats.responses,
+				  resp->stats.truncated );
+		}
+		return 0;
+	}
+
+	/* Stop all responders, if applicable */
+	if ( opts.stop ) {
+		list_for_each_entry ( resp, &responders, list )
+			resp->running = 0;
+		list_for_each_entry_safe ( resp, tmp, &responders, list )
+			responder_destroy ( resp );
+		return 0;
+	}
+
+	/* Construct responder template */
+	memset ( &template, 0, sizeof ( template ) );
+	template.group = opts.group;
+	template.local = opts.local;
+	template.port = opts.port;
+	template.jitter = ( opts.jitter * TICKS_PER_MS );
+
+	/* Start a single responder for all matching resources */
+	if ( ! opts.each ) {
+		match = ( ( optind < argc ) ? argv[optind] : "*" );
+		return responder_create ( match, strlen ( match ), &template );
+	}
+
+	/* Start one responder per matching namespace */
+	list_for_each_entry ( ns, &namespaces, list ) {
+		if ( ( optind < argc ) &&
+		     ( ! glob_match ( argv[optind], ns->uri ) ) )
+			continue;
+		len = strlen ( ns->uri );
+		if ( ( len + 2 /* "*" and NUL */ ) > sizeof ( pattern ) )
+			continue;
+		memcpy ( pattern, ns->uri, len );
+		pattern[len++] = '*';
+		pattern[len] = '\0';
+		template.ns = ns;
+		if ( ( rc = responder_create ( pattern, len,
+					       &template ) ) != 0 )
+			goto err_create;
+		created++;
+	}
+
+	return 0;
+
+ err_create:
+	/* Stop any responders started by this command */
+	while ( created-- ) {
+		resp = list_last_entry ( &responders, struct responder, list );
+		responder_destroy ( resp );
+	}
+	return rc;
+}
+
+/** "respond" command */
+struct command respond_command __command = {
+	.name = "respond",
+	.exec = respond_exec,
+};
+
+/** "discover" options */
+struct discover_options {
+	/** Multicast group */
+	struct in_addr group;
+	/** Local interface address */
+	struct in_addr local;
+	/** Port */
+	unsigned int port;
+	/** Time to wait for responses (in milliseconds) */
+	unsigned int wait;
+	/** Number of copies of query to send */
+	unsigned int repeat;
+	/** Print responses */
+	int verbose;
+};
+
+/** "discover" option list */
+static struct option_descriptor discover_opts[] = {
+	OPTION_DESC ( "group", 'g', required_argument,
+		      struct discover_options, group, parse_address ),
+	OPTION_DESC ( "local", 'l', required_argument,
+		      struct discover_options, local, parse_address ),
+	OPTION_DESC ( "port", 'p', required_argument,
+		      struct discover_options, port, parse_integer ),
+	OPTION_DESC ( "wait", 'w', required_argument,
+		      struct discover_options, wait, parse_integer ),
+	OPTION_DESC ( "repeat", 'r', required_argument,
+		      struct discover_options, repeat, parse_integer ),
+	OPTION_DESC ( "verbose", 'v', no_argument,
+		      struct discover_options, verbose, parse_flag ),
+};
+
+/** "discover" command descriptor */
+static struct command_descriptor discover_cmd =
+	COMMAND_DESC ( struct discover_options, discover_opts, 0, 1,
+		       "[<query>]" );
+
+/**
+ * Compare response latencies
+ *
+ * @v a			Latency
+ * @v b			Latency
+ * @ret diff		Difference
+ */
+static int discover_cmp ( const void *a, const void *b ) {
+	const unsigned long *x = a;
+	const unsigned long *y = b;
+
+	return ( ( *x > *y ) - ( *x < *y ) );
+}
+
+/**
+ * "discover" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int discover_exec ( int argc, char **argv ) {
+	struct discover_options opts;
+	struct sockaddr_in addr;
+	struct pollfd pfd;
+	const char *query;
+	char buf[ RESPONDER_RESPONSE_LEN + 1 /* NUL */ ];
+	unsigned long *latency;
+	unsigned long started;
+	unsigned long elapsed;
+	unsigned long links = 0;
+	unsigned int timeout;
+	unsigned int count = 0;
+	unsigned int i;
+	unsigned char loop = 1;
+	ssize_t len;
+	int fd;
+	int rc;
+
+	/* Parse options, with defaults */
+	memset ( &opts, 0, sizeof ( opts ) );
+	inet_aton ( RESPONDER_GROUP, &opts.group );
+	opts.port = RESPONDER_PORT;
+	opts.wait = 1000;
+	opts.repeat = 1;
+	if ( ( rc = reparse_options ( argc, argv, &discover_cmd,
+				      &opts ) ) != 0 )
+		goto err_parse;
+	query = ( ( optind < argc ) ? argv[optind] : "/oic/res" );
+
+	/* Allocate latency records */
+	latency = malloc ( DISCOVER_MAX_RESPONSES * sizeof ( latency[0] ) );
+	if ( ! latency ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+
+	/* Open socket */
+	fd = socket ( AF_INET, SOCK_DGRAM, 0 );
+	if ( fd < 0 ) {
+		rc = -errno;
+		goto err_socket;
+	}
+	if ( ( setsockopt ( fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop,
+			    sizeof ( loop ) ) != 0 ) ||
+	     ( opts.local.s_addr &&
+	       ( setsockopt ( fd, IPPROTO_IP, IP_MULTICAST_IF, &opts.local,
+			      sizeof ( opts.local ) ) != 0 ) ) ) {
+		rc = -errno;
+		goto err_setsockopt;
+	}
+
+	/* Send query */
+	memset ( &addr, 0, sizeof ( addr ) );
+	addr.sin_family = AF_INET;
+	addr.sin_addr = opts.group;
+	addr.sin_port = htons ( opts.port );
+	started = currticks();
+	for ( i = 0 ; i < opts.repeat ; i++ ) {
+		if ( sendto ( fd, query, strlen ( query ), 0,
+			      ( struct sockaddr * ) &addr,
+			      sizeof ( addr ) ) < 0 ) {
+			rc = -errno;
+			cprintf ( "Could not send query: %s\n",
+				  strerror ( errno ) );
+			goto err_sendto;
+		}
+	}
+
+	/* Collect responses */
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while ( ( elapsed = ( currticks() - started ) ) <
+		( opts.wait * TICKS_PER_MS ) ) {
+		timeout = ( opts.wait - ( elapsed / TICKS_PER_MS ) );
+		if ( poll ( &pfd, 1, timeout ) <= 0 )
+			continue;
+		len = recv ( fd, buf, ( sizeof ( buf ) - 1 /* NUL */ ), 0 );
+		if ( len <= 0 )
+			continue;
+		buf[len] = '\0';
+		if ( count < DISCOVER_MAX_RESPONSES )
+			latency[count++] = ( currticks() - started );
+		for ( i = 0 ; i < ( ( size_t ) len ) ; i++ )
+			links += ( buf[i] == '<' );
+		if ( opts.verbose )
+			cprintf ( "%s\n", buf );
+	}
+
+	/* Report latency distribution */
+	cprintf ( "%u responses, %lu links", count, links );
+	if ( count ) {
+		qsort ( latency, count, sizeof ( latency[0] ), discover_cmp );
+		cprintf ( ", latency min/50%%/90%%/99%%/max = "
+			  "%lu/%lu/%lu/%lu/%lums",
+			  ( latency[0] / TICKS_PER_MS ),
+			  ( latency[ count / 2 ] / TICKS_PER_MS ),
+			  ( latency[ ( count * 9 ) / 10 ] / TICKS_PER_MS ),
+			  ( latency[ ( count * 99 ) / 100 ] / TICKS_PER_MS ),
+			  ( latency[ count - 1 ] / TICKS_PER_MS ) );
+	}
+	cprintf ( "\n" );
+	rc = 0;
+
+ err_sendto:
+ err_setsockopt:
+	close ( fd );
+ err_socket:
+	free ( latency );
+ err_alloc:
+ err_parse:
+	return rc;
+}
+
+/** "discover" command */
+struct command discover_command __command = {
+	.name = "discover",
+	.exec = discover_exec,
+};
@@ -0,0 +1,830 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Rule engine
+ *
+ * A rule observes a trigger resource and updates a target resource
+ * whenever a condition on the trigger's properties becomes true, for
+ * example
+ *
+ *     rule off /b/left value /o/power value=false
+ *
+ * Conditions compare boolean, integer, fixed-point and temperature
+ * unit properties against literal values using "==", "!=", "<", "<=",
+ * ">" and ">=", and combine comparisons using "!", "&&", "||" and
+ * parentheses.  A bare property name tests for a non-zero value.
+ *
+ * Conditions are compiled to a small stack-based bytecode when the
+ * rule is defined.  Literal values are parsed using the property's
+ * own parser, and so may use any syntax accepted for the property
+ * (e.g. "true" or "21.5").  The action's property values are also
+ * parsed when the rule is defined.  Handling a notification therefore
+ * requires neither parsing nor allocation.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <uniport/rule.h>
+#include <uniport/temperature.h>
+#include <uniport/interface.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+
+/** Maximum length of a property name or literal within a condition */
+#define RULE_WORD_LEN 32
+
+/** A rule condition compiler */
+struct rule_compiler {
+	/** Rule */
+	struct rule *rule;
+	/** Trigger resource */
+	struct resource *res;
+	/** Scratch resource state used for parsing literal values */
+	void *scratch;
+	/** Current position within condition */
+	const char *pos;
+	/** Current evaluation stack depth */
+	unsigned int depth;
+};
+
+/** Rule comparison operators */
+static const struct {
+	/** Operator */
+	const char *text;
+	/** Opcode */
+	uint8_t opcode;
+} rule_comparisons[] = {
+	/* Longer operators must precede their prefixes */
+	{ "==", RULE_EQ },
+	{ "!=", RULE_NE },
+	{ "<=", RULE_LE },
+	{ ">=", RULE_GE },
+	{ "<", RULE_LT },
+	{ ">", RULE_GT },
+};
+
+/** List of rules */
+static LIST_HEAD ( rules );
+
+/**
+ * Load property value
+ *
+ * @v opcode		Load opcode
+ * @v state		Resource state
+ * @v offset		Offset of property within resource state
+ * @ret value		Property value
+ */
+static inline __attribute__ (( always_inline )) int
+rule_load ( uint8_t opcode, const uint8_t *state, uint16_t offset ) {
+
+	if ( opcode == RULE_LOAD_BOOL )
+		return *( ( const bool * ) ( state + offset ) );
+	return *( ( const int * ) ( state + offset ) );
+}
+
+/**
+ * Evaluate compiled condition
+ *
+ * @v code		Compiled condition
+ * @v state		Trigger resource state
+ * @ret match		Condition is true
+ */
+static int rule_evaluate ( const uint8_t *code, const void *state ) {
+	int stack[RULE_STACK];
+	int *sp = stack;
+	uint16_t offset;
+	uint8_t opcode;
+	int value;
+
+	while ( 1 ) {
+		switch ( ( opcode = *(code++) ) ) {
+		case RULE_LOAD_BOOL:
+		case RULE_LOAD_INT:
+			memcpy ( &offset, code, sizeof ( offset ) );
+			code += sizeof ( offset );
+			*(sp++) = rule_load ( opcode, state, offset );
+			break;
+		case RULE_CONST:
+			memcpy ( &value, code, sizeof ( value ) );
+			code += sizeof ( value );
+			*(sp++) = value;
+			break;
+		case RULE_EQ:
+			sp--;
+			sp[-1] = ( sp[-1] == sp[0] );
+			break;
+		case RULE_NE:
+			sp--;
+			sp[-1] = ( sp[-1] != sp[0] );
+			break;
+		case RULE_LT:
+			sp--;
+			sp[-1] = ( sp[-1] < sp[0] );
+			break;
+		case RULE_LE:
+			sp--;
+			sp[-1] = ( sp[-1] <= sp[0] );
+			break;
+		case RULE_GT:
+			sp--;
+			sp[-1] = ( sp[-1] > sp[0] );
+			break;
+		case RULE_GE:
+			sp--;
+			sp[-1] = ( sp[-1] >= sp[0] );
+			break;
+		case RULE_NOT:
+			sp[-1] = ( ! sp[-1] );
+			break;
+		case RULE_AND:
+			sp--;
+			sp[-1] = ( sp[-1] && sp[0] );
+			break;
+		case RULE_OR:
+			sp--;
+			sp[-1] = ( sp[-1] || sp[0] );
+			break;
+		default:
+			return ( stack[0] != 0 );
+		}
+	}
+}
+
+/**
+ * Emit bytecode
+ *
+ * @v comp		Compiler
+ * @v opcode		Opcode
+ * @v operand		Operand, if any
+ * @v len		Length of operand
+ * @v pushed		Net number of values pushed onto evaluation stack
+ * @ret rc		Return status code
+ */
+static int rule_emit ( struct rule_compiler *comp, uint8_t opcode,
+		       const void *operand, size_t len, int pushed ) {
+	struct rule *rule = comp->rule;
+
+	/* Check for space, leaving room for the final RULE_END */
+	if ( ( rule->len + 1 /* opcode */ + len ) >= RULE_CODE_LEN ) {
+		cprintf ( "Condition too long\n" );
+		return -E2BIG;
+	}
+
+	/* Check evaluation stack depth */
+	comp->depth += pushed;
+	if ( comp->depth > RULE_STACK ) {
+		cprintf ( "Condition too deeply nested\n" );
+		return -E2BIG;
+	}
+
+	/* Append bytecode */
+	rule->code[rule->len++] = opcode;
+	memcpy ( &rule->code[rule->len], operand, len );
+	rule->len += len;
+
+	return 0;
+}
+
+/**
+ * Skip whitespace within condition
+ *
+ * @v comp		Compiler
+ */
+static void rule_skip ( struct rule_compiler *comp ) {
+
+	while ( isspace ( *( ( const unsigned char * ) comp->pos ) ) )
+		comp->pos++;
+}
+
+/**
+ * Accept token within condition
+ *
+ * @v comp		Compiler
+ * @v token		Token
+ * @ret accepted	Token was present (and has been consumed)
+ */
+static int rule_accept ( struct rule_compiler *comp, const char *token ) {
+	size_t len = strlen ( token );
+
+	rule_skip ( comp );
+	if ( strncmp ( comp->pos, token, len ) != 0 )
+		return 0;
+	comp->pos += len;
+	return 1;
+}
+
+/**
+ * Report syntax error within condition
+ *
+ * @v comp		Compiler
+ * @ret rc		Return status code
+ */
+static int rule_syntax ( struct rule_compiler *comp ) {
+
+	cprintf ( "Invalid condition at \"%s\"\n", comp->pos );
+	return -EINVAL;
+}
+
+/**
+ * Parse word (property name or literal value) within condition
+ *
+ * @v comp		Compiler
+ * @v buf		Buffer
+ * @v len		Length of buffer
+ * @ret rc		Return status code
+ */
+static int rule_word ( struct rule_compiler *comp, char *buf, size_t len ) {
+	size_t used = 0;
+
+	rule_skip ( comp );
+	while ( *comp->pos &&
+		( ! isspace ( *( ( const unsigned char * ) comp->pos ) ) ) &&
+		( ! strchr ( "()!&|<>=", *comp->pos ) ) ) {
+		if ( ( used + 1 /* NUL */ ) >= len )
+			return rule_syntax ( comp );
+		buf[used++] = *(comp->pos++);
+	}
+	buf[used] = '\0';
+
+	return ( used ? 0 : rule_syntax ( comp ) );
+}
+
+static int rule_or ( struct rule_compiler *comp );
+
+/**
+ * Compile comparison
+ *
+ * @v comp		Compiler
+ * @ret rc		Return status code
+ */
+static int rule_compare ( struct rule_compiler *comp ) {
+	struct property *prop;
+	char name[RULE_WORD_LEN];
+	char literal[RULE_WORD_LEN];
+	uint16_t offset;
+	uint8_t load;
+	unsigned int i;
+	int value;
+	int rc;
+
+	/* Parse property name */
+	if ( ( rc = rule_word ( comp, name, sizeof ( name ) ) ) != 0 )
+		return rc;
+	prop = resource_property ( comp->res, name );
+	if ( ! prop ) {
+		cprintf ( "\"%s\": no such property\n", name );
+		return -ENOENT;
+	}
+	if ( prop->type == &boolean_property ) {
+		load = RULE_LOAD_BOOL;
+	} else if ( ( prop->type == &integer_property ) ||
+		    ( prop->type == &fixed_property ) ||
+		    ( prop->type == &temperature_units_property ) ) {
+		load = RULE_LOAD_INT;
+	} else {
+		cprintf ( "\"%s\": cannot compare %s properties\n",
+			  name, prop->type->name );
+		return -ENOTSUP;
+	}
+	offset = prop->offset;
+	if ( offset != prop->offset )
+		return -ERANGE;
+
+	/* Load property value */
+	if ( ( rc = rule_emit ( comp, load, &offset, sizeof ( offset ),
+				1 ) ) != 0 )
+		return rc;
+
+	/* Compile comparison, if present */
+	for ( i = 0 ; i < ( sizeof ( rule_comparisons ) /
+			    sizeof ( rule_comparisons[0] ) ) ; i++ ) {
+		if ( ! rule_accept ( comp, rule_comparisons[i].text ) )
+			continue;
+
+		/* Parse literal value using property's own parser */
+		if ( ( rc = rule_word ( comp, literal,
+					sizeof ( literal ) ) ) != 0 )
+			return rc;
+		if ( ( rc = property_parse ( prop, literal,
+					     comp->scratch ) ) != 0 ) {
+			cprintf ( "\"%s\": %s\n", literal, strerror ( rc ) );
+			return rc;
+		}
+		value = rule_load ( load, comp->scratch, offset );
+
+		/* Compare against constant value */
+		if ( ( rc = rule_emit ( comp, RULE_CONST, &value,
+					sizeof ( value ), 1 ) ) != 0 )
+			return rc;
+		return rule_emit ( comp, rule_comparisons[i].opcode,
+				   NULL, 0, -1 );
+	}
+
+	return 0;
+}
+
+/**
+ * Compile negation, parenthesised condition, or comparison
+ *
+ * @v comp		Compiler
+ * @ret rc		Return status code
+ */
+static int rule_not ( struct rule_compiler *comp ) {
+	int rc;
+
+	/* Compile negation */
+	if ( rule_accept ( comp, "!" ) ) {
+		if ( ( rc = rule_not ( comp ) ) != 0 )
+			return rc;
+		return rule_emit ( comp, RULE_NOT, NULL, 0, 0 );
+	}
+
+	/* Compile parenthesised condition */
+	if ( rule_accept ( comp, "(" ) ) {
+		if ( ( rc = rule_or ( comp ) ) != 0 )
+			return rc;
+		if ( ! rule_accept ( comp, ")" ) )
+			return rule_syntax ( comp );
+		return 0;
+	}
+
+	/* Compile comparison */
+	return rule_compare ( comp );
+}
+
+/**
+ * Compile conjunction
+ *
+ * @v comp		Compiler
+ * @ret rc		Return status code
+ */
+static int rule_and ( struct rule_compiler *comp ) {
+	int rc;
+
+	if ( ( rc = rule_not ( comp ) ) != 0 )
+		return rc;
+	while ( rule_accept ( comp, "&&" ) ) {
+		if ( ( rc = rule_not ( comp ) ) != 0 )
+			return rc;
+		if ( ( rc = rule_emit ( comp, RULE_AND, NULL, 0, -1 ) ) != 0 )
+			return rc;
+	}
+	return 0;
+}
+
+/**
+ * Compile disjunction
+ *
+ * @v comp		Compiler
+ * @ret rc		Return status code
+ */
+static int rule_or ( struct rule_compiler *comp ) {
+	int rc;
+
+	if ( ( rc = rule_and ( comp ) ) != 0 )
+		return rc;
+	while ( rule_accept ( comp, "||" ) ) {
+		if ( ( rc = rule_and ( comp ) ) != 0 )
+			return rc;
+		if ( ( rc = rule_emit ( comp, RULE_OR, NULL, 0, -1 ) ) != 0 )
+			return rc;
+	}
+	return 0;
+}
+
+/**
+ * Compile condition
+ *
+ * @v rule		Rule
+ * @v res		Trigger resource
+ * @v condition		Condition
+ * @ret rc		Return status code
+ */
+static int rule_compile ( struct rule *rule, struct resource *res,
+			  const char *condition ) {
+	struct rule_compiler comp;
+	int rc;
+
+	/* Initialise compiler */
+	memset ( &comp, 0, sizeof ( comp ) );
+	comp.rule = rule;
+	comp.res = res;
+	comp.pos = condition;
+	comp.scratch = malloc ( res->desc->len );
+	if ( ! comp.scratch ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	memcpy ( comp.scratch, resource_retrieve ( res ), res->desc->len );
+
+	/* Compile condition */
+	rule->len = 0;
+	if ( ( rc = rule_or ( &comp ) ) != 0 )
+		goto err_compile;
+	rule_skip ( &comp );
+	if ( *comp.pos ) {
+		rc = rule_syntax ( &comp );
+		goto err_compile;
+	}
+	rule->code[rule->len++] = RULE_END;
+
+ err_compile:
+	free ( comp.scratch );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Apply rule action
+ *
+ * @v rule		Rule
+ */
+static void rule_fire ( struct rule *rule ) {
+	struct resource *target = rule->target;
+	struct property *prop;
+	unsigned int i;
+	int rc;
+
+	/* Construct updated state */
+	memcpy ( rule->update, resource_retrieve ( target ),
+		 target->desc->len );
+	for ( i = 0 ; i < rule->num_assigned ; i++ ) {
+		prop = rule->assigned[i];
+		memcpy ( ( rule->update + prop->offset ),
+			 ( rule->values + prop->offset ), prop->len );
+	}
+
+	/* Update target, ignoring any notifications caused by our own
+	 * update.
+	 */
+	rule->busy = 1;
+	rc = resource_update ( target, rule->update );
+	rule->busy = 0;
+	rule->fired++;
+	if ( rc != 0 )
+		rule->failed++;
+}
+
+/**
+ * Handle notification of trigger resource state change
+ *
+ * @v obs		Observer
+ * @v state		Trigger resource state
+ */
+static void rule_notify ( struct observer *obs, const void *state ) {
+	struct rule *rule = container_of ( obs, struct rule, obs );
+	int match;
+
+	/* Ignore notifications caused by our own update */
+	if ( rule->busy )
+		return;
+
+	/* Evaluate condition */
+	rule->evaluations++;
+	match = rule_evaluate ( rule->code, state );
+
+	/* Apply action if condition has become true */
+	if ( match && ( ! rule->active ) )
+		rule_fire ( rule );
+	rule->active = match;
+}
+
+/**
+ * Prepare rule action
+ *
+ * @v rule		Rule
+ * @v assignments	Property assignments ("<name>=<value>"; will be split)
+ * @v count		Number of property assignments
+ * @ret rc		Return status code
+ */
+static int rule_prepare ( struct rule *rule, char **assignments,
+			  unsigned int count ) {
+	struct resource *target = rule->target;
+	struct property *prop;
+	char *name;
+	char *sep;
+	unsigned int i;
+	int rc;
+
+	/* Parse property values into a copy of the current state */
+	memcpy ( rule->values, resource_retrieve ( target ),
+		 target->desc->len );
+	for ( i = 0 ; i < count ; i++ ) {
+
+		/* Split into name and value */
+		name = assignments[i];
+		sep = strchr ( name, '=' );
+		if ( ! sep ) {
+			cprintf ( "\"%s\": expected <prop>=<value>\n", name );
+			return -EINVAL;
+		}
+		*sep = '\0';
+
+		/* Find writable property */
+		prop = resource_property ( target, name );
+		if ( ! prop ) {
+			cprintf ( "\"%s\": no such property\n", name );
+			return -ENOENT;
+		}
+		if ( ! ( prop->flags & PROP_RW ) ) {
+			cprintf ( "\"%s\": property is read-only\n", name );
+			return -EROFS;
+		}
+
+		/* Array values refer to the resource's own buffer,
+		 * and so cannot be prepared in advance.
+		 */
+		if ( property_is_array ( prop ) ) {
+			cprintf ( "\"%s\": cannot assign %s properties\n",
+				  name, prop->type->name );
+			return -ENOTSUP;
+		}
+
+		/* Parse value */
+		rc = property_parse ( prop, ( sep + 1 ), rule->values );
+		*sep = '=';
+		if ( rc != 0 ) {
+			cprintf ( "\"%s\": %s\n", name, strerror ( rc ) );
+			return rc;
+		}
+		rule->assigned[rule->num_assigned++] = prop;
+	}
+
+	return 0;
+}
+
+/**
+ * Free rule
+ *
+ * @v rule		Rule
+ */
+static void rule_free ( struct rule *rule ) {
+
+	free ( rule->update );
+	free ( rule->values );
+	free ( rule->args );
+	free ( rule );
+}
+
+/**
+ * Create rule
+ *
+ * @v argc		Number of arguments
+ * @v argv		Name, trigger URI, condition, target URI, and
+ *			property assignments
+ * @ret rc		Return status code
+ */
+static int rule_create ( int argc, char **argv ) {
+	struct resource *trigger;
+	struct resource *target;
+	struct rule *rule;
+	char *copy[argc];
+	size_t len = 0;
+	char *arg;
+	int i;
+	int rc;
+
+	/* Find trigger and target resources */
+	if ( ( rc = parse_resource ( argv[1], &trigger ) ) != 0 )
+		goto err_trigger;
+	if ( ( rc = parse_resource ( argv[3], &target ) ) != 0 )
+		goto err_target;
+	if ( ( argc - 4 ) > RULE_ASSIGNMENTS ) {
+		rc = -E2BIG;
+		goto err_count;
+	}
+
+	/* Allocate and initialise rule */
+	rule = calloc ( 1, sizeof ( *rule ) );
+	if ( ! rule ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	rule->target = target;
+	observer_init ( &rule->obs, trigger, &oic_if_baseline, rule_notify );
+
+	/* Record definition */
+	for ( i = 0 ; i < argc ; i++ )
+		len += ( strlen ( argv[i] ) + 1 /* NUL */ );
+	rule->args = malloc ( len );
+	if ( ! rule->args ) {
+		rc = -ENOMEM;
+		goto err_args;
+	}
+	for ( arg = rule->args, i = 0 ; i < argc ; i++ ) {
+		copy[i] = arg;
+		arg = ( stpcpy ( arg, argv[i] ) + 1 /* NUL */ );
+	}
+	rule->num_args = argc;
+	rule->name = rule->args;
+
+	/* Compile condition */
+	if ( ( rc = rule_compile ( rule, trigger, argv[2] ) ) != 0 )
+		goto err_compile;
+
+	/* Prepare action, using the copied definition (since parsed
+	 * string values will refer to the assignment text).
+	 */
+	rule->values = malloc ( target->desc->len );
+	rule->update = malloc ( target->desc->len );
+	if ( ! ( rule->values && rule->update ) ) {
+		rc = -ENOMEM;
+		goto err_state;
+	}
+	if ( ( rc = rule_prepare ( rule, &copy[4], ( argc - 4 ) ) ) != 0 )
+		goto err_prepare;
+
+	/* Record initial condition, so that a condition which is
+	 * already true does not immediately trigger the action.
+	 */
+	rule->active = rule_evaluate ( rule->code,
+				       resource_retrieve ( trigger ) );
+
+	/* Add to list of rules and start observing trigger */
+	list_add_tail ( &rule->list, &rules );
+	resource_observe ( &rule->obs );
+
+	return 0;
+
+ err_prepare:
+ err_state:
+ err_compile:
+ err_args:
+	rule_free ( rule );
+ err_alloc:
+ err_count:
+ err_target:
+ err_trigger:
+	return rc;
+}
+
+/**
+ * Destroy rule
+ *
+ * @v rule		Rule
+ */
+static void rule_destroy ( struct rule *rule ) {
+
+	/* Stop observing trigger and remove from list of rules */
+	resource_unobserve ( &rule->obs );
+	list_del ( &rule->list );
+
+	/* Free rule */
+	rule_free ( rule );
+}
+
+/**
+ * Find rule
+ *
+ * @v name		Name
+ * @ret rule		Rule, or NULL if not found
+ */
+static struct rule * rule_find ( const char *name ) {
+	struct rule *rule;
+
+	list_for_each_entry ( rule, &rules, list ) {
+		if ( strcmp ( rule->name, name ) == 0 )
+			return rule;
+	}
+	return NULL;
+}
+
+/**
+ * Remove rules referring to an unregistered namespace
+ *
+ * @v ns		Resource namespace
+ */
+static void rule_forget ( struct namespace *ns ) {
+	struct rule *rule;
+	struct rule *tmp;
+
+	list_for_each_entry_safe ( rule, tmp, &rules, list ) {
+		if ( ( rule->obs.res->ns == ns ) || ( rule->target->ns == ns ) )
+			rule_destroy ( rule );
+	}
+}
+
+/** Rule engine namespace removal hook */
+struct namespace_hook rule_namespace_hook __namespace_hook = {
+	.forget = rule_forget,
+};
+
+/**
+ * Print rule
+ *
+ * @v rule		Rule
+ */
+static void rule_print ( struct rule *rule ) {
+	const char *arg = rule->args;
+	unsigned int i;
+
+	for ( i = 0 ; i < rule->num_args ; i++ ) {
+		cprintf ( "%s%s", arg, ( i ? " " : ": " ) );
+		arg += ( strlen ( arg ) + 1 /* NUL */ );
+	}
+	cprintf ( "active=%d evaluations=%lu fired=%lu failed=%lu "
+		  "code=%zu\n", rule->active, rule->evaluations, rule->fired,
+		  rule->failed, rule->len );
+}
+
+/** "rule" options */
+struct rule_options {
+	/** Delete rule */
+	int delete;
+};
+
+/** "rule" option list */
+static struct option_descriptor rule_opts[] = {
+	OPTION_DESC ( "delete", 'd', no_argument,
+		      struct rule_options, delete, parse_flag ),
+};
+
+/** "rule" command descriptor */
+static struct command_descriptor rule_cmd =
+	COMMAND_DESC ( struct rule_options, rule_opts, 0, MAX_ARGUMENTS,
+		       "[<name> [<uri> <condition> <target-uri> "
+		       "<prop>=<value>...]]" );
+
+/**
+ * "rule" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int rule_exec ( int argc, char **argv ) {
+	struct rule_options opts;
+	struct rule *rule;
+	int count;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &rule_cmd, &opts ) ) != 0 )
+		return rc;
+	count = ( argc - optind );
+
+	/* List rules, if no rule is specified */
+	if ( ! count ) {
+		list_for_each_entry ( rule, &rules, list )
+			rule_print ( rule );
+		return 0;
+	}
+
+	/* Find existing rule, if any */
+	rule = rule_find ( argv[optind] );
+
+	/* Delete or show rule, if applicable */
+	if ( opts.delete || ( count == 1 ) ) {
+		if ( ! rule ) {
+			cprintf ( "\"%s\": no such rule\n", argv[optind] );
+			return -ENOENT;
+		}
+		if ( opts.delete ) {
+			rule_destroy ( rule );
+		} else {
+			rule_print ( rule );
+		}
+		return 0;
+	}
+
+	/* Otherwise, create rule */
+	if ( count < 5 ) {
+		print_usage ( &rule_cmd, argv );
+		return -EINVAL;
+	}
+	if ( rule ) {
+		cprintf ( "\"%s\": rule already exists\n", argv[optind] );
+		return -EEXIST;
+	}
+	return rule_create ( count, &argv[optind] );
+}
+
+/** "rule" command */
+struct command rule_command __command = {
+	.name = "rule",
+	.exec = rule_exec,
+};
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Resource state serialisation
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <uniport/serialise.h>
+#include <uniport/bench.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/timer.h>
+
+/**
+ * Serialise resource state using property table
+ *
+ * @v res		Resource
+ * @v intf		Interface
+ * @v state		Resource state
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @ret len		Length of serialised state
+ */
+static size_t serialise_table ( struct resource *res, struct interface *intf,
+				const void *state, char *buf, size_t len ) {
+	const struct resource_descriptor *desc = res->desc;
+	struct property *prop;
+	unsigned int i;
+	size_t used = 0;
+
+	/* Terminate string in case there is nothing to serialise */
+	if ( len )
+		buf[0] = '\0';
+
+	/* Serialise each visible property */
+	for_each_interface_property ( i, intf, desc, INTERFACE_VISIBLE ) {
+		prop = &desc->props[i];
+		if ( used )
+			used += serialise_text ( buf, len, used, " ", 1 );
+		used += serialise_text ( buf, len, used, prop->name,
+					 strlen ( prop->name ) );
+		used += serialise_text ( buf, len, used, "=", 1 );
+		used += property_format ( prop,
+					  serialise_buf ( buf, len, used ),
+					  serialise_avail ( len, used ),
+					  state );
+	}
+
+	return used;
+}
+
+/**
+ * Deserialise property value using property table
+ *
+ * @v res		Resource
+ * @v intf		Interface
+ * @v name		Property name
+ * @v value		Property value
+ * @v state		Resource state to update
+ * @ret rc		Return status code
+ */
+static int deserialise_table ( struct resource *res, struct interface *intf,
+			       const char *name, const char *value,
+			       void *state ) {
+	struct property *prop;
+
+	/* Identify writable property */
+	prop = resource_property ( res, name );
+	if ( ( ! prop ) ||
+	     ( ! interface_mask_test ( intf, res->desc, INTERFACE_WRITABLE,
+				       ( prop - res->desc->props ) ) ) ) {
+		return -EPERM;
+	}
+
+	/* Parse value */
+	return property_parse ( prop, value, state );
+}
+
+/**
+ * Serialise resource state
+ *
+ * @v res		Resource
+ * @v intf		Interface
+ * @v state		Resource state
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @ret len		Length of serialised state
+ *
+ * The serialised state is truncated and NUL-terminated in the same
+ * way as snprintf().  The buffer may be NULL if its length is zero.
+ */
+size_t resource_serialise ( struct resource *res, struct interface *intf,
+			    const void *state, char *buf, size_t len ) {
+	const struct resource_descriptor *desc = res->desc;
+
+	/* Use generated serialiser, if available */
+	if ( desc->serialise ) {
+		return desc->serialise ( interface_mask ( intf, desc,
+							  INTERFACE_VISIBLE ),
+					 state, buf, len );
+	}
+
+	/* Otherwise, use property table */
+	return serialise_table ( res, intf, state, buf, len );
+}
+
+/**
+ * Deserialise resource state
+ *
+ * @v res		Resource
+ * @v intf		Interface
+ * @v string		Serialised state (will be modified)
+ * @v state		Resource state to update
+ * @ret rc		Return status code
+ *
+ * Only the properties present within the serialised state are
+ * updated.  Every property must be writable via the interface.
+ */
+int resource_deserialise ( struct resource *res, struct interface *intf,
+			   char *string, void *state ) {
+	const struct resource_descriptor *desc = res->desc;
+	char *name;
+	char *value;
+	char *next;
+	int rc;
+
+	/* Parse each "name=value" pair */
+	for ( name = string ; name ; name = next ) {
+		next = strchr ( name, ' ' );
+		if ( next )
+			*(next++) = '\0';
+		if ( ! *name )
+			continue;
+		value = strchr ( name, '=' );
+		if ( ! value )
+			return -EINVAL;
+		*(value++) = '\0';
+		if ( desc->deserialise ) {
+			rc = desc->deserialise ( interface_mask (
+							 intf, desc,
+							 INTERFACE_WRITABLE ),
+						 name, value, state );
+		} else {
+			rc = deserialise_table ( res, intf, name, value,
+						 state );
+		}
+		if ( rc != 0 )
+			return rc;
+	}
+
+	return 0;
+}
+
+/** "serialise" options */
+struct serialise_options {
+	/** Interface in use */
+	struct interface *intf;
+	/** Number of iterations */
+	unsigned int count;
+};
+
+/** "serialise" option list */
+static struct option_descriptor serialise_opts[] = {
+	OPTION_DESC ( "interface", 'i', required_argument,
+		      struct serialise_options, intf, parse_interface ),
+	OPTION_DESC ( "count", 'n', required_argument,
+		      struct serialise_options, count, parse_integer ),
+};
+
+/** "serialise" command descriptor */
+static struct command_descriptor serialise_cmd =
+	COMMAND_DESC ( struct serialise_options, serialise_opts, 0, 1,
+		       "[<pattern>]" );
+
+/** Length of "serialise" command buffers */
+#define SERIALISE_BENCH_LEN 256
+
+/** A resource measured by the "serialise" command */
+struct serialise_bench {
+	/** Resource */
+	struct resource *res;
+	/** Resource state */
+	const void *state;
+};
+
+/** "serialise" measurement results */
+struct serialise_results {
+	/** Number of resources measured */
+	unsigned int resources;
+	/** Number of matching resources without a generated serialiser */
+	unsigned int skipped;
+	/** Number of resources for which the two methods disagree */
+	unsigned int mismatched;
+	/** Total length of serialised state (for a single pass) */
+	unsigned long long bytes;
+	/** Time taken using the generated serialisers (in ticks) */
+	unsigned long generated_ticks;
+	/** Time taken using the property tables (in ticks) */
+	unsigned long table_ticks;
+};
+
+/**
+ * Compare generated serialisers against property tables
+ *
+ * @v pattern		URI pattern
+ * @v intf		Interface
+ * @v count		Number of passes
+ * @v results		Results to fill in
+ * @ret rc		Return status code
+ *
+ * Serialise the state of all matching resources having a generated
+ * serialiser, using both the generated serialiser and the property
+ * table, and measure the time taken by each.  Each pass covers all of
+ * the matching resources, so that the cost of moving between
+ * resources is included in the measurement.
+ */
+static int serialise_compare ( const char *pattern, struct interface *intf,
+			       unsigned int count,
+			       struct serialise_results *results ) {
+	struct serialise_bench *benches;
+	struct serialise_bench *bench;
+	struct resource *res;
+	char generated[SERIALISE_BENCH_LEN];
+	char table[SERIALISE_BENCH_LEN];
+	unsigned long start;
+	unsigned int i;
+	unsigned int j;
+	size_t len;
+
+	/* Allocate list of matching resources */
+	memset ( results, 0, sizeof ( *results ) );
+	benches = malloc ( resource_index_count * sizeof ( benches[0] ) );
+	if ( ( ! benches ) && resource_index_count )
+		return -ENOMEM;
+
+	/* Collect matching resources, checking that both methods agree */
+	for ( i = 0 ; i < resource_index_count ; i++ ) {
+		res = resource_index[i];
+		if ( ! resource_uri_match ( res, pattern ) )
+			continue;
+		if ( ! res->desc->serialise ) {
+			results->skipped++;
+			continue;
+		}
+		bench = &benches[results->resources++];
+		bench->res = res;
+		bench->state = resource_retrieve ( res );
+		len = resource_serialise ( res, intf, bench->state,
+					   generated, sizeof ( generated ) );
+		serialise_table ( res, intf, bench->state, table,
+				  sizeof ( table ) );
+		if ( strcmp ( generated, table ) != 0 ) {
+			cprintf ( "%s: generated \"%s\" != table \"%s\"\n",
+				  res->uri, generated, table );
+			results->mismatched++;
+		}
+		results->bytes += len;
+	}
+
+	/* Time whole passes using the generated serialisers */
+	start = currticks();
+	for ( j = 0 ; j < count ; j++ ) {
+		for ( i = 0 ; i < results->resources ; i++ ) {
+			bench = &benches[i];
+			resource_serialise ( bench->res, intf, bench->state,
+					     generated, sizeof ( generated ) );
+		}
+	}
+	results->generated_ticks = ( currticks() - start );
+
+	/* Time whole passes using the property tables */
+	start = currticks();
+	for ( j = 0 ; j < count ; j++ ) {
+		for ( i = 0 ; i < results->resources ; i++ ) {
+			bench = &benches[i];
+			serialise_table ( bench->res, intf, bench->state,
+					  table, sizeof ( table ) );
+		}
+	}
+	results->table_ticks = ( currticks() - start );
+
+	free ( benches );
+	return 0;
+}
+
+/**
+ * "serialise" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ *
+ * Compare the generated serialisers of all matching resources against
+ * their property tables, and report the time taken by each.
+ */
+static int serialise_exec ( int argc, char **argv ) {
+	struct serialise_options opts;
+	struct serialise_results results;
+	const char *pattern;
+	unsigned long long total;
+	int rc;
+
+	/* Parse options, with defaults */
+	memset ( &opts, 0, sizeof ( opts ) );
+	opts.count = BENCH_DEFAULT_COUNT;
+	if ( ( rc = reparse_options ( argc, argv, &serialise_cmd,
+				      &opts ) ) != 0 )
+		return rc;
+	if ( ! opts.count ) {
+		cprintf ( "%s: count must be non-zero\n", argv[0] );
+		return -EINVAL;
+	}
+	pattern = ( ( optind < argc ) ? argv[optind] : "*" );
+
+	/* Default to baseline interface where not specified */
+	if ( ! opts.intf )
+		opts.intf = &oic_if_baseline;
+
+	/* Compare serialisers */
+	if ( ( rc = serialise_compare ( pattern, opts.intf, opts.count,
+					&results ) ) != 0 )
+		return rc;
+
+	/* Report timings */
+	total = ( ( ( unsigned long long ) results.resources ) * opts.count );
+	cprintf ( "serialise: %u resources (%u skipped, %u mismatched), "
+		  "%llu bytes, %u passes\n", results.resources,
+		  results.skipped, results.mismatched, results.bytes,
+		  opts.count );
+	cprintf ( "serialise: generated %lu.%03lums (%llu ns/resource), "
+		  "table %lu.%03lums (%llu ns/resource)\n",
+		  ( results.generated_ticks / TICKS_PER_MS ),
+		  ( results.generated_ticks % TICKS_PER_MS ),
+		  ( total ? ( ( ( ( unsigned long long )
+				  results.generated_ticks ) *
+			        ( 1000000000ULL / TICKS_PER_SEC ) ) / total ) :
+		    0 ),
+		  ( results.table_ticks / TICKS_PER_MS ),
+		  ( results.table_ticks % TICKS_PER_MS ),
+		  ( total ? ( ( ( ( unsigned long long )
+				  results.table_ticks ) *
+			        ( 1000000000ULL / TICKS_PER_SEC ) ) / total ) :
+		    0 ) );
+
+	return ( results.mismatched ? -EIO : 0 );
+}
+
+/** "serialise" command */
+struct command serialise_command __command = {
+	.name = "serialise",
+	.exec = serialise_exec,
+};
+
+/**
+ * Serialisation benchmark
+ *
+ * @v count		Number of passes
+ * @ret rc		Return status code
+ *
+ * Each operation serialises a single resource via the baseline
+ * interface.
+ */
+static int serialise_bench ( unsigned int count ) {
+	struct serialise_results results;
+	unsigned long long total;
+	int rc;
+
+	/* Compare serialisers for all resources */
+	if ( ( rc = serialise_compare ( "*", &oic_if_baseline, count,
+					&results ) ) != 0 )
+		return rc;
+
+	/* Report timings */
+	total = ( ( ( unsigned long long ) results.resources ) * count );
+	bench_report ( "serialise", "generated", results.generated_ticks,
+		       total );
+	bench_report ( "serialise", "table", results.table_ticks, total );
+
+	return ( results.mismatched ? -EIO : 0 );
+}
+
+/** Serialisation benchmark */
+struct benchmark serialise_benchmark __benchmark = {
+	.name = "serialise",
+	.run = serialise_bench,
+};
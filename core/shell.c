@@ -0,0 +1,562 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Network shell
+ *
+ * The network shell exposes the same command set as the console to
+ * multiple concurrent TCP sessions, all served by a single thread
+ * using select().
+ *
+ * Each session has its own output stream, backed by a fixed-size
+ * output buffer that is written to the socket without blocking.
+ * Commands are executed via fsystem() with the session's output
+ * stream as the command output, so that all output from the command
+ * reaches the correct session without affecting stdout.
+ *
+ * The "observe" command records the session's output stream, so that
+ * notifications are delivered to the session that requested them.
+ * Output arriving from other threads wakes the shell thread via a
+ * pipe.  Closing a session removes its observers (waiting for any
+ * notification being delivered) before closing its output stream.
+ *
+ * Since all sessions share a single thread, a long-running command
+ * will delay all other sessions.  If a session's output buffer fills
+ * up, excess output is discarded and the number of discarded bytes is
+ * reported to the session.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <uniport/shell.h>
+#include <uniport/cli.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+
+/** List of sessions */
+static struct list_head shell_sessions = LIST_HEAD_INIT ( shell_sessions );
+
+/** Number of sessions */
+static unsigned int shell_count;
+
+/** Listening socket, or negative if not running */
+static int shell_listener = -1;
+
+/** Listening port */
+static unsigned int shell_port;
+
+/** Wakeup pipe */
+static int shell_wake[2];
+
+/** Shell thread */
+static pthread_t shell_thread_id;
+
+/** Shell thread is running */
+static volatile int shell_running;
+
+/**
+ * Wake shell thread
+ *
+ */
+static void shell_wakeup ( void ) {
+	uint8_t wake = 0;
+
+	if ( write ( shell_wake[1], &wake, sizeof ( wake ) ) < 0 ) {
+		/* Pipe is full: shell thread is already awake */
+	}
+}
+
+/**
+ * Write to session output stream
+ *
+ * @v cookie		Session
+ * @v data		Data
+ * @v len		Length of data
+ * @ret len		Length consumed
+ *
+ * This may be called from any thread (e.g. when delivering an
+ * observer notification).  Output that does not fit within the
+ * output buffer is discarded.
+ */
+static ssize_t shell_write ( void *cookie, const char *data, size_t len ) {
+	struct shell_session *session = cookie;
+	size_t space;
+	size_t frag_len;
+
+	pthread_mutex_lock ( &session->lock );
+	space = ( sizeof ( session->output ) - session->output_len );
+	frag_len = ( ( len < space ) ? len : space );
+	memcpy ( ( session->output + session->output_len ), data, frag_len );
+	if ( frag_len && ( ! session->output_len ) )
+		shell_wakeup();
+	session->output_len += frag_len;
+	session->dropped += ( len - frag_len );
+	pthread_mutex_unlock ( &session->lock );
+
+	return len;
+}
+
+/** Session output stream operations */
+static cookie_io_functions_t shell_io = {
+	.write = shell_write,
+};
+
+/**
+ * Transmit pending output
+ *
+ * @v session		Session
+ * @ret rc		Return status code
+ */
+static int shell_transmit ( struct shell_session *session ) {
+	ssize_t len;
+	int rc = 0;
+
+	pthread_mutex_lock ( &session->lock );
+
+	/* Write out as much as possible */
+	if ( session->output_len ) {
+		len = write ( session->fd, session->output,
+			      session->output_len );
+		if ( len < 0 ) {
+			if ( errno != EAGAIN )
+				rc = -errno;
+			goto done;
+		}
+		session->output_len -= len;
+		memmove ( session->output, ( session->output + len ),
+			  session->output_len );
+	}
+
+	/* Report discarded output once the buffer has drained */
+	if ( session->dropped && ( ! session->output_len ) ) {
+		session->output_len =
+			snprintf ( session->output, sizeof ( session->output ),
+				   "\n[%lu bytes discarded]\n",
+				   session->dropped );
+		session->dropped = 0;
+	}
+
+ done:
+	pthread_mutex_unlock ( &session->lock );
+	return rc;
+}
+
+/**
+ * Execute command line within a session
+ *
+ * @v session		Session
+ * @v line		Command line
+ * @ret rc		Return status code
+ */
+static int shell_execute ( struct shell_session *session, char *line ) {
+
+	/* Close session on request */
+	if ( strcmp ( line, "exit" ) == 0 )
+		return -ECANCELED;
+
+	/* Run command with output directed to this session */
+	fsystem ( session->out, line );
+
+	/* Show prompt for next command */
+	fputs ( SHELL_PROMPT, session->out );
+	fflush ( session->out );
+
+	return 0;
+}
+
+/**
+ * Receive data
+ *
+ * @v session		Session
+ * @ret rc		Return status code
+ */
+static int shell_receive ( struct shell_session *session ) {
+	size_t max_len = ( sizeof ( session->line ) - 1 /* NUL */ );
+	char buf[64];
+	ssize_t len;
+	ssize_t i;
+	char c;
+	int rc;
+
+	/* Read data */
+	len = read ( session->fd, buf, sizeof ( buf ) );
+	if ( len < 0 )
+		return ( ( errno == EAGAIN ) ? 0 : -errno );
+	if ( len == 0 )
+		return -ECONNRESET;
+
+	/* Accumulate and execute command lines */
+	for ( i = 0 ; i < len ; i++ ) {
+		c = buf[i];
+		if ( c == '\r' ) {
+			continue;
+		} else if ( c != '\n' ) {
+			if ( session->line_len >= max_len ) {
+				session->overflow = 1;
+				continue;
+			}
+			session->line[session->line_len++] = c;
+			continue;
+		}
+		session->line[session->line_len] = '\0';
+		if ( session->overflow ) {
+			fprintf ( session->out, "Line too long\n"
+				  SHELL_PROMPT );
+			fflush ( session->out );
+		} else if ( ( rc = shell_execute ( session,
+						   session->line ) ) != 0 ) {
+			return rc;
+		}
+		session->line_len = 0;
+		session->overflow = 0;
+	}
+
+	return 0;
+}
+
+/**
+ * Open session
+ *
+ * @v fd		Connected socket (will be owned by the session)
+ * @ret rc		Return status code
+ */
+static int shell_open ( int fd ) {
+	struct shell_session *session;
+	int rc;
+
+	/* Refuse excess sessions */
+	if ( shell_count >= SHELL_SESSIONS ) {
+		rc = -EMFILE;
+		goto err_count;
+	}
+
+	/* Allocate and initialise session */
+	session = calloc ( 1, sizeof ( *session ) );
+	if ( ! session ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	session->fd = fd;
+	pthread_mutex_init ( &session->lock, NULL );
+	if ( fcntl ( fd, F_SETFL,
+		     ( fcntl ( fd, F_GETFL ) | O_NONBLOCK ) ) < 0 ) {
+		rc = -errno;
+		goto err_nonblock;
+	}
+
+	/* Create output stream */
+	session->out = fopencookie ( session, "w", shell_io );
+	if ( ! session->out ) {
+		rc = -ENOMEM;
+		goto err_fopen;
+	}
+	setvbuf ( session->out, NULL, _IOLBF, SHELL_LINE_LEN );
+
+	/* Add to list of sessions */
+	list_add_tail ( &session->list, &shell_sessions );
+	shell_count++;
+
+	/* Show prompt */
+	fputs ( SHELL_PROMPT, session->out );
+	fflush ( session->out );
+
+	return 0;
+
+ err_fopen:
+ err_nonblock:
+	pthread_mutex_destroy ( &session->lock );
+	free ( session );
+ err_alloc:
+ err_count:
+	close ( fd );
+	return rc;
+}
+
+/**
+ * Close session
+ *
+ * @v session		Session
+ */
+static void shell_close ( struct shell_session *session ) {
+
+	/* Remove any observers delivering to this session (waiting for
+	 * any notification in progress), so that no other thread can
+	 * write to the output stream once it has been closed.
+	 */
+	cli_close ( session->out );
+
+	/* Remove from list of sessions */
+	list_del ( &session->list );
+	shell_count--;
+
+	/* Free session */
+	fclose ( session->out );
+	close ( session->fd );
+	pthread_mutex_destroy ( &session->lock );
+	free ( session );
+}
+
+/**
+ * Run shell thread
+ *
+ * @v arg		Unused
+ * @ret arg		Unused
+ */
+static void * shell_thread ( void *arg __unused ) {
+	struct shell_session *session;
+	struct shell_session *tmp;
+	uint8_t discard[16];
+	fd_set rfds;
+	fd_set wfds;
+	int max_fd;
+	int fd;
+	int rc;
+
+	while ( shell_running ) {
+
+		/* Construct descriptor sets */
+		FD_ZERO ( &rfds );
+		FD_ZERO ( &wfds );
+		FD_SET ( shell_listener, &rfds );
+		FD_SET ( shell_wake[0], &rfds );
+		max_fd = ( ( shell_listener > shell_wake[0] ) ?
+			   shell_listener : shell_wake[0] );
+		list_for_each_entry ( session, &shell_sessions, list ) {
+			FD_SET ( session->fd, &rfds );
+			if ( session->output_len || session->dropped )
+				FD_SET ( session->fd, &wfds );
+			if ( session->fd > max_fd )
+				max_fd = session->fd;
+		}
+
+		/* Wait for activity */
+		if ( select ( ( max_fd + 1 ), &rfds, &wfds, NULL, NULL ) < 0 )
+			continue;
+		if ( FD_ISSET ( shell_wake[0], &rfds ) ) {
+			if ( read ( shell_wake[0], discard,
+				    sizeof ( discard ) ) < 0 ) {
+				/* Nothing to do */
+			}
+		}
+
+		/* Accept new sessions */
+		if ( FD_ISSET ( shell_listener, &rfds ) ) {
+			fd = accept ( shell_listener, NULL, NULL );
+			if ( ( fd >= 0 ) &&
+			     ( ( rc = shell_open ( fd ) ) != 0 ) ) {
+				printf ( "shell: could not open session: %s\n",
+					 strerror ( rc ) );
+			}
+		}
+
+		/* Service existing sessions */
+		list_for_each_entry_safe ( session, tmp, &shell_sessions,
+					   list ) {
+			rc = 0;
+			if ( FD_ISSET ( session->fd, &rfds ) )
+				rc = shell_receive ( session );
+			if ( rc == 0 )
+				rc = shell_transmit ( session );
+			if ( rc != 0 )
+				shell_close ( session );
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Start network shell
+ *
+ * @v port		Listening port
+ * @ret rc		Return status code
+ */
+static int shell_start ( unsigned int port ) {
+	struct sockaddr_in local;
+	int one = 1;
+	int rc;
+
+	/* Create listening socket */
+	shell_listener = socket ( AF_INET, SOCK_STREAM, 0 );
+	if ( shell_listener < 0 ) {
+		rc = -errno;
+		goto err_socket;
+	}
+	setsockopt ( shell_listener, SOL_SOCKET, SO_REUSEADDR,
+		     &one, sizeof ( one ) );
+	memset ( &local, 0, sizeof ( local ) );
+	local.sin_family = AF_INET;
+	local.sin_port = htons ( port );
+	if ( bind ( shell_listener, ( struct sockaddr * ) &local,
+		    sizeof ( local ) ) != 0 ) {
+		rc = -errno;
+		goto err_bind;
+	}
+	if ( listen ( shell_listener, SHELL_SESSIONS ) != 0 ) {
+		rc = -errno;
+		goto err_listen;
+	}
+
+	/* Create wakeup pipe */
+	if ( pipe ( shell_wake ) != 0 ) {
+		rc = -errno;
+		goto err_pipe;
+	}
+	fcntl ( shell_wake[0], F_SETFL, O_NONBLOCK );
+	fcntl ( shell_wake[1], F_SETFL, O_NONBLOCK );
+
+	/* Start shell thread */
+	shell_running = 1;
+	if ( ( rc = pthread_create ( &shell_thread_id, NULL, shell_thread,
+				     NULL ) ) != 0 ) {
+		rc = -rc;
+		goto err_thread;
+	}
+
+	shell_port = port;
+	return 0;
+
+ err_thread:
+	shell_running = 0;
+	close ( shell_wake[0] );
+	close ( shell_wake[1] );
+ err_pipe:
+ err_listen:
+ err_bind:
+	close ( shell_listener );
+ err_socket:
+	shell_listener = -1;
+	return rc;
+}
+
+/**
+ * Stop network shell
+ *
+ */
+static void shell_stop ( void ) {
+	struct shell_session *session;
+	struct shell_session *tmp;
+
+	/* Stop shell thread */
+	shell_running = 0;
+	shell_wakeup();
+	pthread_join ( shell_thread_id, NULL );
+
+	/* Close all sessions */
+	list_for_each_entry_safe ( session, tmp, &shell_sessions, list )
+		shell_close ( session );
+
+	/* Close listening socket and wakeup pipe */
+	close ( shell_listener );
+	shell_listener = -1;
+	close ( shell_wake[0] );
+	close ( shell_wake[1] );
+}
+
+/** "shell" options */
+struct shell_options {
+	/** Listening port */
+	unsigned int port;
+	/** Stop shell */
+	int stop;
+};
+
+/** "shell" option list */
+static struct option_descriptor shell_opts[] = {
+	OPTION_DESC ( "port", 'p', required_argument,
+		      struct shell_options, port, parse_integer ),
+	OPTION_DESC ( "stop", 'd', no_argument,
+		      struct shell_options, stop, parse_flag ),
+};
+
+/** "shell" command descriptor */
+static struct command_descriptor shell_cmd =
+	COMMAND_DESC ( struct shell_options, shell_opts, 0, 0, NULL );
+
+/**
+ * "shell" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int shell_exec ( int argc, char **argv ) {
+	struct shell_options opts;
+	struct shell_session *session;
+	int rc;
+
+	/* Parse options, with defaults */
+	memset ( &opts, 0, sizeof ( opts ) );
+	opts.port = SHELL_PORT;
+	if ( ( rc = reparse_options ( argc, argv, &shell_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Stop shell, if applicable */
+	if ( opts.stop ) {
+		if ( shell_listener >= 0 ) {
+			if ( pthread_equal ( pthread_self(),
+					     shell_thread_id ) ) {
+				cprintf ( "shell: cannot stop from within a "
+					  "session\n" );
+				return -EBUSY;
+			}
+			shell_stop();
+		}
+		return 0;
+	}
+
+	/* Show sessions, if already running */
+	if ( shell_listener >= 0 ) {
+		cprintf ( "shell: port %u sessions=%u\n",
+			  shell_port, shell_count );
+		list_for_each_entry ( session, &shell_sessions, list ) {
+			cprintf ( "  fd %d: pending=%zu discarded=%lu%s\n",
+				  session->fd, session->output_len,
+				  session->dropped,
+				  ( ( session->out == command_output() ) ?
+				    " (this session)" : "" ) );
+		}
+		return 0;
+	}
+
+	/* Otherwise, start shell */
+	if ( ( rc = shell_start ( opts.port ) ) != 0 ) {
+		cprintf ( "shell: could not listen on port %u: %s\n",
+			  opts.port, strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
+/** "shell" command */
+struct command shell_command __command = {
+	.name = "shell",
+	.exec = shell_exec,
+};
@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Output sinks
+ *
+ * An output sink is a stdio stream backed by a pluggable backend
+ * (such as a UART or socket file descriptor, or a memory buffer).
+ * The stream is fully buffered, so that the many small printf()
+ * calls made by a typical command are batched into a small number of
+ * large backend writes.
+ *
+ * Commands write their output to command_output().  Executing a
+ * command via sink_system() directs the command output to the sink
+ * for the duration of the command, and flushes the sink once the
+ * command completes.  The calling thread's stdout is left untouched.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <uniport/sink.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/timer.h>
+
+/**
+ * Write data to file descriptor
+ *
+ * @v sink		Output sink
+ * @v data		Data
+ * @v len		Length of data
+ * @ret len		Length written, or negative error
+ */
+static ssize_t fd_sink_write ( struct sink *sink, const void *data,
+			       size_t len ) {
+	struct fd_sink *fdsink = container_of ( sink, struct fd_sink, sink );
+	size_t remaining = len;
+	ssize_t frag_len;
+
+	while ( remaining ) {
+		frag_len = write ( fdsink->fd, data, remaining );
+		sink->stats.writes++;
+		if ( frag_len < 0 ) {
+			if ( errno == EINTR )
+				continue;
+			return -errno;
+		}
+		data += frag_len;
+		remaining -= frag_len;
+	}
+	return len;
+}
+
+/** File descriptor output sink operations */
+const struct sink_operations fd_sink_operations = {
+	.name = "fd",
+	.write = fd_sink_write,
+};
+
+/**
+ * Write data to memory buffer
+ *
+ * @v sink		Output sink
+ * @v data		Data
+ * @v len		Length of data
+ * @ret len		Length written
+ */
+static ssize_t memory_sink_write ( struct sink *sink, const void *data,
+				   size_t len ) {
+	struct memory_sink *memsink =
+		container_of ( sink, struct memory_sink, sink );
+	size_t frag_len = ( memsink->max - memsink->len );
+
+	if ( frag_len > len )
+		frag_len = len;
+	memcpy ( ( memsink->data + memsink->len ), data, frag_len );
+	memsink->len += frag_len;
+	sink->stats.writes++;
+	return len;
+}
+
+/** Memory output sink operations */
+const struct sink_operations memory_sink_operations = {
+	.name = "memory",
+	.write = memory_sink_write,
+};
+
+/**
+ * Write data to underlying stream
+ *
+ * @v sink		Output sink
+ * @v data		Data
+ * @v len		Length of data
+ * @ret len		Length written, or negative error
+ */
+static ssize_t stream_sink_write ( struct sink *sink, const void *data,
+				   size_t len ) {
+	struct stream_sink *streamsink =
+		container_of ( sink, struct stream_sink, sink );
+
+	sink->stats.writes++;
+	if ( ( fwrite ( data, 1, len, streamsink->stream ) != len ) ||
+	     ( fflush ( streamsink->stream ) != 0 ) )
+		return -EIO;
+	return len;
+}
+
+/** Stream output sink operations */
+const struct sink_operations stream_sink_operations = {
+	.name = "stream",
+	.write = stream_sink_write,
+};
+
+/**
+ * Write to output sink stream
+ *
+ * @v cookie		Output sink
+ * @v data		Data
+ * @v len		Length of data
+ * @ret len		Length written, or negative error
+ */
+static ssize_t sink_write ( void *cookie, const char *data, size_t len ) {
+	struct sink *sink = cookie;
+	ssize_t rc;
+
+	rc = sink->op->write ( sink, data, len );
+	if ( rc > 0 )
+		sink->stats.bytes += rc;
+	return rc;
+}
+
+/** Output sink stream operations */
+static cookie_io_functions_t sink_io = {
+	.write = sink_write,
+};
+
+/**
+ * Open output sink
+ *
+ * @v sink		Output sink
+ * @v op		Backend operations
+ * @v buffered		Buffer output (rather than writing immediately)
+ * @ret rc		Return status code
+ */
+int sink_open ( struct sink *sink, const struct sink_operations *op,
+		int buffered ) {
+
+	sink->op = op;
+	memset ( &sink->stats, 0, sizeof ( sink->stats ) );
+	sink->file = fopencookie ( sink, "w", sink_io );
+	if ( ! sink->file )
+		return -ENOMEM;
+	if ( buffered ) {
+		setvbuf ( sink->file, sink->buf, _IOFBF, sizeof ( sink->buf ) );
+	} else {
+		setvbuf ( sink->file, NULL, _IONBF, 0 );
+	}
+	return 0;
+}
+
+/**
+ * Close output sink
+ *
+ * @v sink		Output sink
+ */
+void sink_close ( struct sink *sink ) {
+
+	fclose ( sink->file );
+	sink->file = NULL;
+}
+
+/**
+ * Execute command line with output directed to a sink
+ *
+ * @v sink		Output sink
+ * @v command		Command line
+ * @ret rc		Return status code
+ */
+int sink_system ( struct sink *sink, const char *command ) {
+	int rc;
+
+	rc = fsystem ( sink->file, command );
+	sink->stats.commands++;
+
+	return rc;
+}
+
+/**
+ * Execute command with output directed to a sink
+ *
+ * @v sink		Output sink
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+int sink_execv ( struct sink *sink, char * const argv[] ) {
+	int rc;
+
+	rc = fexecv ( sink->file, argv );
+	sink->stats.commands++;
+
+	return rc;
+}
+
+/** An output sink used by the "sink" command */
+union sink_backend {
+	/** Output sink */
+	struct sink sink;
+	/** File descriptor output sink */
+	struct fd_sink fd;
+	/** Memory output sink */
+	struct memory_sink memory;
+	/** Stream output sink */
+	struct stream_sink stream;
+};
+
+/** "sink" options */
+struct sink_options {
+	/** Number of iterations */
+	unsigned int count;
+	/** Discard output (using a memory sink) */
+	int discard;
+	/** Disable buffering */
+	int unbuffered;
+};
+
+/** "sink" option list */
+static struct option_descriptor sink_opts[] = {
+	OPTION_DESC ( "count", 'n', required_argument,
+		      struct sink_options, count, parse_integer ),
+	OPTION_DESC ( "discard", 'm', no_argument,
+		      struct sink_options, discard, parse_flag ),
+	OPTION_DESC ( "unbuffered", 'u', no_argument,
+		      struct sink_options, unbuffered, parse_flag ),
+};
+
+/** "sink" command descriptor */
+static struct command_descriptor sink_cmd =
+	COMMAND_DESC ( struct sink_options, sink_opts, 1, MAX_ARGUMENTS,
+		       "<command>..." );
+
+/**
+ * "sink" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ *
+ * Execute a command repeatedly via an output sink, and report the
+ * command rate and the number of bytes per backend write.  Use "--"
+ * to separate the command's own options from those of "sink".
+ */
+static int sink_exec ( int argc, char **argv ) {
+	struct sink_options opts;
+	FILE *out = command_output();
+	union sink_backend *backend;
+	struct sink *sink;
+	struct sink_stats *stats;
+	unsigned long start;
+	unsigned long elapsed;
+	char *data = NULL;
+	unsigned int first;
+	unsigned int i;
+	int rc;
+
+	/* Parse options, with defaults */
+	memset ( &opts, 0, sizeof ( opts ) );
+	opts.count = 1;
+	if ( ( rc = reparse_options ( argc, argv, &sink_cmd, &opts ) ) != 0 )
+		goto err_parse;
+	first = optind;
+
+	/* Open sink */
+	backend = malloc ( sizeof ( *backend ) );
+	if ( ! backend ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	sink = &backend->sink;
+	stats = &sink->stats;
+	fflush ( out );
+	if ( opts.discard ) {
+		data = malloc ( SINK_BUF_LEN );
+		if ( ! data ) {
+			rc = -ENOMEM;
+			goto err_data;
+		}
+		backend->memory.data = data;
+		backend->memory.max = SINK_BUF_LEN;
+		backend->memory.len = 0;
+		rc = sink_open ( sink, &memory_sink_operations,
+				 ( ! opts.unbuffered ) );
+	} else if ( fileno ( out ) >= 0 ) {
+		/* Write directly to the command output's file descriptor */
+		backend->fd.fd = fileno ( out );
+		rc = sink_open ( sink, &fd_sink_operations,
+				 ( ! opts.unbuffered ) );
+	} else {
+		/* A network shell session has no file descriptor */
+		backend->stream.stream = out;
+		rc = sink_open ( sink, &stream_sink_operations,
+				 ( ! opts.unbuffered ) );
+	}
+	if ( rc != 0 )
+		goto err_open;
+
+	/* Execute command repeatedly.  The command's own option
+	 * parsing may permute its argument list, so each execution is
+	 * given a fresh copy.
+	 */
+	start = currticks();
+	for ( i = 0 ; i < opts.count ; i++ ) {
+		char *args[ argc - first + 1 ];
+
+		memcpy ( args, &argv[first],
+			 ( ( argc - first ) * sizeof ( args[0] ) ) );
+		args[argc - first] = NULL;
+		if ( opts.discard )
+			backend->memory.len = 0;
+		sink_execv ( sink, args );
+	}
+	elapsed = ( currticks() - start );
+
+	/* Report throughput */
+	cprintf ( "sink: %lu commands in %lu.%03lus (%llu commands/s) "
+		  "via %s%s: %llu bytes in %lu writes "
+		  "(%llu bytes/write)\n",
+		  stats->commands, ( elapsed / TICKS_PER_SEC ),
+		  ( ( elapsed % TICKS_PER_SEC ) / TICKS_PER_MS ),
+		  ( elapsed ? ( ( ( ( unsigned long long ) stats->commands ) *
+				  TICKS_PER_SEC ) / elapsed ) : 0 ),
+		  sink->op->name, ( opts.unbuffered ? " (unbuffered)" : "" ),
+		  stats->bytes, stats->writes,
+		  ( stats->writes ? ( stats->bytes / stats->writes ) : 0 ) );
+
+	sink_close ( sink );
+ err_open:
+	free ( data );
+ err_data:
+	free ( backend );
+ err_alloc:
+ err_parse:
+	return rc;
+}
+
+/** "sink" command */
+struct command sink_command __command = {
+	.name = "sink",
+	.exec = sink_exec,
+};
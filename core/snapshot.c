@@ -0,0 +1,884 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Resource state snapshots
+ *
+ * A snapshot is a compact binary image of the writable state of a
+ * set of resources, as described by each resource descriptor's
+ * property list.  Read-only properties (and resources that cannot be
+ * updated) are omitted, since they could never be restored.  The
+ * image is written sequentially (and so may be streamed to any stdio
+ * stream), and may be restored directly from memory (such as a
+ * memory-mapped file) without first being copied.
+ *
+ * Each record carries a hash of the resource descriptor from which it
+ * was generated.  Records whose hash does not match the current
+ * descriptor are skipped on restore, so that a change to a
+ * descriptor's layout cannot corrupt the resource state.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <uniport/snapshot.h>
+#include <uniport/resource.h>
+#include <uniport/string.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/timer.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/** In-memory snapshot image, if any */
+static char *snapshot_image;
+
+/** Length of in-memory snapshot image */
+static size_t snapshot_len;
+
+/**
+ * Round up to snapshot alignment
+ *
+ * @v len		Length
+ * @ret len		Aligned length
+ */
+static inline size_t snapshot_align ( size_t len ) {
+
+	return ( ( len + SNAPSHOT_ALIGN - 1 ) & ~( SNAPSHOT_ALIGN - 1 ) );
+}
+
+/**
+ * Accumulate integer into hash
+ *
+ * @v hash		Hash (FNV-1a)
+ * @v value		Value
+ * @ret hash		Updated hash
+ */
+static uint32_t snapshot_hash_int ( uint32_t hash, uint32_t value ) {
+
+	return fnv_hash ( hash, &value, sizeof ( value ) );
+}
+
+/**
+ * Accumulate string into hash
+ *
+ * @v hash		Hash (FNV-1a)
+ * @v string		String (including NUL)
+ * @ret hash		Updated hash
+ */
+static uint32_t snapshot_hash_string ( uint32_t hash, const char *string ) {
+
+	return fnv_hash ( hash, string, ( strlen ( string ) + 1 /* NUL */ ) );
+}
+
+/**
+ * Calculate resource descriptor hash
+ *
+ * @v desc		Resource descriptor
+ * @ret hash		Hash
+ *
+ * The hash covers everything that determines the interpretation of a
+ * snapshot record: the state length and each property's name, type,
+ * layout and flags.
+ */
+uint32_t snapshot_hash ( const struct resource_descriptor *desc ) {
+	struct property *prop;
+	uint32_t hash = FNV_OFFSET_BASIS;
+	unsigned int i;
+
+	hash = snapshot_hash_int ( hash, desc->len );
+	hash = snapshot_hash_int ( hash, desc->count );
+	for ( i = 0 ; i < desc->count ; i++ ) {
+		prop = &desc->props[i];
+		hash = snapshot_hash_string ( hash, prop->name );
+		hash = snapshot_hash_string ( hash, prop->type->name );
+		hash = snapshot_hash_int ( hash, prop->offset );
+		hash = snapshot_hash_int ( hash, prop->len );
+		hash = snapshot_hash_int ( hash, prop->flags );
+		hash = snapshot_hash_int ( hash, prop->param );
+	}
+	return hash;
+}
+
+/** Most recently hashed resource descriptor
+ *
+ * Resources sharing a descriptor are typically adjacent within the
+ * resource index, so remembering a single hash avoids almost all
+ * recalculation.
+ */
+struct snapshot_hash_cache {
+	/** Resource descriptor */
+	const struct resource_descriptor *desc;
+	/** Hash */
+	uint32_t hash;
+};
+
+/**
+ * Get resource descriptor hash
+ *
+ * @v cache		Hash cache
+ * @v desc		Resource descriptor
+ * @ret hash		Hash
+ */
+static uint32_t
+snapshot_hash_cached ( struct snapshot_hash_cache *cache,
+		       const struct resource_descriptor *desc ) {
+
+	if ( cache->desc != desc ) {
+		cache->desc = desc;
+		cache->hash = snapshot_hash ( desc );
+	}
+	return cache->hash;
+}
+
+/**
+ * Get length of padded snapshot property value
+ *
+ * @v prop		Property
+ * @v len		Length of value
+ * @ret len		Length of padded value (including header)
+ */
+static size_t snapshot_value_space ( struct property *prop, size_t len ) {
+
+	if ( property_is_indirect ( prop ) )
+		len += 1 /* NUL */;
+	return snapshot_align ( sizeof ( struct snapshot_value ) + len );
+}
+
+/**
+ * Get value data within record buffer
+ *
+ * @v buf		Record buffer
+ * @v offset		Offset of value header
+ * @ret data		Value data
+ */
+static inline void * snapshot_data ( void *buf, size_t offset ) {
+
+	return ( buf + offset + sizeof ( struct snapshot_value ) );
+}
+
+/**
+ * Ensure space within record buffer
+ *
+ * @v buf		Record buffer (may be reallocated)
+ * @v max		Length of record buffer (may be updated)
+ * @v len		Required length
+ * @ret rc		Return status code
+ */
+static int snapshot_reserve ( void **buf, size_t *max, size_t len ) {
+	size_t new_max = ( *max ? *max : 256 );
+	void *new_buf;
+
+	if ( len <= *max )
+		return 0;
+	while ( new_max < len )
+		new_max *= 2;
+	new_buf = realloc ( *buf, new_max );
+	if ( ! new_buf )
+		return -ENOMEM;
+	*buf = new_buf;
+	*max = new_max;
+	return 0;
+}
+
+/**
+ * Construct snapshot record
+ *
+ * @v res		Resource
+ * @v hash		Resource descriptor hash
+ * @v buf		Record buffer (may be reallocated)
+ * @v max		Length of record buffer (may be updated)
+ * @ret len		Length of record, zero to skip, or negative error
+ *
+ * Only writable property values are recorded.  A resource that cannot
+ * be updated, or that has no writable properties, is skipped.
+ *
+ * Indirect values are formatted directly into the record buffer,
+ * which is grown (and the value reformatted) only if the value does
+ * not fit.
+ */
+static ssize_t snapshot_record ( struct resource *res, uint32_t hash,
+				 void **buf, size_t *max ) {
+	const struct resource_descriptor *desc = res->desc;
+	struct snapshot_record *record;
+	struct snapshot_value *value;
+	struct property *prop;
+	const void *state;
+	size_t uri_len;
+	size_t offset;
+	size_t space;
+	size_t need;
+	size_t len;
+	char *data;
+	unsigned int writable = 0;
+	unsigned int i;
+	int rc;
+
+	/* Skip resources with no writable state */
+	if ( desc->update ) {
+		for ( i = 0 ; i < desc->count ; i++ ) {
+			if ( desc->props[i].flags & PROP_RW )
+				writable++;
+		}
+	}
+	if ( ! writable )
+		return 0;
+
+	/* Construct record header and URI */
+	state = resource_retrieve ( res );
+	uri_len = resource_uri ( res, NULL, 0 );
+	if ( ( uri_len > 0xffff ) || ( writable > 0xffff ) )
+		return -ERANGE;
+	offset = snapshot_align ( sizeof ( *record ) + uri_len + 1 /* NUL */ );
+	if ( ( rc = snapshot_reserve ( buf, max, offset ) ) != 0 )
+		return rc;
+	record = *buf;
+	record->hash = hash;
+	record->uri_len = uri_len;
+	record->count = writable;
+	len = resource_uri ( res, ( ( char * ) ( record + 1 ) ),
+			     ( uri_len + 1 /* NUL */ ) );
+	memset ( ( *buf + sizeof ( *record ) + len ), 0,
+		 ( offset - sizeof ( *record ) - len ) );
+
+	/* Construct writable property values */
+	for ( i = 0 ; i < desc->count ; i++ ) {
+		prop = &desc->props[i];
+		if ( ! ( prop->flags & PROP_RW ) )
+			continue;
+		len = ( property_is_indirect ( prop ) ? 0 : prop->len );
+		need = ( offset + snapshot_value_space ( prop, len ) );
+		if ( ( rc = snapshot_reserve ( buf, max, need ) ) != 0 )
+			return rc;
+		if ( property_is_indirect ( prop ) ) {
+			/* Reformat if value does not fit */
+			space = ( *max - offset - sizeof ( *value ) );
+			data = snapshot_data ( *buf, offset );
+			len = property_format ( prop, data, space, state );
+			if ( len >= space ) {
+				need = ( offset +
+					 snapshot_value_space ( prop, len ) );
+				rc = snapshot_reserve ( buf, max, need );
+				if ( rc != 0 )
+					return rc;
+				data = snapshot_data ( *buf, offset );
+				property_format ( prop, data, ( len + 1 ),
+						  state );
+			}
+		} else {
+			memcpy ( snapshot_data ( *buf, offset ),
+				 ( state + prop->offset ), len );
+		}
+		value = ( *buf + offset );
+		value->index = i;
+		value->reserved = 0;
+		value->len = len;
+
+		/* Zero padding */
+		space = snapshot_value_space ( prop, len );
+		if ( property_is_indirect ( prop ) )
+			len += 1 /* NUL */;
+		memset ( ( snapshot_data ( *buf, offset ) + len ), 0,
+			 ( space - sizeof ( *value ) - len ) );
+		offset += space;
+	}
+
+	/* Fill in record length */
+	record = *buf;
+	record->len = offset;
+	return offset;
+}
+
+/**
+ * Save snapshot
+ *
+ * @v file		Output stream
+ * @v pattern		Resource URI pattern
+ * @v stats		Snapshot statistics to fill in
+ * @ret rc		Return status code
+ */
+int snapshot_save ( FILE *file, const char *pattern,
+		    struct snapshot_stats *stats ) {
+	struct snapshot_hash_cache cache = { NULL, 0 };
+	struct snapshot_header hdr;
+	struct snapshot_record end;
+	struct resource *res;
+	size_t prefix_len = glob_prefix_len ( pattern );
+	int any = ( ( pattern[prefix_len] == '*' ) &&
+		    ( ! pattern[ prefix_len + 1 ] ) );
+	void *buf = NULL;
+	size_t max = 0;
+	ssize_t len;
+	unsigned int i;
+	int rc;
+
+	/* Write header */
+	memset ( stats, 0, sizeof ( *stats ) );
+	memset ( &hdr, 0, sizeof ( hdr ) );
+	hdr.magic = SNAPSHOT_MAGIC;
+	hdr.version = SNAPSHOT_VERSION;
+	hdr.len = sizeof ( hdr );
+	if ( fwrite ( &hdr, sizeof ( hdr ), 1, file ) != 1 ) {
+		rc = -EIO;
+		goto err_write;
+	}
+	stats->len += sizeof ( hdr );
+
+	/* Write a record for each matching resource (where a single
+	 * trailing '*' matches any resource sharing the literal prefix)
+	 */
+	for ( i = resource_index_lower ( pattern, prefix_len ) ;
+	      i < resource_index_count ; i++ ) {
+		res = resource_index[i];
+		if ( resource_uri_ncmp ( res, pattern, prefix_len ) != 0 )
+			break;
+		if ( ( ! any ) && ( ! resource_uri_match ( res, pattern ) ) )
+			continue;
+		len = snapshot_record ( res, snapshot_hash_cached ( &cache,
+								    res->desc ),
+					&buf, &max );
+		if ( len < 0 ) {
+			stats->failed++;
+			continue;
+		}
+		if ( len == 0 ) {
+			stats->skipped++;
+			continue;
+		}
+		if ( fwrite ( buf, len, 1, file ) != 1 ) {
+			rc = -EIO;
+			goto err_write;
+		}
+		stats->len += len;
+		stats->resources++;
+	}
+
+	/* Write terminator */
+	memset ( &end, 0, sizeof ( end ) );
+	if ( fwrite ( &end, sizeof ( end ), 1, file ) != 1 ) {
+		rc = -EIO;
+		goto err_write;
+	}
+	stats->len += sizeof ( end );
+
+	rc = 0;
+
+ err_write:
+	free ( buf );
+	return rc;
+}
+
+/**
+ * Find resource described by snapshot record
+ *
+ * @v uri		URI
+ * @v len		Length of URI
+ * @v next		Expected resource index (will be updated)
+ * @ret res		Resource, or NULL if not found
+ *
+ * Records are saved in resource index order, so each record usually
+ * describes the resource following the previous record's resource.
+ */
+static struct resource * snapshot_find ( const char *uri, size_t len,
+					 unsigned int *next ) {
+	unsigned int index = *next;
+
+	/* Fall back to searching the index if not the expected resource */
+	if ( ( index >= resource_index_count ) ||
+	     ( resource_uri_ncmp ( resource_index[index], uri,
+				   ( len + 1 /* NUL */ ) ) != 0 ) ) {
+		index = resource_index_lower ( uri, ( len + 1 /* NUL */ ) );
+		if ( ( index >= resource_index_count ) ||
+		     ( resource_uri_ncmp ( resource_index[index], uri,
+					   ( len + 1 /* NUL */ ) ) != 0 ) )
+			return NULL;
+	}
+
+	*next = ( index + 1 );
+	return resource_index[index];
+}
+
+/**
+ * Restore snapshot record
+ *
+ * @v record		Snapshot record
+ * @v stats		Snapshot statistics to update
+ * @v buf		State buffer (may be reallocated)
+ * @v max		Length of state buffer (may be updated)
+ * @v cache		Hash cache
+ * @v next		Expected resource index (will be updated)
+ * @ret rc		Return status code
+ *
+ * The record must already have been validated as lying within the
+ * image.  A record that cannot be applied to its resource is counted
+ * as failed; only a malformed record or an allocation failure is
+ * returned as an error.
+ */
+static int snapshot_apply ( const struct snapshot_record *record,
+			    struct snapshot_stats *stats, void **buf,
+			    size_t *max, struct snapshot_hash_cache *cache,
+			    unsigned int *next ) {
+	const void *data = record;
+	const void *end = ( data + record->len );
+	const struct snapshot_value *value;
+	const struct resource_descriptor *desc;
+	const char *uri = ( ( const char * ) ( record + 1 ) );
+	struct resource *res;
+	struct property *prop;
+	unsigned int writable = 0;
+	unsigned int i;
+	void *state;
+	int rc;
+
+	/* Identify resource */
+	data += snapshot_align ( sizeof ( *record ) + record->uri_len +
+				 1 /* NUL */ );
+	if ( ( data > end ) || uri[record->uri_len] )
+		return -EBADMSG;
+	res = snapshot_find ( uri, record->uri_len, next );
+	if ( ! res ) {
+		stats->missing++;
+		return 0;
+	}
+	desc = res->desc;
+
+	/* Reject records generated from a different descriptor layout */
+	if ( record->hash != snapshot_hash_cached ( cache, desc ) ) {
+		stats->mismatched++;
+		return 0;
+	}
+
+	/* Skip resources that cannot be updated */
+	if ( ! desc->update ) {
+		stats->skipped++;
+		return 0;
+	}
+
+	/* Copy current state */
+	if ( ( rc = snapshot_reserve ( buf, max, desc->len ) ) != 0 )
+		return rc;
+	state = *buf;
+	memcpy ( state, resource_retrieve ( res ), desc->len );
+
+	/* Apply writable property values.  Indirect values are parsed
+	 * directly from the image, which must remain valid until the
+	 * update is complete.
+	 */
+	for ( i = 0 ; i < record->count ; i++ ) {
+		value = data;
+		rc = -EBADMSG;
+		if ( ( data + sizeof ( *value ) ) > end )
+			goto err_value;
+		if ( value->index >= desc->count )
+			goto err_value;
+		prop = &desc->props[value->index];
+		data += snapshot_value_space ( prop, value->len );
+		if ( data > end )
+			goto err_value;
+		if ( ! ( prop->flags & PROP_RW ) )
+			continue;
+		if ( property_is_indirect ( prop ) ) {
+			if ( ( ( const char * ) ( value + 1 ) )[value->len] )
+				goto err_value;
+			if ( ( rc = property_parse ( prop,
+						     ( ( const char * )
+						       ( value + 1 ) ),
+						     state ) ) != 0 )
+				goto err_parse;
+		} else {
+			if ( value->len != prop->len )
+				goto err_value;
+			memcpy ( ( state + prop->offset ), ( value + 1 ),
+				 value->len );
+		}
+		writable++;
+	}
+	if ( ! writable ) {
+		stats->skipped++;
+		return 0;
+	}
+
+	/* Update resource state */
+	if ( ( rc = resource_update ( res, state ) ) != 0 ) {
+		stats->failed++;
+		return 0;
+	}
+
+	stats->resources++;
+	return 0;
+
+ err_parse:
+	stats->failed++;
+	rc = 0;
+ err_value:
+	resource_discard ( res, state );
+	return rc;
+}
+
+/**
+ * Restore snapshot
+ *
+ * @v image		Snapshot image
+ * @v len		Length of snapshot image
+ * @v stats		Snapshot statistics to fill in
+ * @ret rc		Return status code
+ *
+ * Each writable property value within the image is applied via
+ * resource_update().  Records that cannot be applied are counted and
+ * skipped; a malformed image aborts the restore with -EBADMSG.
+ */
+int snapshot_restore ( const void *image, size_t len,
+		       struct snapshot_stats *stats ) {
+	struct snapshot_hash_cache cache = { NULL, 0 };
+	const struct snapshot_header *hdr = image;
+	const struct snapshot_record *record;
+	const void *data = image;
+	const void *end = ( data + len );
+	unsigned int next = 0;
+	void *buf = NULL;
+	size_t max = 0;
+	int rc;
+
+	/* Validate header */
+	memset ( stats, 0, sizeof ( *stats ) );
+	if ( ( len < sizeof ( *hdr ) ) || ( hdr->magic != SNAPSHOT_MAGIC ) ||
+	     ( hdr->len < sizeof ( *hdr ) ) || ( hdr->len > len ) ||
+	     ( hdr->len & ( SNAPSHOT_ALIGN - 1 ) ) ) {
+		rc = -EBADMSG;
+		goto err_header;
+	}
+	if ( hdr->version != SNAPSHOT_VERSION ) {
+		rc = -ENOTSUP;
+		goto err_header;
+	}
+	data += hdr->len;
+
+	/* Apply each record */
+	while ( 1 ) {
+		record = data;
+		if ( ( data + sizeof ( *record ) ) > end ) {
+			rc = -EBADMSG;
+			goto err_record;
+		}
+		if ( ! record->len )
+			break;
+		if ( ( record->len < sizeof ( *record ) ) ||
+		     ( record->len & ( SNAPSHOT_ALIGN - 1 ) ) ||
+		     ( record->len > ( size_t ) ( end - data ) ) ) {
+			rc = -EBADMSG;
+			goto err_record;
+		}
+		if ( ( rc = snapshot_apply ( record, stats, &buf, &max,
+					     &cache, &next ) ) != 0 )
+			goto err_record;
+		data += record->len;
+	}
+	stats->len = ( data + sizeof ( *record ) - image );
+
+	rc = 0;
+
+ err_record:
+	free ( buf );
+ err_header:
+	return rc;
+}
+
+/**
+ * Map snapshot file
+ *
+ * @v name		File name
+ * @v image		Image to fill in
+ * @v len		Length of image to fill in
+ * @ret rc		Return status code
+ *
+ * On platforms without mmap(), the file is read into memory.
+ */
+static int snapshot_map ( const char *name, void **image, size_t *len ) {
+#ifdef __linux__
+	struct stat st;
+	int fd;
+	int rc;
+
+	fd = open ( name, O_RDONLY );
+	if ( fd < 0 ) {
+		rc = -errno;
+		goto err_open;
+	}
+	if ( fstat ( fd, &st ) != 0 ) {
+		rc = -errno;
+		goto err_stat;
+	}
+	*len = st.st_size;
+	*image = mmap ( NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0 );
+	if ( *image == MAP_FAILED ) {
+		rc = -errno;
+		goto err_mmap;
+	}
+	close ( fd );
+	return 0;
+
+ err_mmap:
+ err_stat:
+	close ( fd );
+ err_open:
+	return rc;
+#else
+	FILE *file;
+	long size;
+	int rc;
+
+	file = fopen ( name, "rb" );
+	if ( ! file ) {
+		rc = -errno;
+		goto err_open;
+	}
+	if ( ( fseek ( file, 0, SEEK_END ) != 0 ) ||
+	     ( ( size = ftell ( file ) ) < 0 ) ||
+	     ( fseek ( file, 0, SEEK_SET ) != 0 ) ) {
+		rc = -EIO;
+		goto err_size;
+	}
+	*len = size;
+	*image = malloc ( size );
+	if ( ! *image ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	if ( fread ( *image, size, 1, file ) != 1 ) {
+		rc = -EIO;
+		goto err_read;
+	}
+	fclose ( file );
+	return 0;
+
+ err_read:
+	free ( *image );
+ err_alloc:
+ err_size:
+	fclose ( file );
+ err_open:
+	return rc;
+#endif
+}
+
+/**
+ * Unmap snapshot file
+ *
+ * @v image		Image
+ * @v len		Length of image
+ */
+static void snapshot_unmap ( void *image, size_t len ) {
+#ifdef __linux__
+	munmap ( image, len );
+#else
+	( void ) len;
+	free ( image );
+#endif
+}
+
+/**
+ * Print snapshot statistics
+ *
+ * @v name		Command name
+ * @v stats		Snapshot statistics
+ * @v elapsed		Elapsed time (in ticks)
+ */
+static void snapshot_print ( const char *name, struct snapshot_stats *stats,
+			     unsigned long elapsed ) {
+
+	cprintf ( "%s: %u resources, %zu bytes in %lu.%03lums",
+		  name, stats->resources, stats->len,
+		  ( elapsed / TICKS_PER_MS ),
+		  ( ( ( elapsed % TICKS_PER_MS ) * 1000 ) / TICKS_PER_MS ) );
+	if ( stats->skipped )
+		cprintf ( ", %u skipped", stats->skipped );
+	if ( stats->missing )
+		cprintf ( ", %u missing", stats->missing );
+	if ( stats->mismatched )
+		cprintf ( ", %u mismatched", stats->mismatched );
+	if ( stats->failed )
+		cprintf ( ", %u failed", stats->failed );
+	cprintf ( "\n" );
+}
+
+/** "snapshot" options */
+struct snapshot_options {
+	/** File name */
+	char *file;
+};
+
+/** "snapshot" option list */
+static struct option_descriptor snapshot_opts[] = {
+	OPTION_DESC ( "file", 'f', required_argument,
+		      struct snapshot_options, file, parse_string ),
+};
+
+/** "snapshot" command descriptor */
+static struct command_descriptor snapshot_cmd =
+	COMMAND_DESC ( struct snapshot_options, snapshot_opts, 0, 1,
+		       "[<uri-pattern>]" );
+
+/**
+ * "snapshot" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ *
+ * Without a file name, the snapshot is held in memory (replacing any
+ * previous in-memory snapshot).
+ */
+static int snapshot_exec ( int argc, char **argv ) {
+	struct snapshot_options opts;
+	struct snapshot_stats stats;
+	const char *pattern;
+	unsigned long start;
+	char *image = NULL;
+	size_t len = 0;
+	FILE *file;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &snapshot_cmd, &opts ) ) != 0 )
+		goto err_parse;
+	pattern = ( ( optind < argc ) ? argv[optind] : "*" );
+
+	/* Open output stream */
+	if ( opts.file ) {
+		file = fopen ( opts.file, "wb" );
+	} else {
+		file = open_memstream ( &image, &len );
+	}
+	if ( ! file ) {
+		rc = -errno;
+		cprintf ( "%s: %s\n", ( opts.file ? opts.file : "memory" ),
+			  strerror ( errno ) );
+		goto err_open;
+	}
+
+	/* Save snapshot */
+	start = currticks();
+	rc = snapshot_save ( file, pattern, &stats );
+	if ( fclose ( file ) != 0 )
+		rc = -EIO;
+	if ( rc != 0 ) {
+		cprintf ( "snapshot: %s\n", strerror ( rc ) );
+		goto err_save;
+	}
+	snapshot_print ( "snapshot", &stats, ( currticks() - start ) );
+
+	/* Replace in-memory snapshot, if applicable */
+	if ( ! opts.file ) {
+		free ( snapshot_image );
+		snapshot_image = image;
+		snapshot_len = len;
+		image = NULL;
+	}
+
+ err_save:
+	free ( image );
+ err_open:
+ err_parse:
+	return rc;
+}
+
+/** "snapshot" command */
+struct command snapshot_command __command = {
+	.name = "snapshot",
+	.exec = snapshot_exec,
+};
+
+/** "restore" option list */
+static struct option_descriptor restore_opts[] = {
+	OPTION_DESC ( "file", 'f', required_argument,
+		      struct snapshot_options, file, parse_string ),
+};
+
+/** "restore" command descriptor */
+static struct command_descriptor restore_cmd =
+	COMMAND_DESC ( struct snapshot_options, restore_opts, 0, 0, "" );
+
+/**
+ * "restore" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ *
+ * Without a file name, the most recent in-memory snapshot is
+ * restored.
+ */
+static int restore_exec ( int argc, char **argv ) {
+	struct snapshot_options opts;
+	struct snapshot_stats stats;
+	unsigned long start;
+	void *image;
+	size_t len = 0;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &restore_cmd, &opts ) ) != 0 )
+		goto err_parse;
+
+	/* Locate image */
+	if ( opts.file ) {
+		if ( ( rc = snapshot_map ( opts.file, &image, &len ) ) != 0 ) {
+			cprintf ( "%s: %s\n", opts.file, strerror ( rc ) );
+			goto err_map;
+		}
+	} else if ( snapshot_image ) {
+		image = snapshot_image;
+		len = snapshot_len;
+	} else {
+		cprintf ( "restore: no snapshot\n" );
+		rc = -ENOENT;
+		goto err_map;
+	}
+
+	/* Restore snapshot */
+	start = currticks();
+	rc = snapshot_restore ( image, len, &stats );
+	if ( rc != 0 ) {
+		cprintf ( "restore: %s\n", strerror ( rc ) );
+		goto err_restore;
+	}
+	snapshot_print ( "restore", &stats, ( currticks() - start ) );
+
+ err_restore:
+	if ( opts.file )
+		snapshot_unmap ( image, len );
+ err_map:
+ err_parse:
+	return rc;
+}
+
+/** "restore" command */
+struct command restore_command __command = {
+	.name = "restore",
+	.exec = restore_exec,
+};
@@ -24,8 +24,21 @@
  *
  */
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
 #include <uniport/string.h>
 
+/** Powers of ten, indexed by number of decimal places */
+const uint32_t powers_of_ten[ FIXED_SCALE_MAX + 1 ] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+	1000000000,
+};
+
 /**
  * Calculate digit value
  *
@@ -45,3 +58,341 @@ unsigned int digit_value ( unsigned int character ) {
 		return ( character - '0' );
 	return character;
 }
+
+/** Build a two-character decimal pair */
+#define DECIMAL_PAIR( x ) { ( '0' + ( (x) / 10 ) ), ( '0' + ( (x) % 10 ) ) }
+
+/** Build a row of ten decimal pairs */
+#define DECIMAL_ROW( x )						\
+	DECIMAL_PAIR ( (x) + 0 ), DECIMAL_PAIR ( (x) + 1 ),		\
+	DECIMAL_PAIR ( (x) + 2 ), DECIMAL_PAIR ( (x) + 3 ),		\
+	DECIMAL_PAIR ( (x) + 4 ), DECIMAL_PAIR ( (x) + 5 ),		\
+	DECIMAL_PAIR ( (x) + 6 ), DECIMAL_PAIR ( (x) + 7 ),		\
+	DECIMAL_PAIR ( (x) + 8 ), DECIMAL_PAIR ( (x) + 9 )
+
+/** Decimal digit pairs "00" to "99" */
+static const char decimal_pairs[100][2] = {
+	DECIMAL_ROW ( 0 ), DECIMAL_ROW ( 10 ), DECIMAL_ROW ( 20 ),
+	DECIMAL_ROW ( 30 ), DECIMAL_ROW ( 40 ), DECIMAL_ROW ( 50 ),
+	DECIMAL_ROW ( 60 ), DECIMAL_ROW ( 70 ), DECIMAL_ROW ( 80 ),
+	DECIMAL_ROW ( 90 ),
+};
+
+/** Build a lower-case hexadecimal digit */
+#define HEX_DIGIT( x ) ( ( (x) < 10 ) ? ( '0' + (x) ) : ( 'a' + (x) - 10 ) )
+
+/** Build a two-character hexadecimal pair */
+#define HEX_PAIR( x ) { HEX_DIGIT ( (x) >> 4 ), HEX_DIGIT ( (x) & 0xf ) }
+
+/** Build a row of sixteen hexadecimal pairs */
+#define HEX_ROW( x )							\
+	HEX_PAIR ( (x) + 0x0 ), HEX_PAIR ( (x) + 0x1 ),			\
+	HEX_PAIR ( (x) + 0x2 ), HEX_PAIR ( (x) + 0x3 ),			\
+	HEX_PAIR ( (x) + 0x4 ), HEX_PAIR ( (x) + 0x5 ),			\
+	HEX_PAIR ( (x) + 0x6 ), HEX_PAIR ( (x) + 0x7 ),			\
+	HEX_PAIR ( (x) + 0x8 ), HEX_PAIR ( (x) + 0x9 ),			\
+	HEX_PAIR ( (x) + 0xa ), HEX_PAIR ( (x) + 0xb ),			\
+	HEX_PAIR ( (x) + 0xc ), HEX_PAIR ( (x) + 0xd ),			\
+	HEX_PAIR ( (x) + 0xe ), HEX_PAIR ( (x) + 0xf )
+
+/** Hexadecimal digit pairs "00" to "ff" */
+static const char hex_pairs[256][2] = {
+	HEX_ROW ( 0x00 ), HEX_ROW ( 0x10 ), HEX_ROW ( 0x20 ), HEX_ROW ( 0x30 ),
+	HEX_ROW ( 0x40 ), HEX_ROW ( 0x50 ), HEX_ROW ( 0x60 ), HEX_ROW ( 0x70 ),
+	HEX_ROW ( 0x80 ), HEX_ROW ( 0x90 ), HEX_ROW ( 0xa0 ), HEX_ROW ( 0xb0 ),
+	HEX_ROW ( 0xc0 ), HEX_ROW ( 0xd0 ), HEX_ROW ( 0xe0 ), HEX_ROW ( 0xf0 ),
+};
+
+/**
+ * Format string into buffer
+ *
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v string		String to copy
+ * @v string_len	Length of string to copy
+ * @ret len		Length of string
+ *
+ * The string is truncated and NUL-terminated in the same way as
+ * snprintf().  The buffer may be NULL if its length is zero.
+ */
+size_t format_string ( char *buf, size_t len, const char *string,
+		       size_t string_len ) {
+	size_t copy_len;
+
+	/* Copy as much as will fit, leaving room for the NUL */
+	if ( len ) {
+		copy_len = ( ( string_len < len ) ? string_len : ( len - 1 ) );
+		memcpy ( buf, string, copy_len );
+		buf[copy_len] = '\0';
+	}
+
+	return string_len;
+}
+
+/**
+ * Format decimal integer into buffer
+ *
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		Integer value
+ * @ret len		Length of string
+ */
+size_t format_decimal ( char *buf, size_t len, int value ) {
+	char digits[ DECIMAL_MAX_LEN ];
+	char *end = &digits[ sizeof ( digits ) ];
+	char *tmp = end;
+	unsigned int magnitude;
+	unsigned int pair;
+
+	/* Work with the magnitude, avoiding overflow on INT_MIN */
+	magnitude = ( ( value < 0 ) ? ( 0U - ( unsigned int ) value ) :
+		      ( unsigned int ) value );
+
+	/* Generate digits two at a time, starting from the end */
+	while ( magnitude >= 100 ) {
+		pair = ( magnitude % 100 );
+		magnitude /= 100;
+		tmp -= 2;
+		memcpy ( tmp, decimal_pairs[pair], 2 );
+	}
+	if ( magnitude >= 10 ) {
+		tmp -= 2;
+		memcpy ( tmp, decimal_pairs[magnitude], 2 );
+	} else {
+		*(--tmp) = ( '0' + magnitude );
+	}
+	if ( value < 0 )
+		*(--tmp) = '-';
+
+	return format_string ( buf, len, tmp, ( end - tmp ) );
+}
+
+/**
+ * Format fixed-point decimal number into buffer
+ *
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v value		Value, in units of ( 10 ^ -scale )
+ * @v scale		Number of decimal places
+ * @ret len		Length of string
+ */
+size_t format_fixed ( char *buf, size_t len, int64_t value,
+		      unsigned int scale ) {
+	char digits[ FIXED_MAX_LEN ];
+	char *end = &digits[ sizeof ( digits ) ];
+	char *tmp = end;
+	uint64_t magnitude;
+	unsigned int i;
+
+	assert ( scale <= FIXED_SCALE_MAX );
+
+	/* Work with the magnitude, avoiding overflow on INT64_MIN */
+	magnitude = ( ( value < 0 ) ? ( 0ULL - ( uint64_t ) value ) :
+		      ( uint64_t ) value );
+
+	/* Generate fractional digits, starting from the end */
+	for ( i = 0 ; i < scale ; i++ ) {
+		*(--tmp) = ( '0' + ( magnitude % 10 ) );
+		magnitude /= 10;
+	}
+	if ( scale )
+		*(--tmp) = '.';
+
+	/* Generate integer digits, including any leading zero */
+	do {
+		*(--tmp) = ( '0' + ( magnitude % 10 ) );
+		magnitude /= 10;
+	} while ( magnitude );
+	if ( value < 0 )
+		*(--tmp) = '-';
+
+	return format_string ( buf, len, tmp, ( end - tmp ) );
+}
+
+/**
+ * Parse fixed-point decimal number
+ *
+ * @v string		String
+ * @v scale		Number of decimal places
+ * @v value		Value to fill in, in units of ( 10 ^ -scale )
+ * @ret rc		Return status code
+ *
+ * Any digits beyond the specified number of decimal places are used
+ * only to round the result.
+ */
+int parse_fixed ( const char *string, unsigned int scale, int64_t *value ) {
+	uint64_t magnitude = 0;
+	unsigned int places = 0;
+	unsigned int digit;
+	bool negative = false;
+	bool fraction = false;
+	bool round = false;
+	bool any = false;
+
+	assert ( scale <= FIXED_SCALE_MAX );
+
+	/* Parse sign */
+	if ( ( *string == '-' ) || ( *string == '+' ) )
+		negative = ( *(string++) == '-' );
+
+	/* Parse digits */
+	for ( ; *string ; string++ ) {
+		if ( ( *string == '.' ) && ! fraction ) {
+			fraction = true;
+			continue;
+		}
+		digit = ( *string - '0' );
+		if ( digit >= 10 )
+			return -EINVAL;
+		any = true;
+		if ( fraction && ( places >= scale ) ) {
+			/* Round using the first excess digit only */
+			if ( places++ == scale )
+				round = ( digit >= 5 );
+			continue;
+		}
+		if ( magnitude > ( ( ( ( uint64_t ) INT64_MAX ) - digit ) / 10 ) )
+			return -ERANGE;
+		magnitude = ( ( magnitude * 10 ) + digit );
+		if ( fraction )
+			places++;
+	}
+	if ( ! any )
+		return -EINVAL;
+
+	/* Scale to required number of decimal places */
+	for ( ; places < scale ; places++ ) {
+		if ( magnitude > ( INT64_MAX / 10 ) )
+			return -ERANGE;
+		magnitude *= 10;
+	}
+	if ( round && ( magnitude++ == INT64_MAX ) )
+		return -ERANGE;
+
+	*value = ( negative ? -( ( int64_t ) magnitude ) :
+		   ( ( int64_t ) magnitude ) );
+	return 0;
+}
+
+/**
+ * Parse integer
+ *
+ * @v string		String
+ * @v end		End of parsed integer to fill in
+ * @v value		Value to fill in
+ * @ret rc		Return status code
+ *
+ * The integer may be decimal, hexadecimal (with a "0x" prefix) or
+ * octal (with a "0" prefix), as for strtol().  Unlike strtol(),
+ * leading whitespace, an empty string, and values that do not fit
+ * within an int are all rejected.
+ */
+int parse_int ( const char *string, const char **end, int *value ) {
+	char *tmp;
+	long result;
+
+	/* Parse integer */
+	if ( ( *string != '-' ) && ( *string != '+' ) &&
+	     ( digit_value ( *string ) >= 10 ) )
+		return -EINVAL;
+	errno = 0;
+	result = strtol ( string, &tmp, 0 );
+	if ( tmp == string )
+		return -EINVAL;
+	if ( ( errno == ERANGE ) || ( result < INT_MIN ) ||
+	     ( result > INT_MAX ) )
+		return -ERANGE;
+
+	*end = tmp;
+	*value = result;
+	return 0;
+}
+
+/**
+ * Encode data as lower-case hexadecimal
+ *
+ * @v out		Output buffer
+ * @v data		Data to encode
+ * @v len		Length of data
+ * @ret end		End of output
+ *
+ * The output buffer must have room for exactly twice the length of
+ * the data.  No terminating NUL is written.
+ */
+char * hex_encode ( char *out, const void *data, size_t len ) {
+	const uint8_t *byte = data;
+
+	while ( len-- ) {
+		memcpy ( out, hex_pairs[ *(byte++) ], 2 );
+		out += 2;
+	}
+	return out;
+}
+
+/**
+ * Accumulate data into hash
+ *
+ * @v hash		Hash (FNV-1a), or FNV_OFFSET_BASIS to start
+ * @v data		Data
+ * @v len		Length of data
+ * @ret hash		Updated hash
+ */
+uint32_t fnv_hash ( uint32_t hash, const void *data, size_t len ) {
+	const uint8_t *byte = data;
+
+	while ( len-- ) {
+		hash ^= *(byte++);
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+/**
+ * Match string against a glob pattern
+ *
+ * @v pattern		Pattern
+ * @v string		String
+ * @ret match		String matches pattern
+ *
+ * The pattern may contain '*' to match any sequence of characters
+ * (including '/'), and '?' to match any single character.
+ */
+bool glob_match ( const char *pattern, const char *string ) {
+	const char *star = NULL;
+	const char *resume = NULL;
+
+	while ( *string ) {
+		if ( *pattern == '*' ) {
+			/* Record backtracking point */
+			star = pattern++;
+			resume = string;
+		} else if ( ( *pattern == '?' ) || ( *pattern == *string ) ) {
+			/* Match single character */
+			pattern++;
+			string++;
+		} else if ( star ) {
+			/* Backtrack, extending the most recent '*' */
+			pattern = ( star + 1 );
+			string = ++resume;
+		} else {
+			return false;
+		}
+	}
+
+	/* Allow trailing '*'s to match an empty string */
+	while ( *pattern == '*' )
+		pattern++;
+
+	return ( ! *pattern );
+}
+
+/**
+ * Get length of literal prefix of a glob pattern
+ *
+ * @v pattern		Pattern
+ * @ret len		Length of literal prefix
+ */
+size_t glob_prefix_len ( const char *pattern ) {
+
+	return strcspn ( pattern, "*?" );
+}
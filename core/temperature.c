@@ -25,8 +25,13 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#include <uniport/string.h>
+#include <uniport/bench.h>
+#include <uniport/command.h>
+#include <uniport/timer.h>
 #define TEMPERATURE_CONVERSION_PREFIX extern inline
 #include <uniport/temperature.h>
 
@@ -39,12 +44,13 @@
  * @v value		State variable
  * @ret len		Length of string
  */
-static size_t temperature_units_format ( struct property *prop __unused,
-					 char *buf, size_t len,
-					 const enum temperature_units *value ) {
+size_t temperature_units_format ( struct property *prop __unused,
+				  char *buf, size_t len,
+				  const enum temperature_units *value ) {
+	char unit = *value;
 
 	/* Format string */
-	return snprintf ( buf, len, "%c", *value );
+	return format_string ( buf, len, &unit, 1 );
 }
 
 /**
@@ -55,9 +61,9 @@ static size_t temperature_units_format ( struct property *prop __unused,
  * @v value		State variable
  * @ret rc		Return status code
  */
-static int temperature_units_parse ( struct property *prop __unused,
-				     const char *string,
-				     enum temperature_units *value ) {
+int temperature_units_parse ( struct property *prop __unused,
+			      const char *string,
+			      enum temperature_units *value ) {
 	int c;
 	int unit;
 
@@ -81,7 +87,7 @@ static int temperature_units_parse ( struct property *prop __unused,
 	 * key letters 'C', 'F', or 'K'.
 	 */
 	*value = 0;
-	while ( ( c = *(string++) ) ) {
+	while ( ( c = *( ( const unsigned char * ) string++ ) ) ) {
 		unit = toupper ( c );
 		switch ( unit ) {
 		case TEMPERATURE_UNITS_C:
@@ -103,6 +109,305 @@ static int temperature_units_parse ( struct property *prop __unused,
 }
 
 /** Temperature units property type */
-const struct property_type temperature_units_property =
+const struct property_type temperature_units_property __property_type =
 	PROPERTY_TYPE ( "C/F/K", enum temperature_units,
 			temperature_units_format, temperature_units_parse );
+
+/**
+ * Divide, rounding to nearest
+ *
+ * @v dividend		Dividend
+ * @v divisor		Divisor (must be positive)
+ * @ret quotient	Rounded quotient
+ */
+static int64_t temperature_divide ( int64_t dividend, int64_t divisor ) {
+
+	return ( ( dividend + ( ( dividend < 0 ) ? -( divisor / 2 ) :
+				( divisor / 2 ) ) ) / divisor );
+}
+
+/**
+ * Convert fixed-point temperature to Celsius
+ *
+ * @v temperature	Temperature
+ * @v units		Temperature units
+ * @v one		One degree, in fixed-point units
+ * @ret celsius		Temperature in Celsius
+ */
+static int64_t temperature_fixed_celsius ( int64_t temperature,
+					   enum temperature_units units,
+					   int64_t one ) {
+
+	switch ( units ) {
+	case TEMPERATURE_UNITS_F:
+		return temperature_divide ( ( ( temperature - ( 32 * one ) )
+					      * 5 ), 9 );
+	case TEMPERATURE_UNITS_K:
+		return ( temperature - temperature_divide ( ( 27315 * one ),
+							    100 ) );
+	default:
+		return temperature;
+	}
+}
+
+/**
+ * Convert fixed-point temperature to Celsius
+ *
+ * @v temperature	Temperature, in units of ( 10 ^ -scale ) degrees
+ * @v units		Temperature units
+ * @v scale		Number of decimal places
+ * @ret celsius		Temperature in Celsius
+ */
+int temperature_to_celsius_fixed ( int temperature,
+				   enum temperature_units units,
+				   unsigned int scale ) {
+	int64_t one = powers_of_ten[scale];
+
+	return temperature_fixed_celsius ( temperature, units, one );
+}
+
+/**
+ * Convert fixed-point temperature to Fahrenheit
+ *
+ * @v temperature	Temperature, in units of ( 10 ^ -scale ) degrees
+ * @v units		Temperature units
+ * @v scale		Number of decimal places
+ * @ret fahrenheit	Temperature in Fahrenheit
+ */
+int temperature_to_fahrenheit_fixed ( int temperature,
+				      enum temperature_units units,
+				      unsigned int scale ) {
+	int64_t one = powers_of_ten[scale];
+	int64_t celsius;
+
+	if ( units == TEMPERATURE_UNITS_F )
+		return temperature;
+	celsius = temperature_fixed_celsius ( temperature, units, one );
+	return ( temperature_divide ( ( celsius * 9 ), 5 ) + ( 32 * one ) );
+}
+
+/**
+ * Convert fixed-point temperature to Kelvin
+ *
+ * @v temperature	Temperature, in units of ( 10 ^ -scale ) degrees
+ * @v units		Temperature units
+ * @v scale		Number of decimal places
+ * @ret kelvin		Temperature in Kelvin
+ */
+int temperature_to_kelvin_fixed ( int temperature,
+				  enum temperature_units units,
+				  unsigned int scale ) {
+	int64_t one = powers_of_ten[scale];
+	int64_t celsius;
+
+	if ( units == TEMPERATURE_UNITS_K )
+		return temperature;
+	celsius = temperature_fixed_celsius ( temperature, units, one );
+	return ( celsius + temperature_divide ( ( 27315 * one ), 100 ) );
+}
+
+/**
+ * Check temperature units
+ *
+ * @v units		Temperature units
+ * @ret valid		Temperature units are valid
+ */
+static int temperature_units_valid ( enum temperature_units units ) {
+
+	switch ( units ) {
+	case TEMPERATURE_UNITS_C:
+	case TEMPERATURE_UNITS_F:
+	case TEMPERATURE_UNITS_K:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/** Define a bulk temperature conversion kernel
+ *
+ * The kernel is a simple loop with no conditional branches, which
+ * the compiler is able to vectorise.
+ */
+#define TEMPERATURE_KERNEL( source, target, type, ops )			\
+	static void source ## _to_ ## target ## _array_ ## type (	\
+		const type *src, type *dst, size_t count		\
+	) {								\
+		size_t i;						\
+									\
+		for ( i = 0 ; i < count ; i++ ) {			\
+			dst[i] = source ## _to_ ## target ## _ ## ops (	\
+				src[i] );				\
+		}							\
+	}
+
+/** Construct a key for a pair of temperature units */
+#define TEMPERATURE_PAIR( from, to ) ( ( (from) << 8 ) | (to) )
+
+/** Define a bulk temperature conversion function */
+#define TEMPERATURE_CONVERSION_ARRAY( type, ops )			\
+	TEMPERATURE_KERNEL ( celsius, fahrenheit, type, ops );		\
+	TEMPERATURE_KERNEL ( celsius, kelvin, type, ops );		\
+	TEMPERATURE_KERNEL ( fahrenheit, celsius, type, ops );		\
+	TEMPERATURE_KERNEL ( fahrenheit, kelvin, type, ops );		\
+	TEMPERATURE_KERNEL ( kelvin, celsius, type, ops );		\
+	TEMPERATURE_KERNEL ( kelvin, fahrenheit, type, ops );		\
+	int temperature_convert_array_ ## type (			\
+		const type *src, type *dst, size_t count,		\
+		enum temperature_units from, enum temperature_units to	\
+	) {								\
+		switch ( TEMPERATURE_PAIR ( from, to ) ) {		\
+		case TEMPERATURE_PAIR ( TEMPERATURE_UNITS_C,		\
+					TEMPERATURE_UNITS_F ):		\
+			celsius_to_fahrenheit_array_ ## type (		\
+				src, dst, count );			\
+			break;						\
+		case TEMPERATURE_PAIR ( TEMPERATURE_UNITS_C,		\
+					TEMPERATURE_UNITS_K ):		\
+			celsius_to_kelvin_array_ ## type ( src, dst,	\
+							   count );	\
+			break;						\
+		case TEMPERATURE_PAIR ( TEMPERATURE_UNITS_F,		\
+					TEMPERATURE_UNITS_C ):		\
+			fahrenheit_to_celsius_array_ ## type (		\
+				src, dst, count );			\
+			break;						\
+		case TEMPERATURE_PAIR ( TEMPERATURE_UNITS_F,		\
+					TEMPERATURE_UNITS_K ):		\
+			fahrenheit_to_kelvin_array_ ## type ( src, dst,	\
+							     count );	\
+			break;						\
+		case TEMPERATURE_PAIR ( TEMPERATURE_UNITS_K,		\
+					TEMPERATURE_UNITS_C ):		\
+			kelvin_to_celsius_array_ ## type ( src, dst,	\
+							   count );	\
+			break;						\
+		case TEMPERATURE_PAIR ( TEMPERATURE_UNITS_K,		\
+					TEMPERATURE_UNITS_F ):		\
+			kelvin_to_fahrenheit_array_ ## type ( src, dst,	\
+							     count );	\
+			break;						\
+		default:						\
+			if ( ( from != to ) ||				\
+			     ( ! temperature_units_valid ( from ) ) )	\
+				return -EINVAL;				\
+			if ( dst != src )				\
+				memmove ( dst, src,			\
+					  ( count * sizeof ( dst[0] ) ) );\
+			break;						\
+		}							\
+		return 0;						\
+	}
+
+/**
+ * Convert array of temperatures
+ *
+ * @v src		Source temperatures
+ * @v dst		Destination temperatures (may be the same as source)
+ * @v count		Number of temperatures
+ * @v from		Source temperature units
+ * @v to		Destination temperature units
+ * @ret rc		Return status code
+ *
+ * The choice of conversion is made once for the whole array, rather
+ * than once per temperature.  Results are identical to those of the
+ * corresponding scalar conversions.  Invalid units are rejected
+ * without modifying the destination.
+ */
+TEMPERATURE_CONVERSION_ARRAY ( int, integer );
+TEMPERATURE_CONVERSION_ARRAY ( float, single );
+TEMPERATURE_CONVERSION_ARRAY ( double, floating );
+
+/******************************************************************************
+ *
+ * Benchmarks
+ *
+ ******************************************************************************
+ */
+
+/** Number of temperatures converted by each benchmark step */
+#define TEMPERATURE_BENCH_LEN 64
+
+/** Source temperature units for benchmarks
+ *
+ * This is volatile so that the scalar baseline cannot be specialised
+ * for known units at compile time.
+ */
+static volatile enum temperature_units temperature_bench_units =
+	TEMPERATURE_UNITS_C;
+
+/** Define a bulk temperature conversion benchmark */
+#define TEMPERATURE_BENCH( type )					\
+	static int temperature_bench_ ## type ( unsigned int count ) {	\
+		static type src[TEMPERATURE_BENCH_LEN];			\
+		static type scalar[TEMPERATURE_BENCH_LEN];		\
+		static type array[TEMPERATURE_BENCH_LEN];		\
+		unsigned long long ops = 0;				\
+		unsigned long start;					\
+		unsigned long ticks;					\
+		unsigned int done;					\
+		unsigned int i;						\
+		int rc;							\
+									\
+		for ( i = 0 ; i < TEMPERATURE_BENCH_LEN ; i++ )		\
+			src[i] = ( ( type ) i - 40 );			\
+		start = currticks();					\
+		for ( done = 0 ; done < count ;				\
+		      done += TEMPERATURE_BENCH_LEN ) {			\
+			for ( i = 0 ; i < TEMPERATURE_BENCH_LEN ; i++ )	\
+				scalar[i] = temperature_to_fahrenheit_ ## type \
+					( src[i], temperature_bench_units );\
+			ops += TEMPERATURE_BENCH_LEN;			\
+		}							\
+		ticks = ( currticks() - start );			\
+		bench_report ( "temperature", #type "/scalar", ticks, ops );\
+		start = currticks();					\
+		for ( done = 0 ; done < count ;				\
+		      done += TEMPERATURE_BENCH_LEN ) {			\
+			if ( ( rc = temperature_convert_array_ ## type	\
+			       ( src, array, TEMPERATURE_BENCH_LEN,	\
+				 temperature_bench_units,		\
+				 TEMPERATURE_UNITS_F ) ) != 0 )		\
+				return rc;				\
+		}							\
+		ticks = ( currticks() - start );			\
+		bench_report ( "temperature", #type "/array", ticks, ops );\
+		if ( memcmp ( scalar, array, sizeof ( array ) ) ) {	\
+			cprintf ( "temperature: %s array != scalar\n",	\
+				  #type );				\
+			return -EIO;					\
+		}							\
+		return 0;						\
+	}
+
+/* Define bulk temperature conversion benchmarks */
+TEMPERATURE_BENCH ( int );
+TEMPERATURE_BENCH ( float );
+TEMPERATURE_BENCH ( double );
+
+/**
+ * Benchmark bulk temperature conversion
+ *
+ * @v count		Number of temperatures to convert
+ * @ret rc		Return status code
+ *
+ * Each array conversion is compared against the equivalent loop of
+ * scalar conversions, which must produce identical results.
+ */
+static int temperature_bench ( unsigned int count ) {
+	int rc;
+
+	if ( ( rc = temperature_bench_int ( count ) ) != 0 )
+		return rc;
+	if ( ( rc = temperature_bench_float ( count ) ) != 0 )
+		return rc;
+	if ( ( rc = temperature_bench_double ( count ) ) != 0 )
+		return rc;
+	return 0;
+}
+
+/** Bulk temperature conversion benchmark */
+struct benchmark temperature_benchmark __benchmark = {
+	.name = "temperature",
+	.run = temperature_bench,
+};
@@ -24,17 +24,25 @@
  *
  */
 
+#include <stdio.h>
+#include <string.h>
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include <uniport/device.h>
+#include <uniport/history.h>
+#include <uniport/debounce.h>
+#include <uniport/timer.h>
 #include <uniport/init.h>
 
 /* GPIOs */
 #define GPIO_LEFT 13
 #define GPIO_RIGHT 14
 
+/** Debounce integrator threshold (in samples) */
+#define BUTTON_DEBOUNCE_THRESHOLD 5
+
 /** Button state */
 struct button_state {
 	/** Binary switch value */
@@ -55,6 +63,10 @@ struct button {
 	struct resource res;
 	/** Current state */
 	struct button_state state;
+	/** State history */
+	struct history history;
+	/** Debounced input */
+	struct debounce deb;
 
 	/** GPIO to which button is attached l*/
 	unsigned int gpio;
@@ -69,16 +81,64 @@ struct button {
 static const struct button_state * button_retrieve ( struct resource *res ) {
 	struct button *button = container_of ( res, struct button, res );
 
-	/* Update state */
-	button->state.value = ( ! gpio_get_level ( button->gpio ) );
-
 	return &button->state;
 }
 
 /** Button resource descriptor */
-static struct resource_descriptor button_desc =
+static const struct resource_descriptor button_desc =
 	RESOURCE_DESC ( struct button_state, button_props,
-			button_retrieve, NULL, NULL );
+			button_retrieve, NULL, NULL,
+			.rt = "oic.r.button" );
+
+/**
+ * Sample raw button state
+ *
+ * @v deb		Debounced input
+ * @ret raw		Raw input value
+ */
+static int button_sample ( struct debounce *deb ) {
+	struct button *button = container_of ( deb, struct button, deb );
+
+	return ( ! gpio_get_level ( button->gpio ) );
+}
+
+/**
+ * Handle change in debounced button state
+ *
+ * @v deb		Debounced input
+ *
+ * This is called without the debounce lock held, so observers are
+ * notified outside the lock.
+ */
+static void button_changed ( struct debounce *deb ) {
+	struct button *button = container_of ( deb, struct button, deb );
+
+	/* Update state and notify observers */
+	button->state.value = deb->value;
+	resource_notify ( &button->res );
+}
+
+/**
+ * Handle settling of button state
+ *
+ * @v deb		Debounced input
+ */
+static void button_settled ( struct debounce *deb ) {
+	struct button *button = container_of ( deb, struct button, deb );
+
+	/* Re-enable edge interrupt */
+	gpio_intr_enable ( button->gpio );
+}
+
+/** Define debounced input for a button */
+#define BUTTON_DEBOUNCE( _name ) {					\
+	.name = _name,							\
+	.mode = DEBOUNCE_INTEGRATOR,					\
+	.threshold = BUTTON_DEBOUNCE_THRESHOLD,				\
+	.sample = button_sample,					\
+	.changed = button_changed,					\
+	.settled = button_settled,					\
+	}
 
 /** Left button */
 static struct button button_left = {
@@ -86,10 +146,13 @@ static struct button button_left = {
 		.uri = "left",
 		.desc = &button_desc,
 		.observers = OBSERVERS_INIT ( button_left.res ),
+		.history = &button_left.history,
 	},
 	.state = {
 		.name = "Left button",
 	},
+	.history = HISTORY_INIT ( 32, 0, 0 ),
+	.deb = BUTTON_DEBOUNCE ( "left" ),
 	.gpio = GPIO_LEFT,
 };
 
@@ -99,10 +162,13 @@ static struct button button_right = {
 		.uri = "right",
 		.desc = &button_desc,
 		.observers = OBSERVERS_INIT ( button_right.res ),
+		.history = &button_right.history,
 	},
 	.state = {
 		.name = "Right button",
 	},
+	.history = HISTORY_INIT ( 32, 0, 0 ),
+	.deb = BUTTON_DEBOUNCE ( "right" ),
 	.gpio = GPIO_RIGHT,
 };
 
@@ -128,11 +194,16 @@ static xQueueHandle button_queue = NULL;
 /**
  * Button interrupt handler
  *
- * @v opaque		Resource
+ * @v opaque		Button
+ *
+ * The edge interrupt is disabled until the debounced input settles,
+ * so that a bounce burst queues only a single event.
  */
 static void button_isr ( void *opaque ) {
+	struct button *button = opaque;
 
-	/* Wake up task */
+	/* Mask further edges and wake up task */
+	gpio_intr_disable ( button->gpio );
 	xQueueSendFromISR ( button_queue, &opaque, NULL );
 }
 
@@ -140,22 +211,18 @@ static void button_isr ( void *opaque ) {
  * Button task
  *
  * @v arg		Argument (ignored)
+ *
+ * Debounce triggers cannot be reported from interrupt context, so
+ * this task passes each queued edge on to the shared debounce thread.
  */
 static void button_task ( void *arg __unused ) {
 	struct button *button;
-	bool previous;
 
 	while ( 1 ) {
 
 		/* Receive from event queue */
-		if ( xQueueReceive ( button_queue, &button, portMAX_DELAY ) ) {
-
-			/* Notify observers if state has changed */
-			previous = button->state.value;
-			button_retrieve ( &button->res );
-			if ( button->state.value != previous )
-				resource_notify ( &button->res );
-		}
+		if ( xQueueReceive ( button_queue, &button, portMAX_DELAY ) )
+			debounce_trigger ( &button->deb );
 	}
 }
 
@@ -166,6 +233,7 @@ static void button_task ( void *arg __unused ) {
 static void buttons_init ( void ) {
 	struct resource **res;
 	struct button *button;
+	int rc;
 
 	/* Create event queue */
 	button_queue = xQueueCreate ( 16, sizeof ( void * ) );
@@ -183,7 +251,12 @@ static void buttons_init ( void ) {
 		gpio_set_direction ( button->gpio, GPIO_MODE_INPUT );
 		gpio_set_pull_mode ( button->gpio, GPIO_PULLUP_ONLY );
 		gpio_set_intr_type ( button->gpio, GPIO_INTR_ANYEDGE );
-		button_retrieve ( &button->res );
+		if ( ( rc = debounce_register ( &button->deb ) ) != 0 ) {
+			printf ( "Could not debounce %s button: %s\n",
+				 button->deb.name, strerror ( rc ) );
+			continue;
+		}
+		button->state.value = button->deb.value;
 		gpio_isr_handler_add ( button->gpio, button_isr, button );
 	}
 }
@@ -28,6 +28,7 @@
 #include "driver/uart.h"
 #include "linenoise/linenoise.h"
 #include <uniport/init.h>
+#include <uniport/sink.h>
 
 #define PROMPT "uniport> "
 
@@ -44,6 +45,26 @@ extern struct command ls_command;
 extern struct command show_command;
 extern struct command set_command;
 extern struct command observe_command;
+extern struct command history_command;
+extern struct command cache_command;
+extern struct command sim_command;
+extern struct command simload_command;
+extern struct command control_command;
+extern struct command respond_command;
+extern struct command discover_command;
+extern struct command collection_command;
+extern struct command rule_command;
+extern struct command mqtt_command;
+extern struct command export_command;
+extern struct command replica_command;
+extern struct command shell_command;
+extern struct command sink_command;
+extern struct command snapshot_command;
+extern struct command restore_command;
+extern struct command serialise_command;
+extern struct command debounce_command;
+extern struct command bench_command;
+extern struct device oic_dev;
 extern struct device buttons_dev;
 extern struct device oven_dev;
 void *linker_hacks[] = {
@@ -52,10 +73,33 @@ void *linker_hacks[] = {
 	&show_command,
 	&set_command,
 	&observe_command,
+	&history_command,
+	&cache_command,
+	&sim_command,
+	&simload_command,
+	&control_command,
+	&respond_command,
+	&discover_command,
+	&collection_command,
+	&rule_command,
+	&mqtt_command,
+	&export_command,
+	&replica_command,
+	&shell_command,
+	&sink_command,
+	&snapshot_command,
+	&restore_command,
+	&serialise_command,
+	&debounce_command,
+	&bench_command,
+	&oic_dev,
 	&buttons_dev,
 	&oven_dev,
 };
 
+/** Console output sink */
+static struct fd_sink console;
+
 /**
  * Application entry point
  *
@@ -72,6 +116,9 @@ void app_main ( void ) {
 						256, 0, 0, NULL, 0 ) );
 	esp_vfs_dev_uart_use_driver ( CONFIG_CONSOLE_UART_NUM );
 
+	/* Configure buffered command output (ignoring errors) */
+	sink_open_fd ( &console, fileno ( stdout ) );
+
 	/* Configure line editor */
 	linenoiseSetMultiLine ( 1 );
 	linenoiseHistorySetMaxLen ( 100 );
@@ -92,7 +139,11 @@ void app_main ( void ) {
 		linenoiseHistoryAdd ( line );
 
 		/* Run command */
-		system ( line );
+		if ( console.sink.file ) {
+			sink_system ( &console.sink, line );
+		} else {
+			system ( line );
+		}
 
 		/* Free line */
 		free ( line );
@@ -22,15 +22,34 @@
  *
  * Oven demo
  *
+ * The demo board has no temperature sensor, and so the oven may be
+ * driven by a simulated thermal mass.  A simulated oven runs a
+ * closed-loop temperature controller against the thermal model, and
+ * never touches the power GPIO: the heater output drives only the
+ * model.  An oven without a thermal model drives the power GPIO
+ * directly, under manual control.
+ *
  */
 
+#include <stdio.h>
 #include "driver/gpio.h"
 #include <uniport/device.h>
+#include <uniport/serialise.h>
 #include <uniport/temperature.h>
+#include <uniport/history.h>
+#include <uniport/control.h>
+#include <uniport/timer.h>
 #include <uniport/init.h>
 
 /** Power control */
 #define OVEN_GPIO_POWER 23
+/** Control period */
+#define OVEN_CONTROL_PERIOD ( 100 * TICKS_PER_MS )
+/** Number of decimal places in temperatures */
+#define OVEN_TEMPERATURE_SCALE 1
+/** Ambient temperature (in degrees Celsius) */
+#define OVEN_AMBIENT 20
+
 /** Power control state */
 struct oven_power_state {
 	/** Binary switch value */
@@ -40,11 +59,12 @@ struct oven_power_state {
 };
 
 /** Power control properties */
-static struct property oven_power_props[] = {
-	PROPERTY_BOOLEAN ( "value", struct oven_power_state, value, PROP_RW ),
-	PROPERTY_STRING ( "n", struct oven_power_state, name,
-			  PROP_RW | PROP_META ),
-};
+#define OVEN_POWER_PROPS( _prop, _prefix )				\
+	_prop ( _prefix, struct oven_power_state, boolean, "value",	\
+		value, PROP_RW, 0 )					\
+	_prop ( _prefix, struct oven_power_state, string, "n",		\
+		name, ( PROP_RW | PROP_META ), 0 )
+RESOURCE_PROPERTIES ( oven_power, OVEN_POWER_PROPS );
 
 /** Power control */
 struct oven_power {
@@ -58,7 +78,7 @@ struct oven_power {
 
 /** Temperature state */
 struct oven_temperature_state {
-	/** Temperature */
+	/** Temperature (in tenths of a degree) */
 	int temperature;
 	/** Units */
 	enum temperature_units units;
@@ -67,24 +87,25 @@ struct oven_temperature_state {
 };
 
 /** Current temperature properties */
-static struct property oven_current_props[] = {
-	PROPERTY_INTEGER ( "temperature", struct oven_temperature_state,
-			   temperature, 0 ),
-	PROPERTY_TEMPERATURE_UNITS ( "units", struct oven_temperature_state,
-				     units, 0 ),
-	PROPERTY_STRING ( "n", struct oven_temperature_state, name,
-			  PROP_RW | PROP_META ),
-};
+#define OVEN_CURRENT_PROPS( _prop, _prefix )				\
+	_prop ( _prefix, struct oven_temperature_state, fixed,		\
+		"temperature", temperature, 0, OVEN_TEMPERATURE_SCALE )	\
+	_prop ( _prefix, struct oven_temperature_state,			\
+		temperature_units, "units", units, 0, 0 )		\
+	_prop ( _prefix, struct oven_temperature_state, string, "n",	\
+		name, ( PROP_RW | PROP_META ), 0 )
+RESOURCE_PROPERTIES ( oven_current, OVEN_CURRENT_PROPS );
 
 /** Target temperature properties */
-static struct property oven_target_props[] = {
-	PROPERTY_INTEGER ( "temperature", struct oven_temperature_state,
-			   temperature, PROP_RW ),
-	PROPERTY_TEMPERATURE_UNITS ( "units", struct oven_temperature_state,
-				     units, PROP_RW ),
-	PROPERTY_STRING ( "n", struct oven_temperature_state, name,
-			  PROP_RW | PROP_META ),
-};
+#define OVEN_TARGET_PROPS( _prop, _prefix )				\
+	_prop ( _prefix, struct oven_temperature_state, fixed,		\
+		"temperature", temperature, PROP_RW,			\
+		OVEN_TEMPERATURE_SCALE )				\
+	_prop ( _prefix, struct oven_temperature_state,			\
+		temperature_units, "units", units, PROP_RW, 0 )		\
+	_prop ( _prefix, struct oven_temperature_state, string, "n",	\
+		name, ( PROP_RW | PROP_META ), 0 )
+RESOURCE_PROPERTIES ( oven_target, OVEN_TARGET_PROPS );
 
 /** Temperature */
 struct oven_temperature {
@@ -92,6 +113,8 @@ struct oven_temperature {
 	struct resource res;
 	/** Current state */
 	struct oven_temperature_state state;
+	/** State history */
+	struct history history;
 };
 
 /** An oven */
@@ -102,6 +125,12 @@ struct oven {
 	struct oven_temperature target;
 	/** Current temperature */
 	struct oven_temperature current;
+	/** Temperature control loop */
+	struct control_loop loop;
+	/** Simulated thermal mass, or NULL to use the real heater */
+	struct thermal_model *model;
+	/** Accumulated output error for pulse density modulation */
+	int modulation;
 };
 
 /**
@@ -128,17 +157,22 @@ static int oven_power_update ( struct resource *res,
 			       const struct oven_power_state *state ) {
 	struct oven *oven = container_of ( res, struct oven, power.res );
 
-	/* Update power state */
+	/* Update power state, driving the real heater only if the
+	 * oven is not simulated.
+	 */
 	oven->power.state.value = state->value;
-	gpio_set_level ( oven->power.gpio, oven->power.state.value );
+	if ( ! oven->model )
+		gpio_set_level ( oven->power.gpio, oven->power.state.value );
 
 	return 0;
 }
 
 /** Power control resource descriptor */
-static struct resource_descriptor oven_power_desc =
+static const struct resource_descriptor oven_power_desc =
 	RESOURCE_DESC ( struct oven_power_state, oven_power_props,
-			oven_power_retrieve, oven_power_update, NULL );
+			oven_power_retrieve, oven_power_update, NULL,
+			.rt = "oic.r.switch.binary",
+			RESOURCE_SERIALISERS ( oven_power ) );
 
 /**
  * Retrieve temperature state
@@ -167,20 +201,95 @@ static int oven_target_update ( struct resource *res,
 
 	/* Update target temperature */
 	oven->target.state.temperature =
-		temperature_to_celsius_int ( state->temperature, state->units );
+		temperature_to_celsius_fixed ( state->temperature, state->units,
+					       OVEN_TEMPERATURE_SCALE );
+	control_setpoint ( &oven->loop, oven->target.state.temperature );
 
 	return 0;
 }
 
 /** Target temperature resource descriptor */
-static struct resource_descriptor oven_target_desc =
+static const struct resource_descriptor oven_target_desc =
 	RESOURCE_DESC ( struct oven_temperature_state, oven_target_props,
-			oven_temperature_retrieve, oven_target_update, NULL );
+			oven_temperature_retrieve, oven_target_update, NULL,
+			.rt = "oic.r.temperature",
+			RESOURCE_SERIALISERS ( oven_target ) );
 
 /** Current temperature resource descriptor */
-static struct resource_descriptor oven_current_desc =
+static const struct resource_descriptor oven_current_desc =
 	RESOURCE_DESC ( struct oven_temperature_state, oven_current_props,
-			oven_temperature_retrieve, NULL, NULL );
+			oven_temperature_retrieve, NULL, NULL,
+			.rt = "oic.r.temperature",
+			RESOURCE_SERIALISERS ( oven_current ) );
+
+/**
+ * Measure oven temperature
+ *
+ * @v loop		Control loop
+ * @v now		Current time
+ * @ret temperature	Current temperature (in tenths of a degree Celsius)
+ */
+static int oven_measure ( struct control_loop *loop, unsigned long now ) {
+	struct oven *oven = container_of ( loop, struct oven, loop );
+	int temperature;
+
+	/* Advance simulated thermal mass */
+	thermal_model_step ( oven->model, oven->power.state.value, now );
+	temperature = thermal_model_temperature ( oven->model,
+						  OVEN_TEMPERATURE_SCALE );
+
+	/* Notify observers only if temperature has changed */
+	if ( temperature != oven->current.state.temperature ) {
+		oven->current.state.temperature = temperature;
+		resource_notify ( &oven->current.res );
+	}
+
+	return temperature;
+}
+
+/**
+ * Apply oven heater output
+ *
+ * @v loop		Control loop
+ * @v output		Controller output
+ *
+ * The heater is a simple on/off switch, so the output is converted
+ * to a pulse density by accumulating the error between the requested
+ * and the applied output.  The control loop runs only for a
+ * simulated oven, and so the heater state is applied only to the
+ * thermal model (via the power state), never to the power GPIO.
+ */
+static void oven_actuate ( struct control_loop *loop, unsigned int output ) {
+	struct oven *oven = container_of ( loop, struct oven, loop );
+	bool value;
+
+	/* Calculate heater state */
+	oven->modulation += output;
+	value = ( oven->modulation >= ( CONTROL_OUTPUT_MAX / 2 ) );
+	if ( value )
+		oven->modulation -= CONTROL_OUTPUT_MAX;
+
+	/* Update heater and notify observers only if state has changed */
+	if ( value != oven->power.state.value ) {
+		oven->power.state.value = value;
+		resource_notify ( &oven->power.res );
+	}
+}
+
+/** Oven plant */
+static struct control_plant oven_plant = {
+	.measure = oven_measure,
+	.actuate = oven_actuate,
+};
+
+/** Simulated oven thermal mass */
+static struct thermal_model oven_model = {
+	.temperature = ( OVEN_AMBIENT * 1000000LL ),
+	.ambient = OVEN_AMBIENT,
+	.power = 2000000,
+	.loss = 10000,
+	.capacity = 5000000,
+};
 
 /** The oven */
 static struct oven oven = {
@@ -211,12 +320,27 @@ static struct oven oven = {
 			.uri = "current",
 			.desc = &oven_current_desc,
 			.observers = OBSERVERS_INIT ( oven.current.res ),
+			.history = &oven.current.history,
 		},
 		.state = {
 			.name = "Current Temperature",
 			.units = TEMPERATURE_UNITS_C,
 		},
+		.history = HISTORY_INIT ( 64, 60, 60 ),
 	},
+	.loop = {
+		.name = "oven",
+		.plant = &oven_plant,
+		.ctrl = &pid_controller,
+		.period = OVEN_CONTROL_PERIOD,
+		.setpoint = ( OVEN_AMBIENT * 10 ),
+		.kp = 5,
+		.ki = 1,
+		.kd = 20,
+		.hysteresis = 20,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+	},
+	.model = &oven_model,
 };
 
 /** Oven resources */
@@ -242,6 +366,10 @@ struct device oven_dev __device = {
  */
 static void oven_init ( void ) {
 
+	/* Leave the real heater untouched if the oven is simulated */
+	if ( oven.model )
+		return;
+
 	/* Configure GPIOs */
 	gpio_reset_pin ( oven.power.gpio );
 	gpio_set_direction ( oven.power.gpio, GPIO_MODE_OUTPUT );
@@ -251,3 +379,28 @@ static void oven_init ( void ) {
 struct init_fn oven_init_fn __init_fn = {
 	.init = oven_init,
 };
+
+/**
+ * Start oven temperature control
+ *
+ */
+static void oven_control_init ( void ) {
+
+	/* There is no temperature sensor for the real oven */
+	if ( ! oven.model )
+		return;
+
+	/* Start temperature control loop */
+	oven.current.state.temperature =
+		thermal_model_temperature ( oven.model,
+					    OVEN_TEMPERATURE_SCALE );
+	oven.target.state.temperature = oven.loop.setpoint;
+	oven.model->updated = currticks();
+	if ( control_start ( &oven.loop ) != 0 )
+		printf ( "Could not start oven control loop\n" );
+}
+
+/** Oven control initialisation function */
+struct init_fn oven_control_init_fn __late_init_fn = {
+	.init = oven_control_init,
+};
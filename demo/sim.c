@@ -0,0 +1,593 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Simulated devices
+ *
+ * The "sim" command registers an arbitrary number of namespaces each
+ * containing an arbitrary number of simulated resources, requiring
+ * no hardware.  The "simload" command then generates a reproducible
+ * pseudo-random load of state changes, updates, and commands against
+ * the simulated resources, and reports the achieved throughput.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <uniport/resource.h>
+#include <uniport/interface.h>
+#include <uniport/serialise.h>
+#include <uniport/temperature.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include <uniport/timer.h>
+
+/** Simulated resource state */
+struct sim_state {
+	/** Binary switch value */
+	bool value;
+	/** Temperature */
+	int temperature;
+	/** Temperature units */
+	enum temperature_units units;
+	/** Identifier */
+	union uuid id;
+	/** Name */
+	const char *name;
+};
+
+/** Simulated switch properties */
+#define SIM_SWITCH_PROPS( _prop, _prefix )				\
+	_prop ( _prefix, struct sim_state, boolean, "value", value,	\
+		PROP_RW, 0 )						\
+	_prop ( _prefix, struct sim_state, string, "n", name,		\
+		PROP_META, 0 )
+RESOURCE_PROPERTIES ( sim_switch, SIM_SWITCH_PROPS );
+
+/** Simulated temperature sensor properties */
+#define SIM_TEMPERATURE_PROPS( _prop, _prefix )				\
+	_prop ( _prefix, struct sim_state, integer, "temperature",	\
+		temperature, PROP_RW, 0 )				\
+	_prop ( _prefix, struct sim_state, temperature_units, "units",	\
+		units, PROP_RW, 0 )					\
+	_prop ( _prefix, struct sim_state, string, "n", name,		\
+		PROP_META, 0 )
+RESOURCE_PROPERTIES ( sim_temperature, SIM_TEMPERATURE_PROPS );
+
+/** Simulated identifier properties */
+static struct property sim_uuid_props[] = {
+	PROPERTY_UUID ( "id", struct sim_state, id, 0 ),
+	PROPERTY_STRING ( "n", struct sim_state, name, PROP_META ),
+};
+
+/** Simulated combined properties */
+#define SIM_ALL_PROPS( _prop, _prefix )					\
+	_prop ( _prefix, struct sim_state, boolean, "value", value,	\
+		PROP_RW, 0 )						\
+	_prop ( _prefix, struct sim_state, integer, "temperature",	\
+		temperature, PROP_RW, 0 )				\
+	_prop ( _prefix, struct sim_state, temperature_units, "units",	\
+		units, PROP_RW, 0 )					\
+	_prop ( _prefix, struct sim_state, uuid, "id", id, 0, 0 )	\
+	_prop ( _prefix, struct sim_state, string, "n", name,		\
+		PROP_META, 0 )
+RESOURCE_PROPERTIES ( sim_all, SIM_ALL_PROPS );
+
+/** A simulated resource */
+struct sim_resource {
+	/** Resource */
+	struct resource res;
+	/** Current state */
+	struct sim_state state;
+	/** Counting observer */
+	struct observer obs;
+	/** URI suffix */
+	char uri[12];
+};
+
+/** A simulated namespace */
+struct sim_namespace {
+	/** Resource namespace */
+	struct namespace ns;
+	/** Resources */
+	struct sim_resource *sims;
+	/** NULL-terminated list of resources */
+	struct resource **resources;
+	/** URI prefix */
+	char uri[16];
+};
+
+/** A simulated world */
+struct sim_world {
+	/** Namespaces */
+	struct sim_namespace *nss;
+	/** Number of namespaces */
+	unsigned int num_ns;
+	/** Number of resources per namespace */
+	unsigned int num_res;
+	/** Number of namespaces successfully registered */
+	unsigned int registered;
+	/** Counting observers are attached */
+	int observe;
+	/** Total length of allocated memory */
+	size_t len;
+	/** Number of observer notifications */
+	unsigned long notified;
+};
+
+/** The simulated world, if any */
+static struct sim_world *sim;
+
+/**
+ * Retrieve simulated resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct sim_state * sim_retrieve ( struct resource *res ) {
+	struct sim_resource *simres =
+		container_of ( res, struct sim_resource, res );
+
+	return &simres->state;
+}
+
+/**
+ * Update simulated resource state
+ *
+ * @v res		Resource
+ * @v state		New resource state
+ * @ret rc		Return status code
+ */
+static int sim_update ( struct resource *res, const struct sim_state *state ) {
+	struct sim_resource *simres =
+		container_of ( res, struct sim_resource, res );
+
+	/* Update writable state */
+	simres->state.value = state->value;
+	simres->state.temperature = state->temperature;
+	simres->state.units = state->units;
+
+	/* Notify observers */
+	resource_notify ( res );
+
+	return 0;
+}
+
+/** Simulated switch resource descriptor */
+static const struct resource_descriptor sim_switch_desc =
+	RESOURCE_DESC ( struct sim_state, sim_switch_props,
+			sim_retrieve, sim_update, NULL,
+			.rt = "oic.r.switch.binary",
+			RESOURCE_SERIALISERS ( sim_switch ) );
+
+/** Simulated temperature sensor resource descriptor */
+static const struct resource_descriptor sim_temperature_desc =
+	RESOURCE_DESC ( struct sim_state, sim_temperature_props,
+			sim_retrieve, sim_update, NULL,
+			.rt = "oic.r.temperature",
+			RESOURCE_SERIALISERS ( sim_temperature ) );
+
+/** Simulated identifier resource descriptor */
+static const struct resource_descriptor sim_uuid_desc =
+	RESOURCE_DESC ( struct sim_state, sim_uuid_props,
+			sim_retrieve, NULL, NULL );
+
+/** Simulated combined resource descriptor */
+static const struct resource_descriptor sim_all_desc =
+	RESOURCE_DESC ( struct sim_state, sim_all_props,
+			sim_retrieve, sim_update, NULL,
+			RESOURCE_SERIALISERS ( sim_all ) );
+
+/**
+ * Get simulated resource descriptor
+ *
+ * @v kind		Resource kind
+ * @ret desc		Resource descriptor, or NULL if not recognised
+ */
+static const struct resource_descriptor * sim_descriptor ( char kind ) {
+
+	switch ( kind ) {
+	case 's':	return &sim_switch_desc;
+	case 't':	return &sim_temperature_desc;
+	case 'u':	return &sim_uuid_desc;
+	case 'a':	return &sim_all_desc;
+	default:	return NULL;
+	}
+}
+
+/**
+ * Count observer notification
+ *
+ * @v obs		Observer
+ * @v state		Resource state
+ */
+static void sim_notify ( struct observer *obs __unused,
+			 const void *state __unused ) {
+
+	sim->notified++;
+}
+
+/**
+ * Destroy simulated world
+ *
+ */
+static void sim_destroy ( void ) {
+	struct sim_namespace *simns;
+	struct sim_resource *simres;
+	unsigned int i;
+	unsigned int j;
+
+	/* Do nothing if no world exists */
+	if ( ! sim )
+		return;
+
+	/* Unregister and free namespaces */
+	for ( i = 0 ; i < sim->num_ns ; i++ ) {
+		simns = &sim->nss[i];
+		if ( i < sim->registered ) {
+			for ( j = 0 ; sim->observe && ( j < sim->num_res ) ;
+			      j++ ) {
+				simres = &simns->sims[j];
+				resource_unobserve ( &simres->obs );
+			}
+			resource_unregister ( &simns->ns );
+		}
+		free ( simns->resources );
+		free ( simns->sims );
+	}
+	free ( sim->nss );
+	free ( sim );
+	sim = NULL;
+}
+
+/**
+ * Create simulated world
+ *
+ * @v num_ns		Number of namespaces
+ * @v num_res		Number of resources per namespace
+ * @v mix		Mix of resource kinds
+ * @v observe		Attach a counting observer to each resource
+ * @ret rc		Return status code
+ */
+static int sim_create ( unsigned int num_ns, unsigned int num_res,
+			const char *mix, int observe ) {
+	struct sim_namespace *simns;
+	struct sim_resource *simres;
+	size_t mix_len = strlen ( mix );
+	unsigned int i;
+	unsigned int j;
+	int rc;
+
+	/* Validate mix */
+	for ( i = 0 ; i < mix_len ; i++ ) {
+		if ( ! sim_descriptor ( mix[i] ) ) {
+			cprintf ( "\"%c\": no such resource kind\n", mix[i] );
+			return -EINVAL;
+		}
+	}
+	if ( ! mix_len )
+		return -EINVAL;
+
+	/* Allocate world */
+	sim = calloc ( 1, sizeof ( *sim ) );
+	if ( ! sim )
+		return -ENOMEM;
+	sim->num_ns = num_ns;
+	sim->num_res = num_res;
+	sim->observe = observe;
+	sim->len = sizeof ( *sim );
+	sim->nss = calloc ( num_ns, sizeof ( sim->nss[0] ) );
+	if ( ! sim->nss ) {
+		rc = -ENOMEM;
+		goto err;
+	}
+	sim->len += ( num_ns * sizeof ( sim->nss[0] ) );
+
+	/* Create and register namespaces */
+	for ( i = 0 ; i < num_ns ; i++ ) {
+
+		/* Allocate resources */
+		simns = &sim->nss[i];
+		simns->sims = calloc ( num_res, sizeof ( simns->sims[0] ) );
+		simns->resources = calloc ( ( num_res + 1 /* NULL */ ),
+					    sizeof ( simns->resources[0] ) );
+		if ( ! ( simns->sims && simns->resources ) ) {
+			rc = -ENOMEM;
+			goto err;
+		}
+		sim->len += ( ( num_res * sizeof ( simns->sims[0] ) ) +
+			      ( ( num_res + 1 ) *
+				sizeof ( simns->resources[0] ) ) );
+
+		/* Initialise resources */
+		for ( j = 0 ; j < num_res ; j++ ) {
+			simres = &simns->sims[j];
+			snprintf ( simres->uri, sizeof ( simres->uri ),
+				   "r%u", j );
+			simres->res.uri = simres->uri;
+			simres->res.desc =
+				sim_descriptor ( mix[ j % mix_len ] );
+			INIT_LIST_HEAD ( &simres->res.observers );
+			simres->state.units = TEMPERATURE_UNITS_C;
+			simres->state.name = "Simulated";
+			simres->state.id.canonical.a = htonl ( i );
+			simres->state.id.canonical.b = htons ( j );
+			simns->resources[j] = &simres->res;
+		}
+
+		/* Register namespace */
+		snprintf ( simns->uri, sizeof ( simns->uri ), "/sim%u/", i );
+		simns->ns.uri = simns->uri;
+		simns->ns.resources = simns->resources;
+		if ( ( rc = resource_register ( &simns->ns ) ) != 0 )
+			goto err;
+		sim->registered++;
+
+		/* Attach counting observers, if applicable */
+		for ( j = 0 ; observe && ( j < num_res ) ; j++ ) {
+			simres = &simns->sims[j];
+			observer_init ( &simres->obs, &simres->res,
+					&oic_if_baseline, sim_notify );
+			resource_observe ( &simres->obs );
+		}
+	}
+
+	return 0;
+
+ err:
+	sim_destroy();
+	return rc;
+}
+
+/** "sim" options */
+struct sim_options {
+	/** Number of namespaces */
+	unsigned int namespaces;
+	/** Number of resources per namespace */
+	unsigned int resources;
+	/** Mix of resource kinds */
+	char *mix;
+	/** Attach counting observers */
+	int observe;
+	/** Destroy simulated world */
+	int delete;
+};
+
+/** "sim" option list */
+static struct option_descriptor sim_opts[] = {
+	OPTION_DESC ( "namespaces", 'n', required_argument,
+		      struct sim_options, namespaces, parse_integer ),
+	OPTION_DESC ( "resources", 'r', required_argument,
+		      struct sim_options, resources, parse_integer ),
+	OPTION_DESC ( "mix", 'm', required_argument,
+		      struct sim_options, mix, parse_string ),
+	OPTION_DESC ( "observe", 'o', no_argument,
+		      struct sim_options, observe, parse_flag ),
+	OPTION_DESC ( "delete", 'd', no_argument,
+		      struct sim_options, delete, parse_flag ),
+};
+
+/** "sim" command descriptor */
+static struct command_descriptor sim_cmd =
+	COMMAND_DESC ( struct sim_options, sim_opts, 0, 0, NULL );
+
+/**
+ * "sim" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int sim_exec ( int argc, char **argv ) {
+	struct sim_options opts;
+	unsigned long start;
+	unsigned long elapsed;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &sim_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Apply defaults */
+	if ( ! opts.namespaces )
+		opts.namespaces = 1;
+	if ( ! opts.resources )
+		opts.resources = 1;
+	if ( ! opts.mix )
+		opts.mix = "st";
+
+	/* Destroy any existing world */
+	sim_destroy();
+	if ( opts.delete )
+		return 0;
+
+	/* Create new world */
+	start = currticks();
+	if ( ( rc = sim_create ( opts.namespaces, opts.resources, opts.mix,
+				 opts.observe ) ) != 0 ) {
+		cprintf ( "Could not create simulation: %s\n",
+			  strerror ( rc ) );
+		return rc;
+	}
+	elapsed = ( currticks() - start );
+
+	cprintf ( "sim: %u namespaces x %u resources in %lu.%03lus, "
+		  "%zu bytes\n", sim->num_ns, sim->num_res,
+		  ( elapsed / TICKS_PER_SEC ),
+		  ( ( elapsed % TICKS_PER_SEC ) / TICKS_PER_MS ), sim->len );
+	return 0;
+}
+
+/** "sim" command */
+struct command sim_command __command = {
+	.name = "sim",
+	.exec = sim_exec,
+};
+
+/** "simload" options */
+struct simload_options {
+	/** Total number of operations */
+	unsigned int count;
+	/** Operation rate (per second), or zero for unlimited */
+	unsigned int rate;
+	/** Percentage of operations that are updates */
+	unsigned int update;
+	/** Percentage of operations that are commands */
+	unsigned int command;
+	/** Random seed */
+	unsigned int seed;
+};
+
+/** "simload" option list */
+static struct option_descriptor simload_opts[] = {
+	OPTION_DESC ( "count", 'c', required_argument,
+		      struct simload_options, count, parse_integer ),
+	OPTION_DESC ( "rate", 'r', required_argument,
+		      struct simload_options, rate, parse_integer ),
+	OPTION_DESC ( "update", 'u', required_argument,
+		      struct simload_options, update, parse_integer ),
+	OPTION_DESC ( "command", 'x', required_argument,
+		      struct simload_options, command, parse_integer ),
+	OPTION_DESC ( "seed", 's', required_argument,
+		      struct simload_options, seed, parse_integer ),
+};
+
+/** "simload" command descriptor */
+static struct command_descriptor simload_cmd =
+	COMMAND_DESC ( struct simload_options, simload_opts, 0, 0, NULL );
+
+/**
+ * "simload" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int simload_exec ( int argc, char **argv ) {
+	struct simload_options opts;
+	struct sim_resource *simres;
+	struct sim_state state;
+	char command[48];
+	unsigned long start;
+	unsigned long elapsed;
+	unsigned long due;
+	unsigned long notified;
+	unsigned int updates = 0;
+	unsigned int commands = 0;
+	unsigned int changes = 0;
+	unsigned int errors = 0;
+	unsigned int random;
+	unsigned int i;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &simload_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Apply defaults */
+	if ( ! opts.count )
+		opts.count = 1000;
+
+	/* Check that a world exists */
+	if ( ! ( sim && sim->num_ns && sim->num_res ) ) {
+		cprintf ( "No simulation (use \"sim\")\n" );
+		return -ENOENT;
+	}
+	if ( ( opts.update + opts.command ) > 100 ) {
+		print_usage ( &simload_cmd, argv );
+		return -EINVAL;
+	}
+
+	/* Generate load */
+	notified = sim->notified;
+	start = currticks();
+	for ( i = 0 ; i < opts.count ; i++ ) {
+
+		/* Pace operations, if applicable */
+		if ( opts.rate ) {
+			due = ( ( ( ( unsigned long long ) i ) *
+				  TICKS_PER_SEC ) / opts.rate );
+			elapsed = ( currticks() - start );
+			if ( elapsed < due )
+				usleep ( ( due - elapsed ) /
+					 ( TICKS_PER_SEC / 1000000 ) );
+		}
+
+		/* Choose resource and operation */
+		random = rand_r ( &opts.seed );
+		simres = &sim->nss[ random % sim->num_ns ].sims
+			[ ( random / sim->num_ns ) % sim->num_res ];
+		random = ( rand_r ( &opts.seed ) % 100 );
+
+		if ( ( random < opts.update ) && simres->res.desc->update ) {
+
+			/* Update via resource_update() */
+			memcpy ( &state, resource_retrieve ( &simres->res ),
+				 sizeof ( state ) );
+			state.value = ( ! state.value );
+			state.temperature++;
+			if ( resource_update ( &simres->res, &state ) != 0 )
+				errors++;
+			updates++;
+
+		} else if ( ( random >= opts.update ) &&
+			    ( random < ( opts.update + opts.command ) ) ) {
+
+			/* Execute command */
+			snprintf ( command, sizeof ( command ), "show %s%s",
+				   simres->res.ns->uri, simres->res.uri );
+			if ( system ( command ) != 0 )
+				errors++;
+			commands++;
+
+		} else {
+
+			/* Change state directly and notify */
+			simres->state.value = ( ! simres->state.value );
+			simres->state.temperature--;
+			resource_notify ( &simres->res );
+			changes++;
+		}
+	}
+	elapsed = ( currticks() - start );
+
+	/* Report throughput */
+	cprintf ( "simload: %u ops in %lu.%03lus (%llu ops/s): changes=%u "
+		  "updates=%u commands=%u errors=%u notified=%lu\n",
+		  opts.count, ( elapsed / TICKS_PER_SEC ),
+		  ( ( elapsed % TICKS_PER_SEC ) / TICKS_PER_MS ),
+		  ( elapsed ? ( ( ( ( unsigned long long ) opts.count ) *
+				  TICKS_PER_SEC ) / elapsed ) : 0 ),
+		  changes, updates, commands, errors,
+		  ( sim->notified - notified ) );
+
+	return ( errors ? -EIO : 0 );
+}
+
+/** "simload" command */
+struct command simload_command __command = {
+	.name = "simload",
+	.exec = simload_exec,
+};
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Host GPIO emulation
+ *
+ * Output levels are recorded so that they may be read back, and
+ * nothing is connected to any pin.
+ *
+ */
+
+#include <errno.h>
+#include "driver/gpio.h"
+
+/** Current GPIO levels */
+static uint32_t gpio_levels[GPIO_NUM_MAX];
+
+/**
+ * Reset GPIO pin
+ *
+ * @v gpio_num		GPIO number
+ * @ret rc		Return status code
+ */
+esp_err_t gpio_reset_pin ( gpio_num_t gpio_num ) {
+
+	if ( gpio_num >= GPIO_NUM_MAX )
+		return -EINVAL;
+	gpio_levels[gpio_num] = 0;
+	return 0;
+}
+
+/**
+ * Set GPIO direction
+ *
+ * @v gpio_num		GPIO number
+ * @v mode		Direction
+ * @ret rc		Return status code
+ */
+esp_err_t gpio_set_direction ( gpio_num_t gpio_num,
+			       gpio_mode_t mode __unused ) {
+
+	if ( gpio_num >= GPIO_NUM_MAX )
+		return -EINVAL;
+	return 0;
+}
+
+/**
+ * Set GPIO output level
+ *
+ * @v gpio_num		GPIO number
+ * @v level		Output level
+ * @ret rc		Return status code
+ */
+esp_err_t gpio_set_level ( gpio_num_t gpio_num, uint32_t level ) {
+
+	if ( gpio_num >= GPIO_NUM_MAX )
+		return -EINVAL;
+	gpio_levels[gpio_num] = level;
+	return 0;
+}
+
+/**
+ * Get GPIO input level
+ *
+ * @v gpio_num		GPIO number
+ * @ret level		Input level
+ */
+int gpio_get_level ( gpio_num_t gpio_num ) {
+
+	if ( gpio_num >= GPIO_NUM_MAX )
+		return 0;
+	return gpio_levels[gpio_num];
+}
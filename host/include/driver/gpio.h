@@ -0,0 +1,36 @@
+#ifndef _DRIVER_GPIO_H
+#define _DRIVER_GPIO_H
+
+/** @file
+ *
+ * Host GPIO emulation
+ *
+ * This provides the subset of the ESP-IDF GPIO driver API used by
+ * the demo devices.
+ *
+ */
+
+#include <stdint.h>
+
+/** Number of GPIOs */
+#define GPIO_NUM_MAX 40
+
+/** An ESP-IDF error code */
+typedef int esp_err_t;
+
+/** A GPIO number */
+typedef unsigned int gpio_num_t;
+
+/** GPIO directions */
+typedef enum {
+	GPIO_MODE_INPUT,
+	GPIO_MODE_OUTPUT,
+} gpio_mode_t;
+
+extern esp_err_t gpio_reset_pin ( gpio_num_t gpio_num );
+extern esp_err_t gpio_set_direction ( gpio_num_t gpio_num,
+				      gpio_mode_t mode );
+extern esp_err_t gpio_set_level ( gpio_num_t gpio_num, uint32_t level );
+extern int gpio_get_level ( gpio_num_t gpio_num );
+
+#endif /* _DRIVER_GPIO_H */
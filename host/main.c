@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Host entry point
+ *
+ * The host build runs the framework as an ordinary Linux process,
+ * with simulated devices in place of real hardware.  Each
+ * command-line argument is executed as a command; if there are no
+ * arguments then commands are read from standard input instead.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <uniport/init.h>
+
+/** Maximum length of a command read from standard input */
+#define HOST_LINE_LEN 256
+
+/** Report memory usage after each command */
+static int host_memory;
+
+/**
+ * Run command
+ *
+ * @v line		Command line
+ * @ret rc		Return status code
+ */
+static int host_run ( const char *line ) {
+	struct rusage usage;
+	int rc;
+
+	/* Run command */
+	rc = system ( line );
+	if ( rc != 0 )
+		printf ( "%s: %s\n", line, strerror ( rc ) );
+
+	/* Report peak memory usage, if applicable */
+	if ( host_memory && ( getrusage ( RUSAGE_SELF, &usage ) == 0 ) )
+		printf ( "[maxrss %ld kB]\n", usage.ru_maxrss );
+
+	return rc;
+}
+
+/**
+ * Main program
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret exit		Exit status
+ */
+int main ( int argc, char **argv ) {
+	char line[HOST_LINE_LEN];
+	int failures = 0;
+	int i;
+
+	/* Parse "-m" (the only option, to avoid clashing with the
+	 * option parsing used by the commands themselves).
+	 */
+	i = 1;
+	if ( ( i < argc ) && ( strcmp ( argv[i], "-m" ) == 0 ) ) {
+		host_memory = 1;
+		i++;
+	}
+
+	/* Use line-buffered output, as on the console */
+	setvbuf ( stdout, NULL, _IOLBF, 0 );
+
+	/* Initialise system */
+	initialise();
+
+	/* Run commands from command line, if any */
+	if ( i < argc ) {
+		for ( ; i < argc ; i++ ) {
+			if ( host_run ( argv[i] ) != 0 )
+				failures++;
+		}
+		return ( failures ? EXIT_FAILURE : EXIT_SUCCESS );
+	}
+
+	/* Otherwise, run commands from standard input */
+	while ( fgets ( line, sizeof ( line ), stdin ) ) {
+		line[ strcspn ( line, "\n" ) ] = '\0';
+		if ( host_run ( line ) != 0 )
+			failures++;
+	}
+
+	return ( failures ? EXIT_FAILURE : EXIT_SUCCESS );
+}
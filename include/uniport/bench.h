@@ -0,0 +1,40 @@
+#ifndef _UNIPORT_BENCH_H
+#define _UNIPORT_BENCH_H
+
+/** @file
+ *
+ * Benchmarks
+ *
+ */
+
+#include <uniport/tables.h>
+
+/** A benchmark */
+struct benchmark {
+	/** Name */
+	const char *name;
+	/**
+	 * Run benchmark
+	 *
+	 * @v count		Number of iterations
+	 * @ret rc		Return status code
+	 *
+	 * The benchmark should report each of its measurements using
+	 * bench_report().
+	 */
+	int ( * run ) ( unsigned int count );
+};
+
+/** Benchmark table */
+#define BENCHMARKS __table ( struct benchmark, "benchmarks" )
+
+/** Declare a benchmark */
+#define __benchmark __table_entry ( BENCHMARKS, 01 )
+
+/** Default number of benchmark iterations */
+#define BENCH_DEFAULT_COUNT 100000
+
+extern void bench_report ( const char *name, const char *variant,
+			   unsigned long ticks, unsigned long long ops );
+
+#endif /* _UNIPORT_BENCH_H */
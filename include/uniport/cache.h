@@ -0,0 +1,39 @@
+#ifndef _UNIPORT_CACHE_H
+#define _UNIPORT_CACHE_H
+
+/** @file
+ *
+ * Resource retrieval cache
+ *
+ */
+
+#include <uniport/resource.h>
+
+/** A resource retrieval cache */
+struct resource_cache {
+	/** Cached state, or NULL if not valid */
+	const void *state;
+	/** Time at which cached state was retrieved */
+	unsigned long fetched;
+	/** A retrieval is in progress */
+	int busy;
+	/** Invalidation generation
+	 *
+	 * This is incremented by each invalidation, allowing a
+	 * retrieval that was in progress at the time to be discarded.
+	 */
+	unsigned int generation;
+	/** Number of retrievals satisfied from the cache */
+	unsigned long hits;
+	/** Number of retrievals requiring a call to retrieve() */
+	unsigned long misses;
+	/** Number of retrievals coalesced with an in-progress retrieval */
+	unsigned long coalesced;
+};
+
+extern int cache_reserve ( struct resource *res );
+extern void cache_release ( struct resource *res );
+extern const void * cache_retrieve ( struct resource *res );
+extern void cache_invalidate ( struct resource *res );
+
+#endif /* _UNIPORT_CACHE_H */
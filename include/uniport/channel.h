@@ -0,0 +1,138 @@
+#ifndef _UNIPORT_CHANNEL_H
+#define _UNIPORT_CHANNEL_H
+
+/** @file
+ *
+ * Batched stream channels
+ *
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+/** Interval at which an idle channel checks for work (in milliseconds) */
+#define CHANNEL_IDLE_MS 100
+
+struct channel;
+
+/** Channel operations */
+struct channel_operations {
+	/**
+	 * Receive data
+	 *
+	 * @v chan		Channel
+	 * @ret rc		Return status code
+	 *
+	 * This is called from the channel thread whenever the socket
+	 * is readable (or has been closed).
+	 */
+	int ( * receive ) ( struct channel *chan );
+	/**
+	 * Perform periodic work (optional)
+	 *
+	 * @v chan		Channel
+	 * @v now		Current time
+	 *
+	 * This is called from the channel thread before each attempt
+	 * to transmit data.
+	 */
+	void ( * step ) ( struct channel *chan, unsigned long now );
+	/**
+	 * Refill outbound buffer (optional)
+	 *
+	 * @v chan		Channel
+	 *
+	 * This is called from the channel thread after each attempt
+	 * to transmit data, since space may have become available.
+	 */
+	void ( * refill ) ( struct channel *chan );
+	/**
+	 * Check for outstanding work (optional)
+	 *
+	 * @v chan		Channel
+	 * @ret busy		Channel thread should not wait for activity
+	 */
+	int ( * busy ) ( struct channel *chan );
+};
+
+/** Channel statistics */
+struct channel_stats {
+	/** Number of write() calls */
+	unsigned long writes;
+	/** Number of bytes written */
+	unsigned long long bytes;
+};
+
+/** A batched stream channel
+ *
+ * Data is queued by constructing it directly within a fixed-size
+ * outbound buffer, with the channel lock held.  The channel thread
+ * swaps this buffer with a second buffer and writes out everything
+ * accumulated so far in a single write().
+ */
+struct channel {
+	/** Name (used in diagnostics) */
+	const char *name;
+	/** Channel operations */
+	struct channel_operations *op;
+	/** Outbound buffers */
+	uint8_t *buf;
+	/** Length of each outbound buffer */
+	size_t size;
+
+	/** Socket */
+	int fd;
+	/** Wakeup pipe */
+	int wake[2];
+	/** Channel thread */
+	pthread_t thread;
+	/** Channel thread is running */
+	volatile int running;
+	/** Lock (protecting outbound buffers and any owner state) */
+	pthread_mutex_t lock;
+
+	/** Outbound buffer being filled */
+	uint8_t *tx;
+	/** Length of data in outbound buffer being filled */
+	size_t tx_len;
+	/** Outbound buffer being written */
+	uint8_t *out;
+	/** Length of data remaining in outbound buffer being written */
+	size_t out_len;
+	/** Offset of remaining data in outbound buffer being written */
+	size_t out_offset;
+	/** Time of most recent transmission */
+	unsigned long active;
+
+	/** Statistics */
+	struct channel_stats stats;
+};
+
+/**
+ * Initialise channel
+ *
+ * @v chan		Channel
+ * @v name		Name
+ * @v op		Channel operations
+ * @v buf		Outbound buffers (two buffers of @c size bytes each)
+ * @v size		Length of each outbound buffer
+ */
+static inline __attribute__ (( always_inline )) void
+channel_init ( struct channel *chan, const char *name,
+	       struct channel_operations *op, uint8_t *buf, size_t size ) {
+
+	chan->name = name;
+	chan->op = op;
+	chan->buf = buf;
+	chan->size = size;
+	chan->fd = -1;
+}
+
+extern uint8_t * channel_reserve ( struct channel *chan, size_t len );
+extern ssize_t channel_read ( struct channel *chan, void *buf, size_t len );
+extern int channel_open ( struct channel *chan, int fd );
+extern void channel_close ( struct channel *chan );
+
+#endif /* _UNIPORT_CHANNEL_H */
@@ -0,0 +1,14 @@
+#ifndef _UNIPORT_CLI_H
+#define _UNIPORT_CLI_H
+
+/** @file
+ *
+ * Command line interface
+ *
+ */
+
+#include <stdio.h>
+
+extern void cli_close ( FILE *out );
+
+#endif /* _UNIPORT_CLI_H */
@@ -0,0 +1,65 @@
+#ifndef _UNIPORT_COLLECTION_H
+#define _UNIPORT_COLLECTION_H
+
+/** @file
+ *
+ * Resource collections
+ *
+ */
+
+#include <uniport/list.h>
+#include <uniport/resource.h>
+
+struct interface;
+
+/** Number of worker threads used for fanning out to members */
+#define COLLECTION_WORKERS 4
+
+/** A collection member */
+struct collection_member {
+	/** Resource */
+	struct resource *res;
+	/** Most recently retrieved state */
+	const void *state;
+	/** Result of most recent operation */
+	int rc;
+};
+
+/** Collection resource state */
+struct collection_state {
+	/** Member links */
+	const char *links;
+	/** Number of members */
+	int count;
+	/** Number of members that failed the most recent update */
+	int failed;
+};
+
+/** A resource collection */
+struct collection {
+	/** List of collections */
+	struct list_head list;
+	/** Resource namespace */
+	struct namespace ns;
+	/** Collection resource */
+	struct resource res;
+	/** NULL-terminated list of resources */
+	struct resource *resources[2];
+	/** Collection resource state */
+	struct collection_state state;
+	/** Member links */
+	char *links;
+	/** Member links are out of date */
+	int stale;
+	/** Members */
+	struct collection_member *members;
+	/** Number of members */
+	unsigned int count;
+};
+
+extern int collection_retrieve ( struct collection *coll );
+extern int collection_update ( struct collection *coll,
+			       struct interface *intf, char **assignments,
+			       unsigned int count );
+
+#endif /* _UNIPORT_COLLECTION_H */
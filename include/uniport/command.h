@@ -1,6 +1,7 @@
 #ifndef _UNIPORT_COMMAND_H
 #define _UNIPORT_COMMAND_H
 
+#include <stdio.h>
 #include <uniport/tables.h>
 
 /** A command-line command */
@@ -13,6 +14,9 @@ struct command {
 	 * @v argc		Argument count
 	 * @v argv		Argument list
 	 * @ret rc		Return status code
+	 *
+	 * All output should be written to command_output() (e.g. via
+	 * cprintf()), rather than to stdout.
 	 */
 	int ( * exec ) ( int argc, char **argv );
 };
@@ -23,4 +27,19 @@ struct command {
 /** Declare a command */
 #define __command __table_entry ( COMMANDS, 01 )
 
+extern FILE * command_output ( void );
+extern int split_command ( char *command, char **tokens );
+extern int fsystem ( FILE *out, const char *command );
+extern int fexecv ( FILE *out, char * const argv[] );
+
+/**
+ * Print command output
+ *
+ * @v fmt		Format string
+ * @v ...		Arguments
+ * @ret len		Length of output, or negative error
+ */
+#define cprintf( fmt, ... ) \
+	fprintf ( command_output(), fmt, ## __VA_ARGS__ )
+
 #endif /* _UNIPORT_COMMAND_H */
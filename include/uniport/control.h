@@ -0,0 +1,149 @@
+#ifndef _UNIPORT_CONTROL_H
+#define _UNIPORT_CONTROL_H
+
+/** @file
+ *
+ * Closed-loop control
+ *
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+#include <uniport/list.h>
+
+struct control_loop;
+
+/** Maximum controller output */
+#define CONTROL_OUTPUT_MAX 1000
+
+/** A controlled plant */
+struct control_plant {
+	/**
+	 * Measure process value
+	 *
+	 * @v loop		Control loop
+	 * @v now		Current time
+	 * @ret value		Measured process value
+	 */
+	int ( * measure ) ( struct control_loop *loop, unsigned long now );
+	/**
+	 * Apply controller output
+	 *
+	 * @v loop		Control loop
+	 * @v output		Controller output (0 to CONTROL_OUTPUT_MAX)
+	 */
+	void ( * actuate ) ( struct control_loop *loop, unsigned int output );
+};
+
+/** A control algorithm */
+struct controller {
+	/** Name */
+	const char *name;
+	/**
+	 * Calculate controller output
+	 *
+	 * @v loop		Control loop
+	 * @v measured		Measured process value
+	 * @v dt		Time since previous step (in ticks)
+	 * @ret output		Controller output (0 to CONTROL_OUTPUT_MAX)
+	 */
+	unsigned int ( * step ) ( struct control_loop *loop, int measured,
+				  unsigned long dt );
+};
+
+/** Control loop statistics */
+struct control_stats {
+	/** Number of iterations */
+	unsigned long iterations;
+	/** Total wakeup jitter (in ticks) */
+	unsigned long long jitter;
+	/** Maximum wakeup jitter (in ticks) */
+	unsigned long jitter_max;
+	/** Total time spent within each iteration (in ticks) */
+	unsigned long long busy;
+	/** Maximum time spent within an iteration (in ticks) */
+	unsigned long busy_max;
+	/** Number of missed periods */
+	unsigned long overruns;
+};
+
+/** A closed-loop controller */
+struct control_loop {
+	/** Name */
+	const char *name;
+	/** List of control loops */
+	struct list_head list;
+	/** Plant */
+	struct control_plant *plant;
+	/** Control algorithm */
+	struct controller *ctrl;
+	/** Control period (in ticks) */
+	unsigned long period;
+
+	/** Setpoint */
+	int setpoint;
+	/** Proportional gain (output units per unit of error) */
+	unsigned int kp;
+	/** Integral gain (output units per unit of error-seconds) */
+	unsigned int ki;
+	/** Derivative gain (output units per unit of error per second) */
+	unsigned int kd;
+	/** Hysteresis (for on/off control) */
+	unsigned int hysteresis;
+
+	/** Accumulated integral (in error-ticks) */
+	int64_t integral;
+	/** Previous measured process value */
+	int previous;
+	/** Most recent controller output */
+	unsigned int output;
+
+	/** Statistics */
+	struct control_stats stats;
+	/** Control thread */
+	pthread_t thread;
+	/** Control thread is running */
+	volatile int running;
+	/** Parameter lock
+	 *
+	 * This protects the setpoint, the gains, the controller state
+	 * and the statistics against concurrent modification from
+	 * the command line.  It must be initialised by the owner of
+	 * the control loop.
+	 */
+	pthread_mutex_t lock;
+};
+
+/** A simulated first-order thermal mass
+ *
+ * The model tracks temperature in micro-degrees, heater power in
+ * milliwatts, heat loss in milliwatts per degree, and heat capacity
+ * in millijoules per degree.
+ */
+struct thermal_model {
+	/** Current temperature (in micro-degrees) */
+	int64_t temperature;
+	/** Ambient temperature (in degrees) */
+	int ambient;
+	/** Heater power (in milliwatts) */
+	unsigned long power;
+	/** Heat loss to ambient (in milliwatts per degree) */
+	unsigned long loss;
+	/** Heat capacity (in millijoules per degree) */
+	unsigned long capacity;
+	/** Time of last update */
+	unsigned long updated;
+};
+
+extern struct controller pid_controller;
+extern struct controller onoff_controller;
+
+extern int control_start ( struct control_loop *loop );
+extern void control_stop ( struct control_loop *loop );
+extern void control_setpoint ( struct control_loop *loop, int setpoint );
+extern void thermal_model_step ( struct thermal_model *model, int heating,
+				 unsigned long now );
+extern int thermal_model_temperature ( struct thermal_model *model,
+				       unsigned int scale );
+
+#endif /* _UNIPORT_CONTROL_H */
@@ -0,0 +1,153 @@
+#ifndef _UNIPORT_DEBOUNCE_H
+#define _UNIPORT_DEBOUNCE_H
+
+/** @file
+ *
+ * Input debouncing
+ *
+ */
+
+#include <uniport/list.h>
+#include <uniport/timer.h>
+
+/** Debounce sampling period (in ticks) */
+#define DEBOUNCE_PERIOD ( 1 * TICKS_PER_MS )
+
+/** Debounce filter modes */
+enum debounce_mode {
+	/** Integrating counter
+	 *
+	 * A counter is incremented on each sample while the raw input
+	 * is asserted, and decremented while it is deasserted.  The
+	 * debounced value changes only when the counter reaches zero
+	 * or the threshold.
+	 */
+	DEBOUNCE_INTEGRATOR = 0,
+	/** Stable time window
+	 *
+	 * The debounced value changes only once the raw input has
+	 * remained unchanged for the whole window.
+	 */
+	DEBOUNCE_WINDOW,
+};
+
+/** Debounce statistics */
+struct debounce_stats {
+	/** Number of triggers (i.e. raw edges reported) */
+	unsigned long triggers;
+	/** Number of samples taken */
+	unsigned long samples;
+	/** Number of changes in debounced value */
+	unsigned long changes;
+};
+
+/** A debounced input */
+struct debounce {
+	/** Name */
+	const char *name;
+	/** List of debounced inputs */
+	struct list_head list;
+	/** List of inputs being sampled */
+	struct list_head active;
+	/** Filter mode */
+	enum debounce_mode mode;
+	/** Integrator threshold (in samples) */
+	unsigned int threshold;
+	/** Stable time window (in ticks) */
+	unsigned long window;
+	/**
+	 * Sample raw input
+	 *
+	 * @v deb		Debounced input
+	 * @ret raw		Raw input value
+	 */
+	int ( * sample ) ( struct debounce *deb );
+	/**
+	 * Handle change in debounced value
+	 *
+	 * @v deb		Debounced input
+	 *
+	 * This is called from the debounce thread without the
+	 * debounce lock held, once all inputs have been sampled.  It
+	 * may notify observers or call debounce_trigger(), but must
+	 * not call debounce_unregister() for this input.
+	 */
+	void ( * changed ) ( struct debounce *deb );
+	/**
+	 * Handle input settling (optional)
+	 *
+	 * @v deb		Debounced input
+	 *
+	 * This is called when sampling stops, and may be used to
+	 * re-enable an edge interrupt.  The input is sampled once
+	 * more after this method returns, to catch any edge that
+	 * occurred before the interrupt was re-enabled.  The same
+	 * restrictions apply as for changed().
+	 */
+	void ( * settled ) ( struct debounce *deb );
+
+	/** Debounced value */
+	int value;
+	/** Most recent raw value */
+	int raw;
+	/** Integrator count */
+	unsigned int count;
+	/** Time of most recent raw change */
+	unsigned long since;
+	/** Input is being sampled */
+	int sampling;
+	/** List of inputs with events awaiting report */
+	struct list_head pending;
+	/** Events awaiting report */
+	unsigned int events;
+	/** Statistics */
+	struct debounce_stats stats;
+};
+
+/** A recorded raw edge */
+struct debounce_edge {
+	/** Time (in ticks) */
+	unsigned long time;
+	/** Raw value following the edge */
+	int raw;
+};
+
+/** A bounce trace */
+struct debounce_trace {
+	/** Edges */
+	struct debounce_edge *edges;
+	/** Number of edges */
+	unsigned int count;
+	/** Number of allocated edges */
+	unsigned int max;
+	/** Expected number of debounced changes, if known */
+	unsigned int expected;
+};
+
+/** Bounce trace replay results */
+struct debounce_replay {
+	/** Number of notifications */
+	unsigned long notifications;
+	/** Number of wakeups */
+	unsigned long wakeups;
+	/** Number of samples */
+	unsigned long samples;
+};
+
+extern void debounce_reset ( struct debounce *deb, int raw,
+			     unsigned long now );
+extern int debounce_step ( struct debounce *deb, int raw,
+			   unsigned long now );
+extern int debounce_is_settled ( struct debounce *deb, unsigned long now );
+extern int debounce_register ( struct debounce *deb );
+extern void debounce_unregister ( struct debounce *deb );
+extern void debounce_trigger ( struct debounce *deb );
+extern int debounce_trace_load ( struct debounce_trace *trace,
+				 const char *filename );
+extern void debounce_replay_raw ( struct debounce_trace *trace,
+				  struct debounce_replay *replay );
+extern void debounce_replay_filter ( struct debounce_trace *trace,
+				     struct debounce *deb,
+				     struct debounce_replay *replay );
+
+#endif /* _UNIPORT_DEBOUNCE_H */
@@ -0,0 +1,22 @@
+#ifndef _UNIPORT_DISCOVERY_H
+#define _UNIPORT_DISCOVERY_H
+
+/** @file
+ *
+ * Resource discovery
+ *
+ */
+
+#include <stdbool.h>
+#include <uniport/resource.h>
+
+struct interface;
+
+extern bool discovery_has_interface ( struct resource *res,
+				      struct interface *intf );
+extern size_t discovery_link ( struct resource *res, char *buf, size_t len );
+extern int discovery_add ( struct namespace *ns );
+extern void discovery_del ( struct namespace *ns );
+extern size_t discovery_links ( char *buf, size_t len, size_t offset );
+
+#endif /* _UNIPORT_DISCOVERY_H */
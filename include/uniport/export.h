@@ -0,0 +1,156 @@
+#ifndef _UNIPORT_EXPORT_H
+#define _UNIPORT_EXPORT_H
+
+/** @file
+ *
+ * Shared-memory state export
+ *
+ * This header describes the layout of the exported segment, and may
+ * be included by reader processes.  All offsets are relative to the
+ * start of the segment, so that the segment may be mapped at any
+ * address.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+/** Exported segment magic ("UPSX") */
+#define EXPORT_MAGIC 0x58535055UL
+
+/** Exported segment layout version */
+#define EXPORT_VERSION 1
+
+/** Default exported segment name */
+#define EXPORT_NAME "/uniport"
+
+/** Alignment of exported resource states */
+#define EXPORT_ALIGN 8
+
+/** Exported segment header */
+struct export_header {
+	/** Magic (EXPORT_MAGIC), or zero if the segment is not valid */
+	uint32_t magic;
+	/** Layout version */
+	uint16_t version;
+	/** Length of this header */
+	uint16_t header_len;
+	/** Total length of segment */
+	uint32_t len;
+	/** Number of resource descriptors */
+	uint32_t num_descs;
+	/** Offset of resource descriptor table */
+	uint32_t descs;
+	/** Number of resources */
+	uint32_t num_resources;
+	/** Offset of resource table */
+	uint32_t resources;
+	/** Offset of string table */
+	uint32_t strings;
+};
+
+/** An exported resource descriptor */
+struct export_descriptor {
+	/** Resource type (string offset), or zero */
+	uint32_t rt;
+	/** Length of resource state */
+	uint32_t len;
+	/** Number of properties */
+	uint32_t count;
+	/** Offset of property table */
+	uint32_t props;
+};
+
+/** An exported property */
+struct export_property {
+	/** Name (string offset) */
+	uint32_t name;
+	/** Property type name (string offset) */
+	uint32_t type;
+	/** Offset from start of resource state */
+	uint32_t offset;
+	/** Length of state variable */
+	uint32_t len;
+	/** Property flags */
+	uint32_t flags;
+	/** Type-specific parameter */
+	uint32_t param;
+};
+
+/** Exported property value refers to memory within the exporting process
+ *
+ * Such values (e.g. strings and arrays) cannot be decoded by readers.
+ */
+#define EXPORT_PROP_INDIRECT 0x80000000UL
+
+/** An exported resource */
+struct export_resource {
+	/** Sequence counter
+	 *
+	 * The counter is odd while the state is being written.
+	 */
+	uint32_t seq;
+	/** Resource descriptor index, or EXPORT_REMOVED */
+	uint32_t desc;
+	/** URI (string offset) */
+	uint32_t uri;
+	/** Offset of resource state */
+	uint32_t state;
+};
+
+/** Exported resource has been unregistered */
+#define EXPORT_REMOVED 0xffffffffUL
+
+/**
+ * Get pointer within exported segment
+ *
+ * @v hdr		Segment header
+ * @v offset		Offset
+ * @ret ptr		Pointer
+ */
+static inline void * export_ptr ( const struct export_header *hdr,
+				  uint32_t offset ) {
+
+	return ( ( ( void * ) hdr ) + offset );
+}
+
+/**
+ * Read exported resource state
+ *
+ * @v hdr		Segment header
+ * @v rec		Exported resource
+ * @v buf		Buffer (of the descriptor's state length)
+ * @ret desc		Resource descriptor index, or EXPORT_REMOVED
+ *
+ * The copy is retried until it is consistent, without blocking the
+ * exporting process.
+ */
+static inline uint32_t export_read ( const struct export_header *hdr,
+				     const struct export_resource *rec,
+				     void *buf ) {
+	const struct export_descriptor *descs =
+		export_ptr ( hdr, hdr->descs );
+	uint32_t seq;
+	uint32_t desc;
+
+	do {
+		while ( ( seq = __atomic_load_n ( &rec->seq,
+						  __ATOMIC_ACQUIRE ) ) & 1 ) {
+			/* Writer in progress */
+		}
+		desc = __atomic_load_n ( &rec->desc, __ATOMIC_RELAXED );
+		if ( desc == EXPORT_REMOVED )
+			return desc;
+		memcpy ( buf, export_ptr ( hdr, rec->state ),
+			 descs[desc].len );
+		__atomic_thread_fence ( __ATOMIC_ACQUIRE );
+	} while ( __atomic_load_n ( &rec->seq, __ATOMIC_RELAXED ) != seq );
+
+	return desc;
+}
+
+struct resource;
+
+extern void export_record ( struct resource *res, const void *state );
+
+#endif /* _UNIPORT_EXPORT_H */
@@ -0,0 +1,98 @@
+#ifndef _UNIPORT_HISTORY_H
+#define _UNIPORT_HISTORY_H
+
+/** @file
+ *
+ * Resource state history
+ *
+ */
+
+#include <stdint.h>
+#include <uniport/resource.h>
+
+/** History resolutions */
+enum history_resolution {
+	/** Raw state snapshots */
+	HISTORY_RAW = 0,
+	/** One-second buckets */
+	HISTORY_SECOND,
+	/** One-minute buckets */
+	HISTORY_MINUTE,
+	/** Number of resolutions */
+	HISTORY_NUM_RESOLUTIONS
+};
+
+/** A raw history sample */
+struct history_sample {
+	/** Time of sample */
+	unsigned long time;
+	/** Resource state */
+	uint8_t state[0] __attribute__ (( aligned ( 8 ) ));
+};
+
+/** Statistics for an integer property within a history bucket */
+struct history_stat {
+	/** Minimum value */
+	int min;
+	/** Maximum value */
+	int max;
+	/** Sum of values */
+	int64_t sum;
+};
+
+/** A downsampled history bucket */
+struct history_bucket {
+	/** Start time of bucket */
+	unsigned long start;
+	/** Number of samples within bucket */
+	unsigned int count;
+	/** Statistics for each integer property */
+	struct history_stat stats[0];
+};
+
+/** A history ring */
+struct history_ring {
+	/** Entries */
+	void *entries;
+	/** Size of each entry */
+	size_t size;
+	/** Producer counter */
+	unsigned int prod;
+};
+
+/** A resource state history
+ *
+ * The depth of each ring is fixed by the resource owner.  All
+ * storage is reserved when the resource is registered.
+ */
+struct history {
+	/** Number of entries at each resolution */
+	unsigned int depth[HISTORY_NUM_RESOLUTIONS];
+	/** Integer properties */
+	struct property **ints;
+	/** Number of integer properties */
+	unsigned int num_ints;
+	/** History rings */
+	struct history_ring rings[HISTORY_NUM_RESOLUTIONS];
+};
+
+/**
+ * Initialise history
+ *
+ * @v _raw		Number of raw samples
+ * @v _seconds		Number of one-second buckets
+ * @v _minutes		Number of one-minute buckets
+ */
+#define HISTORY_INIT( _raw, _seconds, _minutes ) {			\
+	.depth = {							\
+		[HISTORY_RAW] = _raw,					\
+		[HISTORY_SECOND] = _seconds,				\
+		[HISTORY_MINUTE] = _minutes,				\
+	},								\
+	}
+
+extern int history_reserve ( struct resource *res );
+extern void history_release ( struct resource *res );
+extern void history_record ( struct resource *res, const void *state );
+
+#endif /* _UNIPORT_HISTORY_H */
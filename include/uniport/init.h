@@ -26,6 +26,14 @@ struct init_fn {
 /** Declare an initialisation functon */
 #define __init_fn __table_entry ( INIT_FNS, 01 )
 
+/** Declare a late initialisation function
+ *
+ * Late initialisation functions are called after all other
+ * initialisation functions, and so may rely upon all devices having
+ * been registered.
+ */
+#define __late_init_fn __table_entry ( INIT_FNS, 02 )
+
 extern void initialise ( void );
 
 #endif /* _UNIPORT_INIT_H */
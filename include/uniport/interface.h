@@ -8,6 +8,7 @@
  */
 
 #include <uniport/property.h>
+#include <uniport/resource.h>
 #include <uniport/tables.h>
 
 /** An interface */
@@ -39,7 +40,115 @@ static inline int interface_has_property ( struct interface *intf,
 	return ( ! ( ( prop->flags ^ intf->flags ) & intf->mask ) );
 }
 
+/** Number of properties per property mask word */
+#define INTERFACE_MASK_BITS ( 8 * sizeof ( unsigned long ) )
+
+/** Property mask types */
+enum interface_mask_type {
+	/** Properties accessible via the interface */
+	INTERFACE_VISIBLE = 0,
+	/** Properties accessible and writable via the interface */
+	INTERFACE_WRITABLE = 1,
+};
+
+/**
+ * Get number of words in a property mask
+ *
+ * @v desc		Resource descriptor
+ * @ret words		Number of words
+ */
+static inline __attribute__ (( always_inline )) unsigned int
+interface_mask_words ( const struct resource_descriptor *desc ) {
+
+	return ( ( desc->count + INTERFACE_MASK_BITS - 1 ) /
+		 INTERFACE_MASK_BITS );
+}
+
+/**
+ * Get property mask
+ *
+ * @v intf		Interface
+ * @v desc		Resource descriptor (which must be registered)
+ * @v type		Mask type
+ * @ret mask		Property mask
+ *
+ * The masks for each interface are stored consecutively, in order of
+ * the interface table, with each interface's visible mask followed
+ * by its writable mask.
+ */
+static inline __attribute__ (( always_inline )) const unsigned long *
+interface_mask ( struct interface *intf,
+		 const struct resource_descriptor *desc,
+		 enum interface_mask_type type ) {
+	unsigned int index = table_index ( INTERFACES, intf );
+
+	return ( *desc->masks +
+		 ( ( ( 2 * index ) + type ) * interface_mask_words ( desc ) ) );
+}
+
+/**
+ * Test if property is present in property mask
+ *
+ * @v intf		Interface
+ * @v desc		Resource descriptor (which must be registered)
+ * @v type		Mask type
+ * @v index		Property index
+ * @ret present		Property is present in mask
+ */
+static inline __attribute__ (( always_inline )) int
+interface_mask_test ( struct interface *intf,
+		      const struct resource_descriptor *desc,
+		      enum interface_mask_type type, unsigned int index ) {
+	const unsigned long *mask = interface_mask ( intf, desc, type );
+
+	return ( ( mask[ index / INTERFACE_MASK_BITS ] >>
+		   ( index % INTERFACE_MASK_BITS ) ) & 1 );
+}
+
+/**
+ * Find next property present in property mask
+ *
+ * @v intf		Interface
+ * @v desc		Resource descriptor (which must be registered)
+ * @v type		Mask type
+ * @v index		Starting property index
+ * @ret index		Next property index, or property count if none
+ */
+static inline __attribute__ (( always_inline )) unsigned int
+interface_mask_next ( struct interface *intf,
+		      const struct resource_descriptor *desc,
+		      enum interface_mask_type type, unsigned int index ) {
+	const unsigned long *mask = interface_mask ( intf, desc, type );
+	unsigned int word = ( index / INTERFACE_MASK_BITS );
+	unsigned long bits;
+
+	if ( index >= desc->count )
+		return desc->count;
+	bits = ( mask[word] & ( ~0UL << ( index % INTERFACE_MASK_BITS ) ) );
+	while ( ! bits ) {
+		if ( ++word >= interface_mask_words ( desc ) )
+			return desc->count;
+		bits = mask[word];
+	}
+	return ( ( word * INTERFACE_MASK_BITS ) + __builtin_ctzl ( bits ) );
+}
+
+/**
+ * Iterate over properties present in property mask
+ *
+ * @v index		Property index
+ * @v intf		Interface
+ * @v desc		Resource descriptor (which must be registered)
+ * @v type		Mask type
+ */
+#define for_each_interface_property( index, intf, desc, type )		\
+	for ( index = interface_mask_next ( intf, desc, type, 0 ) ;	\
+	      index < (desc)->count ;					\
+	      index = interface_mask_next ( intf, desc, type,		\
+					    ( index + 1 ) ) )
+
 extern struct interface * interface_find ( const char * name );
+extern int interface_mask_init ( const struct resource_descriptor *desc );
 
 extern struct interface oic_if_baseline __interface;
 
@@ -0,0 +1,143 @@
+#ifndef _UNIPORT_MQTT_H
+#define _UNIPORT_MQTT_H
+
+/** @file
+ *
+ * MQTT bridge
+ *
+ */
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <uniport/resource.h>
+#include <uniport/channel.h>
+
+/** Default MQTT port */
+#define MQTT_PORT 1883
+
+/** Default topic prefix */
+#define MQTT_PREFIX "uniport"
+
+/** Default keepalive interval (in seconds) */
+#define MQTT_KEEPALIVE 60
+
+/** Length of each outbound buffer */
+#define MQTT_TX_LEN 2048
+
+/** Length of inbound buffer */
+#define MQTT_RX_LEN 1024
+
+/** Maximum number of unacknowledged QoS 1 publications */
+#define MQTT_INFLIGHT 16
+
+/** Default interval after which a publication is retried (in ms) */
+#define MQTT_RETRY_MS 5000
+
+/** MQTT control packet types */
+enum mqtt_packet_type {
+	MQTT_CONNECT = 1,
+	MQTT_CONNACK = 2,
+	MQTT_PUBLISH = 3,
+	MQTT_PUBACK = 4,
+	MQTT_SUBSCRIBE = 8,
+	MQTT_SUBACK = 9,
+	MQTT_PINGREQ = 12,
+	MQTT_PINGRESP = 13,
+	MQTT_DISCONNECT = 14,
+};
+
+/** Duplicate delivery flag (within PUBLISH fixed header) */
+#define MQTT_DUP 0x08
+
+struct mqtt_bridge;
+
+/** A bridged resource */
+struct mqtt_observer {
+	/** Observer */
+	struct observer obs;
+	/** Bridge */
+	struct mqtt_bridge *bridge;
+	/** A publication is awaiting space in the outbound buffer */
+	int pending;
+};
+
+/** An unacknowledged QoS 1 publication */
+struct mqtt_inflight {
+	/** Bridged resource, or NULL if slot is free */
+	struct mqtt_observer *mobs;
+	/** Packet identifier */
+	uint16_t id;
+	/** Time at which publication was most recently queued */
+	unsigned long sent;
+	/** Copy of packet (for retransmission) */
+	uint8_t *packet;
+	/** Length of packet */
+	size_t len;
+};
+
+/** MQTT bridge statistics */
+struct mqtt_stats {
+	/** Number of publications queued */
+	unsigned long published;
+	/** Number of publications acknowledged */
+	unsigned long acked;
+	/** Number of publications deferred due to a full buffer */
+	unsigned long deferred;
+	/** Number of publications retried due to a missing acknowledgement */
+	unsigned long retried;
+	/** Number of publications dropped as too large for the buffer */
+	unsigned long oversized;
+	/** Number of updates received */
+	unsigned long updates;
+	/** Number of updates that failed */
+	unsigned long failed;
+};
+
+/** An MQTT bridge */
+struct mqtt_bridge {
+	/** Broker address */
+	struct sockaddr_in server;
+	/** Client identifier */
+	const char *client;
+	/** Topic prefix */
+	const char *prefix;
+	/** Quality of service for publications (0 or 1) */
+	unsigned int qos;
+	/** Keepalive interval (in seconds) */
+	unsigned int keepalive;
+	/** Retransmission interval (in ticks) */
+	unsigned long retry;
+
+	/** Bridged resources */
+	struct mqtt_observer *mobs;
+	/** Number of bridged resources */
+	unsigned int count;
+
+	/** Channel (whose lock also protects in-flight publications) */
+	struct channel chan;
+	/** Outbound buffers */
+	uint8_t buf[ 2 * MQTT_TX_LEN ];
+	/** Some publications are awaiting space in the outbound buffer */
+	int backlog;
+
+	/** Inbound buffer */
+	uint8_t rx[MQTT_RX_LEN];
+	/** Length of data in inbound buffer */
+	size_t rx_len;
+
+	/** Unacknowledged QoS 1 publications */
+	struct mqtt_inflight inflight[MQTT_INFLIGHT];
+	/** Storage for copies of unacknowledged publications */
+	uint8_t *retained;
+	/** Next packet identifier */
+	uint16_t next_id;
+
+	/** Statistics */
+	struct mqtt_stats stats;
+};
+
+extern int mqtt_open ( struct mqtt_bridge *bridge, int fd );
+extern int mqtt_connect ( struct mqtt_bridge *bridge );
+extern void mqtt_close ( struct mqtt_bridge *bridge );
+
+#endif /* _UNIPORT_MQTT_H */
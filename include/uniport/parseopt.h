@@ -13,6 +13,8 @@
 
 struct resource;
 struct interface;
+struct property_type;
+struct in_addr;
 
 /** A command-line option descriptor */
 struct option_descriptor {
@@ -120,6 +122,9 @@ extern int parse_integer ( char *text, unsigned int *value );
 extern int parse_flag ( char *text __unused, int *flag );
 extern int parse_resource ( char *text, struct resource **res );
 extern int parse_interface ( char *text, struct interface **intf );
+extern int parse_property_type ( char *text,
+				 const struct property_type **type );
+extern int parse_address ( char *text, struct in_addr *addr );
 extern void print_usage ( struct command_descriptor *cmd, char **argv );
 extern int reparse_options ( int argc, char **argv,
 			     struct command_descriptor *cmd, void *opts );
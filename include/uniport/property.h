@@ -7,7 +7,9 @@
  *
  */
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <uniport/tables.h>
 #include <uniport/uuid.h>
 
 /** A property */
@@ -16,10 +18,14 @@ struct property {
 	const char *name;
 	/** Offset from start of state descriptor */
 	size_t offset;
+	/** Length of state variable */
+	size_t len;
 	/** Property type */
 	const struct property_type *type;
 	/** Property flags */
 	unsigned int flags;
+	/** Type-specific parameter */
+	unsigned int param;
 };
 
 /** Property is writable */
@@ -28,16 +34,42 @@ struct property {
 /** Property is metadata */
 #define PROP_META 0x00000002
 
-/** Define a property */
-#define PROPERTY( _name, _state, _field, _check, _type, _flags ) {	\
+/** Define a property
+ *
+ * Any additional arguments are used as designated initialisers for
+ * the property (e.g. ".param = 2").
+ */
+#define PROPERTY( _name, _state, _field, _check, _type, _flags, ... ) {	\
 	.name = _name,							\
 	.offset = ( offsetof ( _state, _field ) +			\
 		    ( ( &( ( ( _state * ) NULL )->_field ) ==		\
 			( ( _check * ) NULL ) ) ? 0 : 0 ) ),		\
+	.len = sizeof ( ( ( _state * ) NULL )->_field ),		\
 	.type = _type,							\
 	.flags = _flags,						\
+	__VA_ARGS__							\
 	}
 
+/** Length of temporary buffer used for formatting properties
+ *
+ * Most property values will fit within this length, allowing them to
+ * be formatted in a single pass.
+ */
+#define PROPERTY_FORMAT_LEN 48
+
+/** A position hint within a formatted property value
+ *
+ * This allows a type-specific format_part() method to resume from
+ * where the previous part ended, rather than from the start of the
+ * value.  An all-zero hint is always valid.
+ */
+struct property_hint {
+	/** Index of element (e.g. array element) */
+	size_t element;
+	/** Offset of element within formatted string */
+	size_t position;
+};
+
 /** A property type */
 struct property_type {
 	/** Name */
@@ -61,6 +93,25 @@ struct property_type {
 	 */
 	int ( * parse ) ( struct property *prop, const char *string,
 			  void *state );
+	/** Format part of property as string (optional)
+	 *
+	 * @v prop		Property
+	 * @v buf		String buffer
+	 * @v len		Length of string buffer
+	 * @v value		State variable
+	 * @v offset		Starting offset within formatted string
+	 * @v hint		Position hint (updated), or NULL
+	 * @ret len		Length of remainder of string
+	 *
+	 * The remainder of the string may be reported as any length
+	 * of at least @c len if it does not fit within the buffer.
+	 * This allows large values to be formatted in pieces, without
+	 * first formatting the whole value.
+	 */
+	size_t ( * format_part ) ( struct property *prop, char *buf,
+				   size_t len, const void *value,
+				   size_t offset,
+				   struct property_hint *hint );
 };
 
 /** Type of a property format() method */
@@ -85,17 +136,96 @@ struct property_type {
 	  ( ( ( ( property_parse_t ( _type ) ) NULL )			\
 	      == _parse ) ? _parse : _parse ) )
 
-/** Define a property type */
-#define PROPERTY_TYPE( _name, _type, _format, _parse ) {		\
+/** Type of a property format_part() method */
+#define property_format_part_t( _type )					\
+	size_t ( * ) ( struct property *prop, char *buf, size_t len,	\
+		       const _type *value, size_t offset,		\
+		       struct property_hint *hint )
+
+/** Define a property format_part() method */
+#define PROPERTY_FORMAT_PART( _type, _format_part )			\
+	( ( property_format_part_t ( void ) )				\
+	  ( ( ( ( property_format_part_t ( _type ) ) NULL )		\
+	      == _format_part ) ? _format_part : _format_part ) )
+
+/** Define a property type
+ *
+ * Any additional arguments are used as designated initialisers for
+ * the property type (e.g. ".format_part = ...").
+ */
+#define PROPERTY_TYPE( _name, _type, _format, _parse, ... ) {		\
 	.name = _name,							\
 	.format = PROPERTY_FORMAT ( _type, _format ),			\
 	.parse = PROPERTY_PARSE ( _type, _parse ),			\
+	__VA_ARGS__							\
 	}
 
-extern const struct property_type boolean_property;
-extern const struct property_type integer_property;
-extern const struct property_type string_property;
-extern const struct property_type uuid_property;
+/** Property type table */
+#define PROPERTY_TYPES __table ( const struct property_type, "property_types" )
+
+/** Declare a property type */
+#define __property_type __table_entry ( PROPERTY_TYPES, 01 )
+
+/** An array-valued property
+ *
+ * The state variable refers to a buffer owned by the resource.
+ * Parsing a new value into a copy of the resource state fills in a
+ * staging buffer owned by that copy, leaving the resource's buffer
+ * untouched until the resource's update method accepts the copy and
+ * commits it using resource_commit().
+ */
+struct property_array {
+	/** Elements */
+	void *data;
+	/** Number of elements */
+	size_t count;
+	/** Staged elements, or NULL */
+	void *staged;
+};
+
+extern const struct property_type boolean_property __property_type;
+extern const struct property_type integer_property __property_type;
+extern const struct property_type string_property __property_type;
+extern const struct property_type uuid_property __property_type;
+extern const struct property_type fixed_property __property_type;
+extern const struct property_type float_property __property_type;
+extern const struct property_type array_property __property_type;
+extern const struct property_type blob_property __property_type;
+
+extern const struct property_type * property_type_find ( const char *name );
+
+extern size_t boolean_format ( struct property *prop, char *buf, size_t len,
+			       const bool *value );
+extern int boolean_parse ( struct property *prop, const char *string,
+			   bool *value );
+extern size_t integer_format ( struct property *prop, char *buf, size_t len,
+			       const int *value );
+extern int integer_parse ( struct property *prop, const char *string,
+			   int *value );
+extern size_t string_format ( struct property *prop, char *buf, size_t len,
+			      const char **value );
+extern int string_parse ( struct property *prop, const char *string,
+			  const char **value );
+extern size_t uuid_format ( struct property *prop, char *buf, size_t len,
+			    const union uuid *value );
+extern int uuid_parse ( struct property *prop, const char *string,
+			union uuid *value );
+extern size_t fixed_format ( struct property *prop, char *buf, size_t len,
+			     const int *value );
+extern int fixed_parse ( struct property *prop, const char *string,
+			 int *value );
+extern size_t float_format ( struct property *prop, char *buf, size_t len,
+			     const float *value );
+extern int float_parse ( struct property *prop, const char *string,
+			 float *value );
+extern size_t array_format ( struct property *prop, char *buf, size_t len,
+			     const struct property_array *value );
+extern int array_parse ( struct property *prop, const char *string,
+			 struct property_array *value );
+extern size_t blob_format ( struct property *prop, char *buf, size_t len,
+			    const struct property_array *value );
+extern int blob_parse ( struct property *prop, const char *string,
+			struct property_array *value );
 
 /** Define a boolean property */
 #define PROPERTY_BOOLEAN( _name, _state, _field, _flags )		\
@@ -113,14 +243,81 @@ extern const struct property_type uuid_property;
 		   &string_property, _flags )
 
 /** Define a UUID property */
-#define PROPERTY_UUID( _name, _state, _field ) \
-	PROPERTY ( _name, _state, _field, union uuid, &uuid_property )
+#define PROPERTY_UUID( _name, _state, _field, _flags )			\
+	PROPERTY ( _name, _state, _field, union uuid, &uuid_property,	\
+		   _flags )
+
+/** Define a fixed-point decimal property
+ *
+ * The value is stored as an integer in units of ( 10 ^ -_scale ).
+ */
+#define PROPERTY_FIXED( _name, _state, _field, _scale, _flags )		\
+	PROPERTY ( _name, _state, _field, int, &fixed_property,		\
+		   _flags, .param = _scale )
+
+/** Define a floating-point property
+ *
+ * The value is formatted with a fixed number of decimal places.
+ */
+#define PROPERTY_FLOAT( _name, _state, _field, _places, _flags )	\
+	PROPERTY ( _name, _state, _field, float, &float_property,	\
+		   _flags, .param = _places )
+
+/** Define an integer array property
+ *
+ * The array may hold at most _max integers.
+ */
+#define PROPERTY_ARRAY( _name, _state, _field, _max, _flags )		\
+	PROPERTY ( _name, _state, _field, struct property_array,	\
+		   &array_property, _flags, .param = _max )
+
+/** Define a binary blob property
+ *
+ * The blob may hold at most _max bytes.
+ */
+#define PROPERTY_BLOB( _name, _state, _field, _max, _flags )		\
+	PROPERTY ( _name, _state, _field, struct property_array,	\
+		   &blob_property, _flags, .param = _max )
+
+/**
+ * Check if property value refers to memory owned by the resource
+ *
+ * @v prop		Property
+ * @ret indirect	Property value is not held within the state itself
+ *
+ * Such values (e.g. strings and arrays) cannot be meaningfully
+ * copied out of the running process as raw bytes.
+ */
+static inline int property_is_indirect ( struct property *prop ) {
+
+	return ( ( prop->type == &string_property ) ||
+		 ( prop->type == &array_property ) ||
+		 ( prop->type == &blob_property ) );
+}
+
+/**
+ * Check if property value is an array
+ *
+ * @v prop		Property
+ * @ret array		Property value is a struct property_array
+ */
+static inline int property_is_array ( struct property *prop ) {
+
+	return ( ( prop->type == &array_property ) ||
+		 ( prop->type == &blob_property ) );
+}
 
 extern size_t property_format ( struct property *prop, char *buf, size_t len,
 				const void *state );
 extern char * property_format_alloc ( struct property *prop,
 				      const void *state );
+extern size_t property_format_part ( struct property *prop, char *buf,
+				     size_t len, const void *state,
+				     size_t offset,
+				     struct property_hint *hint );
 extern int property_parse ( struct property *prop, const char *string,
 			    void *state );
+extern void property_commit ( struct property *prop, void *state );
+extern void property_discard ( struct property *prop, void *state );
 
 #endif /* _UNIPORT_PROPERTY_H */
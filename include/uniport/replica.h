@@ -0,0 +1,132 @@
+#ifndef _UNIPORT_REPLICA_H
+#define _UNIPORT_REPLICA_H
+
+/** @file
+ *
+ * State replication
+ *
+ */
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <uniport/resource.h>
+#include <uniport/channel.h>
+
+/** Default replication port */
+#define REPLICA_PORT 5690
+
+/** Default checkpoint interval (in seconds) */
+#define REPLICA_INTERVAL 30
+
+/** Length of each outbound buffer */
+#define REPLICA_TX_LEN 8192
+
+/** Length of inbound buffer (and hence maximum length of a frame) */
+#define REPLICA_RX_LEN 4096
+
+/** Number of recorded entry times (for measuring replication lag) */
+#define REPLICA_TIMES 256
+
+/** A replication frame header */
+struct replica_frame {
+	/** Frame type */
+	uint8_t type;
+	/** Reserved */
+	uint8_t reserved;
+	/** Length of frame body (network byte order) */
+	uint16_t len;
+	/** Sequence number (network byte order) */
+	uint32_t seq;
+} __attribute__ (( packed ));
+
+/** Replication frame types */
+enum replica_frame_type {
+	/** Property update
+	 *
+	 * The body comprises a length-prefixed URI followed by a
+	 * sequence of (property index, value length, value) tuples.
+	 */
+	REPLICA_UPDATE = 1,
+	/** End of full-state checkpoint */
+	REPLICA_CHECKPOINT = 2,
+	/** Acknowledgement of all entries up to this sequence number */
+	REPLICA_ACK = 3,
+};
+
+/** Replication statistics */
+struct replica_stats {
+	/** Number of entries sent or applied */
+	unsigned long entries;
+	/** Number of entries that could not be applied or encoded */
+	unsigned long failed;
+	/** Number of checkpoints sent or received */
+	unsigned long checkpoints;
+	/** Number of checkpoints forced by a full outbound buffer */
+	unsigned long resyncs;
+	/** Most recent replication lag (in ticks) */
+	unsigned long lag;
+	/** Maximum replication lag (in ticks) */
+	unsigned long max_lag;
+};
+
+/** A replication endpoint
+ *
+ * A primary endpoint streams updates to its replicated resources,
+ * interspersed with periodic full-state checkpoints.  A standby
+ * endpoint applies each received entry and acknowledges the highest
+ * applied sequence number.
+ */
+struct replica {
+	/** Endpoint is a standby */
+	int standby;
+	/** URI prefix replaced when applying entries (standby only) */
+	const char *from;
+	/** Replacement URI prefix (standby only) */
+	const char *to;
+	/** Checkpoint interval (in ticks, primary only) */
+	unsigned long interval;
+
+	/** Replicated resources (primary only) */
+	struct resource **resources;
+	/** Number of replicated resources */
+	unsigned int count;
+
+	/** Channel (whose lock also protects sequence numbers) */
+	struct channel chan;
+	/** Outbound buffers */
+	uint8_t buf[ 2 * REPLICA_TX_LEN ];
+
+	/** Inbound buffer */
+	uint8_t rx[REPLICA_RX_LEN];
+	/** Length of data in inbound buffer */
+	size_t rx_len;
+
+	/** Most recently assigned (or applied) sequence number */
+	uint32_t seq;
+	/** Most recently acknowledged sequence number */
+	uint32_t acked;
+	/** Time at which each recent entry was recorded (primary only) */
+	unsigned long times[REPLICA_TIMES];
+	/** Next resource to include in checkpoint, or zero if idle */
+	unsigned int checkpoint;
+	/** Time of most recent checkpoint */
+	unsigned long checkpointed;
+	/** Updates were lost and a checkpoint is required */
+	int resync;
+	/** Number of checkpoints required before the standby agrees
+	 *
+	 * When an entry fails to apply, the sequence number must not
+	 * advance until a complete checkpoint that started after the
+	 * failure has been applied without further failures.
+	 */
+	unsigned int diverged;
+
+	/** Statistics */
+	struct replica_stats stats;
+};
+
+extern int replica_open ( struct replica *replica, int fd );
+extern void replica_close ( struct replica *replica );
+extern void replica_record ( struct resource *res, const void *state );
+
+#endif /* _UNIPORT_REPLICA_H */
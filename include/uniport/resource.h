@@ -9,10 +9,19 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 #include <uniport/list.h>
+#include <uniport/tables.h>
 #include <uniport/property.h>
 
 struct interface;
+struct history;
+struct resource_cache;
+struct export_resource;
+struct replica;
+struct discovery_links;
 
 /** A resource namespace */
 struct namespace {
@@ -22,16 +31,71 @@ struct namespace {
 	const char *uri;
 	/** List of resources */
 	struct resource **resources;
+	/** Serialised discovery links (filled in when registered) */
+	struct discovery_links *links;
 };
 
+/**
+ * A namespace removal hook
+ *
+ * Subsystems holding references to resources (e.g. collections or
+ * rules) use a namespace removal hook to drop those references when
+ * a namespace is unregistered.
+ */
+struct namespace_hook {
+	/**
+	 * Remove references to resources within a namespace
+	 *
+	 * @v ns		Resource namespace
+	 *
+	 * Called before the namespace's resources are removed from
+	 * the resource index.
+	 */
+	void ( * forget ) ( struct namespace *ns );
+};
+
+/** Namespace removal hook table */
+#define NAMESPACE_HOOKS __table ( struct namespace_hook, "namespace_hooks" )
+
+/** Declare a namespace removal hook */
+#define __namespace_hook __table_entry ( NAMESPACE_HOOKS, 01 )
+
 /** A resource */
 struct resource {
 	/** URI suffix */
 	const char *uri;
+	/** Resource namespace (filled in when registered) */
+	struct namespace *ns;
 	/** Resource descriptor */
 	const struct resource_descriptor *desc;
 	/** List of observers */
 	struct list_head observers;
+	/** Observer lock (initialised when registered)
+	 *
+	 * This is a recursive lock, held while the list of observers
+	 * is modified or walked.  Removing an observer therefore waits
+	 * for any notification in progress on another thread.
+	 */
+	pthread_mutex_t observers_lock;
+	/*
+	 * Per-resource subsystem attachments
+	 *
+	 * Each attachment is opaque to the core, and is NULL unless
+	 * the owning subsystem is in use for this resource.  The
+	 * core tests each attachment before calling into its
+	 * subsystem.  The export and replication attachments may be
+	 * detached concurrently, and so must be read atomically; the
+	 * subsystem rechecks its attachment using
+	 * resource_attachment_get().
+	 */
+	/** State history, if any */
+	struct history *history;
+	/** Retrieval cache (allocated if descriptor has a cache lifetime) */
+	struct resource_cache *cache;
+	/** Shared-memory export record, if exported */
+	struct export_resource *export;
+	/** Replication endpoint, if replicated */
+	struct replica *replica;
 };
 
 /** A resource observer */
@@ -48,7 +112,8 @@ struct observer {
 	 * @v obs		Observer
 	 * @v state		Resource state
 	 *
-	 * This method is not permitted to modify the list of
+	 * This method is called with the resource's observer lock
+	 * held, and is not permitted to modify the list of
 	 * observers.
 	 */
 	void ( * notify ) ( struct observer *obs, const void *state );
@@ -59,6 +124,8 @@ struct observer {
 
 /** Resource descriptor */
 struct resource_descriptor {
+	/** Resource type (e.g. "oic.r.temperature"), or NULL */
+	const char *rt;
 	/** Length of resource state */
 	size_t len;
 	/** Properties */
@@ -77,7 +144,10 @@ struct resource_descriptor {
 	 * @v state		New resource state
 	 * @ret rc		Return status code
 	 *
-	 * May be NULL for a read-only resource.
+	 * May be NULL for a read-only resource.  A resource with
+	 * array-valued properties must call resource_commit() on
+	 * its own state (with its own lock held) once it has
+	 * accepted the new state.
 	 */
 	int ( * update ) ( struct resource *res, const void *state );
 	/** Update observation state
@@ -87,6 +157,47 @@ struct resource_descriptor {
 	 * May be NULL for an unobservable resource.
 	 */
 	void ( * observe ) ( struct resource *res );
+	/** Cache lifetime (in ticks)
+	 *
+	 * If non-zero, the state returned by retrieve() will be
+	 * reused for up to this length of time, and concurrent
+	 * retrievals of the same resource will be coalesced into a
+	 * single call to retrieve().
+	 */
+	unsigned long ttl;
+	/** Serialise resource state (optional)
+	 *
+	 * @v visible		Visible property mask
+	 * @v state		Resource state
+	 * @v buf		String buffer
+	 * @v len		Length of string buffer
+	 * @ret len		Length of serialised state
+	 *
+	 * Usually generated by RESOURCE_PROPERTIES().  If NULL, the
+	 * property table will be used instead.
+	 */
+	size_t ( * serialise ) ( const unsigned long *visible,
+				 const void *state, char *buf, size_t len );
+	/** Deserialise property value (optional)
+	 *
+	 * @v writable		Writable property mask
+	 * @v name		Property name
+	 * @v value		Property value
+	 * @v state		Resource state to update
+	 * @ret rc		Return status code
+	 *
+	 * Usually generated by RESOURCE_PROPERTIES().  If NULL, the
+	 * property table will be used instead.
+	 */
+	int ( * deserialise ) ( const unsigned long *writable, const char *name,
+				const char *value, void *state );
+	/** Per-interface property masks (filled in when registered)
+	 *
+	 * This points to writable storage provided by RESOURCE_DESC(),
+	 * so that the descriptor itself may be constant.  See
+	 * interface_mask() for the layout.
+	 */
+	unsigned long **masks;
 };
 
 /** Type of a resource retrieve() method */
@@ -109,16 +220,69 @@ struct resource_descriptor {
 	  ( ( ( ( resource_update_t ( _type ) ) NULL )			\
 	      == _update ) ? _update : _update ) )
 
-/** Define a resource descriptor */
-#define RESOURCE_DESC( _type, _props, _retrieve, _update, _observe ) {	\
+/**
+ * Define a resource descriptor
+ *
+ * @v _type		Resource state type
+ * @v _props		Properties
+ * @v _retrieve		Retrieve method
+ * @v _update		Update method, or NULL
+ * @v _observe		Observe method, or NULL
+ * @v ...		Any additional field initialisers
+ *
+ * The storage for the property masks is a compound literal, which has
+ * static storage duration when the descriptor is defined at file
+ * scope.
+ */
+#define RESOURCE_DESC( _type, _props, _retrieve, _update, _observe,	\
+		       ... ) {						\
 	.len = sizeof ( _type ),					\
 	.props = _props,						\
 	.count = ( sizeof ( _props ) / sizeof ( _props[0] ) ), 		\
 	.retrieve = RESOURCE_RETRIEVE ( _type, _retrieve ),		\
 	.update = RESOURCE_UPDATE ( _type, _update ),			\
 	.observe = _observe,						\
+	.masks = ( ( unsigned long * [1] ) { NULL } ),			\
+	__VA_ARGS__							\
 	}
 
+/** A position within a formatted resource state
+ *
+ * The formatted state is treated as a sequence of segments: the
+ * resource URI, a separator, and then a separator, name, separator
+ * and value for each property.  The cursor pins the resource state
+ * being formatted, so that every block is formatted from the same
+ * state.
+ */
+struct resource_cursor {
+	/** Resource state */
+	const void *state;
+	/** Current segment */
+	unsigned int segment;
+	/** Offset within current segment */
+	size_t offset;
+	/** Position hint within current property value */
+	struct property_hint hint;
+};
+
+/** Length of block used when printing resource state */
+#define RESOURCE_BLOCK_LEN 64
+
+/**
+ * Initialise resource formatting cursor
+ *
+ * @v cursor		Cursor
+ * @v state		Resource state
+ *
+ * The state must remain valid until formatting is complete.
+ */
+static inline __attribute__ (( always_inline )) void
+resource_cursor_init ( struct resource_cursor *cursor, const void *state ) {
+
+	memset ( cursor, 0, sizeof ( *cursor ) );
+	cursor->state = state;
+}
+
 /**
  * Initialise observer
  *
@@ -150,18 +314,78 @@ resource_has_observers ( struct resource *res ) {
 	return ( ! list_empty ( &res->observers ) );
 }
 
+/**
+ * Start using a concurrently detachable attachment
+ *
+ * @v writers		Writer count for this kind of attachment
+ * @v attachment	Attachment field (e.g. &res->export)
+ * @ret attached	Attachment, or NULL if detached
+ *
+ * The writer is counted before the attachment is read, so that
+ * resource_quiesce() either sees this writer or the attachment has
+ * already been detached.  Each call must be matched by a call to
+ * resource_attachment_put(), even if the attachment was detached.
+ */
+#define resource_attachment_get( writers, attachment ) ( {		\
+	__atomic_add_fetch ( (writers), 1, __ATOMIC_SEQ_CST );		\
+	__atomic_load_n ( (attachment), __ATOMIC_SEQ_CST ); } )
+
+/**
+ * Stop using a concurrently detachable attachment
+ *
+ * @v writers		Writer count for this kind of attachment
+ */
+static inline __attribute__ (( always_inline )) void
+resource_attachment_put ( unsigned int *writers ) {
+
+	__atomic_sub_fetch ( writers, 1, __ATOMIC_RELEASE );
+}
+
+/**
+ * Detach a concurrently detachable attachment
+ *
+ * @v attachment	Attachment field (e.g. &res->export)
+ *
+ * Writers may continue to use the attachment until resource_quiesce()
+ * has returned.
+ */
+#define resource_detach( attachment )					\
+	__atomic_store_n ( (attachment), NULL, __ATOMIC_SEQ_CST )
+
 extern struct list_head namespaces;
+extern struct resource **resource_index;
+extern unsigned int resource_index_count;
+extern struct resource **resource_type_index;
+extern unsigned int resource_type_count;
 
+extern void resource_index_lock ( void );
+extern void resource_index_unlock ( void );
 extern const void * resource_retrieve ( struct resource *res );
-extern int resource_update ( struct resource *res, const void *state );
+extern void resource_discard ( struct resource *res, void *state );
+extern void resource_commit ( struct resource *res, void *state );
+extern int resource_update ( struct resource *res, void *state );
 extern void resource_observe ( struct observer *obs );
 extern void resource_unobserve ( struct observer *obs );
 extern void resource_notify ( struct resource *res );
+extern void resource_quiesce ( unsigned int *writers );
+extern size_t resource_format_block ( struct resource *res,
+				      struct interface *intf,
+				      struct resource_cursor *cursor,
+				      char *buf, size_t len );
+extern void resource_fprint ( FILE *out, struct resource *res,
+			      struct interface *intf, const void *state );
 extern void resource_print ( struct resource *res, struct interface *intf,
 			     const void *state );
 extern int resource_register ( struct namespace *ns );
 extern void resource_unregister ( struct namespace *ns );
+extern size_t resource_uri ( struct resource *res, char *buf, size_t len );
+extern int resource_uri_ncmp ( struct resource *res, const char *uri,
+			       size_t len );
+extern bool resource_uri_match ( struct resource *res, const char *pattern );
+extern unsigned int resource_index_lower ( const char *uri, size_t len );
 extern struct resource * resource_find ( const char *uri );
+extern struct resource ** resource_find_type ( const char *rt,
+					       unsigned int *count );
 extern struct property * resource_property ( struct resource *res,
 					     const char *name );
 
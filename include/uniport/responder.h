@@ -0,0 +1,119 @@
+#ifndef _UNIPORT_RESPONDER_H
+#define _UNIPORT_RESPONDER_H
+
+/** @file
+ *
+ * Multicast discovery responder
+ *
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <uniport/list.h>
+
+struct namespace;
+
+/** Default discovery multicast group ("All CoAP Nodes") */
+#define RESPONDER_GROUP "224.0.1.187"
+
+/** Default discovery port */
+#define RESPONDER_PORT 5683
+
+/** Default maximum response jitter (in milliseconds) */
+#define RESPONDER_JITTER_MS 100
+
+/** Maximum length of a discovery query */
+#define RESPONDER_QUERY_LEN 128
+
+/** Maximum length of a discovery response */
+#define RESPONDER_RESPONSE_LEN 1152
+
+/** Number of queued responses per responder */
+#define RESPONDER_PENDING 8
+
+/** Number of recently answered queries remembered per responder */
+#define RESPONDER_RECENT 16
+
+/** Time for which a repeated query is suppressed (in milliseconds) */
+#define RESPONDER_RECENT_MS 2000
+
+/** A queued discovery response */
+struct responder_pending {
+	/** Requester address */
+	struct sockaddr_in peer;
+	/** Time at which response is due */
+	unsigned long due;
+	/** Query */
+	char query[RESPONDER_QUERY_LEN];
+};
+
+/** A recently answered discovery query */
+struct responder_recent {
+	/** Requester address */
+	struct sockaddr_in peer;
+	/** Time at which query was received */
+	unsigned long time;
+	/** Hash of query */
+	uint32_t hash;
+};
+
+/** Discovery responder statistics */
+struct responder_stats {
+	/** Number of queries received */
+	unsigned long queries;
+	/** Number of repeated queries suppressed */
+	unsigned long suppressed;
+	/** Number of queries matching no resources */
+	unsigned long unmatched;
+	/** Number of queries dropped due to a full queue */
+	unsigned long dropped;
+	/** Number of responses sent */
+	unsigned long responses;
+	/** Number of responses truncated to fit a datagram */
+	unsigned long truncated;
+};
+
+/** A multicast discovery responder */
+struct responder {
+	/** List of responders */
+	struct list_head list;
+	/** Resource URI pattern served by this responder */
+	char *pattern;
+	/** Namespace served by this responder, or NULL */
+	struct namespace *ns;
+	/** Multicast group */
+	struct in_addr group;
+	/** Local interface address */
+	struct in_addr local;
+	/** Port */
+	uint16_t port;
+	/** Maximum response jitter (in ticks) */
+	unsigned long jitter;
+
+	/** Socket */
+	int fd;
+	/** Responder thread */
+	pthread_t thread;
+	/** Responder thread is running */
+	volatile int running;
+	/** Random number generator state */
+	unsigned int seed;
+
+	/** Queued responses */
+	struct responder_pending pending[RESPONDER_PENDING];
+	/** Number of queued responses */
+	unsigned int num_pending;
+	/** Recently answered queries */
+	struct responder_recent recent[RESPONDER_RECENT];
+	/** Next recently answered query slot to use */
+	unsigned int next_recent;
+
+	/** Statistics */
+	struct responder_stats stats;
+};
+
+extern int responder_start ( struct responder *resp );
+extern void responder_stop ( struct responder *resp );
+
+#endif /* _UNIPORT_RESPONDER_H */
@@ -0,0 +1,101 @@
+#ifndef _UNIPORT_RULE_H
+#define _UNIPORT_RULE_H
+
+/** @file
+ *
+ * Rule engine
+ *
+ */
+
+#include <stdint.h>
+#include <uniport/list.h>
+#include <uniport/resource.h>
+
+/** Rule bytecode operations */
+enum rule_opcode {
+	/** End of bytecode (result is on top of stack) */
+	RULE_END = 0,
+	/** Push boolean property (followed by 16-bit state offset) */
+	RULE_LOAD_BOOL,
+	/** Push integer property (followed by 16-bit state offset) */
+	RULE_LOAD_INT,
+	/** Push constant (followed by 32-bit value) */
+	RULE_CONST,
+	/** Compare two values for equality */
+	RULE_EQ,
+	/** Compare two values for inequality */
+	RULE_NE,
+	/** Compare two values for less than */
+	RULE_LT,
+	/** Compare two values for less than or equal */
+	RULE_LE,
+	/** Compare two values for greater than */
+	RULE_GT,
+	/** Compare two values for greater than or equal */
+	RULE_GE,
+	/** Logical negation */
+	RULE_NOT,
+	/** Logical conjunction */
+	RULE_AND,
+	/** Logical disjunction */
+	RULE_OR,
+};
+
+/** Maximum length of rule bytecode */
+#define RULE_CODE_LEN 64
+
+/** Maximum depth of rule evaluation stack */
+#define RULE_STACK 8
+
+/** Maximum number of property assignments within a rule action */
+#define RULE_ASSIGNMENTS 4
+
+/** A rule
+ *
+ * When the trigger resource changes state, the compiled condition is
+ * evaluated against the new state.  Each time the condition changes
+ * from false to true, the action's property assignments are applied
+ * to the target resource.
+ */
+struct rule {
+	/** List of rules */
+	struct list_head list;
+	/** Name */
+	const char *name;
+	/** Trigger observer */
+	struct observer obs;
+	/** Compiled condition */
+	uint8_t code[RULE_CODE_LEN];
+	/** Length of compiled condition */
+	size_t len;
+	/** Condition was true at most recent evaluation */
+	int active;
+	/** Action is in progress */
+	int busy;
+
+	/** Target resource */
+	struct resource *target;
+	/** Assigned properties */
+	struct property *assigned[RULE_ASSIGNMENTS];
+	/** Number of assigned properties */
+	unsigned int num_assigned;
+	/** Assigned property values (as a target resource state) */
+	void *values;
+	/** Updated target resource state */
+	void *update;
+
+	/** Definition (as NUL-separated arguments) */
+	char *args;
+	/** Number of arguments within definition */
+	unsigned int num_args;
+
+	/** Number of evaluations */
+	unsigned long evaluations;
+	/** Number of times action was applied */
+	unsigned long fired;
+	/** Number of times action failed */
+	unsigned long failed;
+};
+
+
+#endif /* _UNIPORT_RULE_H */
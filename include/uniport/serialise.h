@@ -0,0 +1,188 @@
+#ifndef _UNIPORT_SERIALISE_H
+#define _UNIPORT_SERIALISE_H
+
+/** @file
+ *
+ * Resource state serialisation
+ *
+ * Resource state is serialised as a space-separated list of
+ * "name=value" pairs, one for each property visible via the chosen
+ * interface.
+ *
+ * A resource defined using RESOURCE_PROPERTIES() gets a serialiser
+ * and deserialiser generated specifically for its state structure.
+ * These access each state variable directly and call each property
+ * type's methods directly, with no walk of the property table.  Any
+ * other resource is serialised using the property table.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <uniport/resource.h>
+#include <uniport/interface.h>
+#include <uniport/string.h>
+
+/**
+ * Get remaining string buffer
+ *
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v used		Length used so far
+ * @ret buf		Remaining string buffer, or NULL
+ */
+static inline __attribute__ (( always_inline )) char *
+serialise_buf ( char *buf, size_t len, size_t used ) {
+
+	return ( ( used < len ) ? ( buf + used ) : NULL );
+}
+
+/**
+ * Get length of remaining string buffer
+ *
+ * @v len		Length of string buffer
+ * @v used		Length used so far
+ * @ret len		Length of remaining string buffer
+ */
+static inline __attribute__ (( always_inline )) size_t
+serialise_avail ( size_t len, size_t used ) {
+
+	return ( ( used < len ) ? ( len - used ) : 0 );
+}
+
+/**
+ * Append fixed text to string buffer
+ *
+ * @v buf		String buffer
+ * @v len		Length of string buffer
+ * @v used		Length used so far
+ * @v text		Text
+ * @v text_len		Length of text
+ * @ret len		Length of text
+ */
+static inline __attribute__ (( always_inline )) size_t
+serialise_text ( char *buf, size_t len, size_t used, const char *text,
+		 size_t text_len ) {
+
+	return format_string ( serialise_buf ( buf, len, used ),
+			       serialise_avail ( len, used ), text, text_len );
+}
+
+/**
+ * Test if property is present in property mask
+ *
+ * @v mask		Property mask
+ * @v index		Property index
+ * @ret present		Property is present in mask
+ */
+static inline __attribute__ (( always_inline )) int
+serialise_test ( const unsigned long *mask, unsigned int index ) {
+
+	return ( ( mask[ index / INTERFACE_MASK_BITS ] >>
+		   ( index % INTERFACE_MASK_BITS ) ) & 1 );
+}
+
+/** Define property index (for use by RESOURCE_PROPERTIES()) */
+#define SERIALISE_INDEX( _prefix, _state, _kind, _name, _field, _flags,	\
+			 _param )					\
+	_prefix ## _index_ ## _field,
+
+/** Define property (for use by RESOURCE_PROPERTIES()) */
+#define SERIALISE_PROPERTY( _prefix, _state, _kind, _name, _field,	\
+			    _flags, _param )				\
+	PROPERTY ( _name, _state, _field,				\
+		   typeof ( ( ( _state * ) NULL )->_field ),		\
+		   &_kind ## _property, _flags, .param = _param ),
+
+/** Serialise property (for use by RESOURCE_PROPERTIES())
+ *
+ * The state is accessed via a non-const pointer, since string
+ * properties take a non-const pointer to the (const) string.  The
+ * state is never modified.
+ */
+#define SERIALISE_FORMAT( _prefix, _state, _kind, _name, _field,	\
+			  _flags, _param )				\
+	if ( serialise_test ( visible, _prefix ## _index_ ## _field ) ) { \
+		if ( used )						\
+			used += serialise_text ( buf, len, used, " ", 1 ); \
+		used += serialise_text ( buf, len, used, _name "=",	\
+					 ( sizeof ( _name "=" ) - 1 ) ); \
+		used += _kind ## _format (				\
+			&_prefix ## _props[ _prefix ## _index_ ## _field ], \
+			serialise_buf ( buf, len, used ),		\
+			serialise_avail ( len, used ),			\
+			&( ( _state * ) state )->_field );		\
+	}
+
+/** Deserialise property (for use by RESOURCE_PROPERTIES()) */
+#define SERIALISE_PARSE( _prefix, _state, _kind, _name, _field,	\
+			 _flags, _param )				\
+	if ( strcmp ( name, _name ) == 0 ) {				\
+		if ( ! serialise_test ( writable,			\
+					_prefix ## _index_ ## _field ) ) \
+			return -EPERM;					\
+		return _kind ## _parse (				\
+			&_prefix ## _props[ _prefix ## _index_ ## _field ], \
+			value, &( ( _state * ) state )->_field );	\
+	}
+
+/**
+ * Define resource properties
+ *
+ * @v _prefix		Name prefix
+ * @v _list		Property list
+ *
+ * The property list is a macro taking a property macro and the name
+ * prefix, which it invokes once for each property as:
+ *
+ *     _prop ( _prefix, _state, _kind, _name, _field, _flags, _param )
+ *
+ * where @c _kind is the property type (e.g. @c fixed for a property
+ * of type @c fixed_property) and @c _param is the type-specific
+ * parameter (or zero).  This defines the property table
+ * _prefix_props[], along with a generated serialiser and
+ * deserialiser.  Use RESOURCE_SERIALISERS() within the resource
+ * descriptor to make use of the generated methods.
+ */
+#define RESOURCE_PROPERTIES( _prefix, _list )				\
+	enum { _list ( SERIALISE_INDEX, _prefix ) };			\
+	static struct property _prefix ## _props[] = {			\
+		_list ( SERIALISE_PROPERTY, _prefix )			\
+	};								\
+	static size_t _prefix ## _serialise ( const unsigned long *visible, \
+					      const void *state,	\
+					      char *buf, size_t len ) { \
+		size_t used = 0;					\
+		if ( len )						\
+			buf[0] = '\0';					\
+		_list ( SERIALISE_FORMAT, _prefix )			\
+		return used;						\
+	}								\
+	static int _prefix ## _deserialise ( const unsigned long *writable, \
+					     const char *name,		\
+					     const char *value,		\
+					     void *state ) {		\
+		_list ( SERIALISE_PARSE, _prefix )			\
+		return -EPERM;						\
+	}
+
+/**
+ * Use generated serialiser and deserialiser
+ *
+ * @v _prefix		Name prefix (as passed to RESOURCE_PROPERTIES())
+ *
+ * This should be included within the additional field initialisers
+ * of RESOURCE_DESC().
+ */
+#define RESOURCE_SERIALISERS( _prefix )					\
+	.serialise = _prefix ## _serialise,				\
+	.deserialise = _prefix ## _deserialise
+
+extern size_t resource_serialise ( struct resource *res,
+				   struct interface *intf,
+				   const void *state, char *buf, size_t len );
+extern int resource_deserialise ( struct resource *res,
+				  struct interface *intf, char *string,
+				  void *state );
+
+#endif /* _UNIPORT_SERIALISE_H */
@@ -0,0 +1,55 @@
+#ifndef _UNIPORT_SHELL_H
+#define _UNIPORT_SHELL_H
+
+/** @file
+ *
+ * Network shell
+ *
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <uniport/list.h>
+
+/** Default network shell port */
+#define SHELL_PORT 2323
+
+/** Maximum number of concurrent sessions */
+#define SHELL_SESSIONS 8
+
+/** Maximum length of a command line */
+#define SHELL_LINE_LEN 256
+
+/** Length of per-session output buffer */
+#define SHELL_OUTPUT_LEN 8192
+
+/** Network shell prompt */
+#define SHELL_PROMPT "uniport> "
+
+/** A network shell session */
+struct shell_session {
+	/** List of sessions */
+	struct list_head list;
+	/** Socket */
+	int fd;
+	/** Output stream (used as command output) */
+	FILE *out;
+
+	/** Partial command line */
+	char line[SHELL_LINE_LEN];
+	/** Length of partial command line */
+	size_t line_len;
+	/** Partial command line has overflowed */
+	int overflow;
+
+	/** Lock (protecting output buffer) */
+	pthread_mutex_t lock;
+	/** Pending output */
+	char output[SHELL_OUTPUT_LEN];
+	/** Length of pending output */
+	size_t output_len;
+	/** Number of output bytes discarded due to a full buffer */
+	unsigned long dropped;
+};
+
+#endif /* _UNIPORT_SHELL_H */
@@ -0,0 +1,159 @@
+#ifndef _UNIPORT_SINK_H
+#define _UNIPORT_SINK_H
+
+/** @file
+ *
+ * Output sinks
+ *
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/** Length of sink output buffer */
+#define SINK_BUF_LEN 4096
+
+struct sink;
+
+/** Output sink backend operations */
+struct sink_operations {
+	/** Name */
+	const char *name;
+	/**
+	 * Write data
+	 *
+	 * @v sink		Output sink
+	 * @v data		Data
+	 * @v len		Length of data
+	 * @ret len		Length written, or negative error
+	 *
+	 * The backend should write all of the data if possible.  The
+	 * data is always a single contiguous run of the sink's
+	 * buffer, so there is no vectored equivalent.
+	 */
+	ssize_t ( * write ) ( struct sink *sink, const void *data,
+			      size_t len );
+};
+
+/** Output sink statistics */
+struct sink_stats {
+	/** Number of bytes written */
+	unsigned long long bytes;
+	/** Number of backend writes */
+	unsigned long writes;
+	/** Number of commands executed */
+	unsigned long commands;
+};
+
+/** An output sink */
+struct sink {
+	/** Backend operations */
+	const struct sink_operations *op;
+	/** Output stream */
+	FILE *file;
+	/** Output buffer */
+	char buf[SINK_BUF_LEN];
+	/** Statistics */
+	struct sink_stats stats;
+};
+
+/** A file descriptor output sink */
+struct fd_sink {
+	/** Output sink */
+	struct sink sink;
+	/** File descriptor */
+	int fd;
+};
+
+/** A memory output sink */
+struct memory_sink {
+	/** Output sink */
+	struct sink sink;
+	/** Memory buffer */
+	char *data;
+	/** Length of memory buffer */
+	size_t max;
+	/** Length of data within memory buffer */
+	size_t len;
+};
+
+/** A stream output sink */
+struct stream_sink {
+	/** Output sink */
+	struct sink sink;
+	/** Underlying stream */
+	FILE *stream;
+};
+
+extern const struct sink_operations fd_sink_operations;
+extern const struct sink_operations memory_sink_operations;
+extern const struct sink_operations stream_sink_operations;
+
+extern int sink_open ( struct sink *sink, const struct sink_operations *op,
+		       int buffered );
+extern void sink_close ( struct sink *sink );
+extern int sink_system ( struct sink *sink, const char *command );
+extern int sink_execv ( struct sink *sink, char * const argv[] );
+
+/**
+ * Open buffered file descriptor output sink
+ *
+ * @v fdsink		File descriptor output sink
+ * @v fd		File descriptor (e.g. a UART or socket)
+ * @ret rc		Return status code
+ *
+ * Output is accumulated in the sink's buffer and written to the file
+ * descriptor when the buffer fills, when a command executed via
+ * sink_system() completes, or when the sink is closed.  The file
+ * descriptor remains owned by the caller, and is not closed by
+ * sink_close().
+ */
+static inline __attribute__ (( always_inline )) int
+sink_open_fd ( struct fd_sink *fdsink, int fd ) {
+
+	fdsink->fd = fd;
+	return sink_open ( &fdsink->sink, &fd_sink_operations, 1 );
+}
+
+/**
+ * Open buffered memory output sink
+ *
+ * @v memsink		Memory output sink
+ * @v data		Memory buffer
+ * @v max		Length of memory buffer
+ * @ret rc		Return status code
+ *
+ * Output is appended to the memory buffer, and the length of data
+ * within the buffer is available as @c memsink->len.  The buffer is not
+ * NUL-terminated.  Output beyond the end of the memory buffer is
+ * counted but discarded.
+ */
+static inline __attribute__ (( always_inline )) int
+sink_open_memory ( struct memory_sink *memsink, char *data, size_t max ) {
+
+	memsink->data = data;
+	memsink->max = max;
+	memsink->len = 0;
+	return sink_open ( &memsink->sink, &memory_sink_operations, 1 );
+}
+
+/**
+ * Open buffered stream output sink
+ *
+ * @v streamsink	Stream output sink
+ * @v stream		Underlying stream (e.g. a network shell session)
+ * @ret rc		Return status code
+ *
+ * This may be used for an output stream that has no underlying file
+ * descriptor.  Each backend write is passed to the underlying stream
+ * and flushed immediately.  The underlying stream remains owned by
+ * the caller, and is not closed by sink_close().
+ */
+static inline __attribute__ (( always_inline )) int
+sink_open_stream ( struct stream_sink *streamsink, FILE *stream ) {
+
+	streamsink->stream = stream;
+	return sink_open ( &streamsink->sink, &stream_sink_operations, 1 );
+}
+
+#endif /* _UNIPORT_SINK_H */
@@ -0,0 +1,94 @@
+#ifndef _UNIPORT_SNAPSHOT_H
+#define _UNIPORT_SNAPSHOT_H
+
+/** @file
+ *
+ * Resource state snapshots
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** Snapshot image magic ("UPSN") */
+#define SNAPSHOT_MAGIC 0x4e535055UL
+
+/** Snapshot image format version */
+#define SNAPSHOT_VERSION 1
+
+/** Alignment of snapshot records and values */
+#define SNAPSHOT_ALIGN 4
+
+/** A snapshot image header
+ *
+ * All fields within a snapshot image are in native byte order.  An
+ * image taken on a host of differing byte order will fail the magic
+ * check.
+ */
+struct snapshot_header {
+	/** Magic signature */
+	uint32_t magic;
+	/** Format version */
+	uint16_t version;
+	/** Length of this header */
+	uint16_t len;
+};
+
+/** A snapshot record
+ *
+ * Each record is followed by the NUL-terminated resource URI and then
+ * by @c count property values, each padded to SNAPSHOT_ALIGN.  The
+ * image is terminated by a record with a zero length, which allows a
+ * truncated image to be detected.
+ */
+struct snapshot_record {
+	/** Length of record (including this header), or zero */
+	uint32_t len;
+	/** Resource descriptor hash */
+	uint32_t hash;
+	/** Length of URI (excluding NUL) */
+	uint16_t uri_len;
+	/** Number of property values */
+	uint16_t count;
+};
+
+/** A snapshot property value
+ *
+ * Inline values are stored as a raw copy of the state variable.
+ * Indirect values (strings, arrays and blobs) are stored in formatted
+ * form, followed by a NUL.
+ */
+struct snapshot_value {
+	/** Property index within resource descriptor */
+	uint16_t index;
+	/** Reserved */
+	uint16_t reserved;
+	/** Length of value (excluding any NUL) */
+	uint32_t len;
+};
+
+/** Snapshot statistics */
+struct snapshot_stats {
+	/** Number of resources saved or restored */
+	unsigned int resources;
+	/** Number of resources skipped (having no writable values) */
+	unsigned int skipped;
+	/** Number of resources not found */
+	unsigned int missing;
+	/** Number of resources with a mismatched descriptor hash */
+	unsigned int mismatched;
+	/** Number of resources that could not be saved or restored */
+	unsigned int failed;
+	/** Length of image */
+	size_t len;
+};
+
+struct resource_descriptor;
+
+extern uint32_t snapshot_hash ( const struct resource_descriptor *desc );
+extern int snapshot_save ( FILE *file, const char *pattern,
+			   struct snapshot_stats *stats );
+extern int snapshot_restore ( const void *image, size_t len,
+			      struct snapshot_stats *stats );
+
+#endif /* _UNIPORT_SNAPSHOT_H */
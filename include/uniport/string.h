@@ -7,6 +7,39 @@
  *
  */
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Maximum length of a formatted decimal integer (excluding NUL) */
+#define DECIMAL_MAX_LEN 11 /* "-2147483648" */
+
+/** Maximum number of decimal places in a fixed-point number */
+#define FIXED_SCALE_MAX 9
+
+/** Maximum length of a formatted fixed-point number (excluding NUL) */
+#define FIXED_MAX_LEN 21 /* "-9223372036.854775808" */
+
+/** FNV-1a hash initial value */
+#define FNV_OFFSET_BASIS 2166136261UL
+
+/** FNV-1a hash multiplier */
+#define FNV_PRIME 16777619UL
+
+extern const uint32_t powers_of_ten[ FIXED_SCALE_MAX + 1 ];
+
 extern unsigned int digit_value ( unsigned int character );
+extern size_t format_string ( char *buf, size_t len, const char *string,
+			      size_t string_len );
+extern size_t format_decimal ( char *buf, size_t len, int value );
+extern size_t format_fixed ( char *buf, size_t len, int64_t value,
+			     unsigned int scale );
+extern int parse_fixed ( const char *string, unsigned int scale,
+			 int64_t *value );
+extern int parse_int ( const char *string, const char **end, int *value );
+extern char * hex_encode ( char *out, const void *data, size_t len );
+extern uint32_t fnv_hash ( uint32_t hash, const void *data, size_t len );
+extern bool glob_match ( const char *pattern, const char *string );
+extern size_t glob_prefix_len ( const char *pattern );
 
 #endif /* _UNIPORT_STRING_H */
@@ -16,7 +16,13 @@ enum temperature_units {
 	TEMPERATURE_UNITS_K = 'K',	/**< Kelvin */
 };
 
-extern const struct property_type temperature_units_property;
+extern const struct property_type temperature_units_property
+	__property_type;
+extern size_t temperature_units_format ( struct property *prop, char *buf,
+					 size_t len,
+					 const enum temperature_units *value );
+extern int temperature_units_parse ( struct property *prop, const char *string,
+				     enum temperature_units *value );
 
 /** Define a temperature units property */
 #define PROPERTY_TEMPERATURE_UNITS( _name, _state, _field, _flags )	\
@@ -37,6 +43,13 @@ extern const struct property_type temperature_units_property;
  */
 #define celsius_to_fahrenheit_floating( c )	( ( (c) * 1.8 ) + 32 )
 
+/** Convert Celsius to Fahrenheit, using single-precision operations
+ *
+ * @v c			Temperature in Celsius
+ * @ret f		Temperature in Fahrenheit
+ */
+#define celsius_to_fahrenheit_single( c )	( ( (c) * 1.8f ) + 32 )
+
 /** Convert Celsius to Kelvin, using integer operations
  *
  * @v c			Temperature in Celsius
@@ -51,6 +64,13 @@ extern const struct property_type temperature_units_property;
  */
 #define celsius_to_kelvin_floating( c )		( (c) + 273.15 )
 
+/** Convert Celsius to Kelvin, using single-precision operations
+ *
+ * @v c			Temperature in Celsius
+ * @ret k		Temperature in Kelvin
+ */
+#define celsius_to_kelvin_single( c )		( (c) + 273.15f )
+
 /** Convert Fahrenheit to Celsius, using integer operations
  *
  * @v f			Temperature in Fahrenheit
@@ -65,6 +85,13 @@ extern const struct property_type temperature_units_property;
  */
 #define fahrenheit_to_celsius_floating( f )	( ( (f) - 32 ) / 1.8 )
 
+/** Convert Fahrenheit to Celsius, using single-precision operations
+ *
+ * @v f			Temperature in Fahrenheit
+ * @ret c		Temperature in Celsius
+ */
+#define fahrenheit_to_celsius_single( f )	( ( (f) - 32 ) / 1.8f )
+
 /** Convert Fahrenheit to Kelvin, using integer operations
  *
  * @v f			Temperature in Fahrenheit
@@ -79,6 +106,13 @@ extern const struct property_type temperature_units_property;
  */
 #define fahrenheit_to_kelvin_floating( f )	( ( (f) + 459.67 ) / 1.8 )
 
+/** Convert Fahrenheit to Kelvin, using single-precision operations
+ *
+ * @v f			Temperature in Fahrenheit
+ * @ret k		Temperature in Kelvin
+ */
+#define fahrenheit_to_kelvin_single( f )	( ( (f) + 459.67f ) / 1.8f )
+
 /** Convert Kelvin to Celsius, using integer operations
  *
  * @v k			Temperature in Kelvin
@@ -93,6 +127,13 @@ extern const struct property_type temperature_units_property;
  */
 #define kelvin_to_celsius_floating( k )		( (k) - 273.15 )
 
+/** Convert Kelvin to Celsius, using single-precision operations
+ *
+ * @v k			Temperature in Kelvin
+ * @ret c		Temperature in Celsius
+ */
+#define kelvin_to_celsius_single( k )		( (k) - 273.15f )
+
 /** Convert Kelvin to Fahrenheit, using integer operations
  *
  * @v k			Temperature in Kelvin
@@ -107,6 +148,13 @@ extern const struct property_type temperature_units_property;
  */
 #define kelvin_to_fahrenheit_floating( k )	( ( (k) * 1.8 ) - 459.67 )
 
+/** Convert Kelvin to Fahrenheit, using single-precision operations
+ *
+ * @v k			Temperature in Kelvin
+ * @ret f		Temperature in Fahrenheit
+ */
+#define kelvin_to_fahrenheit_single( k )	( ( (k) * 1.8f ) - 459.67f )
+
 /**
  * Convert temperature to Celsius
  *
@@ -193,13 +241,35 @@ extern const struct property_type temperature_units_property;
 
 /* Define temperature converters */
 TEMPERATURE_CONVERSION ( celsius, int, integer );
-TEMPERATURE_CONVERSION ( celsius, float, floating );
+TEMPERATURE_CONVERSION ( celsius, float, single );
 TEMPERATURE_CONVERSION ( celsius, double, floating );
 TEMPERATURE_CONVERSION ( fahrenheit, int, integer );
-TEMPERATURE_CONVERSION ( fahrenheit, float, floating );
+TEMPERATURE_CONVERSION ( fahrenheit, float, single );
 TEMPERATURE_CONVERSION ( fahrenheit, double, floating );
 TEMPERATURE_CONVERSION ( kelvin, int, integer );
-TEMPERATURE_CONVERSION ( kelvin, float, floating );
+TEMPERATURE_CONVERSION ( kelvin, float, single );
 TEMPERATURE_CONVERSION ( kelvin, double, floating );
 
+extern int temperature_to_celsius_fixed ( int temperature,
+					  enum temperature_units units,
+					  unsigned int scale );
+extern int temperature_to_fahrenheit_fixed ( int temperature,
+					     enum temperature_units units,
+					     unsigned int scale );
+extern int temperature_to_kelvin_fixed ( int temperature,
+					 enum temperature_units units,
+					 unsigned int scale );
+extern int temperature_convert_array_int ( const int *src, int *dst,
+					   size_t count,
+					   enum temperature_units from,
+					   enum temperature_units to );
+extern int temperature_convert_array_float ( const float *src, float *dst,
+					     size_t count,
+					     enum temperature_units from,
+					     enum temperature_units to );
+extern int temperature_convert_array_double ( const double *src,
+					      double *dst, size_t count,
+					      enum temperature_units from,
+					      enum temperature_units to );
+
 #endif /* _UNIPORT_TEMPERATURE_H */
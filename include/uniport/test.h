@@ -0,0 +1,56 @@
+#ifndef _UNIPORT_TEST_H
+#define _UNIPORT_TEST_H
+
+/** @file
+ *
+ * Self-test infrastructure
+ *
+ * Derived from the implementation in iPXE.  Self-tests are built
+ * only as part of the host build.
+ *
+ */
+
+#include <uniport/tables.h>
+
+/** A self-test set */
+struct self_test {
+	/** Test set name */
+	const char *name;
+	/** Run self-tests */
+	void ( * exec ) ( void );
+	/** Number of tests run */
+	unsigned int total;
+	/** Number of test failures */
+	unsigned int failures;
+};
+
+/** Self-test table */
+#define SELF_TESTS __table ( struct self_test, "self_tests" )
+
+/** Declare a self-test */
+#define __self_test __table_entry ( SELF_TESTS, 01 )
+
+extern const char *test_data;
+
+extern void test_ok ( int success, const char *file, unsigned int line,
+		      const char *test );
+
+/**
+ * Report test result
+ *
+ * @v success		Test succeeded
+ * @v file		File name
+ * @v line		Line number
+ */
+#define okx( success, file, line ) \
+	test_ok ( success, file, line, #success )
+
+/**
+ * Report test result
+ *
+ * @v success		Test succeeded
+ */
+#define ok( success ) \
+	okx ( success, __FILE__, __LINE__ )
+
+#endif /* _UNIPORT_TEST_H */
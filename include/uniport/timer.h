@@ -0,0 +1,18 @@
+#ifndef _UNIPORT_TIMER_H
+#define _UNIPORT_TIMER_H
+
+/** @file
+ *
+ * Timers
+ *
+ */
+
+/** Number of ticks per second */
+#define TICKS_PER_SEC 1000000UL
+
+/** Number of ticks per millisecond */
+#define TICKS_PER_MS ( TICKS_PER_SEC / 1000 )
+
+extern unsigned long currticks ( void );
+
+#endif /* _UNIPORT_TIMER_H */
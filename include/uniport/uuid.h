@@ -27,4 +27,7 @@ union uuid {
 	uint8_t raw[16];
 };
 
+/** Length of a UUID in canonical string form (excluding NUL) */
+#define UUID_STRING_LEN 36
+
 #endif /* _UNIPORT_UUID_H */
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Resource retrieval cache self-tests
+ *
+ * A test resource's retrieve() method may be held open by the test,
+ * allowing concurrent callers and invalidations to be arranged while
+ * a retrieval is in progress.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <uniport/cache.h>
+#include <uniport/timer.h>
+#include <uniport/test.h>
+
+/** Number of concurrent callers */
+#define CACHE_TEST_CALLERS 4
+
+/** Cache lifetime of long-lived test resource */
+#define CACHE_TEST_TTL ( 60 * TICKS_PER_SEC )
+
+/** Cache lifetime of short-lived test resource */
+#define CACHE_TEST_SHORT_TTL ( 20 * TICKS_PER_MS )
+
+/** Cache test resource state */
+struct cache_test_state {
+	/** Value */
+	int value;
+};
+
+/** Cache test resource state */
+static struct cache_test_state cache_test_state;
+
+/** Cache test gate lock */
+static pthread_mutex_t cache_test_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Cache test gate change */
+static pthread_cond_t cache_test_change = PTHREAD_COND_INITIALIZER;
+
+/** Retrievals are held until the gate is opened */
+static int cache_test_closed;
+
+/** Number of calls to retrieve() */
+static unsigned int cache_test_calls;
+
+/** Cache test resource properties */
+static struct property cache_test_props[] = {
+	PROPERTY_INTEGER ( "value", struct cache_test_state, value, 0 ),
+};
+
+/**
+ * Retrieve cache test resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ *
+ * The retrieval is held while the gate is closed.
+ */
+static const struct cache_test_state *
+cache_test_retrieve ( struct resource *res __unused ) {
+
+	pthread_mutex_lock ( &cache_test_lock );
+	cache_test_calls++;
+	pthread_cond_broadcast ( &cache_test_change );
+	while ( cache_test_closed )
+		pthread_cond_wait ( &cache_test_change, &cache_test_lock );
+	pthread_mutex_unlock ( &cache_test_lock );
+	return &cache_test_state;
+}
+
+/** Long-lived cache test resource descriptor */
+static const struct resource_descriptor cache_test_desc =
+	RESOURCE_DESC ( struct cache_test_state, cache_test_props,
+			cache_test_retrieve, NULL, NULL,
+			.ttl = CACHE_TEST_TTL );
+
+/** Short-lived cache test resource descriptor */
+static const struct resource_descriptor cache_test_short_desc =
+	RESOURCE_DESC ( struct cache_test_state, cache_test_props,
+			cache_test_retrieve, NULL, NULL,
+			.ttl = CACHE_TEST_SHORT_TTL );
+
+/** Long-lived cache test resource */
+static struct resource cache_test_res = {
+	.uri = "long",
+	.desc = &cache_test_desc,
+	.observers = OBSERVERS_INIT ( cache_test_res ),
+};
+
+/** Short-lived cache test resource */
+static struct resource cache_test_short_res = {
+	.uri = "short",
+	.desc = &cache_test_short_desc,
+	.observers = OBSERVERS_INIT ( cache_test_short_res ),
+};
+
+/** Cache test resources */
+static struct resource *cache_test_resources[] = {
+	&cache_test_res,
+	&cache_test_short_res,
+	NULL
+};
+
+/** Cache test namespace */
+static struct namespace cache_test_ns = {
+	.uri = "/cache/",
+	.resources = cache_test_resources,
+};
+
+/**
+ * Close retrieval gate
+ *
+ */
+static void cache_test_close ( void ) {
+
+	pthread_mutex_lock ( &cache_test_lock );
+	cache_test_closed = 1;
+	pthread_mutex_unlock ( &cache_test_lock );
+}
+
+/**
+ * Open retrieval gate
+ *
+ */
+static void cache_test_open ( void ) {
+
+	pthread_mutex_lock ( &cache_test_lock );
+	cache_test_closed = 0;
+	pthread_cond_broadcast ( &cache_test_change );
+	pthread_mutex_unlock ( &cache_test_lock );
+}
+
+/**
+ * Wait for retrieve() to have been called
+ *
+ * @v calls		Number of calls to wait for
+ */
+static void cache_test_wait ( unsigned int calls ) {
+
+	pthread_mutex_lock ( &cache_test_lock );
+	while ( cache_test_calls < calls )
+		pthread_cond_wait ( &cache_test_change, &cache_test_lock );
+	pthread_mutex_unlock ( &cache_test_lock );
+}
+
+/**
+ * Retrieve long-lived test resource state
+ *
+ * @v arg		Retrieved state to fill in
+ * @ret result		Result (unused)
+ */
+static void * cache_test_caller ( void *arg ) {
+	const void **state = arg;
+
+	*state = resource_retrieve ( &cache_test_res );
+	return NULL;
+}
+
+/**
+ * Perform resource retrieval cache self-tests
+ *
+ */
+static void cache_test_exec ( void ) {
+	struct resource_cache *cache;
+	const void *states[CACHE_TEST_CALLERS];
+	pthread_t callers[CACHE_TEST_CALLERS];
+	pthread_t caller;
+	const void *state;
+	unsigned int i;
+
+	/* Register resources */
+	ok ( resource_register ( &cache_test_ns ) == 0 );
+	cache = cache_test_res.cache;
+	ok ( cache != NULL );
+	if ( ! cache )
+		return;
+
+	/* Hits and misses are counted */
+	cache_test_calls = 0;
+	ok ( resource_retrieve ( &cache_test_res ) == &cache_test_state );
+	ok ( resource_retrieve ( &cache_test_res ) == &cache_test_state );
+	ok ( resource_retrieve ( &cache_test_res ) == &cache_test_state );
+	ok ( cache_test_calls == 1 );
+	ok ( cache->misses == 1 );
+	ok ( cache->hits == 2 );
+	ok ( cache->coalesced == 0 );
+
+	/* Notifications invalidate the cached state */
+	resource_notify ( &cache_test_res );
+	ok ( cache_test_calls == 2 );
+	ok ( resource_retrieve ( &cache_test_res ) == &cache_test_state );
+	ok ( cache_test_calls == 2 );
+	ok ( cache->misses == 2 );
+	ok ( cache->hits == 3 );
+
+	/* Concurrent callers share a single in-progress retrieval */
+	cache_invalidate ( &cache_test_res );
+	cache_test_calls = 0;
+	cache_test_close();
+	ok ( pthread_create ( &caller, NULL, cache_test_caller,
+			      &state ) == 0 );
+	cache_test_wait ( 1 );
+	for ( i = 0 ; i < CACHE_TEST_CALLERS ; i++ ) {
+		ok ( pthread_create ( &callers[i], NULL, cache_test_caller,
+				      &states[i] ) == 0 );
+	}
+	usleep ( 50000 );
+	cache_test_open();
+	pthread_join ( caller, NULL );
+	for ( i = 0 ; i < CACHE_TEST_CALLERS ; i++ ) {
+		pthread_join ( callers[i], NULL );
+		ok ( states[i] == &cache_test_state );
+	}
+	ok ( state == &cache_test_state );
+	ok ( cache_test_calls == 1 );
+	ok ( cache->misses == 3 );
+	ok ( cache->coalesced > 0 );
+	ok ( ( cache->hits + cache->coalesced ) ==
+	     ( 3 + CACHE_TEST_CALLERS ) );
+
+	/* A retrieval racing with an invalidation is not cached */
+	cache_invalidate ( &cache_test_res );
+	cache_test_calls = 0;
+	cache_test_close();
+	ok ( pthread_create ( &caller, NULL, cache_test_caller,
+			      &state ) == 0 );
+	cache_test_wait ( 1 );
+	cache_invalidate ( &cache_test_res );
+	cache_test_open();
+	pthread_join ( caller, NULL );
+	ok ( state == &cache_test_state );
+	ok ( cache->state == NULL );
+	ok ( ! cache->busy );
+	ok ( resource_retrieve ( &cache_test_res ) == &cache_test_state );
+	ok ( cache_test_calls == 2 );
+	ok ( cache->misses == 5 );
+	ok ( cache->state == &cache_test_state );
+
+	/* Cached state expires after the cache lifetime */
+	cache = cache_test_short_res.cache;
+	cache_test_calls = 0;
+	ok ( resource_retrieve ( &cache_test_short_res ) ==
+	     &cache_test_state );
+	ok ( resource_retrieve ( &cache_test_short_res ) ==
+	     &cache_test_state );
+	ok ( cache_test_calls == 1 );
+	usleep ( 2 * CACHE_TEST_SHORT_TTL / ( TICKS_PER_SEC / 1000000 ) );
+	ok ( resource_retrieve ( &cache_test_short_res ) ==
+	     &cache_test_state );
+	ok ( cache_test_calls == 2 );
+	ok ( cache->misses == 2 );
+	ok ( cache->hits == 1 );
+
+	/* Unregister resources */
+	resource_unregister ( &cache_test_ns );
+	ok ( cache_test_res.cache == NULL );
+}
+
+/** Resource retrieval cache self-test */
+struct self_test cache_test __self_test = {
+	.name = "cache",
+	.exec = cache_test_exec,
+};
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Command line interface self-tests
+ *
+ * A notifier thread notifies observers of a test resource
+ * continuously, while sessions (modelled as memory streams) start
+ * observing it and are then closed.  Closing a session must wait for
+ * any notification being written to it, and no notification may be
+ * written once it has been closed.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <uniport/resource.h>
+#include <uniport/command.h>
+#include <uniport/cli.h>
+#include <uniport/test.h>
+
+/** Number of sessions opened and closed */
+#define CLI_TEST_SESSIONS 200
+
+/** CLI test resource state */
+struct cli_test_state {
+	/** Value */
+	int value;
+};
+
+/** CLI test resource state */
+static struct cli_test_state cli_test_state;
+
+/** Notifier thread should stop */
+static volatile int cli_test_stop;
+
+/** CLI test resource properties */
+static struct property cli_test_props[] = {
+	PROPERTY_INTEGER ( "value", struct cli_test_state, value, 0 ),
+};
+
+/**
+ * Retrieve CLI test resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct cli_test_state *
+cli_test_retrieve ( struct resource *res __unused ) {
+
+	return &cli_test_state;
+}
+
+/** CLI test resource descriptor */
+static const struct resource_descriptor cli_test_desc =
+	RESOURCE_DESC ( struct cli_test_state, cli_test_props,
+			cli_test_retrieve, NULL, NULL );
+
+/** CLI test resource */
+static struct resource cli_test_res = {
+	.uri = "value",
+	.desc = &cli_test_desc,
+	.observers = OBSERVERS_INIT ( cli_test_res ),
+};
+
+/** CLI test resources */
+static struct resource *cli_test_resources[] = {
+	&cli_test_res,
+	NULL
+};
+
+/** CLI test namespace */
+static struct namespace cli_test_ns = {
+	.uri = "/cli/",
+	.resources = cli_test_resources,
+};
+
+/**
+ * Notify observers continuously
+ *
+ * @v arg		Argument (ignored)
+ * @ret result		Result (unused)
+ */
+static void * cli_test_notifier ( void *arg __unused ) {
+
+	while ( ! cli_test_stop ) {
+		cli_test_state.value++;
+		resource_notify ( &cli_test_res );
+	}
+	return NULL;
+}
+
+/**
+ * Perform command line interface self-tests
+ *
+ */
+static void cli_test_exec ( void ) {
+	pthread_t notifier;
+	unsigned int delivered = 0;
+	unsigned int quiet = 0;
+	unsigned int i;
+	size_t closed;
+	size_t len;
+	char *buf;
+	FILE *out;
+
+	/* Register resource and start notifier thread */
+	ok ( resource_register ( &cli_test_ns ) == 0 );
+	cli_test_stop = 0;
+	ok ( pthread_create ( &notifier, NULL, cli_test_notifier,
+			      NULL ) == 0 );
+
+	/* Close sessions while notifications are being delivered */
+	for ( i = 0 ; i < CLI_TEST_SESSIONS ; i++ ) {
+		buf = NULL;
+		len = 0;
+		out = open_memstream ( &buf, &len );
+		if ( ! out )
+			break;
+		if ( fsystem ( out, "observe /cli/value" ) != 0 ) {
+			fclose ( out );
+			free ( buf );
+			break;
+		}
+		usleep ( 100 );
+		cli_close ( out );
+		fflush ( out );
+		closed = len;
+		usleep ( 100 );
+		fflush ( out );
+		if ( len == closed )
+			quiet++;
+		if ( strstr ( buf, "value=" ) )
+			delivered++;
+		fclose ( out );
+		free ( buf );
+	}
+	ok ( i == CLI_TEST_SESSIONS );
+	ok ( quiet == CLI_TEST_SESSIONS );
+	ok ( delivered > 0 );
+
+	/* Stop notifier thread and unregister resource */
+	cli_test_stop = 1;
+	pthread_join ( notifier, NULL );
+	resource_unregister ( &cli_test_ns );
+}
+
+/** Command line interface self-test */
+struct self_test cli_test __self_test = {
+	.name = "cli",
+	.exec = cli_test_exec,
+};
@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Resource collection self-tests
+ *
+ * Collections are formed from test resources that are deliberately
+ * slow, that deliberately fail, or that are themselves backed by a
+ * collection (and so fan out again from within a worker thread).
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <uniport/collection.h>
+#include <uniport/interface.h>
+#include <uniport/command.h>
+#include <uniport/timer.h>
+#include <uniport/test.h>
+
+/** Delay of slow collection test members (in milliseconds) */
+#define COLLECTION_TEST_DELAY_MS 50
+
+/** Collection test resource state */
+struct collection_test_state {
+	/** Value */
+	int value;
+};
+
+/** A collection test member resource */
+struct collection_test_member {
+	/** Resource */
+	struct resource res;
+	/** Resource state */
+	struct collection_test_state state;
+	/** Update delay (in milliseconds) */
+	unsigned int delay;
+	/** Update result */
+	int rc;
+	/** Number of successful updates */
+	unsigned int updates;
+	/** Most recent update ran on a worker thread */
+	int worker;
+};
+
+/** Thread running the self-tests */
+static pthread_t collection_test_thread;
+
+/** Collection backing the nested test members */
+static struct collection *collection_test_inner;
+
+/** Writable collection test resource properties */
+static struct property collection_test_props[] = {
+	PROPERTY_INTEGER ( "value", struct collection_test_state, value,
+			   PROP_RW ),
+};
+
+/** Read-only collection test resource properties */
+static struct property collection_test_ro_props[] = {
+	PROPERTY_INTEGER ( "value", struct collection_test_state, value, 0 ),
+};
+
+/** Unrelated collection test resource properties */
+static struct property collection_test_other_props[] = {
+	PROPERTY_INTEGER ( "other", struct collection_test_state, value,
+			   PROP_RW ),
+};
+
+/**
+ * Retrieve collection test resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct collection_test_state *
+collection_test_retrieve ( struct resource *res ) {
+	struct collection_test_member *member =
+		container_of ( res, struct collection_test_member, res );
+
+	return &member->state;
+}
+
+/**
+ * Update collection test resource state
+ *
+ * @v res		Resource
+ * @v state		New resource state
+ * @ret rc		Return status code
+ */
+static int
+collection_test_update ( struct resource *res,
+			 const struct collection_test_state *state ) {
+	struct collection_test_member *member =
+		container_of ( res, struct collection_test_member, res );
+
+	/* Simulate slow hardware and record the calling thread */
+	usleep ( member->delay * 1000 );
+	member->worker = ( ! pthread_equal ( pthread_self(),
+					     collection_test_thread ) );
+
+	/* Simulate failing hardware */
+	if ( member->rc != 0 )
+		return member->rc;
+
+	memcpy ( &member->state, state, sizeof ( member->state ) );
+	member->updates++;
+	return 0;
+}
+
+/**
+ * Update nested collection test resource state
+ *
+ * @v res		Resource
+ * @v state		New resource state
+ * @ret rc		Return status code
+ *
+ * The new value is applied to all members of the inner collection.
+ */
+static int collection_test_nest ( struct resource *res,
+				  const struct collection_test_state *state ) {
+	char assignment[32];
+	char *assignments[] = { assignment };
+	int rc;
+
+	if ( ( rc = collection_test_update ( res, state ) ) != 0 )
+		return rc;
+	snprintf ( assignment, sizeof ( assignment ), "value=%d",
+		   state->value );
+	return collection_update ( collection_test_inner, &oic_if_baseline,
+				   assignments, 1 );
+}
+
+/** Writable collection test resource descriptor */
+static const struct resource_descriptor collection_test_desc =
+	RESOURCE_DESC ( struct collection_test_state, collection_test_props,
+			collection_test_retrieve, collection_test_update,
+			NULL );
+
+/** Read-only collection test resource descriptor */
+static const struct resource_descriptor collection_test_ro_desc =
+	RESOURCE_DESC ( struct collection_test_state,
+			collection_test_ro_props, collection_test_retrieve,
+			collection_test_update, NULL );
+
+/** Unrelated collection test resource descriptor */
+static const struct resource_descriptor collection_test_other_desc =
+	RESOURCE_DESC ( struct collection_test_state,
+			collection_test_other_props, collection_test_retrieve,
+			collection_test_update, NULL );
+
+/** Nested collection test resource descriptor */
+static const struct resource_descriptor collection_test_nest_desc =
+	RESOURCE_DESC ( struct collection_test_state, collection_test_props,
+			collection_test_retrieve, collection_test_nest, NULL );
+
+/** Define a collection test member resource */
+#define COLLECTION_TEST_MEMBER( _name, _desc, _delay, _rc )		\
+	struct collection_test_member _name = {				\
+		.res = {						\
+			.uri = #_name,					\
+			.desc = &_desc,					\
+			.observers = OBSERVERS_INIT ( _name.res ),	\
+		},							\
+		.delay = _delay,					\
+		.rc = _rc,						\
+	}
+
+/** Fast collection test members */
+static COLLECTION_TEST_MEMBER ( fast0, collection_test_desc, 0, 0 );
+static COLLECTION_TEST_MEMBER ( fast1, collection_test_desc, 0, 0 );
+
+/** Slow collection test members */
+static COLLECTION_TEST_MEMBER ( slow0, collection_test_desc,
+				COLLECTION_TEST_DELAY_MS, 0 );
+static COLLECTION_TEST_MEMBER ( slow1, collection_test_desc,
+				COLLECTION_TEST_DELAY_MS, 0 );
+static COLLECTION_TEST_MEMBER ( slow2, collection_test_desc,
+				COLLECTION_TEST_DELAY_MS, 0 );
+static COLLECTION_TEST_MEMBER ( slow3, collection_test_desc,
+				COLLECTION_TEST_DELAY_MS, 0 );
+
+/** Failing collection test member */
+static COLLECTION_TEST_MEMBER ( fail, collection_test_desc, 0, -EIO );
+
+/** Read-only collection test member */
+static COLLECTION_TEST_MEMBER ( ro, collection_test_ro_desc, 0, 0 );
+
+/** Unrelated collection test member */
+static COLLECTION_TEST_MEMBER ( other, collection_test_other_desc, 0, 0 );
+
+/** Nested collection test members */
+static COLLECTION_TEST_MEMBER ( nest0, collection_test_nest_desc, 0, 0 );
+static COLLECTION_TEST_MEMBER ( nest1, collection_test_nest_desc, 0, 0 );
+static COLLECTION_TEST_MEMBER ( nest2, collection_test_nest_desc, 0, 0 );
+
+/** Collection test resources */
+static struct resource *collection_test_resources[] = {
+	&fast0.res, &fast1.res, &slow0.res, &slow1.res, &slow2.res,
+	&slow3.res, &fail.res, &ro.res, &other.res, NULL
+};
+
+/** Nested collection test resources */
+static struct resource *collection_test_nest_resources[] = {
+	&nest0.res, &nest1.res, &nest2.res, NULL
+};
+
+/** Collection test namespace */
+static struct namespace collection_test_ns = {
+	.uri = "/ct/",
+	.resources = collection_test_resources,
+};
+
+/** Nested collection test namespace */
+static struct namespace collection_test_nest_ns = {
+	.uri = "/ctn/",
+	.resources = collection_test_nest_resources,
+};
+
+/**
+ * Execute command, discarding its output
+ *
+ * @v command		Command line
+ * @ret rc		Return status code
+ */
+static int collection_test_system ( const char *command ) {
+	FILE *out;
+	int rc;
+
+	out = fopen ( "/dev/null", "w" );
+	if ( ! out )
+		return -errno;
+	rc = fsystem ( out, command );
+	fclose ( out );
+	return rc;
+}
+
+/**
+ * Find collection
+ *
+ * @v uri		Collection resource URI
+ * @ret coll		Collection, or NULL if not found
+ */
+static struct collection * collection_test_find ( const char *uri ) {
+	struct resource *res;
+
+	res = resource_find ( uri );
+	if ( ! res )
+		return NULL;
+	return container_of ( res, struct collection, res );
+}
+
+/**
+ * Find result of most recent operation on a collection member
+ *
+ * @v coll		Collection
+ * @v member		Collection test member
+ * @ret rc		Result of most recent operation, or -ENOENT
+ */
+static int collection_test_rc ( struct collection *coll,
+				struct collection_test_member *member ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < coll->count ; i++ ) {
+		if ( coll->members[i].res == &member->res )
+			return coll->members[i].rc;
+	}
+	return -ENOENT;
+}
+
+/**
+ * Update collection members
+ *
+ * @v coll		Collection
+ * @v assignment	Property assignment
+ * @ret rc		Return status code
+ */
+static int collection_test_set ( struct collection *coll,
+				 const char *assignment ) {
+	char buf[32];
+	char *assignments[] = { buf };
+
+	snprintf ( buf, sizeof ( buf ), "%s", assignment );
+	return collection_update ( coll, &oic_if_baseline, assignments, 1 );
+}
+
+/**
+ * Perform resource collection self-tests
+ *
+ */
+static void collection_test_exec ( void ) {
+	struct collection_test_member *slow[] =
+		{ &slow0, &slow1, &slow2, &slow3 };
+	struct collection_test_member *nest[] = { &nest0, &nest1, &nest2 };
+	struct collection *all;
+	struct collection *outer;
+	unsigned long start;
+	unsigned long elapsed;
+	unsigned int workers;
+	unsigned int i;
+
+	/* Register resources and create collections */
+	collection_test_thread = pthread_self();
+	ok ( resource_register ( &collection_test_ns ) == 0 );
+	ok ( resource_register ( &collection_test_nest_ns ) == 0 );
+	ok ( collection_test_system ( "collection -c /cta/all /ct/*" ) == 0 );
+	ok ( collection_test_system ( "collection -c /cti/inner /ct/slow*" )
+	     == 0 );
+	ok ( collection_test_system ( "collection -c /cto/outer /ctn/*" )
+	     == 0 );
+	ok ( collection_test_system ( "collection -c /ctx/none /ct/x*" ) ==
+	     -ENOENT );
+	all = collection_test_find ( "/cta/all" );
+	collection_test_inner = collection_test_find ( "/cti/inner" );
+	outer = collection_test_find ( "/cto/outer" );
+	ok ( all != NULL );
+	ok ( collection_test_inner != NULL );
+	ok ( outer != NULL );
+	if ( ! ( all && collection_test_inner && outer ) )
+		return;
+	ok ( all->count == 9 );
+	ok ( collection_test_inner->count == 4 );
+	ok ( outer->count == 3 );
+
+	/* Slow members are updated in parallel by the worker pool */
+	start = currticks();
+	ok ( collection_test_set ( all, "value=5" ) == -EIO );
+	elapsed = ( currticks() - start );
+	ok ( elapsed < ( 3 * COLLECTION_TEST_DELAY_MS * TICKS_PER_MS ) );
+	for ( workers = 0, i = 0 ; i < ( sizeof ( slow ) /
+					 sizeof ( slow[0] ) ) ; i++ ) {
+		ok ( slow[i]->updates == 1 );
+		ok ( slow[i]->state.value == 5 );
+		ok ( collection_test_rc ( all, slow[i] ) == 0 );
+		workers += slow[i]->worker;
+	}
+	ok ( workers > 0 );
+
+	/* Failures are recorded per member */
+	ok ( all->state.failed == 2 );
+	ok ( collection_test_rc ( all, &fast0 ) == 0 );
+	ok ( collection_test_rc ( all, &fast1 ) == 0 );
+	ok ( fast0.state.value == 5 );
+	ok ( fast1.state.value == 5 );
+	ok ( collection_test_rc ( all, &fail ) == -EIO );
+	ok ( fail.updates == 0 );
+	ok ( fail.state.value == 0 );
+	ok ( collection_test_rc ( all, &ro ) == -EROFS );
+	ok ( ro.updates == 0 );
+	ok ( collection_test_rc ( all, &other ) == 0 );
+	ok ( other.updates == 0 );
+
+	/* Failures are cleared by a subsequent successful update */
+	fail.rc = 0;
+	ok ( collection_test_set ( all, "other=3" ) == 0 );
+	ok ( all->state.failed == 0 );
+	ok ( collection_test_rc ( all, &fail ) == 0 );
+	ok ( other.updates == 1 );
+	ok ( other.state.value == 3 );
+	ok ( fast0.updates == 1 );
+	fail.rc = -EIO;
+
+	/* Assignments are checked before any member is updated */
+	ok ( collection_test_set ( all, "missing=1" ) == -ENOENT );
+	ok ( collection_test_set ( all, "value" ) == -EINVAL );
+	ok ( all->state.failed == 0 );
+
+	/* Values are parsed separately by each member */
+	ok ( collection_test_set ( all, "value=x" ) == -EINVAL );
+	ok ( all->state.failed == 8 );
+	ok ( collection_test_rc ( all, &fail ) == -EINVAL );
+	ok ( collection_test_rc ( all, &ro ) == -EROFS );
+	ok ( collection_test_rc ( all, &other ) == 0 );
+	ok ( fast0.updates == 1 );
+
+	/* Retrieval fans out to all members */
+	ok ( collection_retrieve ( all ) == 0 );
+	for ( i = 0 ; i < all->count ; i++ ) {
+		ok ( all->members[i].rc == 0 );
+		ok ( all->members[i].state ==
+		     resource_retrieve ( all->members[i].res ) );
+	}
+
+	/* Nested collections fan out again from worker threads */
+	ok ( collection_test_set ( outer, "value=9" ) == 0 );
+	ok ( outer->state.failed == 0 );
+	for ( workers = 0, i = 0 ; i < ( sizeof ( nest ) /
+					 sizeof ( nest[0] ) ) ; i++ ) {
+		ok ( nest[i]->updates == 1 );
+		ok ( nest[i]->state.value == 9 );
+		workers += nest[i]->worker;
+	}
+	ok ( workers > 0 );
+	ok ( collection_test_inner->state.failed == 0 );
+	for ( i = 0 ; i < ( sizeof ( slow ) / sizeof ( slow[0] ) ) ; i++ ) {
+		ok ( slow[i]->updates == 4 );
+		ok ( slow[i]->state.value == 9 );
+	}
+
+	/* Members are removed with their namespace */
+	resource_unregister ( &collection_test_nest_ns );
+	ok ( outer->count == 0 );
+	ok ( collection_test_set ( outer, "value=1" ) == -ENOENT );
+
+	/* Delete collections and unregister resources */
+	ok ( collection_test_system ( "collection -d /cto/outer" ) == 0 );
+	ok ( collection_test_system ( "collection -d /cti/inner" ) == 0 );
+	ok ( collection_test_system ( "collection -d /cta/all" ) == 0 );
+	resource_unregister ( &collection_test_ns );
+}
+
+/** Resource collection self-test */
+struct self_test collection_test __self_test = {
+	.name = "collection",
+	.exec = collection_test_exec,
+};
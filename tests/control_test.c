@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Closed-loop control self-tests
+ *
+ */
+
+#include <string.h>
+#include <uniport/control.h>
+#include <uniport/timer.h>
+#include <uniport/test.h>
+
+/**
+ * Report a controller step test result
+ *
+ * @v ctrl		Control algorithm
+ * @v setpoint		Setpoint
+ * @v kp		Proportional gain
+ * @v ki		Integral gain
+ * @v kd		Derivative gain
+ * @v previous		Previous measured value
+ * @v measured		Measured value
+ * @v dt		Time since previous step (in ticks)
+ * @v expected		Expected output
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void control_step_okx ( struct controller *ctrl, int setpoint,
+			       unsigned int kp, unsigned int ki,
+			       unsigned int kd, int previous, int measured,
+			       unsigned long dt, unsigned int expected,
+			       const char *file, unsigned int line ) {
+	struct control_loop loop;
+
+	memset ( &loop, 0, sizeof ( loop ) );
+	loop.ctrl = ctrl;
+	loop.setpoint = setpoint;
+	loop.kp = kp;
+	loop.ki = ki;
+	loop.kd = kd;
+	loop.hysteresis = 5;
+	loop.previous = previous;
+	okx ( ctrl->step ( &loop, measured, dt ) == expected, file, line );
+}
+#define control_step_ok( ctrl, setpoint, kp, ki, kd, previous,		\
+			 measured, dt, expected )			\
+	control_step_okx ( ctrl, setpoint, kp, ki, kd, previous,	\
+			   measured, dt, expected, __FILE__, __LINE__ )
+
+/**
+ * Perform closed-loop control self-tests
+ *
+ */
+static void control_test_exec ( void ) {
+	unsigned long ms = TICKS_PER_MS;
+	struct thermal_model model;
+
+	/* Proportional term */
+	control_step_ok ( &pid_controller, 100, 5, 0, 0, 90, 90,
+			  ( 100 * ms ), 50 );
+	control_step_ok ( &pid_controller, 100, 5, 0, 0, 110, 110,
+			  ( 100 * ms ), 0 );
+	control_step_ok ( &pid_controller, 1000, 5, 0, 0, 0, 0,
+			  ( 100 * ms ), CONTROL_OUTPUT_MAX );
+
+	/* Derivative term opposes a falling measurement */
+	control_step_ok ( &pid_controller, 59, 0, 0, 200, 60, 59,
+			  ( 100 * ms ), 1000 );
+	control_step_ok ( &pid_controller, 59, 0, 0, 20, 60, 59,
+			  ( 100 * ms ), 200 );
+	control_step_ok ( &pid_controller, 59, 0, 0, 20, 58, 59,
+			  ( 100 * ms ), 0 );
+	control_step_ok ( &pid_controller, 59, 5, 0, 20, 60, 59,
+			  ( 100 * ms ), 200 );
+
+	/* Integral term */
+	control_step_ok ( &pid_controller, 100, 0, 10, 0, 90, 90,
+			  ( 1000 * ms ), 100 );
+
+	/* On/off control with hysteresis */
+	control_step_ok ( &onoff_controller, 100, 0, 0, 0, 0, 94, 0,
+			  CONTROL_OUTPUT_MAX );
+	control_step_ok ( &onoff_controller, 100, 0, 0, 0, 0, 106, 0, 0 );
+	control_step_ok ( &onoff_controller, 100, 0, 0, 0, 0, 100, 0, 0 );
+
+	/* Thermal model */
+	memset ( &model, 0, sizeof ( model ) );
+	model.temperature = ( 20 * 1000000LL );
+	model.ambient = 20;
+	model.power = 1000000;
+	model.loss = 10000;
+	model.capacity = 1000000;
+	ok ( thermal_model_temperature ( &model, 0 ) == 20 );
+	ok ( thermal_model_temperature ( &model, 1 ) == 200 );
+	thermal_model_step ( &model, 0, TICKS_PER_SEC );
+	ok ( thermal_model_temperature ( &model, 1 ) == 200 );
+	thermal_model_step ( &model, 1, ( 2 * TICKS_PER_SEC ) );
+	ok ( thermal_model_temperature ( &model, 1 ) == 210 );
+}
+
+/** Closed-loop control self-tests */
+struct self_test control_test __self_test = {
+	.name = "control",
+	.exec = control_test_exec,
+};
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Input debouncing self-tests
+ *
+ * The bounce traces in tests/data/debounce are replayed through each
+ * debounce filter, and a live input is debounced by the debounce
+ * thread to check that its methods are called without the debounce
+ * lock held.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <uniport/debounce.h>
+#include <uniport/test.h>
+
+/** Debounce integrator threshold used for trace replay (in samples) */
+#define DEBOUNCE_TEST_THRESHOLD 5
+
+/** Debounce stable time window used for trace replay (in ticks) */
+#define DEBOUNCE_TEST_WINDOW ( 5 * TICKS_PER_MS )
+
+/** Maximum time to wait for the debounce thread (in milliseconds) */
+#define DEBOUNCE_TEST_WAIT_MS 1000
+
+/** A live debounce test input */
+struct debounce_test_input {
+	/** Debounced input */
+	struct debounce deb;
+	/** Raw input value */
+	volatile int raw;
+	/** Number of changes reported */
+	volatile unsigned int changes;
+	/** Number of times settled */
+	volatile unsigned int settles;
+};
+
+/**
+ * Load and replay bounce trace
+ *
+ * @v filename		Trace file name (within tests/data/debounce)
+ * @v edges		Expected number of edges
+ * @v raw		Expected number of notifications without debouncing
+ * @v integrator	Expected number of integrator notifications
+ * @v window		Expected number of window notifications
+ * @v value		Expected final debounced value
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void debounce_replay_okx ( const char *filename, unsigned int edges,
+				  unsigned long raw, unsigned long integrator,
+				  unsigned long window, int value,
+				  const char *file, unsigned int line ) {
+	struct debounce_trace trace;
+	struct debounce_replay replay;
+	struct debounce deb;
+	char name[256];
+
+	/* Load trace */
+	snprintf ( name, sizeof ( name ), "%s/debounce/%s",
+		   test_data, filename );
+	memset ( &trace, 0, sizeof ( trace ) );
+	okx ( debounce_trace_load ( &trace, name ) == 0, file, line );
+	okx ( trace.count == edges, file, line );
+
+	/* Replay without debouncing */
+	debounce_replay_raw ( &trace, &replay );
+	okx ( replay.notifications == raw, file, line );
+	okx ( replay.wakeups == edges, file, line );
+
+	/* Replay through integrator */
+	memset ( &deb, 0, sizeof ( deb ) );
+	deb.mode = DEBOUNCE_INTEGRATOR;
+	deb.threshold = DEBOUNCE_TEST_THRESHOLD;
+	debounce_replay_filter ( &trace, &deb, &replay );
+	okx ( replay.notifications == integrator, file, line );
+	okx ( deb.value == value, file, line );
+	okx ( ! deb.sampling, file, line );
+
+	/* Replay through stable time window */
+	memset ( &deb, 0, sizeof ( deb ) );
+	deb.mode = DEBOUNCE_WINDOW;
+	deb.window = DEBOUNCE_TEST_WINDOW;
+	debounce_replay_filter ( &trace, &deb, &replay );
+	okx ( replay.notifications == window, file, line );
+	okx ( deb.value == value, file, line );
+	okx ( ! deb.sampling, file, line );
+
+	free ( trace.edges );
+}
+#define debounce_replay_ok( filename, edges, raw, integrator, window,	\
+			    value )					\
+	debounce_replay_okx ( filename, edges, raw, integrator, window,	\
+			      value, __FILE__, __LINE__ )
+
+/**
+ * Sample live test input
+ *
+ * @v deb		Debounced input
+ * @ret raw		Raw input value
+ */
+static int debounce_test_sample ( struct debounce *deb ) {
+	struct debounce_test_input *input =
+		container_of ( deb, struct debounce_test_input, deb );
+
+	return input->raw;
+}
+
+/**
+ * Handle change in live test input
+ *
+ * @v deb		Debounced input
+ */
+static void debounce_test_changed ( struct debounce *deb ) {
+	struct debounce_test_input *input =
+		container_of ( deb, struct debounce_test_input, deb );
+
+	input->changes++;
+}
+
+/**
+ * Handle settling of live test input
+ *
+ * @v deb		Debounced input
+ *
+ * The first time the input settles, report a further edge.  This
+ * would deadlock if the debounce lock were still held.
+ */
+static void debounce_test_settled ( struct debounce *deb ) {
+	struct debounce_test_input *input =
+		container_of ( deb, struct debounce_test_input, deb );
+
+	if ( input->settles++ == 0 )
+		debounce_trigger ( deb );
+}
+
+/** Live test input */
+static struct debounce_test_input debounce_test_input = {
+	.deb = {
+		.name = "test",
+		.mode = DEBOUNCE_INTEGRATOR,
+		.threshold = 3,
+		.sample = debounce_test_sample,
+		.changed = debounce_test_changed,
+		.settled = debounce_test_settled,
+	},
+};
+
+/**
+ * Wait for live test input to settle
+ *
+ * @v settles		Number of times to have settled
+ * @ret settled		Input has settled
+ */
+static int debounce_test_settled_wait ( unsigned int settles ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < DEBOUNCE_TEST_WAIT_MS ; i++ ) {
+		if ( debounce_test_input.settles >= settles )
+			return 1;
+		usleep ( 1000 );
+	}
+	return 0;
+}
+
+/**
+ * Perform input debouncing self-tests
+ *
+ */
+static void debounce_test_exec ( void ) {
+	struct debounce_test_input *input = &debounce_test_input;
+	struct debounce_trace trace;
+	char name[256];
+
+	/* Recorded bounce traces */
+	debounce_replay_ok ( "press.trace", 16, 16, 2, 2, 0 );
+	debounce_replay_ok ( "glitch.trace", 8, 8, 0, 0, 0 );
+	debounce_replay_ok ( "slow.trace", 9, 9, 1, 1, 1 );
+	debounce_replay_ok ( "double.trace", 18, 18, 4, 4, 0 );
+
+	/* Malformed and missing traces must be rejected */
+	memset ( &trace, 0, sizeof ( trace ) );
+	snprintf ( name, sizeof ( name ), "%s/debounce/reversed.trace",
+		   test_data );
+	ok ( debounce_trace_load ( &trace, name ) == -EINVAL );
+	free ( trace.edges );
+	memset ( &trace, 0, sizeof ( trace ) );
+	snprintf ( name, sizeof ( name ), "%s/debounce/missing.trace",
+		   test_data );
+	ok ( debounce_trace_load ( &trace, name ) == -ENOENT );
+	free ( trace.edges );
+
+	/* Live input is initialised from the raw value */
+	ok ( debounce_register ( &input->deb ) == 0 );
+	ok ( input->deb.value == 0 );
+
+	/* Press is reported once, and settling may report an edge */
+	input->raw = 1;
+	debounce_trigger ( &input->deb );
+	ok ( debounce_test_settled_wait ( 2 ) );
+	ok ( input->changes == 1 );
+	ok ( input->deb.value == 1 );
+	ok ( input->deb.stats.triggers == 2 );
+
+	/* Release is reported once */
+	input->raw = 0;
+	debounce_trigger ( &input->deb );
+	ok ( debounce_test_settled_wait ( 3 ) );
+	ok ( input->changes == 2 );
+	ok ( input->deb.value == 0 );
+
+	debounce_unregister ( &input->deb );
+}
+
+/** Input debouncing self-test */
+struct self_test debounce_test __self_test = {
+	.name = "debounce",
+	.exec = debounce_test_exec,
+};
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+
+/** @file
+ *
+ * Resource discovery self-tests
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <uniport/discovery.h>
+#include <uniport/test.h>
+
+/**
+ * Report a discovery links copy test result
+ *
+ * @v block		Length of each copy (including NUL)
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The links are copied in parts, which must reassemble to form the
+ * same string as a single copy of the whole list.
+ */
+static void discovery_links_okx ( size_t block, const char *file,
+				  unsigned int line ) {
+	char buf[block];
+	char *expected;
+	char *result;
+	size_t offset = 0;
+	size_t remaining;
+	size_t len;
+
+	len = discovery_links ( NULL, 0, 0 );
+	expected = malloc ( len + 1 /* NUL */ );
+	result = malloc ( len + 1 /* NUL */ );
+	okx ( ( expected != NULL ) && ( result != NULL ), file, line );
+	if ( ! ( expected && result ) )
+		goto err_alloc;
+	okx ( discovery_links ( expected, ( len + 1 /* NUL */ ), 0 ) == len,
+	      file, line );
+	okx ( strlen ( expected ) == len, file, line );
+	result[0] = '\0';
+	do {
+		remaining = discovery_links ( buf, sizeof ( buf ), offset );
+		okx ( remaining == ( len - offset ), file, line );
+		strcat ( result, buf );
+		offset += strlen ( buf );
+	} while ( offset < len );
+	okx ( strcmp ( result, expected ) == 0, file, line );
+
+ err_alloc:
+	free ( result );
+	free ( expected );
+}
+#define discovery_links_ok( block )					\
+	discovery_links_okx ( block, __FILE__, __LINE__ )
+
+/**
+ * Perform resource discovery self-tests
+ *
+ */
+static void discovery_test_exec ( void ) {
+	size_t len;
+
+	/* Links for core resources only */
+	len = discovery_links ( NULL, 0, 0 );
+	ok ( len > 0 );
+	discovery_links_ok ( 2 );
+	discovery_links_ok ( 64 );
+
+	/* Links grow and shrink with registered namespaces */
+	ok ( system ( "sim -n 3 -r 5" ) == 0 );
+	ok ( discovery_links ( NULL, 0, 0 ) > len );
+	discovery_links_ok ( 7 );
+	discovery_links_ok ( 4096 );
+	ok ( system ( "sim -d" ) == 0 );
+	ok ( discovery_links ( NULL, 0, 0 ) == len );
+	discovery_links_ok ( 13 );
+}
+
+/** Resource discovery self-tests */
+struct self_test discovery_test __self_test = {
+	.name = "discovery",
+	.exec = discovery_test_exec,
+};
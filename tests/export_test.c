@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Shared-memory state export self-tests
+ *
+ * The exported segment is mapped separately, as it would be by a
+ * reader process.  Writer threads record states directly while the
+ * reader checks that every copy returned by export_read() is
+ * consistent.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <uniport/export.h>
+#include <uniport/resource.h>
+#include <uniport/test.h>
+
+/** Number of words within the test resource state */
+#define EXPORT_TEST_WORDS 1024
+
+/** Number of writer threads */
+#define EXPORT_TEST_WRITERS 2
+
+/** Number of reads performed while writers are active */
+#define EXPORT_TEST_READS 20000
+
+/** Export test resource state
+ *
+ * Every word holds the same value, so that a torn copy is visible.
+ */
+struct export_test_state {
+	/** Words */
+	int words[EXPORT_TEST_WORDS];
+};
+
+/** Export test resource state */
+static struct export_test_state export_test_state;
+
+/** Writer threads should stop */
+static volatile int export_test_stop;
+
+/** Export test resource properties */
+static struct property export_test_props[] = {
+	PROPERTY_INTEGER ( "first", struct export_test_state, words[0], 0 ),
+	PROPERTY_INTEGER ( "last", struct export_test_state,
+			   words[ EXPORT_TEST_WORDS - 1 ], 0 ),
+};
+
+/**
+ * Retrieve export test resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct export_test_state *
+export_test_retrieve ( struct resource *res __unused ) {
+
+	return &export_test_state;
+}
+
+/** Export test resource descriptor */
+static const struct resource_descriptor export_test_desc =
+	RESOURCE_DESC ( struct export_test_state, export_test_props,
+			export_test_retrieve, NULL, NULL );
+
+/** Export test resource */
+static struct resource export_test_res = {
+	.uri = "words",
+	.desc = &export_test_desc,
+	.observers = OBSERVERS_INIT ( export_test_res ),
+};
+
+/** Export test resources */
+static struct resource *export_test_resources[] = {
+	&export_test_res,
+	NULL
+};
+
+/** Export test namespace */
+static struct namespace export_test_ns = {
+	.uri = "/xt/",
+	.resources = export_test_resources,
+};
+
+/**
+ * Record states continuously
+ *
+ * @v arg		Writer index
+ * @ret result		Result (unused)
+ *
+ * Each writer records states with values distinct from those of any
+ * other writer.
+ */
+static void * export_test_writer ( void *arg ) {
+	struct export_test_state state;
+	intptr_t index = ( ( intptr_t ) arg );
+	int value = ( index + 1 );
+	unsigned int i;
+
+	while ( ! export_test_stop ) {
+		for ( i = 0 ; i < EXPORT_TEST_WORDS ; i++ )
+			state.words[i] = value;
+		export_record ( &export_test_res, &state );
+		value += EXPORT_TEST_WRITERS;
+	}
+	return NULL;
+}
+
+/**
+ * Map exported segment as a reader
+ *
+ * @v name		Segment name
+ * @ret hdr		Segment header, or NULL on error
+ */
+static const struct export_header * export_test_map ( const char *name ) {
+	struct stat stat;
+	void *map;
+	int fd;
+
+	fd = shm_open ( name, O_RDONLY, 0 );
+	if ( fd < 0 )
+		return NULL;
+	if ( fstat ( fd, &stat ) != 0 ) {
+		close ( fd );
+		return NULL;
+	}
+	map = mmap ( NULL, stat.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close ( fd );
+	return ( ( map == MAP_FAILED ) ? NULL : map );
+}
+
+/**
+ * Find exported resource
+ *
+ * @v hdr		Segment header
+ * @v uri		Resource URI
+ * @ret rec		Exported resource, or NULL if not found
+ */
+static const struct export_resource *
+export_test_find ( const struct export_header *hdr, const char *uri ) {
+	const struct export_resource *rec;
+	unsigned int i;
+
+	rec = export_ptr ( hdr, hdr->resources );
+	for ( i = 0 ; i < hdr->num_resources ; i++, rec++ ) {
+		if ( strcmp ( export_ptr ( hdr, rec->uri ), uri ) == 0 )
+			return rec;
+	}
+	return NULL;
+}
+
+/**
+ * Perform shared-memory state export self-tests
+ *
+ */
+static void export_test_exec ( void ) {
+	pthread_t writers[EXPORT_TEST_WRITERS];
+	const struct export_header *hdr;
+	const struct export_descriptor *desc;
+	const struct export_property *prop;
+	const struct export_resource *rec;
+	struct export_test_state copy;
+	char name[32];
+	char command[48];
+	unsigned int torn = 0;
+	unsigned int changes = 0;
+	unsigned int i;
+	unsigned int j;
+	uint32_t index;
+	size_t len;
+	int last = 0;
+
+	/* Register resource and start exporting */
+	for ( i = 0 ; i < EXPORT_TEST_WORDS ; i++ )
+		export_test_state.words[i] = 42;
+	ok ( resource_register ( &export_test_ns ) == 0 );
+	snprintf ( name, sizeof ( name ), "/uniport-test-%d", getpid() );
+	snprintf ( command, sizeof ( command ), "export %s", name );
+	ok ( system ( command ) == 0 );
+	ok ( export_test_res.export != NULL );
+	hdr = export_test_map ( name );
+	ok ( hdr != NULL );
+	if ( ! hdr )
+		goto err_map;
+	len = hdr->len;
+
+	/* Segment describes the resource */
+	ok ( hdr->magic == EXPORT_MAGIC );
+	ok ( hdr->version == EXPORT_VERSION );
+	rec = export_test_find ( hdr, "/xt/words" );
+	ok ( rec != NULL );
+	if ( ! rec )
+		goto err_find;
+	ok ( ( rec->seq & 1 ) == 0 );
+	desc = export_ptr ( hdr, hdr->descs );
+	desc += rec->desc;
+	ok ( desc->len == sizeof ( struct export_test_state ) );
+	ok ( desc->count == 2 );
+	prop = export_ptr ( hdr, desc->props );
+	ok ( strcmp ( export_ptr ( hdr, prop[1].name ), "last" ) == 0 );
+	ok ( strcmp ( export_ptr ( hdr, prop[1].type ), "integer" ) == 0 );
+	ok ( prop[1].offset == offsetof ( struct export_test_state,
+					  words[ EXPORT_TEST_WORDS - 1 ] ) );
+
+	/* Initial state is exported */
+	ok ( export_read ( hdr, rec, &copy ) == rec->desc );
+	ok ( copy.words[0] == 42 );
+
+	/* Notifications update the exported state */
+	for ( i = 0 ; i < EXPORT_TEST_WORDS ; i++ )
+		export_test_state.words[i] = 7;
+	resource_notify ( &export_test_res );
+	ok ( export_read ( hdr, rec, &copy ) == rec->desc );
+	ok ( memcmp ( &copy, &export_test_state, sizeof ( copy ) ) == 0 );
+
+	/* Reader sees only consistent copies while writers race */
+	export_test_stop = 0;
+	for ( i = 0 ; i < EXPORT_TEST_WRITERS ; i++ ) {
+		ok ( pthread_create ( &writers[i], NULL, export_test_writer,
+				      ( ( void * ) ( intptr_t ) i ) ) == 0 );
+	}
+	for ( i = 0 ; i < EXPORT_TEST_READS ; i++ ) {
+		index = export_read ( hdr, rec, &copy );
+		if ( index != rec->desc ) {
+			torn++;
+			continue;
+		}
+		for ( j = 1 ; j < EXPORT_TEST_WORDS ; j++ ) {
+			if ( copy.words[j] != copy.words[0] )
+				break;
+		}
+		if ( j < EXPORT_TEST_WORDS )
+			torn++;
+		if ( copy.words[0] != last )
+			changes++;
+		last = copy.words[0];
+	}
+	export_test_stop = 1;
+	for ( i = 0 ; i < EXPORT_TEST_WRITERS ; i++ )
+		pthread_join ( writers[i], NULL );
+	ok ( torn == 0 );
+	ok ( changes > 1 );
+	ok ( ( rec->seq & 1 ) == 0 );
+
+	/* Unregistering the namespace marks the resource as removed */
+	resource_unregister ( &export_test_ns );
+	ok ( export_test_res.export == NULL );
+	ok ( export_read ( hdr, rec, &copy ) == EXPORT_REMOVED );
+	ok ( ( rec->seq & 1 ) == 0 );
+
+	/* Stopping the export invalidates the segment */
+	ok ( system ( "export -d" ) == 0 );
+	ok ( hdr->magic == 0 );
+	munmap ( ( void * ) hdr, len );
+	return;
+
+ err_find:
+	munmap ( ( void * ) hdr, len );
+ err_map:
+	system ( "export -d" );
+	resource_unregister ( &export_test_ns );
+}
+
+/** Shared-memory state export self-test */
+struct self_test export_test __self_test = {
+	.name = "export",
+	.exec = export_test_exec,
+};
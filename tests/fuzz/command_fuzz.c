@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Command line parser fuzzing harness
+ *
+ * The input is split into tokens as for system(), and the tokens are
+ * then parsed as options for a command using each kind of option
+ * argument.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <uniport/command.h>
+#include <uniport/parseopt.h>
+#include "fuzz.h"
+
+/** Fuzzed command options */
+struct fuzz_options {
+	/** Integer */
+	unsigned int count;
+	/** Flag */
+	int flag;
+	/** String */
+	char *text;
+};
+
+/** Fuzzed command option list */
+static struct option_descriptor fuzz_opts[] = {
+	OPTION_DESC ( "count", 'n', required_argument,
+		      struct fuzz_options, count, parse_integer ),
+	OPTION_DESC ( "flag", 'f', no_argument,
+		      struct fuzz_options, flag, parse_flag ),
+	OPTION_DESC ( "text", 't', required_argument,
+		      struct fuzz_options, text, parse_string ),
+};
+
+/** Fuzzed command descriptor */
+static struct command_descriptor fuzz_cmd =
+	COMMAND_DESC ( struct fuzz_options, fuzz_opts, 0, 2, "[<arg>...]" );
+
+/**
+ * Split and parse command line
+ *
+ * @v command		Command line (will be modified)
+ */
+static void fuzz_command ( char *command ) {
+	int argc = split_command ( command, NULL );
+	char *argv[ argc + 1 ];
+	struct fuzz_options opts;
+
+	/* Split into tokens, checking that counting and splitting agree */
+	if ( split_command ( command, argv ) != argc )
+		abort();
+	argv[argc] = NULL;
+
+	/* Parse options, as execv() would */
+	if ( argc ) {
+		optind = 0;
+		opterr = 0;
+		parse_options ( argc, argv, &fuzz_cmd, &opts );
+	}
+}
+
+/**
+ * Fuzz command line parsers
+ *
+ * @v data		Input data
+ * @v size		Length of input data
+ * @ret rc		Zero (as required by libFuzzer)
+ */
+int LLVMFuzzerTestOneInput ( const uint8_t *data, size_t size ) {
+	char *string;
+
+	string = fuzz_string ( data, size );
+	if ( ! string )
+		return 0;
+	fuzz_command ( string );
+	free ( string );
+	return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef _FUZZ_H
+#define _FUZZ_H
+
+/** @file
+ *
+ * Parser fuzzing harnesses
+ *
+ * Each harness provides the libFuzzer entry point for a single
+ * parser.  A harness may be linked either with libFuzzer (to search
+ * for new inputs) or with the replay driver (to check the corpus of
+ * inputs kept in tests/data/fuzz).
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern int LLVMFuzzerTestOneInput ( const uint8_t *data, size_t size );
+
+/**
+ * Construct NUL-terminated string from fuzzer input
+ *
+ * @v data		Input data
+ * @v size		Length of input data
+ * @ret string		String (to be freed by the caller), or NULL
+ *
+ * The parsers under test accept only NUL-terminated strings, and so
+ * any NUL within the input simply terminates the string early.
+ */
+static inline char * fuzz_string ( const uint8_t *data, size_t size ) {
+	char *string;
+
+	string = malloc ( size + 1 /* NUL */ );
+	if ( string ) {
+		memcpy ( string, data, size );
+		string[size] = '\0';
+	}
+	return string;
+}
+
+#endif /* _FUZZ_H */
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Fuzzing harness replay driver
+ *
+ * This provides a main() for a fuzzing harness in place of libFuzzer,
+ * passing each input file (or each file within an input directory) to
+ * the harness exactly once.  This allows the corpus to be checked by
+ * any compiler, without requiring libFuzzer.
+ *
+ * As with libFuzzer, results are reported to stderr, leaving stdout
+ * for any diagnostics printed by the parsers under test.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "fuzz.h"
+
+/** Number of inputs replayed */
+static unsigned int replay_count;
+
+/**
+ * Replay input file
+ *
+ * @v name		File name
+ * @ret rc		Return status code
+ */
+static int replay_file ( const char *name ) {
+	struct stat st;
+	uint8_t *data;
+	FILE *file;
+	int rc;
+
+	file = fopen ( name, "rb" );
+	if ( ! file ) {
+		rc = -errno;
+		goto err_open;
+	}
+	if ( fstat ( fileno ( file ), &st ) != 0 ) {
+		rc = -errno;
+		goto err_stat;
+	}
+	data = malloc ( st.st_size + 1 /* avoid zero-length allocation */ );
+	if ( ! data ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	if ( fread ( data, 1, st.st_size, file ) != ( size_t ) st.st_size ) {
+		rc = -EIO;
+		goto err_read;
+	}
+
+	LLVMFuzzerTestOneInput ( data, st.st_size );
+	replay_count++;
+	rc = 0;
+
+ err_read:
+	free ( data );
+ err_alloc:
+ err_stat:
+	fclose ( file );
+ err_open:
+	if ( rc != 0 )
+		fprintf ( stderr, "%s: %s\n", name, strerror ( -rc ) );
+	return rc;
+}
+
+/**
+ * Replay input file or directory
+ *
+ * @v name		File or directory name
+ * @ret rc		Return status code
+ */
+static int replay ( const char *name ) {
+	struct dirent *entry;
+	char path[4096];
+	DIR *dir;
+	int rc = 0;
+
+	/* Replay single file, if applicable */
+	dir = opendir ( name );
+	if ( ! dir )
+		return replay_file ( name );
+
+	/* Otherwise, replay each file within directory */
+	while ( ( entry = readdir ( dir ) ) ) {
+		if ( entry->d_name[0] == '.' )
+			continue;
+		snprintf ( path, sizeof ( path ), "%s/%s",
+			   name, entry->d_name );
+		if ( ( rc = replay_file ( path ) ) != 0 )
+			break;
+	}
+	closedir ( dir );
+	return rc;
+}
+
+/**
+ * Main program
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret exit		Exit status
+ */
+int main ( int argc, char **argv ) {
+	int i;
+
+	for ( i = 1 ; i < argc ; i++ ) {
+		if ( replay ( argv[i] ) != 0 )
+			return EXIT_FAILURE;
+	}
+	if ( ! replay_count ) {
+		fprintf ( stderr, "%s: no inputs\n", argv[0] );
+		return EXIT_FAILURE;
+	}
+	fprintf ( stderr, "%s: %u inputs replayed\n", argv[0], replay_count );
+	return EXIT_SUCCESS;
+}
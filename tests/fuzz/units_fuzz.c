@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Temperature units parser fuzzing harness
+ *
+ */
+
+#include <stdlib.h>
+#include <uniport/temperature.h>
+#include "fuzz.h"
+
+/**
+ * Fuzz temperature units parser
+ *
+ * @v data		Input data
+ * @v size		Length of input data
+ * @ret rc		Zero (as required by libFuzzer)
+ *
+ * Any accepted value must be one of the known units, and must survive
+ * a round trip through the formatter.
+ */
+int LLVMFuzzerTestOneInput ( const uint8_t *data, size_t size ) {
+	char buf[PROPERTY_FORMAT_LEN];
+	enum temperature_units value;
+	enum temperature_units check;
+	char *string;
+
+	string = fuzz_string ( data, size );
+	if ( ! string )
+		return 0;
+	if ( temperature_units_parse ( NULL, string, &value ) == 0 ) {
+		if ( ( value != TEMPERATURE_UNITS_C ) &&
+		     ( value != TEMPERATURE_UNITS_F ) &&
+		     ( value != TEMPERATURE_UNITS_K ) )
+			abort();
+		temperature_units_format ( NULL, buf, sizeof ( buf ), &value );
+		if ( ( temperature_units_parse ( NULL, buf, &check ) != 0 ) ||
+		     ( check != value ) )
+			abort();
+	}
+	free ( string );
+	return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * UUID property parser fuzzing harness
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <uniport/property.h>
+#include <uniport/uuid.h>
+#include "fuzz.h"
+
+/**
+ * Fuzz UUID property parser
+ *
+ * @v data		Input data
+ * @v size		Length of input data
+ * @ret rc		Zero (as required by libFuzzer)
+ *
+ * Any accepted value must survive a round trip through the formatter.
+ */
+int LLVMFuzzerTestOneInput ( const uint8_t *data, size_t size ) {
+	char buf[ UUID_STRING_LEN + 1 /* NUL */ ];
+	union uuid value;
+	union uuid check;
+	char *string;
+
+	string = fuzz_string ( data, size );
+	if ( ! string )
+		return 0;
+	if ( uuid_parse ( NULL, string, &value ) == 0 ) {
+		if ( uuid_format ( NULL, buf, sizeof ( buf ),
+				   &value ) != UUID_STRING_LEN )
+			abort();
+		if ( ( uuid_parse ( NULL, buf, &check ) != 0 ) ||
+		     ( memcmp ( &check, &value, sizeof ( value ) ) != 0 ) )
+			abort();
+	}
+	free ( string );
+	return 0;
+}
@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * MQTT bridge self-tests
+ *
+ * These tests run an in-process broker stand-in on the loopback
+ * interface, and inspect the packets sent by the bridge directly.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <uniport/mqtt.h>
+#include <uniport/test.h>
+
+/** Port used for MQTT bridge self-tests */
+#define MQTT_TEST_PORT 11883
+
+/** Time to wait for an expected packet (in milliseconds) */
+#define MQTT_TEST_WAIT_MS 1000
+
+/** Time to wait for the absence of any packet (in milliseconds) */
+#define MQTT_TEST_QUIET_MS 300
+
+/** Length of oversized test string */
+#define MQTT_TEST_LARGE_LEN ( MQTT_TX_LEN + 16 )
+
+/** MQTT test resource state */
+struct mqtt_test_state {
+	/** Value */
+	int value;
+	/** Text */
+	const char *text;
+};
+
+/** MQTT test oversized text */
+static char mqtt_test_text[ MQTT_TEST_LARGE_LEN + 1 /* NUL */ ];
+
+/** MQTT test small resource state */
+static struct mqtt_test_state mqtt_test_small;
+
+/** MQTT test large resource state */
+static struct mqtt_test_state mqtt_test_large = {
+	.text = mqtt_test_text,
+};
+
+/** MQTT test small resource properties */
+static struct property mqtt_test_small_props[] = {
+	PROPERTY_INTEGER ( "value", struct mqtt_test_state, value, PROP_RW ),
+};
+
+/** MQTT test large resource properties */
+static struct property mqtt_test_large_props[] = {
+	PROPERTY_STRING ( "text", struct mqtt_test_state, text, 0 ),
+};
+
+/**
+ * Retrieve MQTT test small resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct mqtt_test_state *
+mqtt_test_small_retrieve ( struct resource *res __unused ) {
+
+	return &mqtt_test_small;
+}
+
+/**
+ * Retrieve MQTT test large resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct mqtt_test_state *
+mqtt_test_large_retrieve ( struct resource *res __unused ) {
+
+	return &mqtt_test_large;
+}
+
+/**
+ * Update MQTT test resource state
+ *
+ * @v res		Resource
+ * @v state		New resource state
+ * @ret rc		Return status code
+ */
+static int mqtt_test_update ( struct resource *res,
+			      const struct mqtt_test_state *state ) {
+
+	mqtt_test_small.value = state->value;
+	resource_notify ( res );
+	return 0;
+}
+
+/** MQTT test small resource descriptor */
+static const struct resource_descriptor mqtt_test_small_desc =
+	RESOURCE_DESC ( struct mqtt_test_state, mqtt_test_small_props,
+			mqtt_test_small_retrieve, mqtt_test_update, NULL );
+
+/** MQTT test large resource descriptor */
+static const struct resource_descriptor mqtt_test_large_desc =
+	RESOURCE_DESC ( struct mqtt_test_state, mqtt_test_large_props,
+			mqtt_test_large_retrieve, NULL, NULL );
+
+/** MQTT test small resource */
+static struct resource mqtt_test_small_res = {
+	.uri = "small",
+	.desc = &mqtt_test_small_desc,
+	.observers = OBSERVERS_INIT ( mqtt_test_small_res ),
+};
+
+/** MQTT test large resource */
+static struct resource mqtt_test_large_res = {
+	.uri = "large",
+	.desc = &mqtt_test_large_desc,
+	.observers = OBSERVERS_INIT ( mqtt_test_large_res ),
+};
+
+/** MQTT test resources */
+static struct resource *mqtt_test_res[] = {
+	&mqtt_test_small_res,
+	&mqtt_test_large_res,
+	NULL
+};
+
+/** MQTT test namespace */
+static struct namespace mqtt_test_ns = {
+	.uri = "/mqtt/",
+	.resources = mqtt_test_res,
+};
+
+/**
+ * Receive byte from bridge
+ *
+ * @v fd		Broker stand-in socket
+ * @v byte		Byte to fill in
+ * @v wait		Time to wait (in milliseconds)
+ * @ret received	Byte was received
+ */
+static int mqtt_test_byte ( int fd, uint8_t *byte, unsigned int wait ) {
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	if ( poll ( &pfd, 1, wait ) <= 0 )
+		return 0;
+	return ( read ( fd, byte, 1 ) == 1 );
+}
+
+/**
+ * Receive packet from bridge
+ *
+ * @v fd		Broker stand-in socket
+ * @v buf		Packet buffer
+ * @v len		Length of packet buffer
+ * @v wait		Time to wait (in milliseconds)
+ * @ret len		Length of packet, or zero if none was received
+ */
+static size_t mqtt_test_recv ( int fd, uint8_t *buf, size_t len,
+			       unsigned int wait ) {
+	size_t remaining = 0;
+	size_t used = 0;
+	unsigned int shift = 0;
+
+	/* Read fixed header */
+	do {
+		if ( ! mqtt_test_byte ( fd, &buf[used++], wait ) )
+			return 0;
+		if ( used == 1 )
+			continue;
+		remaining |= ( ( buf[ used - 1 ] & 0x7f ) << shift );
+		shift += 7;
+	} while ( ( used == 1 ) || ( ( used < 5 ) &&
+				    ( buf[ used - 1 ] & 0x80 ) ) );
+
+	/* Read packet body */
+	if ( ( used + remaining ) > len )
+		return 0;
+	while ( remaining-- ) {
+		if ( ! mqtt_test_byte ( fd, &buf[used++], wait ) )
+			return 0;
+	}
+	return used;
+}
+
+/**
+ * Send packet to bridge
+ *
+ * @v fd		Broker stand-in socket
+ * @v data		Packet
+ * @v len		Length of packet
+ */
+static void mqtt_test_send ( int fd, const void *data, size_t len ) {
+
+	if ( write ( fd, data, len ) != ( ssize_t ) len ) {
+		/* Test will fail when the expected response is missing */
+	}
+}
+
+/**
+ * Send PUBLISH packet to bridge (with QoS 0)
+ *
+ * @v fd		Broker stand-in socket
+ * @v topic		Topic
+ * @v payload		Payload
+ */
+static void mqtt_test_publish ( int fd, const char *topic,
+				const char *payload ) {
+	size_t topic_len = strlen ( topic );
+	size_t payload_len = strlen ( payload );
+	uint8_t buf[ 4 + topic_len + payload_len ];
+
+	buf[0] = ( MQTT_PUBLISH << 4 );
+	buf[1] = ( 2 + topic_len + payload_len );
+	buf[2] = 0;
+	buf[3] = topic_len;
+	memcpy ( &buf[4], topic, topic_len );
+	memcpy ( &buf[ 4 + topic_len ], payload, payload_len );
+	mqtt_test_send ( fd, buf, sizeof ( buf ) );
+}
+
+/**
+ * Acknowledge publication
+ *
+ * @v fd		Broker stand-in socket
+ * @v id		Packet identifier
+ */
+static void mqtt_test_puback ( int fd, unsigned int id ) {
+	uint8_t buf[] = { ( MQTT_PUBACK << 4 ), 2, ( id >> 8 ), id };
+
+	mqtt_test_send ( fd, buf, sizeof ( buf ) );
+}
+
+/**
+ * Check received QoS 1 publication
+ *
+ * @v buf		Packet
+ * @v len		Length of packet
+ * @v dup		Expected DUP flag
+ * @v topic		Expected topic
+ * @v payload		Expected payload
+ * @v file		Test code file
+ * @v line		Test code line
+ * @ret id		Packet identifier
+ */
+static unsigned int mqtt_test_publish_okx ( const uint8_t *buf, size_t len,
+					    int dup, const char *topic,
+					    const char *payload,
+					    const char *file,
+					    unsigned int line ) {
+	size_t topic_len = strlen ( topic );
+	size_t payload_len = strlen ( payload );
+
+	okx ( len == ( 6 + topic_len + payload_len ), file, line );
+	if ( len != ( 6 + topic_len + payload_len ) )
+		return 0;
+	okx ( buf[0] == ( ( MQTT_PUBLISH << 4 ) | ( dup ? MQTT_DUP : 0 ) |
+			  0x02 /* QoS 1 */ ), file, line );
+	okx ( buf[1] == ( len - 2 ), file, line );
+	okx ( buf[3] == topic_len, file, line );
+	okx ( memcmp ( &buf[4], topic, topic_len ) == 0, file, line );
+	okx ( memcmp ( &buf[ 6 + topic_len ], payload,
+		       payload_len ) == 0, file, line );
+	return ( ( buf[ 4 + topic_len ] << 8 ) | buf[ 5 + topic_len ] );
+}
+#define mqtt_test_publish_ok( buf, len, dup, topic, payload )		\
+	mqtt_test_publish_okx ( buf, len, dup, topic, payload,		\
+				__FILE__, __LINE__ )
+
+/**
+ * Perform MQTT bridge self-tests
+ *
+ */
+static void mqtt_test_exec ( void ) {
+	static const uint8_t connack[] = { ( MQTT_CONNACK << 4 ), 2, 0, 0 };
+	static const char state[] = "uniport/state/mqtt/small";
+	struct sockaddr_in addr;
+	uint8_t buf[MQTT_TX_LEN];
+	uint8_t first[MQTT_TX_LEN];
+	size_t first_len;
+	size_t len;
+	unsigned int id;
+	int listener;
+	int one = 1;
+	int fd;
+
+	/* Register test resources */
+	memset ( mqtt_test_text, 'x', MQTT_TEST_LARGE_LEN );
+	ok ( resource_register ( &mqtt_test_ns ) == 0 );
+
+	/* Listen as broker stand-in */
+	listener = socket ( AF_INET, SOCK_STREAM, 0 );
+	ok ( listener >= 0 );
+	setsockopt ( listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof ( one ) );
+	memset ( &addr, 0, sizeof ( addr ) );
+	addr.sin_family = AF_INET;
+	inet_aton ( "127.0.0.1", &addr.sin_addr );
+	addr.sin_port = htons ( MQTT_TEST_PORT );
+	ok ( bind ( listener, ( struct sockaddr * ) &addr,
+		    sizeof ( addr ) ) == 0 );
+	ok ( listen ( listener, 1 ) == 0 );
+
+	/* A zero retransmission interval is rejected */
+	ok ( system ( "mqtt -p 11883 -q 1 -r 0 /mqtt/*" ) != 0 );
+
+	/* Connect bridge with QoS 1 and a short retransmission interval */
+	ok ( system ( "mqtt -p 11883 -q 1 -k 0 -r 100 /mqtt/*" ) == 0 );
+	fd = accept ( listener, NULL, NULL );
+	ok ( fd >= 0 );
+	len = mqtt_test_recv ( fd, buf, sizeof ( buf ), MQTT_TEST_WAIT_MS );
+	ok ( ( len > 0 ) && ( buf[0] == ( MQTT_CONNECT << 4 ) ) );
+	len = mqtt_test_recv ( fd, buf, sizeof ( buf ), MQTT_TEST_WAIT_MS );
+	ok ( ( len > 0 ) && ( buf[0] == ( ( MQTT_SUBSCRIBE << 4 ) | 0x02 ) ) );
+	mqtt_test_send ( fd, connack, sizeof ( connack ) );
+
+	/* An unacknowledged publication is retransmitted unchanged,
+	 * with the same packet identifier and with DUP set.
+	 */
+	mqtt_test_small.value = 42;
+	resource_notify ( &mqtt_test_small_res );
+	first_len = mqtt_test_recv ( fd, first, sizeof ( first ),
+				     MQTT_TEST_WAIT_MS );
+	id = mqtt_test_publish_ok ( first, first_len, 0, state, "value=42" );
+	mqtt_test_small.value = 43;
+	len = mqtt_test_recv ( fd, buf, sizeof ( buf ), MQTT_TEST_WAIT_MS );
+	ok ( mqtt_test_publish_ok ( buf, len, 1, state, "value=42" ) == id );
+	mqtt_test_puback ( fd, id );
+	ok ( mqtt_test_recv ( fd, buf, sizeof ( buf ),
+			      MQTT_TEST_QUIET_MS ) == 0 );
+
+	/* An oversized publication is dropped without stalling others */
+	resource_notify ( &mqtt_test_large_res );
+	resource_notify ( &mqtt_test_small_res );
+	len = mqtt_test_recv ( fd, buf, sizeof ( buf ), MQTT_TEST_WAIT_MS );
+	id = mqtt_test_publish_ok ( buf, len, 0, state, "value=43" );
+	mqtt_test_puback ( fd, id );
+
+	/* An update is applied to the bridged resource */
+	mqtt_test_publish ( fd, "uniport/set/mqtt/small", "value=7" );
+	len = mqtt_test_recv ( fd, buf, sizeof ( buf ), MQTT_TEST_WAIT_MS );
+	id = mqtt_test_publish_ok ( buf, len, 0, state, "value=7" );
+	mqtt_test_puback ( fd, id );
+	ok ( mqtt_test_small.value == 7 );
+
+	/* Unregistering the namespace abandons unacknowledged
+	 * publications and ignores further updates.
+	 */
+	resource_notify ( &mqtt_test_small_res );
+	len = mqtt_test_recv ( fd, buf, sizeof ( buf ), MQTT_TEST_WAIT_MS );
+	mqtt_test_publish_ok ( buf, len, 0, state, "value=7" );
+	resource_unregister ( &mqtt_test_ns );
+	mqtt_test_publish ( fd, "uniport/set/mqtt/small", "value=8" );
+	ok ( mqtt_test_recv ( fd, buf, sizeof ( buf ),
+			      MQTT_TEST_QUIET_MS ) == 0 );
+	ok ( mqtt_test_small.value == 7 );
+
+	/* Stopping the bridge disconnects cleanly */
+	ok ( system ( "mqtt -d" ) == 0 );
+	len = mqtt_test_recv ( fd, buf, sizeof ( buf ), MQTT_TEST_WAIT_MS );
+	ok ( ( len == 2 ) && ( buf[0] == ( MQTT_DISCONNECT << 4 ) ) );
+
+	close ( fd );
+	close ( listener );
+}
+
+/** MQTT bridge self-tests */
+struct self_test mqtt_test __self_test = {
+	.name = "mqtt",
+	.exec = mqtt_test_exec,
+};
@@ -0,0 +1,464 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Property self-tests
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <float.h>
+#include <uniport/resource.h>
+#include <uniport/string.h>
+#include <uniport/temperature.h>
+#include <uniport/test.h>
+
+/** Maximum number of test array elements */
+#define PROPERTY_TEST_MAX 4
+
+/** Property test resource state */
+struct property_test_state {
+	/** Integer array */
+	struct property_array array;
+	/** Binary blob */
+	struct property_array blob;
+};
+
+/** Property test numeric state */
+struct property_test_number {
+	/** Fixed-point value (no decimal places) */
+	int fixed0;
+	/** Fixed-point value (one decimal place) */
+	int fixed1;
+	/** Fixed-point value (maximum decimal places) */
+	int fixed9;
+	/** Floating-point value (no decimal places) */
+	float float0;
+	/** Floating-point value (two decimal places) */
+	float float2;
+	/** Floating-point value (maximum decimal places) */
+	float float9;
+};
+
+/** Property test integer array buffer */
+static int property_test_elements[PROPERTY_TEST_MAX];
+
+/** Property test binary blob buffer */
+static uint8_t property_test_bytes[PROPERTY_TEST_MAX];
+
+/** Property test update rejection status, or zero to accept */
+static int property_test_reject;
+
+/** Property test resource state */
+static struct property_test_state property_test_state = {
+	.array = { .data = property_test_elements },
+	.blob = { .data = property_test_bytes },
+};
+
+/** Property test properties */
+static struct property property_test_props[] = {
+	PROPERTY_ARRAY ( "array", struct property_test_state, array,
+			 PROPERTY_TEST_MAX, PROP_RW ),
+	PROPERTY_BLOB ( "blob", struct property_test_state, blob,
+			PROPERTY_TEST_MAX, PROP_RW ),
+};
+
+/** Property test numeric properties */
+static struct property property_test_number_props[] = {
+	PROPERTY_FIXED ( "fixed0", struct property_test_number, fixed0, 0,
+			 PROP_RW ),
+	PROPERTY_FIXED ( "fixed1", struct property_test_number, fixed1, 1,
+			 PROP_RW ),
+	PROPERTY_FIXED ( "fixed9", struct property_test_number, fixed9,
+			 FIXED_SCALE_MAX, PROP_RW ),
+	PROPERTY_FLOAT ( "float0", struct property_test_number, float0, 0,
+			 PROP_RW ),
+	PROPERTY_FLOAT ( "float2", struct property_test_number, float2, 2,
+			 PROP_RW ),
+	PROPERTY_FLOAT ( "float9", struct property_test_number, float9,
+			 FIXED_SCALE_MAX, PROP_RW ),
+};
+
+/**
+ * Retrieve property test resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct property_test_state *
+property_test_retrieve ( struct resource *res __unused ) {
+
+	return &property_test_state;
+}
+
+/**
+ * Update property test resource state
+ *
+ * @v res		Resource
+ * @v state		New resource state
+ * @ret rc		Return status code
+ */
+static int property_test_update ( struct resource *res,
+				  const struct property_test_state *state ) {
+
+	/* Reject update, if applicable */
+	if ( property_test_reject )
+		return property_test_reject;
+
+	/* Accept new state */
+	memcpy ( &property_test_state, state, sizeof ( property_test_state ) );
+	resource_commit ( res, &property_test_state );
+	return 0;
+}
+
+/** Property test resource descriptor */
+static const struct resource_descriptor property_test_desc =
+	RESOURCE_DESC ( struct property_test_state, property_test_props,
+			property_test_retrieve, property_test_update, NULL );
+
+/** Property test resource */
+static struct resource property_test_res = {
+	.uri = "property",
+	.desc = &property_test_desc,
+};
+
+/**
+ * Report a property parse test result
+ *
+ * @v prop		Property
+ * @v string		String to parse
+ * @v expected_rc	Expected return status code
+ * @v expected		Expected formatted value of updated copy
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The value is parsed into a copy of the resource state, which is
+ * then discarded.  The resource's own buffers must be unaffected.
+ */
+static void property_parse_okx ( struct property *prop, const char *string,
+				 int expected_rc, const char *expected,
+				 const char *file, unsigned int line ) {
+	struct resource *res = &property_test_res;
+	struct property_test_state copy;
+	char before[PROPERTY_FORMAT_LEN];
+	char after[PROPERTY_FORMAT_LEN];
+	char buf[PROPERTY_FORMAT_LEN];
+	int rc;
+
+	memcpy ( &copy, resource_retrieve ( res ), sizeof ( copy ) );
+	property_format ( prop, before, sizeof ( before ), &copy );
+	rc = property_parse ( prop, string, &copy );
+	okx ( rc == expected_rc, file, line );
+	if ( rc == 0 ) {
+		property_format ( prop, buf, sizeof ( buf ), &copy );
+		okx ( strcmp ( buf, expected ) == 0, file, line );
+	}
+	property_format ( prop, after, sizeof ( after ),
+			  resource_retrieve ( res ) );
+	okx ( strcmp ( before, after ) == 0, file, line );
+	resource_discard ( res, &copy );
+}
+#define property_parse_ok( prop, string, expected_rc, expected )	\
+	property_parse_okx ( prop, string, expected_rc, expected,	\
+			     __FILE__, __LINE__ )
+
+/**
+ * Report a numeric property round-trip test result
+ *
+ * @v prop		Property
+ * @v string		String to parse
+ * @v expected_rc	Expected return status code
+ * @v expected		Expected formatted value
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The formatted value must parse back to a value with the same
+ * formatted representation.  A rejected value must leave the state
+ * untouched.
+ */
+static void property_number_okx ( struct property *prop, const char *string,
+				  int expected_rc, const char *expected,
+				  const char *file, unsigned int line ) {
+	struct property_test_number number;
+	struct property_test_number again;
+	struct property_test_number zero;
+	char buf[PROPERTY_FORMAT_LEN];
+	int rc;
+
+	memset ( &number, 0, sizeof ( number ) );
+	memset ( &again, 0, sizeof ( again ) );
+	memset ( &zero, 0, sizeof ( zero ) );
+	rc = property_parse ( prop, string, &number );
+	okx ( rc == expected_rc, file, line );
+	if ( rc != 0 ) {
+		okx ( memcmp ( &number, &zero, sizeof ( number ) ) == 0,
+		      file, line );
+		return;
+	}
+	property_format ( prop, buf, sizeof ( buf ), &number );
+	okx ( strcmp ( buf, expected ) == 0, file, line );
+	okx ( property_parse ( prop, buf, &again ) == 0, file, line );
+	property_format ( prop, buf, sizeof ( buf ), &again );
+	okx ( strcmp ( buf, expected ) == 0, file, line );
+}
+#define property_number_ok( prop, string, expected_rc, expected )	\
+	property_number_okx ( prop, string, expected_rc, expected,	\
+			      __FILE__, __LINE__ )
+
+/**
+ * Report a floating-point property exact round-trip test result
+ *
+ * @v prop		Property
+ * @v value		Value
+ * @v expected		Expected formatted value
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The formatted value must parse back to exactly the original value.
+ */
+static void property_float_okx ( struct property *prop, float value,
+				 const char *expected, const char *file,
+				 unsigned int line ) {
+	struct property_test_number number;
+	char buf[PROPERTY_FORMAT_LEN];
+
+	memset ( &number, 0, sizeof ( number ) );
+	number.float0 = value;
+	property_format ( prop, buf, sizeof ( buf ), &number );
+	okx ( strcmp ( buf, expected ) == 0, file, line );
+	number.float0 = 0;
+	okx ( property_parse ( prop, buf, &number ) == 0, file, line );
+	okx ( number.float0 == value, file, line );
+}
+#define property_float_ok( prop, value, expected )			\
+	property_float_okx ( prop, value, expected, __FILE__, __LINE__ )
+
+/**
+ * Report a property part formatting test result
+ *
+ * @v prop		Property
+ * @v state		Resource state
+ * @v block		Length of each part (including NUL)
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The value is formatted in parts using a position hint, which must
+ * produce the same string as formatting the whole value.
+ */
+static void property_part_okx ( struct property *prop, const void *state,
+				size_t block, const char *file,
+				unsigned int line ) {
+	struct property_hint hint;
+	char expected[PROPERTY_FORMAT_LEN];
+	char result[PROPERTY_FORMAT_LEN];
+	char buf[block];
+	size_t offset = 0;
+	size_t remaining;
+	size_t len;
+
+	len = property_format ( prop, expected, sizeof ( expected ), state );
+	memset ( &hint, 0, sizeof ( hint ) );
+	result[0] = '\0';
+	do {
+		remaining = property_format_part ( prop, buf, sizeof ( buf ),
+						   state, offset, &hint );
+		strcat ( result, buf );
+		offset += strlen ( buf );
+	} while ( ( remaining >= sizeof ( buf ) ) && ( offset < len ) );
+	okx ( strcmp ( result, expected ) == 0, file, line );
+}
+#define property_part_ok( prop, state, block )				\
+	property_part_okx ( prop, state, block, __FILE__, __LINE__ )
+
+/**
+ * Perform property self-tests
+ *
+ */
+static void property_test_exec ( void ) {
+	struct resource *res = &property_test_res;
+	struct property *array = &property_test_props[0];
+	struct property *blob = &property_test_props[1];
+	struct property *fixed0 = &property_test_number_props[0];
+	struct property *fixed1 = &property_test_number_props[1];
+	struct property *fixed9 = &property_test_number_props[2];
+	struct property *float0 = &property_test_number_props[3];
+	struct property *float2 = &property_test_number_props[4];
+	struct property *float9 = &property_test_number_props[5];
+	struct property_test_state copy;
+	char buf[PROPERTY_FORMAT_LEN];
+
+	/* Property types are found by name */
+	ok ( property_type_find ( "integer" ) == &integer_property );
+	ok ( property_type_find ( "blob" ) == &blob_property );
+	ok ( property_type_find ( "C/F/K" ) == &temperature_units_property );
+	ok ( property_type_find ( "int" ) == NULL );
+
+	/* Array parsing is staged within the copy */
+	property_parse_ok ( array, "1,2,3", 0, "1,2,3" );
+	property_parse_ok ( array, "-7", 0, "-7" );
+	property_parse_ok ( array, "", 0, "" );
+	property_parse_ok ( array, "1,2,3,4,5", -ERANGE, NULL );
+	property_parse_ok ( array, "1,2,", -EINVAL, NULL );
+	property_parse_ok ( array, "1,,2", -EINVAL, NULL );
+	property_parse_ok ( array, "1;2", -EINVAL, NULL );
+
+	/* Blob parsing is staged within the copy */
+	property_parse_ok ( blob, "c0ffee", 0, "c0ffee" );
+	property_parse_ok ( blob, "c0ffee0", -EINVAL, NULL );
+	property_parse_ok ( blob, "0123456789", -ERANGE, NULL );
+
+	/* Staged values are committed by a successful update */
+	memcpy ( &copy, resource_retrieve ( res ), sizeof ( copy ) );
+	ok ( property_parse ( array, "4,5,6", &copy ) == 0 );
+	ok ( property_parse ( blob, "0badcafe", &copy ) == 0 );
+	ok ( property_parse ( array, "7,8", &copy ) == 0 );
+	ok ( resource_update ( res, &copy ) == 0 );
+	ok ( copy.array.staged == NULL );
+	ok ( property_test_state.array.staged == NULL );
+	ok ( property_test_state.array.data == property_test_elements );
+	ok ( property_test_elements[0] == 7 );
+	ok ( property_test_elements[1] == 8 );
+	property_format ( array, buf, sizeof ( buf ), &property_test_state );
+	ok ( strcmp ( buf, "7,8" ) == 0 );
+	property_format ( blob, buf, sizeof ( buf ), &property_test_state );
+	ok ( strcmp ( buf, "0badcafe" ) == 0 );
+
+	/* Parts resume from the hinted element */
+	memcpy ( &copy, resource_retrieve ( res ), sizeof ( copy ) );
+	ok ( property_parse ( array, "-1000,2000,-300000,4", &copy ) == 0 );
+	ok ( property_parse ( blob, "01020304", &copy ) == 0 );
+	ok ( resource_update ( res, &copy ) == 0 );
+	property_part_ok ( array, &property_test_state, 2 );
+	property_part_ok ( array, &property_test_state, 3 );
+	property_part_ok ( array, &property_test_state, 7 );
+	property_part_ok ( blob, &property_test_state, 4 );
+
+	/* Rejected updates leave the resource untouched */
+	memcpy ( &copy, resource_retrieve ( res ), sizeof ( copy ) );
+	ok ( property_parse ( array, "5,6,7", &copy ) == 0 );
+	ok ( property_parse ( blob, "ff", &copy ) == 0 );
+	property_test_reject = -EPERM;
+	ok ( resource_update ( res, &copy ) == -EPERM );
+	property_test_reject = 0;
+	ok ( copy.array.staged == NULL );
+	ok ( copy.blob.staged == NULL );
+	ok ( property_test_state.array.count == 4 );
+	ok ( property_test_elements[0] == -1000 );
+	ok ( property_test_bytes[0] == 0x01 );
+
+	/* Abandoned copies leave the resource untouched */
+	memcpy ( &copy, resource_retrieve ( res ), sizeof ( copy ) );
+	ok ( property_parse ( array, "9", &copy ) == 0 );
+	ok ( property_parse ( blob, "xx", &copy ) == -EINVAL );
+	resource_discard ( res, &copy );
+	ok ( copy.array.staged == NULL );
+	ok ( property_test_elements[0] == -1000 );
+
+	/* Fixed-point values round to the property's scale */
+	property_number_ok ( fixed0, "42", 0, "42" );
+	property_number_ok ( fixed0, "-42", 0, "-42" );
+	property_number_ok ( fixed0, "+7", 0, "7" );
+	property_number_ok ( fixed0, "1.4", 0, "1" );
+	property_number_ok ( fixed0, "1.5", 0, "2" );
+	property_number_ok ( fixed0, "-1.5", 0, "-2" );
+	property_number_ok ( fixed1, "21.5", 0, "21.5" );
+	property_number_ok ( fixed1, "21", 0, "21.0" );
+	property_number_ok ( fixed1, "5.", 0, "5.0" );
+	property_number_ok ( fixed1, ".5", 0, "0.5" );
+	property_number_ok ( fixed1, "-0.5", 0, "-0.5" );
+	property_number_ok ( fixed1, "21.54", 0, "21.5" );
+	property_number_ok ( fixed1, "21.55", 0, "21.6" );
+	property_number_ok ( fixed1, "-21.59", 0, "-21.6" );
+	property_number_ok ( fixed9, "0.000000001", 0, "0.000000001" );
+	property_number_ok ( fixed9, "0.0000000005", 0, "0.000000001" );
+	property_number_ok ( fixed9, "0.0000000004", 0, "0.000000000" );
+
+	/* Fixed-point values are limited by the property's scale */
+	property_number_ok ( fixed0, "2147483647", 0, "2147483647" );
+	property_number_ok ( fixed0, "-2147483648", 0, "-2147483648" );
+	property_number_ok ( fixed0, "2147483648", -ERANGE, NULL );
+	property_number_ok ( fixed0, "-2147483649", -ERANGE, NULL );
+	property_number_ok ( fixed1, "214748364.7", 0, "214748364.7" );
+	property_number_ok ( fixed1, "214748364.75", -ERANGE, NULL );
+	property_number_ok ( fixed9, "2.147483647", 0, "2.147483647" );
+	property_number_ok ( fixed9, "-2.147483648", 0, "-2.147483648" );
+	property_number_ok ( fixed9, "2.147483648", -ERANGE, NULL );
+	property_number_ok ( fixed9, "3", -ERANGE, NULL );
+	property_number_ok ( fixed0, "99999999999999999999", -ERANGE, NULL );
+
+	/* Malformed fixed-point values are rejected */
+	property_number_ok ( fixed1, "", -EINVAL, NULL );
+	property_number_ok ( fixed1, "-", -EINVAL, NULL );
+	property_number_ok ( fixed1, ".", -EINVAL, NULL );
+	property_number_ok ( fixed1, "abc", -EINVAL, NULL );
+	property_number_ok ( fixed1, "1.2.3", -EINVAL, NULL );
+	property_number_ok ( fixed1, "1e3", -EINVAL, NULL );
+	property_number_ok ( fixed1, "--1", -EINVAL, NULL );
+	property_number_ok ( fixed1, "1 ", -EINVAL, NULL );
+
+	/* Floating-point values round to the property's scale */
+	property_number_ok ( float0, "42", 0, "42" );
+	property_number_ok ( float0, "1e3", 0, "1000" );
+	property_number_ok ( float0, "-2.5", 0, "-3" );
+	property_number_ok ( float2, "21.5", 0, "21.50" );
+	property_number_ok ( float2, "-21.5", 0, "-21.50" );
+	property_number_ok ( float2, "0.125", 0, "0.13" );
+	property_number_ok ( float2, "-0.125", 0, "-0.13" );
+	property_number_ok ( float2, "-0.004", 0, "0.00" );
+	property_number_ok ( float9, "0.5", 0, "0.500000000" );
+	property_number_ok ( float9, "-0.25", 0, "-0.250000000" );
+
+	/* Non-finite floating-point values */
+	property_number_ok ( float2, "nan", 0, "nan" );
+	property_number_ok ( float2, "inf", 0, "inf" );
+	property_number_ok ( float2, "-inf", 0, "-inf" );
+	property_number_ok ( float2, "INFINITY", 0, "inf" );
+
+	/* Malformed or unrepresentable floating-point values are rejected */
+	property_number_ok ( float2, "", -EINVAL, NULL );
+	property_number_ok ( float2, "abc", -EINVAL, NULL );
+	property_number_ok ( float2, "1.5x", -EINVAL, NULL );
+	property_number_ok ( float2, "1e", -EINVAL, NULL );
+	property_number_ok ( float2, "1e39", -ERANGE, NULL );
+	property_number_ok ( float2, "-1e39", -ERANGE, NULL );
+
+	/* Large values use an exponent and a mantissa of no more
+	 * than FLT_DECIMAL_DIG digits, and reproduce the exact value.
+	 */
+	property_float_ok ( float0, 1e17f, "99999998430674944" );
+	property_float_ok ( float0, 1e18f, "999999984e9" );
+	property_float_ok ( float0, -1e20f, "-100000002e12" );
+	property_float_ok ( float0, 1.5e30f, "149999995e22" );
+	property_float_ok ( float0, 2.5e18f, "25e17" );
+	property_float_ok ( float0, FLT_MAX, "340282347e30" );
+	property_float_ok ( float0, -FLT_MAX, "-340282347e30" );
+	property_number_ok ( float2, "1e16", 0, "100000003e8" );
+	property_number_ok ( float9, "1e9", 0, "1e9" );
+	property_number_ok ( float9, "-1e9", 0, "-1e9" );
+}
+
+/** Property self-tests */
+struct self_test property_test __self_test = {
+	.name = "property",
+	.exec = property_test_exec,
+};
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * State replication self-tests
+ *
+ * These tests connect a primary and a standby endpoint within the
+ * same process, replicating one namespace onto another.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <uniport/replica.h>
+#include <uniport/timer.h>
+#include <uniport/test.h>
+
+/** Time to wait for replication to complete (in milliseconds) */
+#define REPLICA_TEST_WAIT_MS 1000
+
+/** Time to wait for the absence of an acknowledgement (in milliseconds) */
+#define REPLICA_TEST_QUIET_MS 200
+
+/** Replication test resource state */
+struct replica_test_state {
+	/** Value */
+	int value;
+};
+
+/** Replication test resource */
+struct replica_test_resource {
+	/** Resource */
+	struct resource res;
+	/** Current state */
+	struct replica_test_state state;
+};
+
+/** Replication test properties */
+static struct property replica_test_props[] = {
+	PROPERTY_INTEGER ( "value", struct replica_test_state, value,
+			   PROP_RW ),
+};
+
+/**
+ * Retrieve replication test resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct replica_test_state *
+replica_test_retrieve ( struct resource *res ) {
+	struct replica_test_resource *test =
+		container_of ( res, struct replica_test_resource, res );
+
+	return &test->state;
+}
+
+/**
+ * Update replication test resource state
+ *
+ * @v res		Resource
+ * @v state		New resource state
+ * @ret rc		Return status code
+ *
+ * Negative values are rejected, to allow entries to fail to apply.
+ */
+static int replica_test_update ( struct resource *res,
+				 const struct replica_test_state *state ) {
+	struct replica_test_resource *test =
+		container_of ( res, struct replica_test_resource, res );
+
+	if ( state->value < 0 )
+		return -EINVAL;
+	test->state.value = state->value;
+	return 0;
+}
+
+/** Replication test resource descriptor */
+static const struct resource_descriptor replica_test_desc =
+	RESOURCE_DESC ( struct replica_test_state, replica_test_props,
+			replica_test_retrieve, replica_test_update, NULL );
+
+/** Primary test resource */
+static struct replica_test_resource replica_test_primary = {
+	.res = {
+		.uri = "value",
+		.desc = &replica_test_desc,
+		.observers = OBSERVERS_INIT ( replica_test_primary.res ),
+	},
+	.state = {
+		.value = 5,
+	},
+};
+
+/** Standby test resource */
+static struct replica_test_resource replica_test_standby = {
+	.res = {
+		.uri = "value",
+		.desc = &replica_test_desc,
+		.observers = OBSERVERS_INIT ( replica_test_standby.res ),
+	},
+};
+
+/** Primary test resources */
+static struct resource *replica_test_primary_res[] = {
+	&replica_test_primary.res,
+	NULL
+};
+
+/** Standby test resources */
+static struct resource *replica_test_standby_res[] = {
+	&replica_test_standby.res,
+	NULL
+};
+
+/** Primary test namespace */
+static struct namespace replica_test_primary_ns = {
+	.uri = "/rp/",
+	.resources = replica_test_primary_res,
+};
+
+/** Standby test namespace */
+static struct namespace replica_test_standby_ns = {
+	.uri = "/rs/",
+	.resources = replica_test_standby_res,
+};
+
+/** Primary test endpoint */
+static struct replica replica_test_primary_ep;
+
+/** Standby test endpoint */
+static struct replica replica_test_standby_ep;
+
+/** Replication test load generator is running */
+static volatile int replica_test_running;
+
+/**
+ * Update primary test resource
+ *
+ * @v value		New value
+ * @ret rc		Return status code
+ */
+static int replica_test_set ( int value ) {
+	struct replica_test_state state = { .value = value };
+
+	return resource_update ( &replica_test_primary.res, &state );
+}
+
+/**
+ * Wait for primary to receive acknowledgement of all entries
+ *
+ * @v primary		Primary endpoint
+ * @v wait		Time to wait (in milliseconds)
+ * @ret acked		All entries were acknowledged
+ */
+static int replica_test_acked ( struct replica *primary, unsigned int wait ) {
+	unsigned int i;
+	int acked;
+
+	for ( i = 0 ; i < wait ; i++ ) {
+		pthread_mutex_lock ( &primary->chan.lock );
+		acked = ( primary->acked == primary->seq );
+		pthread_mutex_unlock ( &primary->chan.lock );
+		if ( acked )
+			return 1;
+		usleep ( 1000 );
+	}
+	return 0;
+}
+
+/**
+ * Wait for standby to receive a further checkpoint
+ *
+ * @v standby		Standby endpoint
+ * @v checkpoints	Number of checkpoints already received
+ * @ret received	Checkpoint was received
+ */
+static int replica_test_checkpointed ( struct replica *standby,
+				       unsigned long checkpoints ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < REPLICA_TEST_WAIT_MS ; i++ ) {
+		if ( standby->stats.checkpoints != checkpoints )
+			return 1;
+		usleep ( 1000 );
+	}
+	return 0;
+}
+
+/**
+ * Force checkpoint and wait for standby to receive it
+ *
+ * @v primary		Primary endpoint
+ * @v standby		Standby endpoint
+ * @ret received	Checkpoint was received
+ */
+static int replica_test_checkpoint ( struct replica *primary,
+				     struct replica *standby ) {
+	unsigned long checkpoints = standby->stats.checkpoints;
+
+	pthread_mutex_lock ( &primary->chan.lock );
+	primary->resync = 1;
+	pthread_mutex_unlock ( &primary->chan.lock );
+	return replica_test_checkpointed ( standby, checkpoints );
+}
+
+/**
+ * Generate a continuous stream of updates
+ *
+ * @v arg		Unused
+ * @ret result		Result (unused)
+ */
+static void * replica_test_load ( void *arg __unused ) {
+	int value = 0;
+
+	while ( replica_test_running )
+		replica_test_set ( value++ & 0xffff );
+	return NULL;
+}
+
+/**
+ * Perform state replication self-tests
+ *
+ */
+static void replica_test_exec ( void ) {
+	static struct resource *resources[] = { &replica_test_primary.res };
+	struct replica *primary = &replica_test_primary_ep;
+	struct replica *standby = &replica_test_standby_ep;
+	pthread_t load;
+	uint32_t seq;
+	int fds[2];
+
+	/* Register test resources */
+	ok ( resource_register ( &replica_test_primary_ns ) == 0 );
+	ok ( resource_register ( &replica_test_standby_ns ) == 0 );
+
+	/* Connect endpoints */
+	ok ( socketpair ( AF_UNIX, SOCK_STREAM, 0, fds ) == 0 );
+	standby->standby = 1;
+	standby->from = "/rp/";
+	standby->to = "/rs/";
+	primary->interval = ( 3600 * TICKS_PER_SEC );
+	primary->resources = resources;
+	primary->count = 1;
+	ok ( replica_open ( standby, fds[1] ) == 0 );
+	ok ( replica_open ( primary, fds[0] ) == 0 );
+
+	/* Initial checkpoint brings the standby up to date */
+	ok ( replica_test_checkpointed ( standby, 0 ) );
+	ok ( replica_test_acked ( primary, REPLICA_TEST_WAIT_MS ) );
+	ok ( replica_test_standby.state.value == 5 );
+
+	/* Updates are applied and acknowledged */
+	ok ( replica_test_set ( 9 ) == 0 );
+	ok ( replica_test_acked ( primary, REPLICA_TEST_WAIT_MS ) );
+	ok ( replica_test_standby.state.value == 9 );
+	ok ( primary->acked == standby->seq );
+
+	/* An entry that fails to apply is never acknowledged, and
+	 * neither is any subsequent entry until a clean checkpoint.
+	 */
+	seq = standby->seq;
+	replica_test_primary.state.value = -1;
+	ok ( replica_test_checkpoint ( primary, standby ) );
+	ok ( standby->stats.failed == 1 );
+	ok ( standby->seq == seq );
+	ok ( replica_test_set ( 3 ) == 0 );
+	ok ( ! replica_test_acked ( primary, REPLICA_TEST_QUIET_MS ) );
+	ok ( replica_test_standby.state.value == 3 );
+	ok ( standby->seq == seq );
+
+	/* A complete checkpoint without failures restores agreement */
+	ok ( replica_test_checkpoint ( primary, standby ) );
+	ok ( replica_test_acked ( primary, REPLICA_TEST_WAIT_MS ) );
+	ok ( standby->seq == primary->seq );
+
+	replica_close ( primary );
+	replica_close ( standby );
+
+	/* A zero checkpoint interval is rejected */
+	ok ( system ( "replica -k 0 -p 15690 /rp/*" ) != 0 );
+
+	/* Endpoints may be stopped while updates are being recorded */
+	ok ( system ( "replica -l -p 15690 -m /rp/=/rs/" ) == 0 );
+	ok ( system ( "replica -p 15690 /rp/*" ) == 0 );
+	replica_test_running = 1;
+	ok ( pthread_create ( &load, NULL, replica_test_load, NULL ) == 0 );
+	usleep ( 50000 );
+	ok ( system ( "replica -d" ) == 0 );
+	usleep ( 10000 );
+	replica_test_running = 0;
+	pthread_join ( load, NULL );
+	ok ( system ( "replica -l -d" ) == 0 );
+
+	resource_unregister ( &replica_test_standby_ns );
+	resource_unregister ( &replica_test_primary_ns );
+}
+
+/** State replication self-tests */
+struct self_test replica_test __self_test = {
+	.name = "replica",
+	.exec = replica_test_exec,
+};
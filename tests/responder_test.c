@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+
+/** @file
+ *
+ * Multicast discovery responder self-tests
+ *
+ * These tests use multicast loopback on the local host, and so
+ * require only a loopback interface.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <uniport/responder.h>
+#include <uniport/test.h>
+
+/** Port used for responder self-tests */
+#define RESPONDER_TEST_PORT 15683
+
+/** Time to wait for responses (in milliseconds) */
+#define RESPONDER_TEST_WAIT_MS 200
+
+/** Responder self-test load generator is running */
+static volatile int responder_test_running;
+
+/**
+ * Send discovery query and count links in responses
+ *
+ * @v query		Query
+ * @v wait		Time to wait for responses (in milliseconds)
+ * @ret links		Number of links received, or negative error
+ */
+static int responder_test_query ( const char *query, unsigned int wait ) {
+	struct sockaddr_in addr;
+	struct in_addr local;
+	struct pollfd pfd;
+	char buf[ RESPONDER_RESPONSE_LEN + 1 /* NUL */ ];
+	unsigned char loop = 1;
+	int links = 0;
+	ssize_t len;
+	ssize_t i;
+	int fd;
+
+	/* Open socket */
+	fd = socket ( AF_INET, SOCK_DGRAM, 0 );
+	if ( fd < 0 )
+		return -1;
+	inet_aton ( "127.0.0.1", &local );
+	setsockopt ( fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop,
+		     sizeof ( loop ) );
+	setsockopt ( fd, IPPROTO_IP, IP_MULTICAST_IF, &local,
+		     sizeof ( local ) );
+
+	/* Send query */
+	memset ( &addr, 0, sizeof ( addr ) );
+	addr.sin_family = AF_INET;
+	inet_aton ( RESPONDER_GROUP, &addr.sin_addr );
+	addr.sin_port = htons ( RESPONDER_TEST_PORT );
+	if ( sendto ( fd, query, strlen ( query ), 0,
+		      ( struct sockaddr * ) &addr, sizeof ( addr ) ) < 0 ) {
+		close ( fd );
+		return -1;
+	}
+
+	/* Count links in responses */
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while ( poll ( &pfd, 1, wait ) > 0 ) {
+		len = recv ( fd, buf, ( sizeof ( buf ) - 1 /* NUL */ ), 0 );
+		for ( i = 0 ; i < len ; i++ )
+			links += ( buf[i] == '<' );
+	}
+
+	close ( fd );
+	return links;
+}
+
+/**
+ * Generate a continuous stream of discovery queries
+ *
+ * @v arg		Unused
+ * @ret result		Result (unused)
+ */
+static void * responder_test_load ( void *arg __unused ) {
+	char query[64];
+	unsigned int i = 0;
+
+	while ( responder_test_running ) {
+		snprintf ( query, sizeof ( query ),
+			   "/oic/res?href=/sim*&n=%u", i++ );
+		responder_test_query ( query, 1 );
+	}
+	return NULL;
+}
+
+/**
+ * Perform multicast discovery responder self-tests
+ *
+ */
+static void responder_test_exec ( void ) {
+	pthread_t load;
+
+	/* Create a world with one responder per namespace */
+	ok ( system ( "sim -n 2 -r 4" ) == 0 );
+	ok ( system ( "respond -e -j 0 -l 127.0.0.1 -p 15683 /sim*" ) == 0 );
+	ok ( responder_test_query ( "/oic/res?href=/sim1/*",
+				    RESPONDER_TEST_WAIT_MS ) == 4 );
+	ok ( responder_test_query ( "/oic/res",
+				    RESPONDER_TEST_WAIT_MS ) == 8 );
+
+	/* Destroy the world while queries are being answered */
+	responder_test_running = 1;
+	ok ( pthread_create ( &load, NULL, responder_test_load, NULL ) == 0 );
+	usleep ( 50000 );
+	ok ( system ( "sim -d" ) == 0 );
+	usleep ( 50000 );
+	responder_test_running = 0;
+	pthread_join ( load, NULL );
+
+	/* Responders for the destroyed namespaces must have stopped */
+	ok ( responder_test_query ( "/oic/res",
+				    RESPONDER_TEST_WAIT_MS ) == 0 );
+
+	/* A responder for all resources must survive namespace churn */
+	ok ( system ( "respond -j 0 -l 127.0.0.1 -p 15683 /sim*" ) == 0 );
+	ok ( system ( "sim -n 3 -r 2" ) == 0 );
+	ok ( responder_test_query ( "/oic/res",
+				    RESPONDER_TEST_WAIT_MS ) == 6 );
+	responder_test_running = 1;
+	ok ( pthread_create ( &load, NULL, responder_test_load, NULL ) == 0 );
+	ok ( system ( "sim -d" ) == 0 );
+	ok ( system ( "sim -n 1 -r 3" ) == 0 );
+	responder_test_running = 0;
+	pthread_join ( load, NULL );
+	ok ( responder_test_query ( "/oic/res",
+				    RESPONDER_TEST_WAIT_MS ) == 3 );
+	ok ( system ( "sim -d" ) == 0 );
+
+	ok ( system ( "respond -d" ) == 0 );
+
+	/* A failure to start must leave no responders running */
+	ok ( system ( "respond -e -j 0 -l 192.0.2.1 -p 15683" ) != 0 );
+	ok ( responder_test_query ( "/oic/res",
+				    RESPONDER_TEST_WAIT_MS ) == 0 );
+}
+
+/** Multicast discovery responder self-tests */
+struct self_test responder_test __self_test = {
+	.name = "responder",
+	.exec = responder_test_exec,
+};
@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Rule engine self-tests
+ *
+ * Conditions are compiled against a trigger resource, and the result
+ * of evaluating each condition against the trigger's current state is
+ * read back from the rule's "active" status.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <uniport/rule.h>
+#include <uniport/temperature.h>
+#include <uniport/command.h>
+#include <uniport/test.h>
+
+/** Rule test trigger resource state */
+struct rule_test_input {
+	/** Boolean */
+	bool b;
+	/** Integer */
+	int i;
+	/** Fixed-point value (in tenths) */
+	int f;
+	/** Temperature units */
+	enum temperature_units u;
+	/** Name */
+	const char *s;
+};
+
+/** Rule test target resource state */
+struct rule_test_output {
+	/** Value */
+	int value;
+};
+
+/** Rule test trigger resource state */
+static struct rule_test_input rule_test_input;
+
+/** Rule test target resource state */
+static struct rule_test_output rule_test_output;
+
+/** Number of trigger resource updates */
+static unsigned int rule_test_input_updates;
+
+/** Number of target resource updates */
+static unsigned int rule_test_output_updates;
+
+/** Rule test trigger resource properties */
+static struct property rule_test_input_props[] = {
+	PROPERTY_BOOLEAN ( "b", struct rule_test_input, b, PROP_RW ),
+	PROPERTY_INTEGER ( "i", struct rule_test_input, i, PROP_RW ),
+	PROPERTY_FIXED ( "f", struct rule_test_input, f, 1, PROP_RW ),
+	PROPERTY_TEMPERATURE_UNITS ( "u", struct rule_test_input, u,
+				     PROP_RW ),
+	PROPERTY_STRING ( "s", struct rule_test_input, s, 0 ),
+};
+
+/** Rule test target resource properties */
+static struct property rule_test_output_props[] = {
+	PROPERTY_INTEGER ( "value", struct rule_test_output, value, PROP_RW ),
+};
+
+/**
+ * Retrieve rule test trigger resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct rule_test_input *
+rule_test_input_retrieve ( struct resource *res __unused ) {
+
+	return &rule_test_input;
+}
+
+/**
+ * Update rule test trigger resource state
+ *
+ * @v res		Resource
+ * @v state		New resource state
+ * @ret rc		Return status code
+ */
+static int rule_test_input_update ( struct resource *res,
+				    const struct rule_test_input *state ) {
+
+	memcpy ( &rule_test_input, state, sizeof ( rule_test_input ) );
+	rule_test_input_updates++;
+	resource_notify ( res );
+	return 0;
+}
+
+/**
+ * Retrieve rule test target resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct rule_test_output *
+rule_test_output_retrieve ( struct resource *res __unused ) {
+
+	return &rule_test_output;
+}
+
+/**
+ * Update rule test target resource state
+ *
+ * @v res		Resource
+ * @v state		New resource state
+ * @ret rc		Return status code
+ */
+static int rule_test_output_update ( struct resource *res,
+				     const struct rule_test_output *state ) {
+
+	memcpy ( &rule_test_output, state, sizeof ( rule_test_output ) );
+	rule_test_output_updates++;
+	resource_notify ( res );
+	return 0;
+}
+
+/** Rule test trigger resource descriptor */
+static const struct resource_descriptor rule_test_input_desc =
+	RESOURCE_DESC ( struct rule_test_input, rule_test_input_props,
+			rule_test_input_retrieve, rule_test_input_update,
+			NULL );
+
+/** Rule test target resource descriptor */
+static const struct resource_descriptor rule_test_output_desc =
+	RESOURCE_DESC ( struct rule_test_output, rule_test_output_props,
+			rule_test_output_retrieve, rule_test_output_update,
+			NULL );
+
+/** Rule test trigger resource */
+static struct resource rule_test_input_res = {
+	.uri = "in",
+	.desc = &rule_test_input_desc,
+	.observers = OBSERVERS_INIT ( rule_test_input_res ),
+};
+
+/** Rule test target resource */
+static struct resource rule_test_output_res = {
+	.uri = "out",
+	.desc = &rule_test_output_desc,
+	.observers = OBSERVERS_INIT ( rule_test_output_res ),
+};
+
+/** Rule test resources */
+static struct resource *rule_test_resources[] = {
+	&rule_test_input_res,
+	&rule_test_output_res,
+	NULL
+};
+
+/** Rule test namespace */
+static struct namespace rule_test_ns = {
+	.uri = "/rt/",
+	.resources = rule_test_resources,
+};
+
+/**
+ * Execute command, discarding its output
+ *
+ * @v command		Command line
+ * @ret rc		Return status code
+ */
+static int rule_test_system ( const char *command ) {
+	FILE *out;
+	int rc;
+
+	out = fopen ( "/dev/null", "w" );
+	if ( ! out )
+		return -errno;
+	rc = fsystem ( out, command );
+	fclose ( out );
+	return rc;
+}
+
+/**
+ * Get rule status field
+ *
+ * @v name		Rule name
+ * @v field		Field name (including the trailing "=")
+ * @ret value		Field value, or -1 on error
+ */
+static long rule_test_status ( const char *name, const char *field ) {
+	char command[64];
+	char *buf = NULL;
+	size_t len = 0;
+	char *value;
+	long result = -1;
+	FILE *out;
+
+	snprintf ( command, sizeof ( command ), "rule %s", name );
+	out = open_memstream ( &buf, &len );
+	if ( ! out )
+		return -1;
+	if ( ( fsystem ( out, command ) == 0 ) &&
+	     ( ( value = strstr ( buf, field ) ) != NULL ) ) {
+		result = strtol ( ( value + strlen ( field ) ), NULL, 10 );
+	}
+	fclose ( out );
+	free ( buf );
+	return result;
+}
+
+/**
+ * Report a rule condition test result
+ *
+ * @v condition		Condition
+ * @v expected_rc	Expected return status code
+ * @v expected		Expected result of evaluating the condition
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The rule is created against the trigger's current state, which
+ * evaluates the condition, and is then deleted.
+ */
+static void rule_condition_okx ( const char *condition, int expected_rc,
+				 int expected, const char *file,
+				 unsigned int line ) {
+	char command[128];
+	int rc;
+
+	snprintf ( command, sizeof ( command ),
+		   "rule cond /rt/in %s /rt/out value=1", condition );
+	rc = rule_test_system ( command );
+	okx ( rc == expected_rc, file, line );
+	if ( rc != 0 )
+		return;
+	okx ( rule_test_status ( "cond", "active=" ) == expected, file, line );
+	okx ( rule_test_system ( "rule -d cond" ) == 0, file, line );
+}
+#define rule_condition_ok( condition, expected_rc, expected )		\
+	rule_condition_okx ( condition, expected_rc, expected,		\
+			     __FILE__, __LINE__ )
+
+/**
+ * Perform rule engine self-tests
+ *
+ */
+static void rule_test_exec ( void ) {
+
+	/* Register resources */
+	memset ( &rule_test_input, 0, sizeof ( rule_test_input ) );
+	rule_test_input.b = true;
+	rule_test_input.i = 3;
+	rule_test_input.f = 215;
+	rule_test_input.u = TEMPERATURE_UNITS_F;
+	rule_test_input.s = "name";
+	ok ( resource_register ( &rule_test_ns ) == 0 );
+
+	/* Comparison opcodes */
+	rule_condition_ok ( "i==3", 0, 1 );
+	rule_condition_ok ( "i==4", 0, 0 );
+	rule_condition_ok ( "i!=3", 0, 0 );
+	rule_condition_ok ( "i!=4", 0, 1 );
+	rule_condition_ok ( "i<4", 0, 1 );
+	rule_condition_ok ( "i<3", 0, 0 );
+	rule_condition_ok ( "i<=3", 0, 1 );
+	rule_condition_ok ( "i<=2", 0, 0 );
+	rule_condition_ok ( "i>2", 0, 1 );
+	rule_condition_ok ( "i>3", 0, 0 );
+	rule_condition_ok ( "i>=3", 0, 1 );
+	rule_condition_ok ( "i>=4", 0, 0 );
+	rule_condition_ok ( "i>-1", 0, 1 );
+	rule_condition_ok ( "i", 0, 1 );
+
+	/* Literals are parsed by the property's own parser */
+	rule_condition_ok ( "b==true", 0, 1 );
+	rule_condition_ok ( "b==false", 0, 0 );
+	rule_condition_ok ( "f==21.5", 0, 1 );
+	rule_condition_ok ( "f>21.4", 0, 1 );
+	rule_condition_ok ( "f<21", 0, 0 );
+	rule_condition_ok ( "u==Fahrenheit", 0, 1 );
+	rule_condition_ok ( "u!=degF", 0, 0 );
+	rule_condition_ok ( "u==K", 0, 0 );
+
+	/* Precedence of "!", "&&", "||" and parentheses */
+	rule_condition_ok ( "!b", 0, 0 );
+	rule_condition_ok ( "!!b", 0, 1 );
+	rule_condition_ok ( "!b||i==3", 0, 1 );
+	rule_condition_ok ( "!(b||i==3)", 0, 0 );
+	rule_condition_ok ( "b||i==4&&f>100", 0, 1 );
+	rule_condition_ok ( "(b||i==4)&&f>100", 0, 0 );
+	rule_condition_ok ( "i==4&&b||f==21.5", 0, 1 );
+	rule_condition_ok ( "i==4&&(b||f==21.5)", 0, 0 );
+	rule_condition_ok ( "!(i<3)&&(u==F)", 0, 1 );
+
+	/* Invalid conditions */
+	rule_condition_ok ( "x==1", -ENOENT, 0 );
+	rule_condition_ok ( "s==name", -ENOTSUP, 0 );
+	rule_condition_ok ( "i==abc", -EINVAL, 0 );
+	rule_condition_ok ( "b==maybe", -EINVAL, 0 );
+	rule_condition_ok ( "i==", -EINVAL, 0 );
+	rule_condition_ok ( "(i==3", -EINVAL, 0 );
+	rule_condition_ok ( "i==3)", -EINVAL, 0 );
+	rule_condition_ok ( "i&&(i&&(i&&(i&&(i&&(i&&(i&&(i&&i)))))))",
+			    -E2BIG, 0 );
+	rule_condition_ok ( "i==1||i==2||i==3||i==4||i==5||i==6||i==7",
+			    -E2BIG, 0 );
+	ok ( rule_test_system ( "rule bad /rt/in i /rt/out value=x" ) ==
+	     -EINVAL );
+	ok ( rule_test_system ( "rule bad /rt/in i /rt/in s=x" ) == -EROFS );
+
+	/* Action fires only on false to true edges */
+	rule_test_input.i = 0;
+	rule_test_output_updates = 0;
+	ok ( rule_test_system ( "rule edge /rt/in i>5 /rt/out value=7" ) ==
+	     0 );
+	resource_notify ( &rule_test_input_res );
+	ok ( rule_test_output_updates == 0 );
+	rule_test_input.i = 6;
+	resource_notify ( &rule_test_input_res );
+	ok ( rule_test_output_updates == 1 );
+	ok ( rule_test_output.value == 7 );
+	rule_test_input.i = 9;
+	resource_notify ( &rule_test_input_res );
+	ok ( rule_test_output_updates == 1 );
+	rule_test_input.i = 0;
+	resource_notify ( &rule_test_input_res );
+	ok ( rule_test_output_updates == 1 );
+	rule_test_input.i = 8;
+	resource_notify ( &rule_test_input_res );
+	ok ( rule_test_output_updates == 2 );
+	ok ( rule_test_status ( "edge", "evaluations=" ) == 5 );
+	ok ( rule_test_status ( "edge", "fired=" ) == 2 );
+	ok ( rule_test_system ( "rule -d edge" ) == 0 );
+
+	/* Rule ignores notifications caused by its own update */
+	rule_test_input.i = 0;
+	rule_test_input_updates = 0;
+	ok ( rule_test_system ( "rule self /rt/in i>5 /rt/in b=false" ) ==
+	     0 );
+	rule_test_input.i = 6;
+	resource_notify ( &rule_test_input_res );
+	ok ( rule_test_input_updates == 1 );
+	ok ( ! rule_test_input.b );
+	ok ( rule_test_status ( "self", "evaluations=" ) == 1 );
+	ok ( rule_test_status ( "self", "fired=" ) == 1 );
+
+	/* Rules are removed with their namespace */
+	resource_unregister ( &rule_test_ns );
+	ok ( rule_test_status ( "self", "active=" ) == -1 );
+}
+
+/** Rule engine self-test */
+struct self_test rule_test __self_test = {
+	.name = "rule",
+	.exec = rule_test_exec,
+};
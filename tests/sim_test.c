@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Simulated device self-tests
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <uniport/resource.h>
+#include <uniport/cli.h>
+#include <uniport/test.h>
+
+/**
+ * Perform simulated device self-tests
+ *
+ */
+static void sim_test_exec ( void ) {
+
+	/* Create and populate a world */
+	ok ( system ( "sim -n 4 -r 16 -m stua -o" ) == 0 );
+	ok ( resource_find ( "/sim0/r0" ) != NULL );
+	ok ( resource_find ( "/sim3/r15" ) != NULL );
+	ok ( resource_find ( "/sim4/r0" ) == NULL );
+	ok ( system ( "observe /sim0/r0" ) == 0 );
+	ok ( system ( "observe /sim3/r1" ) == 0 );
+	ok ( system ( "simload -c 1000 -u 30 -x 1" ) == 0 );
+
+	/* Destroy the world while still observed */
+	ok ( system ( "sim -d" ) == 0 );
+	ok ( resource_find ( "/sim0/r0" ) == NULL );
+	ok ( system ( "simload" ) != 0 );
+
+	/* Closing the session must not touch the destroyed resources */
+	cli_close ( stdout );
+
+	/* Recreate the world and check that no stale observers remain */
+	ok ( system ( "sim -n 4 -r 16 -m stua" ) == 0 );
+	ok ( system ( "observe /sim0/r0" ) == 0 );
+	ok ( system ( "simload -c 1000 -u 30" ) == 0 );
+	ok ( system ( "observe -d /sim0/r0" ) == 0 );
+	ok ( system ( "sim -d" ) == 0 );
+}
+
+/** Simulated device self-tests */
+struct self_test sim_test __self_test = {
+	.name = "sim",
+	.exec = sim_test_exec,
+};
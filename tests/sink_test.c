@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+/** @file
+ *
+ * Output sink self-tests
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <uniport/sink.h>
+#include <uniport/command.h>
+#include <uniport/test.h>
+
+/** Number of times the test command has been executed */
+static unsigned int sink_test_calls;
+
+/** Most recent argument count seen by the test command */
+static int sink_test_argc;
+
+/** Most recent final argument seen by the test command */
+static char sink_test_last[32];
+
+/**
+ * "sinktest" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int sink_test_cmd_exec ( int argc, char **argv ) {
+
+	sink_test_calls++;
+	sink_test_argc = argc;
+	snprintf ( sink_test_last, sizeof ( sink_test_last ), "%s",
+		   argv[ argc - 1 ] );
+	cprintf ( "%s\n", argv[ argc - 1 ] );
+	return 0;
+}
+
+/** "sinktest" command */
+struct command sink_test_command __command = {
+	.name = "sinktest",
+	.exec = sink_test_cmd_exec,
+};
+
+/**
+ * Perform output sink self-tests
+ *
+ */
+static void sink_test_exec ( void ) {
+	char *sink_argv[] = { "sink", "-m", "-n", "3", "--", "sinktest",
+			      "a b", NULL };
+	char *argv[] = { "sinktest", "x y", NULL };
+	struct memory_sink memsink;
+	char data[16];
+	FILE *null;
+
+	/* Memory sink collects command output */
+	ok ( sink_open_memory ( &memsink, data, sizeof ( data ) ) == 0 );
+	ok ( sink_execv ( &memsink.sink, argv ) == 0 );
+	ok ( memsink.len == 4 );
+	ok ( memcmp ( data, "x y\n", 4 ) == 0 );
+	ok ( sink_system ( &memsink.sink, "sinktest abcdefghijklmnop" ) == 0 );
+	ok ( memsink.len == sizeof ( data ) );
+	ok ( memcmp ( &data[4], "abcdefghijkl", 12 ) == 0 );
+	ok ( memsink.sink.stats.commands == 2 );
+	ok ( memsink.sink.stats.bytes == 21 );
+	sink_close ( &memsink.sink );
+
+	/* "sink" command passes arguments through without resplitting */
+	null = fopen ( "/dev/null", "w" );
+	ok ( null != NULL );
+	if ( ! null )
+		return;
+	sink_test_calls = 0;
+	ok ( fexecv ( null, sink_argv ) == 0 );
+	ok ( sink_test_calls == 3 );
+	ok ( sink_test_argc == 2 );
+	ok ( strcmp ( sink_test_last, "a b" ) == 0 );
+	fclose ( null );
+}
+
+/** Output sink self-test */
+struct self_test sink_test __self_test = {
+	.name = "sink",
+	.exec = sink_test_exec,
+};
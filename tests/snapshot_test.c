@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Resource state snapshot self-tests
+ *
+ * The reference image tests/data/snapshot.bin was saved from the
+ * test resources below by a little-endian LP64 host build.  It pins
+ * the image format: saving the same state must reproduce it exactly,
+ * and restoring it must recover the writable state.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <uniport/snapshot.h>
+#include <uniport/resource.h>
+#include <uniport/test.h>
+
+/** Snapshot test resource state */
+struct snapshot_test_state {
+	/** Writable integer */
+	int value;
+	/** Writable boolean */
+	bool enabled;
+	/** Read-only integer */
+	int count;
+	/** Read-only name */
+	const char *name;
+};
+
+/** Snapshot test writable resource state */
+static struct snapshot_test_state snapshot_test_rw = {
+	.name = "snapshot-rw",
+};
+
+/** Snapshot test read-only resource state */
+static struct snapshot_test_state snapshot_test_ro = {
+	.name = "snapshot-ro",
+};
+
+/** Snapshot test writable resource properties */
+static struct property snapshot_test_rw_props[] = {
+	PROPERTY_INTEGER ( "value", struct snapshot_test_state, value,
+			   PROP_RW ),
+	PROPERTY_BOOLEAN ( "enabled", struct snapshot_test_state, enabled,
+			   PROP_RW ),
+	PROPERTY_INTEGER ( "count", struct snapshot_test_state, count, 0 ),
+	PROPERTY_STRING ( "name", struct snapshot_test_state, name, 0 ),
+};
+
+/** Snapshot test read-only resource properties */
+static struct property snapshot_test_ro_props[] = {
+	PROPERTY_INTEGER ( "count", struct snapshot_test_state, count, 0 ),
+	PROPERTY_STRING ( "name", struct snapshot_test_state, name, 0 ),
+};
+
+/** Snapshot test update return status code */
+static int snapshot_test_rc;
+
+/**
+ * Retrieve snapshot test writable resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct snapshot_test_state *
+snapshot_test_rw_retrieve ( struct resource *res __unused ) {
+
+	return &snapshot_test_rw;
+}
+
+/**
+ * Retrieve snapshot test read-only resource state
+ *
+ * @v res		Resource
+ * @ret state		Resource state
+ */
+static const struct snapshot_test_state *
+snapshot_test_ro_retrieve ( struct resource *res __unused ) {
+
+	return &snapshot_test_ro;
+}
+
+/**
+ * Update snapshot test resource state
+ *
+ * @v res		Resource
+ * @v state		New resource state
+ * @ret rc		Return status code
+ */
+static int snapshot_test_update ( struct resource *res __unused,
+				  const struct snapshot_test_state *state ) {
+
+	if ( snapshot_test_rc )
+		return snapshot_test_rc;
+	memcpy ( &snapshot_test_rw, state, sizeof ( snapshot_test_rw ) );
+	return 0;
+}
+
+/** Snapshot test writable resource descriptor */
+static const struct resource_descriptor snapshot_test_rw_desc =
+	RESOURCE_DESC ( struct snapshot_test_state, snapshot_test_rw_props,
+			snapshot_test_rw_retrieve, snapshot_test_update,
+			NULL );
+
+/** Snapshot test resource descriptor with no writable properties */
+static const struct resource_descriptor snapshot_test_fixed_desc =
+	RESOURCE_DESC ( struct snapshot_test_state, snapshot_test_ro_props,
+			snapshot_test_ro_retrieve, snapshot_test_update,
+			NULL );
+
+/** Snapshot test resource descriptor with no update method */
+static const struct resource_descriptor snapshot_test_ro_desc =
+	RESOURCE_DESC ( struct snapshot_test_state, snapshot_test_rw_props,
+			snapshot_test_ro_retrieve, NULL, NULL );
+
+/** Snapshot test writable resource */
+static struct resource snapshot_test_rw_res = {
+	.uri = "rw",
+	.desc = &snapshot_test_rw_desc,
+	.observers = OBSERVERS_INIT ( snapshot_test_rw_res ),
+};
+
+/** Snapshot test resource with no writable properties */
+static struct resource snapshot_test_fixed_res = {
+	.uri = "fixed",
+	.desc = &snapshot_test_fixed_desc,
+	.observers = OBSERVERS_INIT ( snapshot_test_fixed_res ),
+};
+
+/** Snapshot test resource with no update method */
+static struct resource snapshot_test_ro_res = {
+	.uri = "ro",
+	.desc = &snapshot_test_ro_desc,
+	.observers = OBSERVERS_INIT ( snapshot_test_ro_res ),
+};
+
+/** Snapshot test resources */
+static struct resource *snapshot_test_res[] = {
+	&snapshot_test_rw_res,
+	&snapshot_test_fixed_res,
+	&snapshot_test_ro_res,
+	NULL
+};
+
+/** Snapshot test namespace */
+static struct namespace snapshot_test_ns = {
+	.uri = "/snap/",
+	.resources = snapshot_test_res,
+};
+
+/**
+ * Load reference snapshot image
+ *
+ * @v len		Length of image to fill in
+ * @ret image		Image (to be freed by the caller), or NULL on error
+ */
+static void * snapshot_test_load ( size_t *len ) {
+	char name[256];
+	FILE *file;
+	void *image;
+	long size;
+
+	snprintf ( name, sizeof ( name ), "%s/snapshot.bin", test_data );
+	file = fopen ( name, "rb" );
+	if ( ! file )
+		return NULL;
+	image = NULL;
+	if ( ( fseek ( file, 0, SEEK_END ) == 0 ) &&
+	     ( ( size = ftell ( file ) ) > 0 ) &&
+	     ( fseek ( file, 0, SEEK_SET ) == 0 ) &&
+	     ( ( image = malloc ( size ) ) != NULL ) &&
+	     ( fread ( image, size, 1, file ) != 1 ) ) {
+		free ( image );
+		image = NULL;
+	}
+	*len = ( image ? ( size_t ) size : 0 );
+	fclose ( file );
+	return image;
+}
+
+/**
+ * Perform snapshot self-tests
+ *
+ */
+static void snapshot_test_exec ( void ) {
+	const struct snapshot_header *hdr;
+	struct snapshot_record *record;
+	struct snapshot_value *value;
+	struct snapshot_stats stats;
+	void *corrupt;
+	char *saved = NULL;
+	size_t saved_len = 0;
+	void *image;
+	size_t len;
+	FILE *file;
+
+	/* Register test resources */
+	ok ( resource_register ( &snapshot_test_ns ) == 0 );
+	snapshot_test_rw.value = 42;
+	snapshot_test_rw.enabled = true;
+	snapshot_test_rw.count = 7;
+	snapshot_test_ro.count = 9;
+
+	/* Load reference image */
+	image = snapshot_test_load ( &len );
+	ok ( image != NULL );
+	if ( ! image )
+		goto err_load;
+
+	/* Save snapshot: only the writable resource is recorded */
+	file = open_memstream ( &saved, &saved_len );
+	ok ( file != NULL );
+	if ( ! file )
+		goto err_open;
+	ok ( snapshot_save ( file, "/snap/*", &stats ) == 0 );
+	ok ( fclose ( file ) == 0 );
+	ok ( stats.resources == 1 );
+	ok ( stats.skipped == 2 );
+	ok ( stats.failed == 0 );
+	ok ( stats.len == saved_len );
+
+	/* Saved image must match the reference image exactly, and so
+	 * must not contain any read-only values.
+	 */
+	ok ( saved_len == len );
+	ok ( ( saved_len == len ) && ( memcmp ( saved, image, len ) == 0 ) );
+	ok ( memmem ( saved, saved_len, "snapshot-", 9 ) == NULL );
+
+	/* Restore reference image over modified state */
+	snapshot_test_rw.value = -1;
+	snapshot_test_rw.enabled = false;
+	snapshot_test_rw.count = 3;
+	ok ( snapshot_restore ( image, len, &stats ) == 0 );
+	ok ( stats.resources == 1 );
+	ok ( stats.missing == 0 );
+	ok ( stats.mismatched == 0 );
+	ok ( stats.failed == 0 );
+	ok ( stats.len == len );
+	ok ( snapshot_test_rw.value == 42 );
+	ok ( snapshot_test_rw.enabled );
+	ok ( snapshot_test_rw.count == 3 );
+	ok ( strcmp ( snapshot_test_rw.name, "snapshot-rw" ) == 0 );
+
+	/* A rejected update is counted without aborting the restore */
+	snapshot_test_rw.value = -1;
+	snapshot_test_rc = -EINVAL;
+	ok ( snapshot_restore ( image, len, &stats ) == 0 );
+	ok ( stats.resources == 0 );
+	ok ( stats.failed == 1 );
+	ok ( stats.len == len );
+	ok ( snapshot_test_rw.value == -1 );
+	snapshot_test_rc = 0;
+
+	/* Malformed images must be rejected */
+	ok ( snapshot_restore ( image, 4, &stats ) == -EBADMSG );
+	ok ( snapshot_test_rw.value == -1 );
+	ok ( snapshot_restore ( image, ( len - 1 ), &stats ) == -EBADMSG );
+
+	/* A value referring to a nonexistent property is malformed */
+	corrupt = malloc ( len );
+	ok ( corrupt != NULL );
+	if ( corrupt ) {
+		memcpy ( corrupt, image, len );
+		hdr = corrupt;
+		record = ( corrupt + hdr->len );
+		value = ( ( ( void * ) record ) +
+			  ( ( sizeof ( *record ) + record->uri_len +
+			      1 /* NUL */ + SNAPSHOT_ALIGN - 1 ) &
+			    ~( SNAPSHOT_ALIGN - 1 ) ) );
+		value->index = 0xffff;
+		snapshot_test_rw.value = -1;
+		ok ( snapshot_restore ( corrupt, len, &stats ) == -EBADMSG );
+		ok ( snapshot_test_rw.value == -1 );
+		free ( corrupt );
+	}
+
+	free ( saved );
+ err_open:
+	free ( image );
+ err_load:
+	resource_unregister ( &snapshot_test_ns );
+}
+
+/** Snapshot self-test */
+struct self_test snapshot_test __self_test = {
+	.name = "snapshot",
+	.exec = snapshot_test_exec,
+};
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+
+/** @file
+ *
+ * Temperature conversion self-tests
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <uniport/temperature.h>
+#include <uniport/test.h>
+
+/** Number of temperatures used for bulk conversion tests */
+#define TEMPERATURE_TEST_LEN 37
+
+/**
+ * Report a bulk integer conversion test result
+ *
+ * @v from		Source temperature units
+ * @v to		Destination temperature units
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void temperature_array_okx ( enum temperature_units from,
+				    enum temperature_units to,
+				    const char *file, unsigned int line ) {
+	int src[TEMPERATURE_TEST_LEN];
+	int dst[TEMPERATURE_TEST_LEN];
+	int expected;
+	unsigned int i;
+
+	for ( i = 0 ; i < TEMPERATURE_TEST_LEN ; i++ )
+		src[i] = ( ( i * 17 ) - 300 );
+	okx ( temperature_convert_array_int ( src, dst, TEMPERATURE_TEST_LEN,
+					      from, to ) == 0, file, line );
+	for ( i = 0 ; i < TEMPERATURE_TEST_LEN ; i++ ) {
+		switch ( to ) {
+		case TEMPERATURE_UNITS_C:
+			expected = temperature_to_celsius_int ( src[i], from );
+			break;
+		case TEMPERATURE_UNITS_F:
+			expected = temperature_to_fahrenheit_int ( src[i],
+								   from );
+			break;
+		default:
+			expected = temperature_to_kelvin_int ( src[i], from );
+			break;
+		}
+		okx ( dst[i] == expected, file, line );
+	}
+}
+#define temperature_array_ok( from, to )				\
+	temperature_array_okx ( from, to, __FILE__, __LINE__ )
+
+/**
+ * Perform temperature conversion self-tests
+ *
+ */
+static void temperature_test_exec ( void ) {
+	float src[2] = { 100.0, -40.0 };
+	float dst[2] = { 1.0, 2.0 };
+
+	/* Bulk conversions match scalar conversions */
+	temperature_array_ok ( TEMPERATURE_UNITS_C, TEMPERATURE_UNITS_F );
+	temperature_array_ok ( TEMPERATURE_UNITS_C, TEMPERATURE_UNITS_K );
+	temperature_array_ok ( TEMPERATURE_UNITS_F, TEMPERATURE_UNITS_C );
+	temperature_array_ok ( TEMPERATURE_UNITS_F, TEMPERATURE_UNITS_K );
+	temperature_array_ok ( TEMPERATURE_UNITS_K, TEMPERATURE_UNITS_C );
+	temperature_array_ok ( TEMPERATURE_UNITS_K, TEMPERATURE_UNITS_F );
+	temperature_array_ok ( TEMPERATURE_UNITS_C, TEMPERATURE_UNITS_C );
+
+	/* Identical units copy values */
+	ok ( temperature_convert_array_float ( src, dst, 2, TEMPERATURE_UNITS_K,
+					       TEMPERATURE_UNITS_K ) == 0 );
+	ok ( memcmp ( src, dst, sizeof ( dst ) ) == 0 );
+
+	/* Invalid units are rejected without modifying destination */
+	dst[0] = dst[1] = 1.0;
+	ok ( temperature_convert_array_float ( src, dst, 2, 'X', 'X' )
+	     == -EINVAL );
+	ok ( temperature_convert_array_float ( src, dst, 2, TEMPERATURE_UNITS_C,
+					       'X' ) == -EINVAL );
+	ok ( temperature_convert_array_float ( src, dst, 2, 0,
+					       TEMPERATURE_UNITS_F )
+	     == -EINVAL );
+	ok ( ( dst[0] == 1.0 ) && ( dst[1] == 1.0 ) );
+}
+
+/** Temperature conversion self-tests */
+struct self_test temperature_test __self_test = {
+	.name = "temperature",
+	.exec = temperature_test_exec,
+};
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2018 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/** @file
+ *
+ * Self-test infrastructure
+ *
+ * Derived from the implementation in iPXE.  Each test set is run in
+ * turn, and the process exits with a failure status if any test
+ * failed.  Test sets may be selected by name pattern on the command
+ * line.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <uniport/string.h>
+#include <uniport/init.h>
+#include <uniport/test.h>
+
+/** Current self-test set */
+static struct self_test *current_tests;
+
+/** Directory containing test data files */
+const char *test_data = TEST_DATA;
+
+/**
+ * Report test result
+ *
+ * @v success		Test succeeded
+ * @v file		File name
+ * @v line		Line number
+ * @v test		Test description
+ */
+void test_ok ( int success, const char *file, unsigned int line,
+	       const char *test ) {
+
+	/* Sanity check */
+	if ( ! current_tests ) {
+		printf ( "TEST %s:%d called outside of a test set\n",
+			 file, line );
+		abort();
+	}
+
+	/* Increment test counter */
+	current_tests->total++;
+
+	/* Report failure if applicable */
+	if ( ! success ) {
+		current_tests->failures++;
+		printf ( "FAILURE: \"%s\" test failed at %s line %d\n",
+			 test, file, line );
+	}
+}
+
+/**
+ * Run self-test set
+ *
+ * @v tests		Self-test set
+ */
+static void run_tests ( struct self_test *tests ) {
+
+	/* Run tests */
+	current_tests = tests;
+	tests->exec();
+	current_tests = NULL;
+
+	/* Check result */
+	if ( tests->failures ) {
+		printf ( "FAILURE: %s self-tests (%d of %d failed)\n",
+			 tests->name, tests->failures, tests->total );
+	} else {
+		printf ( "OK: %s self-tests (%d passed)\n",
+			 tests->name, tests->total );
+	}
+}
+
+/**
+ * Check if self-test set was selected
+ *
+ * @v tests		Self-test set
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret selected	Self-test set was selected
+ */
+static int tests_selected ( struct self_test *tests, int argc, char **argv ) {
+	int i;
+
+	/* Run all test sets if none are named */
+	if ( argc < 2 )
+		return 1;
+
+	/* Otherwise, run only the matching test sets */
+	for ( i = 1 ; i < argc ; i++ ) {
+		if ( glob_match ( argv[i], tests->name ) )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Main program
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret exit		Exit status
+ */
+int main ( int argc, char **argv ) {
+	struct self_test *tests;
+	unsigned int failures = 0;
+	unsigned int total = 0;
+
+	/* Initialise system */
+	setvbuf ( stdout, NULL, _IOLBF, 0 );
+	initialise();
+
+	/* Run all selected test sets */
+	for_each_table_entry ( tests, SELF_TESTS ) {
+		if ( ! tests_selected ( tests, argc, argv ) )
+			continue;
+		run_tests ( tests );
+		failures += tests->failures;
+		total += tests->total;
+	}
+
+	/* Print summary */
+	if ( failures ) {
+		printf ( "FAILURE: %d of %d tests failed\n", failures, total );
+	} else if ( total ) {
+		printf ( "OK: all %d tests passed\n", total );
+	} else {
+		printf ( "FAILURE: no tests were run\n" );
+		failures = 1;
+	}
+
+	return ( failures ? EXIT_FAILURE : EXIT_SUCCESS );
+}